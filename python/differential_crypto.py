@@ -0,0 +1,452 @@
+#!/usr/bin/env python3
+
+## Runs random UIDs, IDs, keys and blocks through every implementation
+## of the tag arithmetic we have, and checks that they agree:
+##
+##   native  toypad/src-pc/protocol/crypto-vectors (C++)
+##   python  legodimensions.py, tea.py, command_0xB3_replayed.py
+##   c       the TEA of c/tea_tester.c
+##   js      the functions of javascript/index.html (with node)
+##
+## Not every implementation has every operation; an operation is
+## compared between those that have it. An implementation that cannot
+## run here (no node, no compiler) is skipped, with a warning. Native
+## and Python are what the others are checked against: a run without
+## them (no make, no numpy) fails, unless --allow-skip says so.
+##
+## Every implementation also reports how fast it is per operation:
+## after a first pass over the inputs (the answers, and the warm-up of
+## a JIT), the best of REPEATS batches. Native and C time batches of
+## 20 ms, JavaScript and Python batches of --batch calls. Anything
+## slower than its baseline (differential_crypto_baseline.json) times
+## --tolerance fails as well, unless it was timed over fewer than
+## MIN_SAMPLES calls: too few to tell a regression from noise.
+## --update-baseline stores the throughputs of this run instead.
+##
+## Exits with 0 if everything agrees and nothing got slower, 1 if not.
+
+import argparse
+import contextlib
+import io
+import json
+import logging
+import os
+import random
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+import types
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+REPO = os.path.dirname(HERE)
+PROTOCOL = os.path.join(REPO, 'toypad', 'src-pc', 'protocol')
+BASELINE = os.path.join(HERE, 'differential_crypto_baseline.json')
+
+## The operations, with the lines of crypto-vectors.cpp.
+OPERATIONS = ['password', 'scramble', 'tea_key', 'encrypt', 'decrypt', 'character', 'shuffle', 'toypad_scramble']
+
+## Timed batches per operation, the fastest counts.
+REPEATS = 5
+## Below this many calls in a batch the throughput is not checked.
+MIN_SAMPLES = 1000
+
+
+
+def random_lines(count, rng):
+	lines = []
+	for operation in OPERATIONS:
+		for _ in range(count):
+			uid = rng.randbytes(7).hex()
+			if operation in ('password', 'tea_key'):
+				lines.append(f"{operation} {uid}")
+			elif operation == 'scramble':
+				lines.append(f"{operation} {uid} {rng.randint(3, 6)}")
+			elif operation == 'character':
+				lines.append(f"{operation} {uid} {rng.randint(1, 999)}")
+			elif operation in ('encrypt', 'decrypt'):
+				lines.append(f"{operation} {rng.randbytes(16).hex()} {rng.randbytes(8).hex()}")
+			elif operation == 'shuffle':
+				lines.append(f"{operation} {rng.randbytes(16).hex()}")
+			else:
+				lines.append(f"{operation} {rng.randbytes(4).hex()}")
+	return lines
+
+def parse_output(output, count):
+	## The answers, then "# <operation> <count> <seconds>".
+	answers = []
+	times = {}
+	for line in output.splitlines():
+		if line.startswith('#'):
+			(_, operation, n, seconds) = line.split()
+			times[operation] = (int(n), float(seconds))
+		else:
+			answers.append(line.strip())
+	if len(answers) != count:
+		raise RuntimeError(f"{count} answers expected, got {len(answers)}")
+	return answers, times
+
+
+
+## Every runner returns the answers (None where it does not have the
+## operation) and, per operation, the calls of its fastest batch and
+## their seconds, or raises Unavailable.
+class Unavailable(Exception):
+	pass
+
+def run_native(lines, batch):
+	program = os.path.join(PROTOCOL, 'crypto-vectors')
+	if shutil.which('make') is None:
+		raise Unavailable("no make")
+	subprocess.run(['make', '--quiet', '-C', PROTOCOL, 'crypto-vectors'], check=True)
+	result = subprocess.run([program], input='\n'.join(lines) + '\n', capture_output=True, text=True, check=True)
+	return parse_output(result.stdout, len(lines))
+
+def run_python(lines, batch):
+	sys.path.insert(0, HERE)
+	try:
+		import numpy
+	except ImportError as e:
+		raise Unavailable(str(e))
+	## command_0xB3_replayed.py imports pyusb for its main() only.
+	try:
+		import usb.core
+		import usb.util
+	except ImportError:
+		usb = types.ModuleType('usb')
+		usb.core = types.ModuleType('usb.core')
+		usb.util = types.ModuleType('usb.util')
+		sys.modules.update({'usb': usb, 'usb.core': usb.core, 'usb.util': usb.util})
+	import command_0xB3_replayed
+	import legodimensions
+	from   tea import TEA
+
+	def compute(operation, args):
+		if operation == 'password':
+			return legodimensions.Tag(uid=bytes.fromhex(args[0])).password
+		if operation == 'scramble':
+			return legodimensions.Tag(uid=bytes.fromhex(args[0])).scramble(int(args[1]))
+		if operation == 'tea_key':
+			return legodimensions.Tag(uid=bytes.fromhex(args[0])).tea_key
+		if operation == 'encrypt':
+			return TEA(bytes.fromhex(args[0]), byteorder='little').encrypt(bytes.fromhex(args[1]))
+		if operation == 'decrypt':
+			return TEA(bytes.fromhex(args[0]), byteorder='little').decrypt(bytes.fromhex(args[1]))
+		if operation == 'character':
+			return legodimensions.Tag(uid=bytes.fromhex(args[0])).encrypt(int(args[1]))
+		if operation == 'shuffle':
+			return command_0xB3_replayed.toypad_shuffle(bytes.fromhex(args[0]))
+		## toypad_scramble() prints every round.
+		with contextlib.redirect_stdout(io.StringIO()):
+			return command_0xB3_replayed.toypad_scramble(bytes.fromhex(args[0]))
+
+	answers = []
+	inputs = {}
+	for line in lines:
+		(operation, *args) = line.split()
+		answers.append(compute(operation, args).hex())
+		inputs.setdefault(operation, []).append(args)
+	times = {}
+	for (operation, args) in inputs.items():
+		best = None
+		for _ in range(REPEATS):
+			start = time.perf_counter()
+			for n in range(batch):
+				compute(operation, args[n % len(args)])
+			seconds = time.perf_counter() - start
+			best = seconds if best is None else min(best, seconds)
+		times[operation] = (batch, best)
+	return answers, times
+
+## A main() for the functions of c/tea_tester.c (its own is renamed).
+C_RUNNER = r'''
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+void encrypt(uint32_t v[2], const uint32_t k[4]);
+void decrypt(uint32_t v[2], const uint32_t k[4]);
+
+#define MAX_LINES 100000
+
+static char operations[MAX_LINES][16];
+static uint32_t keys[MAX_LINES][4], blocks[MAX_LINES][2], answers[MAX_LINES][2];
+static int has[MAX_LINES];
+
+static uint32_t le32(const char * hex)
+{
+	unsigned b[4];
+	sscanf(hex, "%2x%2x%2x%2x", &b[0], &b[1], &b[2], &b[3]);
+	return b[0] | b[1] << 8 | b[2] << 16 | (uint32_t) b[3] << 24;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(void)
+{
+	char line[256], key[64], block[64];
+	int count = 0;
+	while (count < MAX_LINES && fgets(line, sizeof line, stdin))
+	{
+		sscanf(line, "%15s", operations[count]);
+		has[count] = sscanf(line, "%*s %63s %63s", key, block) == 2
+		          && strlen(key) == 32 && strlen(block) == 16
+		          && (!strcmp(operations[count], "encrypt") || !strcmp(operations[count], "decrypt"));
+		if (has[count])
+		{
+			for (int n = 0; n < 4; ++n)
+				keys[count][n] = le32(key + 8 * n);
+			blocks[count][0] = le32(block);
+			blocks[count][1] = le32(block + 8);
+		}
+		++count;
+	}
+	double seconds[2] = {0, 0};
+	int counts[2] = {0, 0};
+	for (int first = 0; first < count; )
+	{
+		int last = first;
+		while (last < count && !strcmp(operations[last], operations[first]))
+			++last;
+		/* As crypto-vectors does: after a first pass, as many times as
+		   fit in 20 ms, REPEATS times; the fastest counts. */
+		int decrypting = !strcmp(operations[first], "decrypt");
+		for (int repeat = 0; has[first] && repeat <= REPEATS; ++repeat)
+		{
+			double start = now(), elapsed;
+			int passes = 0;
+			do
+			{
+				for (int n = first; n < last; ++n)
+					if (has[n])
+					{
+						uint32_t v[2] = {blocks[n][0], blocks[n][1]};
+						if (decrypting)
+							decrypt(v, keys[n]);
+						else
+							encrypt(v, keys[n]);
+						answers[n][0] = v[0];
+						answers[n][1] = v[1];
+					}
+				++passes;
+				elapsed = now() - start;
+			}
+			while (repeat && elapsed < 0.02);
+			int calls = passes * (last - first);
+			if (repeat && (!counts[decrypting] || calls / elapsed > counts[decrypting] / seconds[decrypting]))
+			{
+				seconds[decrypting] = elapsed;
+				counts[decrypting] = calls;
+			}
+		}
+		first = last;
+	}
+	for (int n = 0; n < count; ++n)
+	{
+		if (!has[n])
+		{
+			printf("-\n");
+			continue;
+		}
+		for (int w = 0; w < 2; ++w)
+			for (int b = 0; b < 4; ++b)
+				printf("%02x", (answers[n][w] >> (8 * b)) & 0xff);
+		printf("\n");
+	}
+	printf("# encrypt %d %.9f\n# decrypt %d %.9f\n", counts[0], seconds[0], counts[1], seconds[1]);
+	return 0;
+}
+'''
+
+def run_c(lines, batch):
+	compiler = shutil.which('cc') or shutil.which('gcc')
+	if compiler is None:
+		raise Unavailable("no C compiler")
+	with tempfile.TemporaryDirectory() as directory:
+		runner = os.path.join(directory, 'runner.c')
+		program = os.path.join(directory, 'runner')
+		with open(runner, 'w') as f:
+			f.write(C_RUNNER)
+		subprocess.run(
+			[compiler, '-O2', '-Dmain=tea_tester_main', '-c', os.path.join(REPO, 'c', 'tea_tester.c'), '-o', program + '-tea.o'],
+			check=True,
+		)
+		subprocess.run([compiler, '-O2', f'-DREPEATS={REPEATS}', runner, program + '-tea.o', '-o', program], check=True)
+		result = subprocess.run([program], input='\n'.join(lines) + '\n', capture_output=True, text=True, check=True)
+	answers, times = parse_output(result.stdout, len(lines))
+	return [None if answer == '-' else answer for answer in answers], times
+
+## The functions of javascript/index.html, in node: the script of the
+## page without the page.
+JS_RUNNER = r'''
+const fs = require('fs');
+const vm = require('vm');
+const html = fs.readFileSync(process.argv[2], 'utf-8');
+const script = html.match(/<script>([\s\S]*)<\/script>/)[1];
+globalThis.document = { querySelector: () => ({ addEventListener: () => {} }), forms: {} };
+console.log = () => {};
+vm.runInThisContext(script);
+
+const hex = (words) => Array.from(words, (word) => uint322hexstr(word)).join('');
+const le = (word) => swap_endianness_32(word);
+const words = (text) => Array.from({ length: text.length / 8 }, (_, n) => le(parseInt(text.substr(8 * n, 8), 16)));
+const operations = {
+	password: (uid) => hex([uid2password(BigInt('0x' + uid))]),
+	scramble: (uid, rounds) => hex([le(scramble(BigInt('0x' + uid), parseInt(rounds)))]),
+	tea_key: (uid) => hex(tea_key(BigInt('0x' + uid)).map(le)),
+	encrypt: (key, block) => hex(tea_encrypt(Uint32Array.from(words(block)), Uint32Array.from(words(key)))),
+	character: (uid, id) => hex(tea_encrypt(Uint32Array.from([parseInt(id), parseInt(id)]), tea_key(BigInt('0x' + uid)))),
+};
+
+const batch = parseInt(process.argv[3]);
+const repeats = parseInt(process.argv[4]);
+const lines = fs.readFileSync(0, 'utf-8').split('\n').filter((line) => line.length);
+const answers = [];
+const inputs = {};
+for (const line of lines)
+{
+	const [operation, ...args] = line.split(' ');
+	const compute = operations[operation];
+	if (!compute)
+	{
+		answers.push('-');
+		continue;
+	}
+	answers.push(compute(...args));
+	(inputs[operation] || (inputs[operation] = [])).push(args);
+}
+process.stdout.write(answers.join('\n') + '\n');
+// Warmed up by the answers; then the fastest of repeats batches of
+// batch calls (their lengths add up, so none is optimized away).
+let length = 0;
+for (const [operation, args] of Object.entries(inputs))
+{
+	const compute = operations[operation];
+	let best = Infinity;
+	for (let repeat = 0; repeat < repeats; ++repeat)
+	{
+		const start = process.hrtime.bigint();
+		for (let n = 0; n < batch; ++n)
+			length += compute(...args[n % args.length]).length;
+		best = Math.min(best, Number(process.hrtime.bigint() - start) / 1e9);
+	}
+	process.stdout.write(`# ${operation} ${batch} ${best.toFixed(9)}\n`);
+}
+'''
+
+def run_js(lines, batch):
+	node = shutil.which('node') or shutil.which('nodejs')
+	if node is None:
+		raise Unavailable("no node")
+	with tempfile.TemporaryDirectory() as directory:
+		runner = os.path.join(directory, 'runner.js')
+		with open(runner, 'w') as f:
+			f.write(JS_RUNNER)
+		result = subprocess.run(
+			[node, runner, os.path.join(REPO, 'javascript', 'index.html'), str(batch), str(REPEATS)],
+			input='\n'.join(lines) + '\n', capture_output=True, text=True, check=True,
+		)
+	answers, times = parse_output(result.stdout, len(lines))
+	return [None if answer == '-' else answer for answer in answers], times
+
+RUNNERS = {
+	'native': run_native,
+	'python': run_python,
+	'c': run_c,
+	'js': run_js,
+}
+
+## Without these there is not much of a cross-check.
+REQUIRED = ('native', 'python')
+
+
+
+def main():
+	parser = argparse.ArgumentParser(
+		prog='Differential test of the LEGO Dimensions tag arithmetic',
+		description='Runs random inputs through the native, Python, C and JavaScript implementations and compares the answers and the throughputs.',
+	)
+	parser.add_argument('--count', type=int, default=200, help='Random inputs per operation.')
+	parser.add_argument('--batch', type=int, default=2000, help='Calls per timed batch of JavaScript and Python.')
+	parser.add_argument('--seed', type=int, default=1, help='Of the random inputs.')
+	parser.add_argument('--only', action='append', choices=RUNNERS.keys(), help='Run only this implementation (again for more).')
+	parser.add_argument('--allow-skip', action='append', default=[], choices=REQUIRED, help='Do not fail if this implementation cannot run here (again for more).')
+	parser.add_argument('--tolerance', type=float, default=0.5, help='Fail below this fraction of the baseline throughput.')
+	parser.add_argument('--update-baseline', action='store_true', help=f'Store the throughputs of this run in {os.path.basename(BASELINE)}.')
+	parser.add_argument('--verbose', '-v', action='store_true', help='Be verbose.')
+	args = parser.parse_args()
+
+	logging.basicConfig(level=logging.DEBUG if args.verbose else logging.INFO, format='%(message)s')
+
+	lines = random_lines(args.count, random.Random(args.seed))
+	## Wyldstyle, the vector of c/tea_tester.c.
+	lines.insert(0, "character 0413bb1a994080 3")
+	results = {}
+	failures = 0
+	for name in args.only or RUNNERS.keys():
+		try:
+			results[name] = RUNNERS[name](lines, args.batch)
+		except Unavailable as e:
+			if name in REQUIRED and name not in args.allow_skip:
+				logging.error(f"{name}: cannot run here ({e}); nothing is checked against it (--allow-skip {name} to go on without)")
+				failures += 1
+			else:
+				logging.warning(f"{name}: SKIPPED ({e})")
+
+	if results.get('native') and results['native'][0][0] != '0139ed60e4be307c':
+		logging.error(f"native: Wyldstyle is {results['native'][0][0]}, not 0139ed60e4be307c")
+		failures += 1
+
+	## Every answer against those of the other implementations.
+	for (n, line) in enumerate(lines):
+		answers = {name: result[0][n] for (name, result) in results.items() if result[0][n] is not None}
+		if len(set(answers.values())) > 1:
+			failures += 1
+			if failures <= 10:
+				logging.error(f"mismatch: {line}: " + ', '.join(f"{name}={answer}" for (name, answer) in answers.items()))
+	compared = {name: sum(answer is not None for answer in result[0]) for (name, result) in results.items()}
+	logging.info(f"{len(lines)} inputs, answers per implementation: " + ', '.join(f"{name} {count}" for (name, count) in compared.items()))
+
+	baseline = {}
+	if os.path.exists(BASELINE):
+		with open(BASELINE) as f:
+			baseline = json.load(f)
+	for (name, (_, times)) in results.items():
+		for (operation, (calls, seconds)) in sorted(times.items()):
+			per_second = calls / max(seconds, 1e-9)
+			expected = baseline.get(name, {}).get(operation)
+			note = ''
+			if calls < MIN_SAMPLES:
+				note = f" ({calls} calls, too few to check)"
+			elif expected is not None:
+				note = f" (baseline {expected:.0f}, {per_second / expected:.0%})"
+				if not args.update_baseline and per_second < expected * args.tolerance:
+					note += ' REGRESSION'
+					failures += 1
+			logging.info(f"{name:6s} {operation:15s} {per_second:14.0f} per second{note}")
+
+	if args.update_baseline and failures:
+		logging.error("Not writing the baseline of a run with failures.")
+	elif args.update_baseline:
+		for (name, (_, times)) in results.items():
+			baseline[name] = {operation: round(calls / max(seconds, 1e-9)) for (operation, (calls, seconds)) in sorted(times.items()) if calls >= MIN_SAMPLES}
+		with open(BASELINE, 'w') as f:
+			json.dump(baseline, f, indent='\t', sort_keys=True)
+			f.write('\n')
+		logging.info(f"Baseline written to {BASELINE}.")
+
+	logging.info(f"{failures} failures")
+	return 1 if failures else 0
+
+
+
+if __name__ == '__main__':
+	sys.exit(main())
@@ -0,0 +1,112 @@
+#!/usr/bin/env python3
+
+## Client of toypad/src-pc/protocol/tag-server: the pages of tags for
+## UIDs and IDs, without numpy, without the catalog JSON and without
+## working out the keys ourselves (see tag-service.hpp for the requests
+## and replies).
+##
+##   with TagService() as service:
+##   	memory = service.tags([(uid, 3)])[0]            ## 180 bytes
+##   	(pages, password) = service.pages([(uid, 3)])[0] ## 16 bytes, int
+##
+## As a script: the pages 0x24 to 0x27 and the password of UID ID pairs,
+## or the metrics of the server with --stats.
+
+import argparse
+import logging
+import socket
+import struct
+import sys
+
+DEFAULT_SOCKET = '/tmp/tag-service.socket'
+
+OP_TAGS  = 1
+OP_PAGES = 2
+OP_STATS = 3
+
+STATUS_OK = 0
+
+UID_SIZE         = 7
+TAG_MEMORY_SIZE  = 4 * 45
+PAGES_REPLY_SIZE = 16 + 4
+MAX_REQUEST_TAGS = 4096
+
+
+
+class TagService:
+	def __init__(self, path=DEFAULT_SOCKET):
+		self.socket = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+		self.socket.connect(path)
+
+	def __enter__(self):
+		return self
+
+	def __exit__(self, *exception):
+		self.close()
+
+	def close(self):
+		self.socket.close()
+
+	## tags: (uid, id) pairs, the UID as 7 bytes. Every tag its whole
+	## memory.
+	def tags(self, tags):
+		reply = self._call(OP_TAGS, tags)
+		return [reply[n:n + TAG_MEMORY_SIZE] for n in range(0, len(reply), TAG_MEMORY_SIZE)]
+
+	## Every tag pages 0x24 to 0x27 (16 bytes) and its password.
+	def pages(self, tags):
+		reply = self._call(OP_PAGES, tags)
+		return [(reply[n:n + 16], struct.unpack_from('<I', reply, n + 16)[0]) for n in range(0, len(reply), PAGES_REPLY_SIZE)]
+
+	## In the text format of Prometheus.
+	def stats(self):
+		return self._call(OP_STATS, []).decode()
+
+	def _call(self, op, tags):
+		if len(tags) > MAX_REQUEST_TAGS:
+			raise ValueError(f"at most {MAX_REQUEST_TAGS} tags per request")
+		request = bytearray(struct.pack('<BBH', op, 0, len(tags)))
+		for (uid, tag_id) in tags:
+			if len(uid) != UID_SIZE:
+				raise ValueError(f"UID {uid.hex()}: not {UID_SIZE} bytes")
+			request += uid + struct.pack('<I', tag_id)
+		self.socket.sendall(request)
+		(status, _, count, size) = struct.unpack('<BBHI', self._receive(8))
+		if status != STATUS_OK:
+			raise RuntimeError("tag service: bad request")
+		return self._receive(size)
+
+	def _receive(self, size):
+		data = bytearray()
+		while len(data) < size:
+			chunk = self.socket.recv(size - len(data))
+			if not chunk:
+				raise RuntimeError("tag service: hung up")
+			data += chunk
+		return bytes(data)
+
+
+
+def main():
+	parser = argparse.ArgumentParser(
+		description='The pages 0x24 to 0x27 and the password of tags, from tag-server.',
+	)
+	parser.add_argument('tags', nargs='*', metavar='UID ID', help='UID (hex, 7 bytes) and ID pairs.')
+	parser.add_argument('--socket', default=DEFAULT_SOCKET, help=f"The socket of tag-server ({DEFAULT_SOCKET}).")
+	parser.add_argument('--stats', action='store_true', help='Print the metrics of the server.')
+	parser.add_argument('--verbose', '-v', action='store_true', help='Be verbose.')
+	args = parser.parse_args()
+	logging.basicConfig(level=logging.DEBUG if args.verbose else logging.INFO, format='%(message)s')
+
+	if len(args.tags) % 2:
+		parser.error("UID and ID pairs expected")
+	tags = [(bytes.fromhex(args.tags[n]), int(args.tags[n + 1], 0)) for n in range(0, len(args.tags), 2)]
+	with TagService(args.socket) as service:
+		if args.stats:
+			print(service.stats(), end='')
+		for ((uid, tag_id), (pages, password)) in zip(tags, service.pages(tags) if tags else []):
+			print(f"{uid.hex()} {tag_id}: pages {pages.hex()}, password {password:08x}")
+	return 0
+
+if __name__ == '__main__':
+	sys.exit(main())
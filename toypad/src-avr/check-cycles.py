@@ -0,0 +1,212 @@
+#!/usr/bin/env python3
+# Check the cycle budget of the glitch in the BUILT glitcher, i.e. after
+# the compiler and the linker had their say. Disassembles glitcher.elf
+# and checks:
+#
+#   1. The vectors of the TIMER1 OVF and TIMER4 COMPB interrupts are a
+#      bare "reti" (see the vector table in glitcher.cpp).
+#   2. Every copy of the timed sequence of run_glitch() is exactly:
+#
+#        out   PORTB, rXX         release the reset of the LPC11U35
+#        sts   TCCR1B, rXX        start timer 1
+#        sleep                    woken up by TIMER1 OVF
+#        sts   TCCR4B, rXX        start timer 4
+#        sts   TCCR1B, r1         stop timer 1
+#        sleep                    woken up by TIMER4 COMPB
+#        sts   TCCR4B, r1         stop timer 4
+#
+#   3. Every other "out PORTB" directly followed by starting timer 1 is
+#      the start of the boot calibration of command_calibrate():
+#
+#        out   PORTB, rXX         release the reset of the LPC11U35
+#        sts   TCCR1B, rXX        start timer 1
+#        ...                      polling, never a sleep
+#
+#   4. The cycles of those paths, as disassembled, add up to the
+#      constants in glitcher.hpp.
+#
+# Exits with status 1 (and so fails "make") if not.
+#
+# Usage: ./check-cycles.py <glitcher.elf> <glitcher.hpp> [objdump output]
+
+import re
+import subprocess
+import sys
+
+# ATmega32U4 datasheet, "Instruction Set Summary", and "Interrupt
+# Response Time" (sleep adds 5 cycles).
+INSTRUCTION_CYCLES = {
+	'out': 1,
+	'sts': 2,
+	'sleep': 1,
+	'reti': 5,
+}
+SLEEP_WAKE_UP_CYCLES = 5
+INTERRUPT_RESPONSE_CYCLES = 5
+
+# I/O and data space addresses.
+PORTB = 0x05
+TCCR1B = 0x81
+TCCR4B = 0xC1
+
+# Vector numbers, 4 bytes per vector.
+VECTOR_SIZE = 4
+TIMER1_OVF_VECTOR = 20
+TIMER4_COMPB_VECTOR = 39
+
+# (mnemonic, first operand, second operand or None for any register)
+SEQUENCE = (
+	('out', PORTB, None),
+	('sts', TCCR1B, None),
+	('sleep', None, None),
+	('sts', TCCR4B, None),
+	('sts', TCCR1B, 'r1'),
+	('sleep', None, None),
+	('sts', TCCR4B, 'r1'),
+)
+
+# The start of command_calibrate(): timer 1 then timestamps the markers
+# of the target with its input capture unit, nothing else is timed.
+CALIBRATION_SEQUENCE = SEQUENCE[:2]
+
+#      1b4:	05 b9       	out	0x05, r16	; 5
+LINE = re.compile(r'^\s*([0-9a-f]+):\s+(?:[0-9a-f]{2} )+\s*([a-z]+)\s*([^;]*)')
+
+def disassemble(elf):
+	return subprocess.run(('avr-objdump', '--disassemble', elf),
+		check = True, stdout = subprocess.PIPE,
+		universal_newlines = True).stdout
+
+def parse(objdump):
+	'''List of (address, mnemonic, operands).'''
+	instructions = []
+	for line in objdump.splitlines():
+		match = LINE.match(line)
+		if not match:
+			continue
+		operands = [op.strip() for op in match.group(3).split(',') if op.strip()]
+		instructions.append((int(match.group(1), 16), match.group(2), operands))
+	return instructions
+
+def read_defines(header):
+	'''The #defines of the header that evaluate to a number.'''
+	raw = {}
+	with open(header) as f:
+		for line in f:
+			match = re.match(r'#define\s+(\w+)\s+(.+?)\s*(//.*)?$', line)
+			if match:
+				raw[match.group(1)] = match.group(2)
+	def evaluate(name, depth = 0):
+		expression = raw[name]
+		if depth > 10 or not re.fullmatch(r'[\w\s()+*<-]+', expression):
+			raise ValueError(name)
+		expression = re.sub(r'[A-Za-z_]\w*',
+			lambda m: str(evaluate(m.group(0), depth + 1)), expression)
+		return eval(expression, {'__builtins__': {}})
+	defines = {}
+	for name in raw:
+		try:
+			defines[name] = evaluate(name)
+		except (KeyError, ValueError, SyntaxError):
+			pass
+	return defines
+
+def matches(instruction, expected):
+	address, mnemonic, operands = instruction
+	want_mnemonic, want_first, want_second = expected
+	if mnemonic != want_mnemonic:
+		return False
+	if want_first is None:
+		return not operands
+	if len(operands) != 2 or int(operands[0], 0) != want_first:
+		return False
+	return want_second is None or operands[1] == want_second
+
+def find_sequences(instructions, sequence = SEQUENCE):
+	'''Start indices of all (complete) copies of the sequence.'''
+	found = []
+	for i in range(len(instructions) - len(sequence) + 1):
+		if all(matches(instructions[i + j], sequence[j]) for j in range(len(sequence))):
+			found.append(i)
+	return found
+
+def check(instructions, defines):
+	'''List of errors, empty if the timing is as glitcher.hpp says.'''
+	errors = []
+	by_address = {address: (mnemonic, operands) for address, mnemonic, operands in instructions}
+
+	def cycles(mnemonics):
+		return sum(INSTRUCTION_CYCLES.get(m, 0) for m in mnemonics)
+
+	vectors = {}
+	for name, vector in (('TIMER1 OVF', TIMER1_OVF_VECTOR),
+			('TIMER4 COMPB', TIMER4_COMPB_VECTOR)):
+		address = vector * VECTOR_SIZE
+		mnemonic = by_address.get(address, ('missing', []))[0]
+		vectors[vector] = mnemonic
+		if mnemonic != 'reti':
+			errors.append('vector %d (%s) at 0x%x is "%s", not "reti"' %
+				(vector, name, address, mnemonic))
+
+	sequences = find_sequences(instructions)
+	if not sequences:
+		errors.append('timed sequence of run_glitch() not found')
+	# Any other "out PORTB" directly followed by starting timer 1 is the
+	# calibration of command_calibrate(), which polls and never sleeps.
+	# If it does go to sleep soon after (like run_glitch()), it is a
+	# broken copy of the sequence.
+	calibrations = []
+	for i in find_sequences(instructions, CALIBRATION_SEQUENCE):
+		if i in sequences:
+			continue
+		if any(mnemonic == 'sleep' for address, mnemonic, operands
+				in instructions[i + 2:i + len(SEQUENCE)]):
+			errors.append('timed sequence at 0x%x differs from run_glitch()' %
+				instructions[i][0])
+		else:
+			calibrations.append(i)
+
+	# The cycles of the instructions as they are in the disassembly, per
+	# copy. Waking up runs the reti of the vector (if it is one, see
+	# above), then the next "sts".
+	def wake_up(vector, sts):
+		return SLEEP_WAKE_UP_CYCLES + INTERRUPT_RESPONSE_CYCLES \
+			+ cycles((vectors[vector], instructions[sts][1]))
+	budget = []
+	for i in sequences:
+		budget.append((i, 'CPU_CYCLES_BEFORE_STARTING_TIMER1',
+			cycles(instruction[1] for instruction in instructions[i:i + 2])))
+		for name, vector, sts in (
+				('TIMER1_INTERRUPT_CPU_CYCLES_BEFORE_STARTING_TIMER4', TIMER1_OVF_VECTOR, i + 3),
+				('TIMER4_INTERRUPT_CPU_CYCLES_BEFORE_STOPPING_TIMER4', TIMER4_COMPB_VECTOR, i + 6)):
+			if vectors[vector] == 'reti':
+				budget.append((i, name, wake_up(vector, sts)))
+	for i in calibrations:
+		budget.append((i, 'CALIBRATION_CPU_CYCLES_BEFORE_STARTING_TIMER1',
+			cycles(instruction[1] for instruction in instructions[i:i + 2])))
+	for i, name, counted in budget:
+		if name not in defines:
+			errors.append('%s not defined' % name)
+		elif defines[name] != counted:
+			errors.append('%s is %d, but the code at 0x%x takes %d cycles' %
+				(name, defines[name], instructions[i][0], counted))
+	return errors
+
+def main():
+	if len(sys.argv) not in (3, 4):
+		print('Usage: %s <glitcher.elf> <glitcher.hpp> [objdump output]' % sys.argv[0])
+		sys.exit(2)
+	if len(sys.argv) == 4:
+		with open(sys.argv[3]) as f:
+			objdump = f.read()
+	else:
+		objdump = disassemble(sys.argv[1])
+	errors = check(parse(objdump), read_defines(sys.argv[2]))
+	for error in errors:
+		print('%s: %s' % (sys.argv[1], error))
+	if errors:
+		sys.exit(1)
+	print('%s: cycle budget OK' % sys.argv[1])
+
+if __name__ == '__main__':
+	main()
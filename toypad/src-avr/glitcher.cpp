@@ -7,6 +7,7 @@
 
 #include "usart.hpp"
 #include "glitcher.hpp"
+#include "swd.hpp"
 
 /*
      _____ _              _     _
@@ -88,14 +89,66 @@ __attribute__((__used__))
 	[40] = JMP_0000,[41] = JMP_0000,[42] = JMP_0000,
 };
 
+// The timing of run_glitch() depends on these. check-cycles.py checks
+// the instructions that were actually emitted.
+static_assert(ISR_NUM_ELEMENTS == 43,
+  "vector table layout changed, fix the vector numbers above");
+static_assert(TIMER1_INTERRUPT_CPU_CYCLES_BEFORE_STARTING_TIMER4
+  == CPU_CYCLES_SLEEP_WAKE_UP + CPU_CYCLES_INTERRUPT_RESPONSE
+   + CPU_CYCLES_RETI + CPU_CYCLES_STS,
+  "timer 1 wake up: sleep + interrupt + reti + sts");
+static_assert(TIMER4_INTERRUPT_CPU_CYCLES_BEFORE_STOPPING_TIMER4
+  == CPU_CYCLES_SLEEP_WAKE_UP + CPU_CYCLES_INTERRUPT_RESPONSE
+   + CPU_CYCLES_RETI + CPU_CYCLES_STS,
+  "timer 4 wake up: sleep + interrupt + reti + sts");
+// Timer 1 must be stopped before it overflows again (at least after
+// 1 CPU cycle), timer 4 before it wraps around to the start of a
+// second glitch. The latter limits the glitch, see MAX_GLITCH_TICKS_*.
+static_assert(CPU_CYCLES_STS < TIMER1_INTERRUPT_CPU_CYCLES_BEFORE_STARTING_TIMER4,
+  "timer 1 must be stopped before it overflows again");
+static_assert((MAX_GLITCH_TICKS_48MHZ - 1)
+  + 3 * TIMER4_INTERRUPT_CPU_CYCLES_BEFORE_STOPPING_TIMER4 < (1 << 10),
+  "timer 4 must be stopped before it starts a second glitch (48 MHz)");
+static_assert((MAX_GLITCH_TICKS_96MHZ - 1)
+  + 6 * TIMER4_INTERRUPT_CPU_CYCLES_BEFORE_STOPPING_TIMER4 < (1 << 10),
+  "timer 4 must be stopped before it starts a second glitch (96 MHz)");
+static_assert(MAX_GLITCH_TICKS_96MHZ > MIN_TIMER4_TICKS_BEFORE_OVERFLOW,
+  "there must be room for a glitch at 96 MHz");
+static_assert(MIN_TIMER4_TICKS_BEFORE_OVERFLOW < (1 << 10),
+  "timer 4 is a 10 bit timer");
+static_assert(LOOP_TIMER4_TICKS_BEFORE_PULSE < MIN_TIMER4_TICKS_BEFORE_OVERFLOW,
+  "see LOOP_TIMER4_TICKS_BEFORE_PULSE");
+static_assert(3 * LOOP_MIN_PERIOD_CPU_CYCLES > LOOP_MAX_PULSE_STEPS,
+  "the longest pulse must fit in the shortest period");
+
 
 
 void setup_clocks();
 void setup_timer1(uint16_t timer_ticks_wanted_before_overflow);
+void setup_timer1_registers(uint16_t tcnt1);
 void setup_timer4(
     uint16_t timer_ticks_before_compare_match,
-    uint16_t timer_ticks_before_overflow
+    uint16_t timer_ticks_before_overflow,
+    uint8_t dead_time = 0
 );
+void setup_timer4_registers(uint16_t tcnt4, uint16_t ocr4b, uint8_t dt4);
+void command_glitch();
+void command_timed_glitch();
+void run_glitch(uint8_t cs4_divider);
+void command_resolution();
+void command_calibrate();
+void command_loop();
+void command_swd_oracle();
+char swd_oracle();
+uint8_t select_timer4_resolution(uint8_t resolution_wanted);
+bool timer4_self_test(uint8_t plltm, uint8_t cs4_divider, uint8_t ticks_per_cpu_cycle);
+bool timer4_dead_time_self_test();
+
+// The resolution timer 4 currently runs at. See glitcher.hpp.
+static uint8_t timer4_resolution = TIMER4_RESOLUTION_48MHZ;
+
+// Whether command 'G' checks SWD after the glitch. See command 'S'.
+static bool swd_oracle_enabled = false;
 
 /* The downside of using linker flag "-nostartfiles" is that section 
  .init2 and .init9 are not linked in. Hence, we must borrow code from 
@@ -171,187 +224,770 @@ int main()
       }
     }
     
-    // RX has completed; we can read a byte. Expect the 'G', which 
-    // stands for "glitch".
+    // RX has completed; we can read a byte. This is the command:
+    // 
+    //   'G': Glitch. See command_glitch().
+    //   'T': Glitch with precomputed registers. See command_timed_glitch().
+    //   'R': Select the resolution of timer 4. See command_resolution().
+    //   'C': Calibrate the boot timing. See command_calibrate().
+    //   'L': Pulse until the target faults. See command_loop().
+    //   'S': Check SWD after each glitch. See command_swd_oracle().
     char magic_byte = UDR1;
-    if (magic_byte != 'G')    {
-      usart_transmit_string("FAIL\r\n");
-      continue;
-    }
 #ifdef USART_ECHO
     usart_transmit_string("\r\n");
     usart_transmit_char(magic_byte);
 #endif
-    
-    uint16_t post_reset_ticks_at_48MHz = usart_receive_uint16();
-    uint16_t glitch_ticks_at_48MHz     = usart_receive_uint16();
-    if (glitch_ticks_at_48MHz <= 1)
+    switch (magic_byte)
     {
-      usart_transmit_string("FAIL: GLITCH TOO SHORT\r\n");
-      continue;
+      case 'G':
+        command_glitch();
+        break;
+      case 'T':
+        command_timed_glitch();
+        break;
+      case 'R':
+        command_resolution();
+        break;
+      case 'C':
+        command_calibrate();
+        break;
+      case 'L':
+        command_loop();
+        break;
+      case 'S':
+        command_swd_oracle();
+        break;
+      default:
+        usart_transmit_string("FAIL\r\n");
     }
+  }
+}
+
+
+
+// Command 'G': "G<post reset ticks>,<glitch ticks>\n".
+// 
+// Both numbers are in steps of the current resolution of timer 4, i.e. 
+// in 48 MHz ticks by default and in 96 MHz ticks after "R2".
+inline void command_glitch()
+{
+  uint16_t post_reset_steps = usart_receive_uint16();
+  uint16_t glitch_steps     = usart_receive_uint16();
+  if (glitch_steps <= 1)
+  {
+    usart_transmit_string("FAIL: GLITCH TOO SHORT\r\n");
+    return;
+  }
+  
+#ifdef USART_ECHO
+  usart_transmit_string("\r\n");
+#endif
+
+  usart_transmit_string("Glitching: post reset = ");
+  usart_transmit_num(post_reset_steps);
+  usart_transmit_string("; glitch ticks = ");
+  usart_transmit_num(glitch_steps);
+  usart_transmit_string(".\r\n");
+  
+  // Convert steps into ticks of the timer 4 counter.
+  // 
+  // The CPU runs at 16 MHz (or more precise: F_CPU). But the high 
+  // speed timer 4 runs at 48 MHz (or more precise: 48 MHz times the 
+  // PLL postscalar), or even 96 MHz.
+  uint16_t post_reset_timer4_ticks = post_reset_steps;
+  uint16_t glitch_timer4_ticks     = glitch_steps;
+  uint8_t frequency_ratio = 3;
+  uint16_t max_glitch_timer4_ticks = MAX_GLITCH_TICKS_48MHZ;
+  uint8_t cs4_divider = CS4_DIVIDER;
+  uint8_t dead_time = 0;
+  switch (timer4_resolution)
+  {
+    case TIMER4_RESOLUTION_96MHZ:
+      frequency_ratio = 6;
+      max_glitch_timer4_ticks = MAX_GLITCH_TICKS_96MHZ;
+      break;
     
+    case TIMER4_RESOLUTION_96MHZ_DEAD_TIME:
+      // The counter runs at 48 MHz, i.e. 1 tick is 2 steps. An odd 
+      // offset is made up by 1 step (1 PCK cycle) of dead time on the 
+      // rising edge of OC4B. The falling edge can only happen on a 
+      // counter tick, so an odd end of the glitch is rounded up: the 
+      // glitch is then 1 step longer than asked for, and we say so.
+      // 
+      // Reset the prescaler when starting timer 4, otherwise we don't 
+      // know in which half of a counter tick we start.
+      dead_time = post_reset_steps & 1;
+      post_reset_timer4_ticks = post_reset_steps >> 1;
+      glitch_timer4_ticks = ((post_reset_steps + glitch_steps + 1) >> 1)
+                          - post_reset_timer4_ticks;
+      cs4_divider = CS4_DIVIDER_2 | _BV(PSR4);
+      
+      usart_transmit_string("Dead time = ");
+      usart_transmit_num(dead_time);
+      usart_transmit_string("; actual glitch ticks = ");
+      usart_transmit_num(2 * glitch_timer4_ticks - dead_time);
+      if (2 * glitch_timer4_ticks - dead_time != glitch_steps)
+      {
+        usart_transmit_string(" (ROUNDED UP)");
+      }
+      usart_transmit_string(".\r\n");
+      break;
+  }
+  
+  if (glitch_timer4_ticks <= 1)
+  {
+    usart_transmit_string("FAIL: GLITCH TOO SHORT\r\n");
+    return;
+  }
+  // Timer 4 is 10 bits, and counts on for a while after the end of the 
+  // glitch. It must not wrap around to a second glitch before the 
+  // interrupt stops it, see MAX_GLITCH_TICKS_48MHZ.
+  if (glitch_timer4_ticks > max_glitch_timer4_ticks)
+  {
+    usart_transmit_string("FAIL: GLITCH TOO LONG\r\n");
+    return;
+  }
+  
+  uint16_t timer1_ticks;
+  uint16_t  timer4_ticks;
+
+  if (post_reset_timer4_ticks <= MIN_TIMER4_TICKS_BEFORE_OVERFLOW)
+  {
+    usart_transmit_string("FAIL\r\n");
+    return;
+  }
+  
+  // We subtract ticks here so they won't be part of coarse timer 1. 
+  // We will add these ticks to timer 4 later.
+  uint16_t post_reset_ticks =
+    post_reset_timer4_ticks - MIN_TIMER4_TICKS_BEFORE_OVERFLOW;
+  
+  timer1_ticks =  post_reset_ticks / frequency_ratio;
+  timer4_ticks = (post_reset_ticks % frequency_ratio)
+               + MIN_TIMER4_TICKS_BEFORE_OVERFLOW;
+  usart_transmit_string("Timer 1 ticks before glitch: ");
+  usart_transmit_num(timer1_ticks);
+  usart_transmit_string("; timer 4 ticks before glitch: ");
+  usart_transmit_num(timer4_ticks);
+  usart_transmit_string(".\r\n");
+  
+  // We will start timer 1 precisely 3 CPU cycle later than starting 
+  // the LPC11U35, compensate.
+  timer1_ticks += CPU_CYCLES_BEFORE_STARTING_TIMER1;
+  
+  // We need at least 1 CPU cycle for the timer to fire.
+  if (timer1_ticks <= TIMER1_INTERRUPT_CPU_CYCLES_BEFORE_STARTING_TIMER4)
+  {
+    usart_transmit_string("FAIL: POST RESET TOO SHORT\r\n");
+    return;
+  }
+  timer1_ticks -= TIMER1_INTERRUPT_CPU_CYCLES_BEFORE_STARTING_TIMER4;
+  
+  setup_timer1(timer1_ticks);
+  setup_timer4(timer4_ticks, glitch_timer4_ticks, dead_time);
+  run_glitch(cs4_divider);
+  usart_transmit_string("DONE\r\n");
+}
+
+
+
+// Command 'T': "T<TCNT1>,<TCNT4>,<OCR4B>,<DT4>,<TCCR4B>\n".
+// 
+// Like 'G', but with the register values computed by the host (see 
+// src-pc/timing.py), from a calibration profile of this board. No 
+// arithmetic here, just some sanity checks so a bad value cannot give a 
+// second glitch.
+// 
+// The resolution (PLL postscaler) must have been selected with 'R'; 
+// <TCCR4B> is the clock select of timer 4, CS4_DIVIDER_1 or 
+// CS4_DIVIDER_2 (nothing slower: MAX_GLITCH_TICKS_* only bound the 
+// glitch for those), with PSR4 for dead time. <DT4> is the dead time, 
+// only with PSR4.
+inline void command_timed_glitch()
+{
+  uint16_t tcnt1  = usart_receive_uint16();
+  uint16_t tcnt4  = usart_receive_uint16();
+  uint16_t ocr4b  = usart_receive_uint16();
+  uint16_t dt4    = usart_receive_uint16();
+  uint16_t tccr4b = usart_receive_uint16();
 #ifdef USART_ECHO
+  usart_transmit_string("\r\n");
+#endif
+  
+  // The longest glitch, as in command_glitch(): timer 4 counts 6 ticks 
+  // per CPU cycle at clk_TMR = 96 MHz without a divider, 3 (or fewer) 
+  // otherwise.
+  uint16_t max_glitch_timer4_ticks = MAX_GLITCH_TICKS_48MHZ;
+  if (timer4_resolution != TIMER4_RESOLUTION_48MHZ
+   && (tccr4b & 0x0F) == CS4_DIVIDER_1)
+  {
+    max_glitch_timer4_ticks = MAX_GLITCH_TICKS_96MHZ;
+  }
+  
+  // Timer 4 must not overflow before the interrupt of timer 1 has 
+  // started it, and the interrupt of timer 4 must be able to stop it 
+  // before it overflows again. The glitch is at least 2 ticks, like in 
+  // command_glitch(). run_glitch() and setup_timer4_registers() take 
+  // bytes, so nothing may be cut off on the way.
+  uint8_t cs4 = tccr4b & ~_BV(PSR4);
+  if (tcnt1 == 0
+   || tcnt4 > (1 << 10) - MIN_TIMER4_TICKS_BEFORE_OVERFLOW
+   || ocr4b < 1
+   || ocr4b >= max_glitch_timer4_ticks
+   || tccr4b > 0xFF
+   || (cs4 != CS4_DIVIDER_1 && cs4 != CS4_DIVIDER_2)
+   || dt4 > 0xFF
+   || (dt4 && !(tccr4b & _BV(PSR4))))
+  {
+    usart_transmit_string("FAIL: BAD REGISTERS\r\n");
+    return;
+  }
+  
+  setup_timer1_registers(tcnt1);
+  setup_timer4_registers(tcnt4, ocr4b, dt4);
+  run_glitch(tccr4b);
+  usart_transmit_string("DONE\r\n");
+}
+
+
+
+// Reset the LPC11U35, and glitch it with the timers as set up by 
+// setup_timer1() and setup_timer4(). Reports the SWD oracle status if 
+// it is enabled.
+inline void run_glitch(uint8_t cs4_divider)
+{
+  // From the datasheet of the LPC11U35:
+  // 
+  //   A LOW-going pulse as short as 50 ns on this pin resets the 
+  //   device, causing I/O ports and peripherals to take on their 
+  //   default states and processor execution to begin at address 0.
+  GLITCHER_PORT = GLITCHER_PORT_STATE_RESET_LPC11U35_WITH_REGULAR_VOLTAGE;
+  _delay_us(100);
+  
+  
+  // We fancy a very precise glitch. Therefore, we must be able to 
+  // count cycles/instructions. And the only way to actually know 
+  // which instructions are executed, is to write assembly.
+  asm volatile(
+    NT ASM_FILE_LINE
+    NT";; Start the LPC11U35. (Stop resetting.)"
+    NT";; "
+    NT";; PORTB = regular voltage for LPC11U35, don't reset."
+    NT"out %[port], %[regular_voltage_no_reset]"
+    NT
+    NT
+    NT
+    // Note: TCCR registers are outside the reach of the faster OUT 
+    // instruction.
+    NT ASM_FILE_LINE
+    NT";; Start low speed timer."
+    NT";;   0x1: divide clock source by    1 (don't divide)"
+    NT";;   0x2: divide clock source by    8"
+    NT";;   0x3: divide clock source by   64"
+    NT";;   0x4: divide clock source by  256"
+    NT";;   0x5: divide clock source by 1024"
+    NT"sts %[tccr_low_speed], %[cs1_divider]"	// 2 CPU cycles
+    NT
+    NT
+    NT
+    // We want the tick count to be as precise as possible. However, 
+    // the datasheet says: "If an interrupt occurs during execution of 
+    // a multi-cycle instruction, this instruction is completed before 
+    // the interrupt is served."
+    // 
+    // A jump takes at least 2 cycles (RJMP/IJMP/EIJMP). A conditional 
+    // branch takes 2 instructions. So a while(!done) loop contains at 
+    // least one multi-cycle instruction :-/.
+    // 
+    // However, the datasheet also states: "If an interrupt occurs 
+    // when the MCU is in sleep mode, the interrupt execution response 
+    // time is increased by five clock cycles." This is a FIXED number 
+    // of cycles :-).
+    NT";; Will wake up after servicing timer 1 overflow interrupt."
+    NT"sleep"
+    NT
+    NT
+    NT
+    // Note: TCCR registers are outside the reach of the faster OUT 
+    // instruction.
+    NT ASM_FILE_LINE
+    NT";; Start the high speed timer (48 MHz)."
+    NT";;   0x1: divide clock source by     1 (96 MHz)"
+    NT";;   0x2: divide clock source by     2 (48 MHz)"
+    NT";;   (...)"
+    NT";;   0xE: divide clock source by  8192 (11.718 kHz)"
+    NT";;   0xF: divide clock source by 16384 ( 5.859 kHz)"
+    NT"sts %[tccr_high_speed], %[cs4_divider]"	// 2 CPU cycles
+    NT
+    NT
+    NT
+    NT";; Stop low speed timer."
+    NT"sts %[tccr_low_speed], __zero_reg__"
+    NT
+    NT
+    NT
+    NT";; Will wake up after servicing timer 4 output compare B interrupt."
+    NT"sleep"
+    NT
+    NT
+    NT
+    NT";; Stop high speed timer."
+    NT"sts %[tccr_high_speed], __zero_reg__"
+    //
+    //
+    // Output operands
+    :
+    // Input operands
+    :
+      // I: Constant greater than −1, less than 64
+      [port] "I" _SFR_IO_ADDR(GLITCHER_PORT),
+      
+      // d: Registers from r16 to r31
+      // 
+      // Without the cast to byte/char/uint8, the compiler assumes a 
+      // 16-bit value and uses 2 registers.
+      [cs1_divider] "d" ((uint8_t) CS1_DIVIDER),
+      [cs4_divider] "d" (cs4_divider),
+      [regular_voltage_no_reset] "d" ((uint8_t) GLITCHER_PORT_STATE_RUN_LPC11U35_WITH_REGULAR_VOLTAGE),
+      
+      // M: Constant that fits in 8 bits
+      [tccr_low_speed]  "M" (_SFR_MEM_ADDR(TCCR1B)),
+      [tccr_high_speed] "M" (_SFR_MEM_ADDR(TCCR4B))
+    // Clobbered registers.
+  );
+  
+  if (swd_oracle_enabled)
+  {
+    // The attempt status byte, in the characters of run-glitch.py.
+    usart_transmit_string("STATUS ");
+    usart_transmit_char(swd_oracle());
     usart_transmit_string("\r\n");
+  }
+}
+
+
+
+// Command 'R': "R<steps per 48 MHz tick>\n".
+// 
+//   R1: 48 MHz, the default.
+//   R2: 96 MHz. Timer 4 counts at 96 MHz if it passes its self test, 
+//       otherwise it counts at 48 MHz and the dead time generator 
+//       provides the odd steps of the offset.
+// 
+// If timer 4 fails at 96 MHz altogether, we fall back to 48 MHz. The 
+// reply tells the host which resolution is in effect; the number in 
+// "RESOLUTION <n>" is the number of steps per 48 MHz tick, so the host 
+// knows how to interpret the arguments of the next 'G' commands.
+inline void command_resolution()
+{
+  uint16_t steps_per_tick = usart_receive_uint16();
+#ifdef USART_ECHO
+  usart_transmit_string("\r\n");
 #endif
-    // Assert enough ticks are available for the post reset.
-    if (glitch_ticks_at_48MHz > 10000)
-    {
-      usart_transmit_string("FAIL: GLITCH TOO LONG\r\n");
-      continue;
-    }
+  
+  uint8_t resolution_wanted;
+  switch (steps_per_tick)
+  {
+    case 1:
+      resolution_wanted = TIMER4_RESOLUTION_48MHZ;
+      break;
+    case 2:
+      resolution_wanted = TIMER4_RESOLUTION_96MHZ;
+      break;
+    default:
+      usart_transmit_string("FAIL: UNKNOWN RESOLUTION\r\n");
+      return;
+  }
+  
+  timer4_resolution = select_timer4_resolution(resolution_wanted);
+  if (timer4_resolution < resolution_wanted)
+  {
+    usart_transmit_string("FALLBACK\r\n");
+  }
+  
+  switch (timer4_resolution)
+  {
+    case TIMER4_RESOLUTION_96MHZ:
+      usart_transmit_string("RESOLUTION 2: 96 MHz\r\n");
+      break;
+    case TIMER4_RESOLUTION_96MHZ_DEAD_TIME:
+      usart_transmit_string("RESOLUTION 2: 96 MHz DEAD TIME\r\n");
+      break;
+    default:
+      usart_transmit_string("RESOLUTION 1: 48 MHz\r\n");
+  }
+  usart_transmit_string("DONE\r\n");
+}
 
-    usart_transmit_string("Glitching: post reset = ");
-    usart_transmit_num(post_reset_ticks_at_48MHz);
-    usart_transmit_string("; glitch ticks = ");
-    usart_transmit_num(glitch_ticks_at_48MHz);
-    usart_transmit_string(".\r\n");
-    
-    uint16_t timer1_ticks;
-    uint16_t  timer4_ticks;
 
-    if (post_reset_ticks_at_48MHz <= MIN_TIMER4_TICKS_BEFORE_OVERFLOW)
-    {
-      usart_transmit_string("FAIL\r\n");
-      continue;
-    }
-    
-    // We subtract ticks here so they won't be part of coarse timer 1. 
-    // We will add these ticks to timer 4 later.
-    uint16_t post_reset_ticks =
-      post_reset_ticks_at_48MHz - MIN_TIMER4_TICKS_BEFORE_OVERFLOW;
-    
-    // The CPU runs at 16 MHz (or more precise: F_CPU). But the high 
-    // speed timer 4 runs at 48 MHz (or more precise: 48 MHz times the 
-    // PLL postscalar).
-    uint8_t frequency_ratio = 3;
-    timer1_ticks =  post_reset_ticks / frequency_ratio;
-    timer4_ticks = (post_reset_ticks % frequency_ratio)
-                 + MIN_TIMER4_TICKS_BEFORE_OVERFLOW;
-    usart_transmit_string("Timer 1 ticks before glitch: ");
-    usart_transmit_num(timer1_ticks);
-    usart_transmit_string("; timer 4 ticks before glitch: ");
-    usart_transmit_num(timer4_ticks);
-    usart_transmit_string(".\r\n");
-    
-    // We will start timer 1 precisely 3 CPU cycle later than starting 
-    // the LPC11U35, compensate.
-    timer1_ticks += 3;
-    
-    // We need at least 1 CPU cycle for the timer to fire.
-    if (timer1_ticks <= TIMER1_INTERRUPT_CPU_CYCLES_BEFORE_STARTING_TIMER4)
-    {
-      usart_transmit_string("FAIL: POST RESET TOO SHORT\r\n");
-      continue;
-    }
-    timer1_ticks -= TIMER1_INTERRUPT_CPU_CYCLES_BEFORE_STARTING_TIMER4;
-    
-    setup_timer1(timer1_ticks);
-    setup_timer4(timer4_ticks, glitch_ticks_at_48MHz);
+
+// Command 'C': "C<number of boots>\n".
+// 
+// Replaces the oscilloscope measurements of the README ("Determine the 
+// start of the glitch window with respect to end of reset"). For every 
+// boot we reset the LPC11U35 and let timer 1 timestamp the falling 
+// edges of the marker pin with its input capture unit (ICP1). That is 
+// accurate to the CPU cycle, and it does not wake up or poll anything 
+// while timing.
+// 
+// One line per boot:
+// 
+//   "C <boot> <marker 1> <marker 2>\r\n"   (all in hex)
+//   "C <boot> TIMEOUT\r\n"                (no marker within 4 ms)
+// 
+// The markers are in CPU cycles since starting timer 1, i.e. 
+// CALIBRATION_CPU_CYCLES_BEFORE_STARTING_TIMER1 cycles after releasing 
+// the reset. The host turns them into a distribution of the boot to 
+// glitch window latency (see src-pc/calibrate-boot.py).
+inline void command_calibrate()
+{
+  uint16_t num_boots = usart_receive_uint16();
+#ifdef USART_ECHO
+  usart_transmit_string("\r\n");
+#endif
+  
+  // The marker pin is an input without pull-up.
+  CALIBRATION_DDR &= ~_BV(CALIBRATION_MARKER_PIN);
+  CALIBRATION_PORT &= ~_BV(CALIBRATION_MARKER_PIN);
+  
+  for (uint16_t boot = 0; boot < num_boots; ++boot)
+  {
+    uint16_t markers[CALIBRATION_NUM_MARKERS];
+    uint8_t num_markers = 0;
     
+    // No interrupts: we poll the flags of timer 1 ourselves. (The 
+    // TIMER1 OVF vector would clear TOV1 behind our back.)
+    cli();
+    TCCR1B = CS1_STOP;
+    TCCR1A = 0;		// Normal mode, no output compare pins.
+    TCNT1 = 0;
     
+    // Writing a 1 clears the flag.
+    TIFR1 = _BV(ICF1) | _BV(TOV1);
     
-    // From the datasheet of the LPC11U35:
-    // 
-    //   A LOW-going pulse as short as 50 ns on this pin resets the 
-    //   device, causing I/O ports and peripherals to take on their 
-    //   default states and processor execution to begin at address 0.
     GLITCHER_PORT = GLITCHER_PORT_STATE_RESET_LPC11U35_WITH_REGULAR_VOLTAGE;
     _delay_us(100);
     
-    
-    // We fancy a very precise glitch. Therefore, we must be able to 
-    // count cycles/instructions. And the only way to actually know 
-    // which instructions are executed, is to write assembly.
+    // Same instructions as in command_glitch(), so timer 1 starts 
+    // exactly as many cycles after the reset release as it does there.
+    // 
+    // ICES1 = 0 (in TCCR1B): capture on the falling edge. ICNC1 = 0: 
+    // the noise canceler would add 4 cycles of delay.
     asm volatile(
       NT ASM_FILE_LINE
       NT";; Start the LPC11U35. (Stop resetting.)"
-      NT";; "
-      NT";; PORTB = regular voltage for LPC11U35, don't reset."
       NT"out %[port], %[regular_voltage_no_reset]"
-      NT
-      NT
-      NT
-      // Note: TCCR registers are outside the reach of the faster OUT 
-      // instruction.
-      NT ASM_FILE_LINE
-      NT";; Start low speed timer."
-      NT";;   0x1: divide clock source by    1 (don't divide)"
-      NT";;   0x2: divide clock source by    8"
-      NT";;   0x3: divide clock source by   64"
-      NT";;   0x4: divide clock source by  256"
-      NT";;   0x5: divide clock source by 1024"
-      NT"sts %[tccr_low_speed], %[cs1_divider]"	// 2 CPU cycles
-      NT
-      NT
-      NT
-      // We want the tick count to be as precise as possible. However, 
-      // the datasheet says: "If an interrupt occurs during execution of 
-      // a multi-cycle instruction, this instruction is completed before 
-      // the interrupt is served."
-      // 
-      // A jump takes at least 2 cycles (RJMP/IJMP/EIJMP). A conditional 
-      // branch takes 2 instructions. So a while(!done) loop contains at 
-      // least one multi-cycle instruction :-/.
-      // 
-      // However, the datasheet also states: "If an interrupt occurs 
-      // when the MCU is in sleep mode, the interrupt execution response 
-      // time is increased by five clock cycles." This is a FIXED number 
-      // of cycles :-).
-      NT";; Will wake up after servicing timer 1 overflow interrupt."
-      NT"sleep"
-      NT
-      NT
-      NT
-      // Note: TCCR registers are outside the reach of the faster OUT 
-      // instruction.
-      NT ASM_FILE_LINE
-      NT";; Start the high speed timer (48 MHz)."
-      NT";;   0x1: divide clock source by     1 (96 MHz)"
-      NT";;   0x2: divide clock source by     2 (48 MHz)"
-      NT";;   (...)"
-      NT";;   0xE: divide clock source by  8192 (11.718 kHz)"
-      NT";;   0xF: divide clock source by 16384 ( 5.859 kHz)"
-      NT"sts %[tccr_high_speed], %[cs4_divider]"	// 2 CPU cycles
-      NT
-      NT
-      NT
-      NT";; Stop low speed timer."
-      NT"sts %[tccr_low_speed], __zero_reg__"
-      NT
-      NT
-      NT
-      NT";; Will wake up after servicing timer 4 output compare B interrupt."
-      NT"sleep"
-      NT
-      NT
-      NT
-      NT";; Stop high speed timer."
-      NT"sts %[tccr_high_speed], __zero_reg__"
-      //
-      //
-      // Output operands
+      NT";; Start timer 1 at the CPU clock."
+      NT"sts %[tccr_low_speed], %[cs1_divider]"
       :
-      // Input operands
       :
-        // I: Constant greater than −1, less than 64
         [port] "I" _SFR_IO_ADDR(GLITCHER_PORT),
-        
-        // d: Registers from r16 to r31
-        // 
-        // Without the cast to byte/char/uint8, the compiler assumes a 
-        // 16-bit value and uses 2 registers.
-        [cs1_divider] "d" ((uint8_t) CS1_DIVIDER),
-        [cs4_divider] "d" ((uint8_t) CS4_DIVIDER),
+        [cs1_divider] "d" ((uint8_t) CS1_DIVIDER_1),
         [regular_voltage_no_reset] "d" ((uint8_t) GLITCHER_PORT_STATE_RUN_LPC11U35_WITH_REGULAR_VOLTAGE),
-        
-        // M: Constant that fits in 8 bits
-        [tccr_low_speed]  "M" (_SFR_MEM_ADDR(TCCR1B)),
-        [tccr_high_speed] "M" (_SFR_MEM_ADDR(TCCR4B))
-      // Clobbered registers.
+        [tccr_low_speed]  "M" (_SFR_MEM_ADDR(TCCR1B))
     );
     
-    usart_transmit_string("DONE\r\n");
+    while (num_markers < CALIBRATION_NUM_MARKERS)
+    {
+      uint8_t flags;
+      do
+      {
+        flags = TIFR1 & (_BV(ICF1) | _BV(TOV1));
+      } while (!flags);
+      
+      if (flags & _BV(ICF1))
+      {
+        markers[num_markers++] = ICR1;
+        TIFR1 = _BV(ICF1);
+      }
+      else
+      {
+        // Timer 1 overflowed: 65536 cycles (4 ms) without a marker.
+        break;
+      }
+    }
+    
+    TCCR1B = CS1_STOP;
+    TIFR1 = _BV(ICF1) | _BV(TOV1);
+    sei();
+    
+    usart_transmit_string("C ");
+    usart_transmit_num(boot);
+    if (num_markers < CALIBRATION_NUM_MARKERS)
+    {
+      usart_transmit_string(" TIMEOUT\r\n");
+      continue;
+    }
+    for (uint8_t n = 0; n < CALIBRATION_NUM_MARKERS; ++n)
+    {
+      usart_transmit_char(' ');
+      usart_transmit_num(markers[n]);
+    }
+    usart_transmit_string("\r\n");
+  }
+  usart_transmit_string("DONE\r\n");
+}
+
+
+
+// Command 'L': "L<period>,<pulse steps>,<max pulses>\n".
+// 
+// Closed loop width characterization against src-lpc/voltage-glitch-loop 
+// (the successor of managed-glitch/glitch.cc). Reset the LPC11U35 once, 
+// wait until it is armed, then give a pulse every <period> CPU cycles 
+// until the target pulls the fault pin low. No reset per pulse, so 
+// thousands of pulses per second.
+// 
+//   <period>:      In CPU cycles (timer 1 runs in CTC mode), at least 
+//                  LOOP_MIN_PERIOD_CPU_CYCLES.
+//   <pulse steps>: Width of each pulse, in steps of the current 
+//                  resolution of timer 4 (see command 'R').
+//   <max pulses>:  Give up after this many pulses. 0: never give up.
+// 
+// Any byte from the host aborts the loop as well.
+// 
+// Timer 4 does the width, so the width is exact. The start of each 
+// pulse is polled, so it jitters by a few CPU cycles within the period.
+// 
+// The reply (all numbers in hex):
+// 
+//   "PULSES <pulses high><pulses low>\r\n"
+//   "RESETS <number of times the target rebooted>\r\n"
+//   "FAULT <pulse start> <fault>\r\n"   or "NO FAULT\r\n" or "ABORTED\r\n"
+//   "DONE\r\n"
+// 
+// <pulse start> and <fault> are positions in the period (CPU cycles 
+// since the compare match of timer 1) of the start of the last pulse and 
+// of the falling edge of the fault pin.
+inline void command_loop()
+{
+  uint16_t period_cycles = usart_receive_uint16();
+  uint16_t pulse_steps   = usart_receive_uint16();
+  uint16_t max_pulses    = usart_receive_uint16();
+#ifdef USART_ECHO
+  usart_transmit_string("\r\n");
+#endif
+  
+  if (period_cycles < LOOP_MIN_PERIOD_CPU_CYCLES)
+  {
+    usart_transmit_string("FAIL: PERIOD TOO SHORT\r\n");
+    return;
+  }
+  if (pulse_steps > LOOP_MAX_PULSE_STEPS)
+  {
+    usart_transmit_string("FAIL: GLITCH TOO LONG\r\n");
+    return;
+  }
+  
+  // Same conversion as in command_glitch(), but there is no offset to 
+  // worry about: with dead time, the odd steps of the width are made up 
+  // by delaying the rising edge of OC4B.
+  uint16_t pulse_timer4_ticks = pulse_steps;
+  uint8_t cs4_divider = CS4_DIVIDER;
+  uint8_t dead_time = 0;
+  if (timer4_resolution == TIMER4_RESOLUTION_96MHZ_DEAD_TIME)
+  {
+    dead_time = pulse_steps & 1;
+    pulse_timer4_ticks = (pulse_steps + 1) >> 1;
+    cs4_divider = CS4_DIVIDER_2 | _BV(PSR4);
+  }
+  if (pulse_timer4_ticks <= 1)
+  {
+    usart_transmit_string("FAIL: GLITCH TOO SHORT\r\n");
+    return;
+  }
+  
+  usart_transmit_string("Looping: period = ");
+  usart_transmit_num(period_cycles);
+  usart_transmit_string("; pulse steps = ");
+  usart_transmit_num(pulse_steps);
+  usart_transmit_string(".\r\n");
+  
+  // The fault pin is an input without pull-up. The LPC11U35 has its own.
+  FAULT_DDR &= ~_BV(FAULT_PIN);
+  FAULT_PORT &= ~_BV(FAULT_PIN);
+  
+  setup_timer4(LOOP_TIMER4_TICKS_BEFORE_PULSE, pulse_timer4_ticks, dead_time);
+  uint16_t timer4_reload = (1 << 10) - LOOP_TIMER4_TICKS_BEFORE_PULSE;
+  
+  // Like command_calibrate(): poll the flags of timer 1 with interrupts 
+  // disabled. Wait (at most 4 ms) for the armed pulse of the target.
+  cli();
+  TCCR1B = CS1_STOP;
+  TCCR1A = 0;
+  TCNT1 = 0;
+  TIFR1 = _BV(ICF1) | _BV(TOV1) | _BV(OCF1A);
+  
+  GLITCHER_PORT = GLITCHER_PORT_STATE_RESET_LPC11U35_WITH_REGULAR_VOLTAGE;
+  _delay_us(100);
+  GLITCHER_PORT = GLITCHER_PORT_STATE_RUN_LPC11U35_WITH_REGULAR_VOLTAGE;
+  TCCR1B = CS1_DIVIDER_1;
+  
+  while (!(TIFR1 & (_BV(ICF1) | _BV(TOV1)))) {}
+  bool armed = TIFR1 & _BV(ICF1);
+  _delay_us(LOOP_FAULT_CONFIRM_US);
+  if (!armed || !(FAULT_PIN_REGISTER & _BV(FAULT_PIN)))
+  {
+    TCCR1B = CS1_STOP;
+    TIFR1 = 0xFF;
+    sei();
+    usart_transmit_string("FAIL: TARGET NOT ARMED\r\n");
+    return;
+  }
+  
+  // Timer 1 in CTC mode (mode 4, TOP = OCR1A): the compare match flag 
+  // sets once every period. ICES1 = 0: capture on the falling edge.
+  TCCR1B = CS1_STOP;
+  OCR1A = period_cycles - 1;
+  TCNT1 = 0;
+  TIFR1 = _BV(ICF1) | _BV(TOV1) | _BV(OCF1A);
+  TCCR1B = _BV(WGM12) | CS1_DIVIDER_1;
+  
+  uint32_t pulses = 0;
+  uint16_t resets = 0;
+  uint16_t pulse_start = 0;
+  uint16_t fault = 0;
+  bool faulted = false;
+  bool aborted = false;
+  while (1)
+  {
+    uint8_t flags;
+    do
+    {
+      flags = TIFR1 & (_BV(OCF1A) | _BV(ICF1));
+    } while (!flags);
+    
+    if (flags & _BV(ICF1))
+    {
+      uint16_t capture = ICR1;
+      _delay_us(LOOP_FAULT_CONFIRM_US);
+      TIFR1 = _BV(ICF1);
+      if (!(FAULT_PIN_REGISTER & _BV(FAULT_PIN)))
+      {
+        fault = capture;
+        faulted = true;
+        break;
+      }
+      // The target rebooted and armed itself again. Keep on pulsing.
+      ++resets;
+      continue;
+    }
+    
+    // Start of a period: give a pulse.
+    TCCR4B = cs4_divider;
+    pulse_start = TCNT1;
+    TIFR1 = _BV(OCF1A);
+    while (!(TIFR4 & _BV(OCF4B))) {}
+    TCCR4B = CS4_STOP;
+    TC4H = timer4_reload >> 8;
+    TCNT4L = timer4_reload & 0xff;
+    TIFR4 = _BV(OCF4B) | _BV(TOV4);
+    ++pulses;
+    
+    if (pulses == max_pulses)
+    {
+      break;
+    }
+    if (UCSR1A & _BV(RXC1))
+    {
+      (void) UDR1;
+      aborted = true;
+      break;
+    }
+  }
+  
+  TCCR1B = CS1_STOP;
+  TIFR1 = 0xFF;
+  TIFR4 = 0xFF;
+  sei();
+  
+  usart_transmit_string("PULSES ");
+  usart_transmit_num(pulses >> 16);
+  usart_transmit_num(pulses & 0xffff);
+  usart_transmit_string("\r\nRESETS ");
+  usart_transmit_num(resets);
+  usart_transmit_string("\r\n");
+  if (faulted)
+  {
+    usart_transmit_string("FAULT ");
+    usart_transmit_num(pulse_start);
+    usart_transmit_char(' ');
+    usart_transmit_num(fault);
+    usart_transmit_string("\r\n");
+  }
+  else if (aborted)
+  {
+    usart_transmit_string("ABORTED\r\n");
+  }
+  else
+  {
+    usart_transmit_string("NO FAULT\r\n");
+  }
+  usart_transmit_string("DONE\r\n");
+}
+
+
+
+// Command 'S': "S<0 or 1>\n".
+// 
+// S1: After every glitch (command 'G'), check whether SWD of the 
+//     LPC11U35 answers: line reset and read DP IDCODE (see swd.hpp). 
+//     The reply of 'G' then has a status line:
+//     
+//       "STATUS !\r\n"   SWD answered. With CRP3 that means a hit.
+//       "STATUS .\r\n"   Nobody answered.
+//       "STATUS ?\r\n"   Something answered, but not OK (WAIT, FAULT, 
+//                        parity error).
+//     
+//     That costs some 100 microseconds instead of a round trip through 
+//     openocd and the debug probe, so the host only needs to attach the 
+//     probe after a hit.
+// S0: Don't, the default. The SWD pins are left alone.
+inline void command_swd_oracle()
+{
+  uint16_t enable = usart_receive_uint16();
+#ifdef USART_ECHO
+  usart_transmit_string("\r\n");
+#endif
+  
+  swd_oracle_enabled = enable;
+  if (swd_oracle_enabled)
+  {
+    swd_init();
+    swd_release();
+    usart_transmit_string("SWD ORACLE ON\r\n");
+  }
+  else
+  {
+    usart_transmit_string("SWD ORACLE OFF\r\n");
+  }
+  usart_transmit_string("DONE\r\n");
+}
+
+
+
+// Returns the attempt status byte, see command_swd_oracle(). Releases 
+// the SWD pins afterwards, so a debug probe can take over.
+inline char swd_oracle()
+{
+  _delay_us(SWD_ORACLE_DELAY_US);
+  swd_line_reset();
+  uint32_t idcode;
+  uint8_t ack = swd_read_idcode(&idcode);
+  swd_release();
+  
+  switch (ack)
+  {
+    case SWD_ACK_OK:
+      usart_transmit_string("IDCODE ");
+      usart_transmit_num(idcode >> 16);
+      usart_transmit_num(idcode & 0xffff);
+      usart_transmit_string("\r\n");
+      return '!';
+    case SWD_ACK_NONE:
+      return '.';
+    default:
+      return '?';
   }
 }
 
@@ -409,6 +1045,166 @@ inline void setup_clocks()
 
 
 
+// Try the resolutions from resolution_wanted down to 48 MHz, and 
+// return the first one at which timer 4 passes its self test. Leaves 
+// clk_TMR at the frequency the returned resolution needs.
+inline uint8_t select_timer4_resolution(uint8_t resolution_wanted)
+{
+  if (resolution_wanted >= TIMER4_RESOLUTION_96MHZ
+   && timer4_self_test(PLLTM_96MHZ, CS4_DIVIDER_1, 6))
+  {
+    return TIMER4_RESOLUTION_96MHZ;
+  }
+  
+  if (resolution_wanted >= TIMER4_RESOLUTION_96MHZ_DEAD_TIME
+   && timer4_self_test(PLLTM_96MHZ, CS4_DIVIDER_2 | _BV(PSR4), 3)
+   && timer4_dead_time_self_test())
+  {
+    return TIMER4_RESOLUTION_96MHZ_DEAD_TIME;
+  }
+  
+  // This is the setting of setup_clocks(), which is known to work. The 
+  // self test is only there to set clk_TMR back to 48 MHz.
+  timer4_self_test(PLLTM_48MHZ, CS4_DIVIDER_1, 3);
+  return TIMER4_RESOLUTION_48MHZ;
+}
+
+
+
+// Set clk_TMR with the PLL postscaler, then run timer 4 and timer 1 
+// (at the CPU clock) side by side for TIMER4_SELF_TEST_CPU_CYCLES. If 
+// timer 4 doesn't count ticks_per_cpu_cycle times as fast as timer 1, 
+// it can't keep up with this clock.
+// 
+// The output compare pins are disconnected during the test, so the 
+// LPC11U35 does not notice a thing.
+inline bool timer4_self_test(uint8_t plltm, uint8_t cs4_divider, uint8_t ticks_per_cpu_cycle)
+{
+  cli();
+  TCCR4B = CS4_STOP;
+  TCCR1B = CS1_STOP;
+  
+  // The PLL postscaler must only be changed while timer 4 is stopped.
+  PLLFRQ = (PLLFRQ & ~PLLTM_MASK) | plltm;
+  
+  // Disconnect OC4B and not(OC4B), and count up to the full 10 bits.
+  TCCR4A = 0;
+  TC4H = 0x03;
+  OCR4C = 0xFF;
+  TC4H = 0;
+  TCNT4L = 0;
+  TCNT1 = 0;
+  
+  TCCR4B = cs4_divider;
+  TCCR1B = CS1_DIVIDER_1;
+  while (TCNT1 < TIMER4_SELF_TEST_CPU_CYCLES) {}
+  TCCR4B = CS4_STOP;
+  TCCR1B = CS1_STOP;
+  
+  // From the datasheet, chapter 15.11 ("Accessing 10-bit Registers"):
+  // the low byte must be read before the high byte (TC4H).
+  uint16_t timer4_ticks = TCNT4L;
+  timer4_ticks |= (uint16_t) TC4H << 8;
+  uint16_t timer1_ticks = TCNT1;
+  
+  // Don't let the test trigger our interrupts later on. (Writing a 1 
+  // clears the flag.)
+  TIFR4 = 0xFF;
+  TIFR1 = 0xFF;
+  sei();
+  
+  uint16_t expected_ticks = timer1_ticks * ticks_per_cpu_cycle;
+  uint16_t slack = TIMER4_SELF_TEST_SLACK_CPU_CYCLES * ticks_per_cpu_cycle;
+  return timer4_ticks + slack >= expected_ticks
+      && timer4_ticks <= expected_ticks + slack;
+}
+
+
+
+// The dead time resolution relies on the dead time generator (DT4) 
+// running at clk_TMR, i.e. at 96 MHz, while the counter runs at 48 MHz. 
+// The self test above only sees the counter, so check the generator 
+// itself: start timer 4 right before an overflow, and sample OC4B (the 
+// regular voltage pin, PB6) every CPU cycle. Once without dead time, 
+// once with the longest one, 15 clk_TMR cycles: 2.5 CPU cycles at 96 
+// MHz, so the rising edge must show up 2 or 3 samples later.
+// 
+// OC4B is connected during the test, so we hold the LPC11U35 in reset 
+// meanwhile. Must be called at clk_TMR = 96 MHz (after 
+// timer4_self_test()).
+inline bool timer4_dead_time_self_test()
+{
+  uint8_t port = GLITCHER_PORT;
+  GLITCHER_PORT = GLITCHER_PORT_STATE_RESET_LPC11U35_WITH_REGULAR_VOLTAGE;
+  
+  uint8_t first_high[2];
+  for (uint8_t n = 0; n < 2; ++n)
+  {
+    uint8_t samples[TIMER4_DEAD_TIME_SELF_TEST_SAMPLES];
+    
+    cli();
+    TCCR4B = CS4_STOP;
+    TCCR4A = _BV(COM4B0) | _BV(PWM4B);
+    TCCR4D = 0;
+    DT4 = n ? 0xF0 : 0x00;
+    TC4H = 0x03;
+    OCR4C = 0xFF;
+    // Overflow (OC4B on) after 2 ticks, compare match (OC4B off) some 
+    // 80 CPU cycles later, long after the last sample.
+    TC4H = 0x03;
+    TCNT4L = 0xFE;
+    TC4H = 0x01;
+    OCR4B = 0x00;
+    TIFR4 = 0xFF;
+    
+    asm volatile(
+      NT ASM_FILE_LINE
+      NT"sts %[tccr_high_speed], %[cs4_divider]"
+      NT"in %[s0], %[pin]"
+      NT"in %[s1], %[pin]"
+      NT"in %[s2], %[pin]"
+      NT"in %[s3], %[pin]"
+      NT"in %[s4], %[pin]"
+      NT"in %[s5], %[pin]"
+      NT"in %[s6], %[pin]"
+      NT"in %[s7], %[pin]"
+      :
+        [s0] "=r" (samples[0]), [s1] "=r" (samples[1]),
+        [s2] "=r" (samples[2]), [s3] "=r" (samples[3]),
+        [s4] "=r" (samples[4]), [s5] "=r" (samples[5]),
+        [s6] "=r" (samples[6]), [s7] "=r" (samples[7])
+      :
+        [pin] "I" (_SFR_IO_ADDR(PINB)),
+        [cs4_divider] "r" ((uint8_t) (CS4_DIVIDER_2 | _BV(PSR4))),
+        [tccr_high_speed] "M" (_SFR_MEM_ADDR(TCCR4B))
+    );
+    
+    // Let the compare match turn OC4B off again, so the next run starts 
+    // from the same state. Then disconnect OC4B, and don't let the test 
+    // trigger our interrupts later on.
+    while (!(TIFR4 & _BV(OCF4B))) {}
+    TCCR4B = CS4_STOP;
+    TCCR4A = 0;
+    DT4 = 0;
+    TIFR4 = 0xFF;
+    sei();
+    
+    first_high[n] = 0;
+    while (first_high[n] < TIMER4_DEAD_TIME_SELF_TEST_SAMPLES
+        && !(samples[first_high[n]] & _BV(GLITCHER_VCC_REGULAR_PIN)))
+    {
+      ++first_high[n];
+    }
+  }
+  GLITCHER_PORT = port;
+  
+  return first_high[1] < TIMER4_DEAD_TIME_SELF_TEST_SAMPLES
+      && first_high[1] >= first_high[0] + 2
+      && first_high[1] <= first_high[0] + 3;
+}
+
+
+
 /*  _   _
  * | |_(_)_ __ ___   ___ _ __ ___
  * | __| | '_ ` _ \ / _ \ '__/ __|
@@ -424,7 +1220,15 @@ inline void setup_clocks()
 inline void setup_timer1(uint16_t timer_ticks_wanted_before_overflow)
 {
   uint16_t timer_ticks_left = /* 65536 */ - timer_ticks_wanted_before_overflow;
-  TCNT1 = timer_ticks_left;
+  setup_timer1_registers(timer_ticks_left);
+}
+
+
+
+// Same, with the value of TCNT1 itself.
+inline void setup_timer1_registers(uint16_t tcnt1)
+{
+  TCNT1 = tcnt1;
   
   // Enable the overflow interrupt of timer 1. See ISR(TIMER1_OVF_vect, 
   // ISR_NAKED) for the actual overflow routine.
@@ -438,8 +1242,29 @@ inline void setup_timer1(uint16_t timer_ticks_wanted_before_overflow)
 
 inline void setup_timer4(
     uint16_t timer_ticks_before_glitch,
-    uint16_t timer_ticks_glitch_length
+    uint16_t timer_ticks_glitch_length,
+    uint8_t dead_time
 )
+{
+  // Dead time generator. Since OC4B and not(OC4B) are both connected,
+  // the rising edge of each output can be delayed by 0..15 clk_TMR
+  // cycles (the dead time prescaler, DTPS4 in TCCR4B, is left at 1x):
+  //
+  //   DT4H (bits 7:4): delays the rising edge of OC4B (glitch on).
+  //   DT4L (bits 3:0): delays the rising edge of not(OC4B).
+  //
+  // Only the first one is of use to us.
+  setup_timer4_registers(
+    (1 << 10) - timer_ticks_before_glitch,
+    timer_ticks_glitch_length - 1,
+    (dead_time & 0x0F) << 4
+  );
+}
+
+
+
+// Same, with the values of TCNT4, OCR4B and DT4 themselves.
+inline void setup_timer4_registers(uint16_t tcnt4, uint16_t ocr4b, uint8_t dt4)
 {
   // Disable interrupts during this function.
   cli();
@@ -470,6 +1295,8 @@ inline void setup_timer4(
          | (0 << WGM40)	// Necessary for fast PWM mode.
          ;
 
+  DT4 = dt4;
+
   // Set TOP for fast PWM. Use full 10 bit range.
   // The extreme values for the OCR4C Register represents special cases 
   // when generating a PWM waveform output in the fast PWM mode. If the 
@@ -482,14 +1309,12 @@ inline void setup_timer4(
   // 
   //   To do a 10-bit write, the high byte must be written to the TC4H 
   //   register before the low byte is written.
-  uint16_t value = (1 << 10) - timer_ticks_before_glitch;
-  TC4H = value >> 8;
-  TCNT4L = value & 0xff;
+  TC4H = tcnt4 >> 8;
+  TCNT4L = tcnt4 & 0xff;
 
   // Set glitch length in OCR4B.
-  value = timer_ticks_glitch_length - 1;
-  TC4H = value >> 8;
-  OCR4B = value & 0xff;
+  TC4H = ocr4b >> 8;
+  OCR4B = ocr4b & 0xff;
   
   // Enable the overflow interrupt of timer 4.
   // See ISR(TIMER4_OVF_vect, ISR_NAKED) for the actual overflow routine.
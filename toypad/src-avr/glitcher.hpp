@@ -64,6 +64,74 @@
 #define GLITCHER_PORT_STATE_RESET_LPC11U35_WITH_REGULAR_VOLTAGE	(_BV(GLITCHER_RESET_PIN) | _BV(GLITCHER_VCC_INVERTED_PIN))
 #define GLITCHER_PORT_STATE_RUN_LPC11U35_WITH_REGULAR_VOLTAGE	(                      0 | _BV(GLITCHER_VCC_INVERTED_PIN))
 
+// For calibrating the boot timing we need a 4th pin: the marker pin of
+// the LPC11U35 (see src-lpc/boot-marker). It must go to the input
+// capture pin of timer 1, so the hardware timestamps the edges for us:
+//
+//   ICP1 is PD4: D4 on the Arduino Leonardo, 4 on the SparkFun Pro
+//   Micro.
+#define CALIBRATION_PORT_GROUP		D
+#define CALIBRATION_PORT		CONCAT3(PORT, CALIBRATION_PORT_GROUP, )
+#define CALIBRATION_DDR			CONCAT3(DDR, CALIBRATION_PORT_GROUP, )
+#define CALIBRATION_MARKER_PIN		CONCAT3(PIN, CALIBRATION_PORT_GROUP, 4)
+
+// The boot marker firmware gives 2 pulses per boot: one when the boot
+// ROM starts the user code, and one after the boot ROM has run again
+// from the start of the glitch window. We timestamp the falling edge
+// (the end) of both.
+#define CALIBRATION_NUM_MARKERS		2
+
+// Timer 1 is started this many CPU cycles after the LPC11U35 is
+// released from reset ("out" + "sts"). Same as in command_glitch().
+#define CALIBRATION_CPU_CYCLES_BEFORE_STARTING_TIMER1	CPU_CYCLES_BEFORE_STARTING_TIMER1
+
+// The closed loop mode (command 'L') uses the same wire as the fault
+// pin of src-lpc/voltage-glitch-loop (PIO0_2):
+//
+//   - Right before it starts looping, the target gives a short low
+//     pulse on the pin ("armed"), then keeps the pin high.
+//   - As soon as one of its compares fails, the target pulls the pin
+//     low, and keeps it low.
+//
+// The pin has a pull-up on the LPC11U35 after reset, so a target that
+// browns out and reboots does not pull it low for longer than the armed
+// pulse. The input capture unit catches the falling edges.
+//
+// (A target built with CHARACTERIZE only gives the armed pulse after a
+// fault, and keeps on looping: 'L' counts its faults as reboots. Its
+// fault records, on the UART, tell them apart.)
+#define FAULT_PORT_GROUP		CALIBRATION_PORT_GROUP
+#define FAULT_PORT			CALIBRATION_PORT
+#define FAULT_DDR			CALIBRATION_DDR
+#define FAULT_PIN_REGISTER		CONCAT3(PIN, FAULT_PORT_GROUP, )
+#define FAULT_PIN			CALIBRATION_MARKER_PIN
+
+// A falling edge on the fault pin is a fault if the pin is still low
+// this many microseconds later. Otherwise it was the armed pulse of a
+// rebooted target. (The armed pulse is 24 cycles of the 12 MHz IRC, 2
+// microseconds: FAULT_ARMED_PULSE_LOOPS in voltage-glitch-loop.c.)
+#define LOOP_FAULT_CONFIRM_US		10
+
+// Timer 4 ticks between starting timer 4 and the start of each pulse of
+// the closed loop mode. No interrupt has to stop timer 4 in time, we
+// poll, so this can be (much) less than
+// MIN_TIMER4_TICKS_BEFORE_OVERFLOW.
+#define LOOP_TIMER4_TICKS_BEFORE_PULSE	16
+
+// Shortest period (in CPU cycles) of the closed loop mode: polling for
+// the end of the pulse and re-arming timer 4 must fit in one period,
+// for the longest pulse we allow (LOOP_MAX_PULSE_STEPS, i.e. 1000 / 3
+// CPU cycles at 48 MHz). This gives at most 16 MHz / 512 = 31 kHz.
+#define LOOP_MIN_PERIOD_CPU_CYCLES	512
+#define LOOP_MAX_PULSE_STEPS		1000
+
+
+// The SWD oracle (command 'S') checks SWD this many microseconds after 
+// the end of the glitch. By then the boot ROM has long made up its mind 
+// about CRP (and disabled SWD for CRP3), but has not yet started the 
+// user code, which might take over the SWD pins.
+#define SWD_ORACLE_DELAY_US		20
+
 
 #define CS1_STOP		(        0 |         0 |         0)
 #define CS1_DIVIDER_1		(        0 |         0 | _BV(CS10))
@@ -74,8 +142,61 @@
 
 #define CS4_STOP		(        0 |         0 |         0 |         0)
 #define CS4_DIVIDER_1		(        0 |         0 |         0 | _BV(CS40))
+#define CS4_DIVIDER_2		(        0 |         0 | _BV(CS41) |         0)
 #define CS4_DIVIDER_16384	(_BV(CS43) | _BV(CS42) | _BV(CS41) | _BV(CS40))
 
+// PLLFRQ bits 5:4 (PLLTM1:0), the PLL postscaler for the high speed
+// timer. The PLL itself runs at 96 MHz (see setup_clocks()).
+//
+//   PLLTM1:0 | Postscaler | clk_TMR
+//   ---------+------------+--------
+//        01  |     1      | 96 MHz
+//        11  |     2      | 48 MHz
+#define PLLTM_MASK		(_BV(PLLTM1) | _BV(PLLTM0))
+#define PLLTM_96MHZ		(        0 | _BV(PLLTM0))
+#define PLLTM_48MHZ		(_BV(PLLTM1) | _BV(PLLTM0))
+
+// The datasheet only guarantees timer 4 up to 64 MHz. At 96 MHz we are
+// overclocking it, so we offer 3 resolutions, from best to safest:
+//
+//   TIMER4_RESOLUTION_96MHZ:
+//     clk_TMR = 96 MHz, counter divider 1. Both the offset and the
+//     width of the glitch have a resolution of 10.4 ns. The counter
+//     itself runs out of spec.
+//
+//   TIMER4_RESOLUTION_96MHZ_DEAD_TIME:
+//     clk_TMR = 96 MHz, counter divider 2, so the counter runs at 48
+//     MHz (within spec). Only the dead time generator (DT4) runs at 96
+//     MHz; it delays the rising edge of OC4B by 0 or 1 half tick. So the
+//     offset has a resolution of 10.4 ns, the END of the glitch is
+//     still on a 48 MHz tick.
+//
+//   TIMER4_RESOLUTION_48MHZ:
+//     clk_TMR = 48 MHz, counter divider 1. The original 20.8 ns.
+//
+// The host asks for a resolution (in steps per 48 MHz tick), the
+// glitcher falls back to the next best resolution if timer 4 fails its
+// self test at the requested one.
+#define TIMER4_RESOLUTION_48MHZ			0
+#define TIMER4_RESOLUTION_96MHZ_DEAD_TIME	1
+#define TIMER4_RESOLUTION_96MHZ			2
+
+// Number of CPU cycles timer 1 runs during the self test of timer 4.
+// At 96 MHz this gives 6 * 128 = 768 ticks, which fits in the 10 bit
+// counter.
+#define TIMER4_SELF_TEST_CPU_CYCLES	128
+
+// Number of timer 4 ticks the self test may deviate per timer 4 tick
+// per CPU cycle. Starting and stopping both timers takes 2 "sts"
+// instructions, so 4 CPU cycles of slack.
+#define TIMER4_SELF_TEST_SLACK_CPU_CYCLES	4
+
+// Number of CPU cycles the self test of the dead time generator samples 
+// OC4B, see timer4_dead_time_self_test(). The rising edge comes after 
+// at most 2 ticks of 48 MHz plus 15 dead time cycles of 96 MHz, and the 
+// synchronizer of the pin: some 5 CPU cycles.
+#define TIMER4_DEAD_TIME_SELF_TEST_SAMPLES	8
+
 // We only want to glitch once, i.e. we have to prevent doing a glitch 
 // twice, so we have to be ABLE to stop timer 4 in the interrupt 
 // routine. That means enough ticks between the initial value of 
@@ -84,6 +205,20 @@
 
 
 
+// Cycles of the instructions in the timed sequence of run_glitch(), and 
+// of the interrupts waking it up. check-cycles.py verifies the built 
+// glitcher.elf against these after every link, static_asserts in 
+// glitcher.cpp check the sums below.
+#define CPU_CYCLES_OUT			1
+#define CPU_CYCLES_STS			2
+#define CPU_CYCLES_SLEEP_WAKE_UP	5
+#define CPU_CYCLES_INTERRUPT_RESPONSE	5
+#define CPU_CYCLES_RETI			5
+
+// [1] out PORTB, rXX (release the reset)
+// [2] sts TCCR1B, rXX
+#define CPU_CYCLES_BEFORE_STARTING_TIMER1 (CPU_CYCLES_OUT+CPU_CYCLES_STS)
+
 // [5] "If an interrupt occurs when the MCU is in sleep mode, the 
 //     interrupt execution response time is increased by five clock 
 //     cycles."
@@ -102,6 +237,20 @@
 // [2] sts TCCR4B, rXX
 #define TIMER1_INTERRUPT_CPU_CYCLES_BEFORE_STARTING_TIMER4 (5+5+5+2)
 
+// Same for the output compare B interrupt of timer 4, which ends the 
+// glitch: sleep, interrupt, reti, then "sts TCCR4B, __zero_reg__".
+#define TIMER4_INTERRUPT_CPU_CYCLES_BEFORE_STOPPING_TIMER4 (5+5+5+2)
+
+// The longest glitch, in timer 4 ticks, per counter clock. After the 
+// compare match (the end of the glitch) timer 4 counts on for 
+// TIMER4_INTERRUPT_CPU_CYCLES_BEFORE_STOPPING_TIMER4 CPU cycles, i.e. 3 
+// ticks per CPU cycle at 48 MHz and 6 at 96 MHz. It must not reach the 
+// overflow (the start of a second glitch) before it is stopped, so 
+// OCR4B (the glitch ticks minus 1) plus that many ticks must stay below 
+// 1 << 10. The dead time resolution counts at 48 MHz.
+#define MAX_GLITCH_TICKS_48MHZ ((1 << 10) - 3 * TIMER4_INTERRUPT_CPU_CYCLES_BEFORE_STOPPING_TIMER4)
+#define MAX_GLITCH_TICKS_96MHZ ((1 << 10) - 6 * TIMER4_INTERRUPT_CPU_CYCLES_BEFORE_STOPPING_TIMER4)
+
 #if 0
 #define TIMER1_RUNS_ULTRA_SLOW
 #define TIMER4_RUNS_ULTRA_SLOW
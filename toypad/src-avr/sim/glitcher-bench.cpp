@@ -0,0 +1,686 @@
+// Cycle accurate test bench for the timing of command 'G' of
+// ../glitcher.cpp.
+//
+// Runs the real firmware image (../glitcher.elf) in simavr, talks to it
+// over its serial port like run-glitch.py does, and records the edges of
+// PB4 (reset of the LPC11U35), PB5 and PB6 (not(OC4B) and OC4B: the
+// glitch) into a VCD file. For a sweep of "G<post reset>,<glitch>" it
+// asserts that:
+//
+//   - the glitch starts exactly <post reset> steps after the release of
+//     the reset,
+//   - the glitch is exactly <glitch> steps wide,
+//   - there is exactly 1 glitch,
+//
+// with a step being a 48 MHz tick (R1) or a 96 MHz tick (R2), see
+// command_resolution(). So it verifies the hand counted constants
+// (TIMER1_INTERRUPT_CPU_CYCLES_BEFORE_STARTING_TIMER4, the "+3",
+// MIN_TIMER4_TICKS_BEFORE_OVERFLOW, the RETI_NOP vectors) against the
+// instruction timing of simavr, before a compiler upgrade costs a week
+// of campaigns.
+//
+// It also asserts that widths just over the limit of command_glitch()
+// (MAX_GLITCH_TICKS_48MHZ and _96MHZ) are refused without a glitch.
+//
+// simavr has neither the PLL nor the high speed timer 4 of the
+// ATmega32U4, so this file models both (class Timer4). OC4B also drives
+// the input of PB6, for the self test of the dead time generator.
+// Timer 1, the sleep/interrupt timing and the USART are simavr's own.
+//
+// Time is kept in steps of 1/96 MHz: 6 steps per CPU cycle, 2 per 48 MHz
+// tick. The VCD file is in picoseconds.
+//
+// Usage: glitcher-bench [--vcd <file>] [--no-96mhz] <glitcher.elf>
+//
+//   --no-96mhz: let timer 4 fail its self test at 96 MHz, so R2 falls
+//               back to 48 MHz plus dead time.
+
+#include <algorithm>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "sim_avr.h"
+#include "sim_elf.h"
+#include "sim_io.h"
+#include "sim_irq.h"
+#include "sim_interrupts.h"
+#include "sim_cycle_timers.h"
+#include "avr_ioport.h"
+#include "avr_uart.h"
+
+#ifndef _BV
+#define _BV(bit) (1 << (bit))
+#endif
+
+// For its constants: the limits of command_glitch() and the bits of 
+// PLLFRQ (with PLLTM0 and PLLTM1 below).
+#include "glitcher.hpp"
+
+#define STEPS_PER_CPU_CYCLE	6
+#define PICOSECONDS_PER_STEP	(1e6 / 96)
+
+// Give up on a command after this many CPU cycles (1 second).
+#define MAX_CPU_CYCLES_PER_COMMAND	16000000
+
+// ATmega32U4 datasheet, "Register Summary". Data space addresses.
+#define ADDR_TIFR4	0x39
+#define ADDR_PLLCSR	0x49
+#define ADDR_PLLFRQ	0x52
+#define ADDR_TIMSK4	0x72
+#define ADDR_TCNT4	0xBE
+#define ADDR_TC4H	0xBF
+#define ADDR_TCCR4A	0xC0
+#define ADDR_TCCR4B	0xC1
+#define ADDR_TCCR4C	0xC2
+#define ADDR_TCCR4D	0xC3
+#define ADDR_TCCR4E	0xC4
+#define ADDR_OCR4A	0xCF
+#define ADDR_OCR4B	0xD0
+#define ADDR_OCR4C	0xD1
+#define ADDR_OCR4D	0xD2
+#define ADDR_DT4	0xD4
+
+#define PLOCK		0
+#define PLLE		1
+#define TOV4		2
+#define OCF4B		5
+#define OCIE4B		5
+#define PWM4B		0
+#define COM4B0		4
+#define COM4B1		5
+#define PSR4		6
+#define PLLTM0		4
+#define PLLTM1		5
+#define CS4_MASK	0x0F
+
+#define TIMER4_COMPB_VECTOR	39
+
+#define RESET_PIN	4
+#define GLITCH_INVERTED_PIN	5
+#define GLITCH_PIN	6
+
+
+
+/*
+ * Value changes, for the VCD file and for the assertions.
+ */
+struct Edge
+{
+  uint64_t step;
+  const char * signal;
+  bool level;
+};
+
+static std::vector<Edge> edges;		// Everything, for the VCD file.
+static std::vector<Edge> run_edges;	// Since the last 'G'.
+
+static void record(uint64_t step, const char * signal, bool level)
+{
+  edges.push_back({step, signal, level});
+  run_edges.push_back({step, signal, level});
+}
+
+static void write_vcd(const char * filename)
+{
+  static const char * const signals[] = {"reset", "glitch", "glitch_n"};
+  FILE * f = fopen(filename, "w");
+  if (!f)
+  {
+    perror(filename);
+    return;
+  }
+  fprintf(f, "$timescale 1ps $end\n$scope module glitcher $end\n");
+  for (unsigned n = 0; n < 3; ++n)
+    fprintf(f, "$var wire 1 %c %s $end\n", '!' + n, signals[n]);
+  fprintf(f, "$upscope $end\n$enddefinitions $end\n");
+
+  std::stable_sort(edges.begin(), edges.end(),
+    [](const Edge & a, const Edge & b) { return a.step < b.step; });
+  for (const Edge & e : edges)
+  {
+    unsigned id = 0;
+    while (strcmp(signals[id], e.signal))
+      ++id;
+    fprintf(f, "#%llu\n%d%c\n",
+      (unsigned long long) (e.step * PICOSECONDS_PER_STEP + 0.5),
+      e.level, '!' + id);
+  }
+  fclose(f);
+}
+
+
+
+/*
+ * When does a write to an I/O register take effect?
+ *
+ * simavr calls the write callbacks while executing the instruction, with
+ * avr->cycle still at the start of it. The hardware writes in the last
+ * cycle of the instruction, so the register changes at the end of it: 1
+ * cycle after the start for "out", 2 for "sts".
+ */
+static uint64_t write_step(avr_t * avr)
+{
+  uint16_t opcode = avr->flash[avr->pc] | (avr->flash[avr->pc + 1] << 8);
+  unsigned cycles = 2;
+  if ((opcode & 0xF800) == 0xB800)	// out A, Rr
+    cycles = 1;
+  else if ((opcode & 0xFE0F) == 0x9200)	// sts k, Rr
+    cycles = 2;
+  return (avr->cycle + cycles) * STEPS_PER_CPU_CYCLE;
+}
+
+
+
+/*
+ * The PLL and timer 4 (fast PWM mode with OC4B only, as glitcher.cpp
+ * uses it).
+ *
+ * clk_TMR edges are at multiples of 1 step (96 MHz) or 2 steps (48 MHz)
+ * since power up; the PLL runs off the same crystal as the CPU. The
+ * counter increments on every CS4 divider'th clk_TMR edge after it was
+ * started (PSR4 resets the divider, which is what the firmware does).
+ *
+ *   count TOP -> 0:          OC4B high (after DT4H clk_TMR cycles), TOV4.
+ *   count OCR4B -> OCR4B+1:  OC4B low, OCF4B.
+ *
+ * So with OCR4B = n - 1, OC4B is high for n counter ticks. The level of
+ * OC4B goes to the pin (PINB) in the CPU cycle it changes in.
+ */
+class Timer4
+{
+  public:
+    Timer4(avr_t * avr, bool can_count_at_96mhz);
+
+  private:
+    static void write(avr_t * avr, avr_io_addr_t addr, uint8_t v, void * param);
+    static uint8_t read(avr_t * avr, avr_io_addr_t addr, void * param);
+    static avr_cycle_count_t wake(avr_t * avr, avr_cycle_count_t when, void * param);
+    static avr_cycle_count_t drive_pin(avr_t * avr, avr_cycle_count_t when, void * param);
+
+    uint64_t steps_per_clk_tmr() const;
+    uint64_t steps_per_tick() const;
+    void advance(uint64_t step);
+    void schedule();
+    void set_oc4b(uint64_t step, bool level);
+
+    avr_t * avr;
+    bool can_count_at_96mhz;
+    avr_int_vector_t compb;
+    avr_irq_t * pin;
+    // Levels of OC4B not on the pin yet (the rising edge after dead
+    // time can be in the future).
+    std::vector<Edge> pin_edges;
+
+    uint8_t tc4h = 0;
+    uint16_t count = 0;
+    uint16_t top = 0x3FF;
+    uint16_t ocr4b = 0;
+    uint8_t tccr4a = 0;
+    uint8_t cs4 = 0;
+    uint8_t dt4 = 0;
+    uint8_t pllfrq = 0;
+    bool oc4b = false;
+
+    // Time of the last counter tick we processed.
+    uint64_t last_tick = 0;
+};
+
+Timer4::Timer4(avr_t * avr, bool can_count_at_96mhz)
+: avr(avr)
+, can_count_at_96mhz(can_count_at_96mhz)
+{
+  memset(&compb, 0, sizeof(compb));
+  compb.enable = AVR_IO_REGBIT(ADDR_TIMSK4, OCIE4B);
+  compb.raised = AVR_IO_REGBIT(ADDR_TIFR4, OCF4B);
+  compb.vector = TIMER4_COMPB_VECTOR;
+  avr_register_vector(avr, &compb);
+  pin = avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('B'), GLITCH_PIN);
+
+  static const avr_io_addr_t registers[] = {
+    ADDR_TIFR4, ADDR_PLLFRQ, ADDR_TCNT4, ADDR_TC4H, ADDR_TCCR4A,
+    ADDR_TCCR4B, ADDR_TCCR4C, ADDR_TCCR4D, ADDR_TCCR4E, ADDR_OCR4A,
+    ADDR_OCR4B, ADDR_OCR4C, ADDR_OCR4D, ADDR_DT4,
+  };
+  for (avr_io_addr_t addr : registers)
+  {
+    avr_register_io_write(avr, addr, write, this);
+    avr_register_io_read(avr, addr, read, this);
+  }
+  avr_register_io_read(avr, ADDR_PLLCSR, read, this);
+}
+
+uint64_t Timer4::steps_per_clk_tmr() const
+{
+  return (pllfrq & PLLTM_MASK) == PLLTM_96MHZ ? 1 : 2;
+}
+
+uint64_t Timer4::steps_per_tick() const
+{
+  uint64_t steps = steps_per_clk_tmr() << (cs4 - 1);
+  // An overclocked timer 4 that cannot keep up misses every other edge.
+  if (steps == 1 && !can_count_at_96mhz)
+    steps = 2;
+  return steps;
+}
+
+void Timer4::set_oc4b(uint64_t step, bool level)
+{
+  if (oc4b == level)
+    return;
+  oc4b = level;
+  record(step, "glitch", level);
+  record(step, "glitch_n", !level);
+  pin_edges.push_back({step, "glitch", level});
+  drive_pin(avr, avr->cycle, this);
+}
+
+// Put the levels of OC4B whose CPU cycle has come on the pin, and wake up
+// for the next one.
+avr_cycle_count_t Timer4::drive_pin(avr_t * avr, avr_cycle_count_t, void * param)
+{
+  Timer4 * t = (Timer4 *) param;
+  uint64_t now = avr->cycle * STEPS_PER_CPU_CYCLE;
+  while (!t->pin_edges.empty() && t->pin_edges.front().step <= now)
+  {
+    avr_raise_irq(t->pin, t->pin_edges.front().level);
+    t->pin_edges.erase(t->pin_edges.begin());
+  }
+  if (t->pin_edges.empty())
+    return 0;
+  uint64_t cycle = (t->pin_edges.front().step + STEPS_PER_CPU_CYCLE - 1) / STEPS_PER_CPU_CYCLE;
+  avr_cycle_timer_register(avr, cycle - avr->cycle, drive_pin, t);
+  return 0;
+}
+
+// Process all counter ticks up to and including step.
+void Timer4::advance(uint64_t step)
+{
+  if (!cs4)
+  {
+    last_tick = step;
+    return;
+  }
+  bool pwm = (tccr4a & _BV(PWM4B))
+          && (tccr4a & (_BV(COM4B1) | _BV(COM4B0))) == _BV(COM4B0);
+  uint64_t period = steps_per_tick();
+  while (last_tick + period <= step)
+  {
+    last_tick += period;
+    uint16_t old = count;
+    count = count >= top ? 0 : count + 1;
+    if (count == 0 && old == top)
+    {
+      avr->data[ADDR_TIFR4] |= _BV(TOV4);
+      if (pwm)
+        set_oc4b(last_tick + (dt4 >> 4) * steps_per_clk_tmr(), true);
+    }
+    if (old == ocr4b && count == (uint16_t) (ocr4b + 1))
+    {
+      if (pwm)
+        set_oc4b(last_tick, false);
+      avr_raise_interrupt(avr, &compb);
+    }
+  }
+}
+
+// Wake up at the CPU cycle of the next overflow or compare match, so the
+// interrupt flag is raised in time.
+void Timer4::schedule()
+{
+  avr_cycle_timer_cancel(avr, wake, this);
+  if (!cs4)
+    return;
+  uint16_t ticks_to_overflow = top - count + 1;
+  uint16_t ticks_to_match = count <= ocr4b
+                          ? ocr4b - count + 1
+                          : top - count + 1 + ocr4b + 1;
+  uint64_t ticks = std::min(ticks_to_overflow, ticks_to_match);
+  uint64_t step = last_tick + ticks * steps_per_tick();
+  uint64_t cycle = (step + STEPS_PER_CPU_CYCLE - 1) / STEPS_PER_CPU_CYCLE;
+  avr_cycle_timer_register(avr, cycle > avr->cycle ? cycle - avr->cycle : 1, wake, this);
+}
+
+avr_cycle_count_t Timer4::wake(avr_t * avr, avr_cycle_count_t, void * param)
+{
+  Timer4 * t = (Timer4 *) param;
+  t->advance(avr->cycle * STEPS_PER_CPU_CYCLE);
+  t->schedule();
+  return 0;
+}
+
+void Timer4::write(avr_t * avr, avr_io_addr_t addr, uint8_t v, void * param)
+{
+  Timer4 * t = (Timer4 *) param;
+  uint64_t step = write_step(avr);
+  t->advance(step);
+
+  switch (addr)
+  {
+    case ADDR_TIFR4:
+      // Writing a 1 clears the flag.
+      if (v & _BV(OCF4B))
+        avr_clear_interrupt(avr, &t->compb);
+      avr->data[addr] &= ~v;
+      break;
+    case ADDR_PLLFRQ:
+      t->pllfrq = v;
+      avr->data[addr] = v;
+      break;
+    case ADDR_TC4H:
+      t->tc4h = v & 0x03;
+      avr->data[addr] = t->tc4h;
+      break;
+    case ADDR_TCNT4:
+      t->count = (t->tc4h << 8) | v;
+      break;
+    case ADDR_OCR4B:
+      t->ocr4b = (t->tc4h << 8) | v;
+      break;
+    case ADDR_OCR4C:
+      t->top = (t->tc4h << 8) | v;
+      break;
+    case ADDR_TCCR4A:
+      t->tccr4a = v;
+      avr->data[addr] = v;
+      break;
+    case ADDR_TCCR4B:
+    {
+      uint8_t cs4 = v & CS4_MASK;
+      if (cs4 && (!t->cs4 || (v & _BV(PSR4))))
+      {
+        // Starting (or prescaler reset): the first tick is on the
+        // first clk_TMR edge after this one.
+        uint64_t clk = t->steps_per_clk_tmr();
+        t->last_tick = step / clk * clk;
+      }
+      t->cs4 = cs4;
+      avr->data[addr] = v & ~_BV(PSR4);
+      break;
+    }
+    case ADDR_DT4:
+      t->dt4 = v;
+      avr->data[addr] = v;
+      break;
+    default:
+      avr->data[addr] = v;
+  }
+  t->schedule();
+}
+
+uint8_t Timer4::read(avr_t * avr, avr_io_addr_t addr, void * param)
+{
+  Timer4 * t = (Timer4 *) param;
+  t->advance(avr->cycle * STEPS_PER_CPU_CYCLE);
+  switch (addr)
+  {
+    case ADDR_PLLCSR:
+      // The PLL locks at once.
+      if (avr->data[addr] & _BV(PLLE))
+        return avr->data[addr] | _BV(PLOCK);
+      return avr->data[addr] & ~_BV(PLOCK);
+    case ADDR_TCNT4:
+      // Reading the low byte latches the high byte into TC4H.
+      t->tc4h = t->count >> 8;
+      avr->data[ADDR_TC4H] = t->tc4h;
+      return t->count & 0xFF;
+    case ADDR_TC4H:
+      return t->tc4h;
+    default:
+      return avr->data[addr];
+  }
+}
+
+
+
+/*
+ * Serial port and reset pin.
+ */
+static avr_t * avr;
+static avr_irq_t * uart_input;
+static std::string uart_output;
+
+static void uart_output_hook(avr_irq_t *, uint32_t value, void *)
+{
+  uart_output += (char) value;
+}
+
+static void reset_pin_hook(avr_irq_t *, uint32_t value, void *)
+{
+  record(write_step(avr), "reset", value);
+}
+
+static void send(const std::string & s)
+{
+  for (char c : s)
+    avr_raise_irq(uart_input, (uint8_t) c);
+}
+
+// Run until the firmware has sent "until". Returns everything it sent,
+// or "" on a timeout/crash.
+static std::string run_until(const char * until)
+{
+  avr_cycle_count_t limit = avr->cycle + MAX_CPU_CYCLES_PER_COMMAND;
+  while (uart_output.find(until) == std::string::npos)
+  {
+    int state = avr_run(avr);
+    if (state == cpu_Done || state == cpu_Crashed || avr->cycle > limit)
+    {
+      uart_output.clear();
+      return "";
+    }
+  }
+  size_t end = uart_output.find(until) + strlen(until);
+  std::string out = uart_output.substr(0, end);
+  uart_output.erase(0, end);
+  return out;
+}
+
+
+
+/*
+ * The sweep.
+ */
+static unsigned failures = 0;
+
+static void fail(const char * what, const std::string & output)
+{
+  printf("FAIL: %s\n", what);
+  printf("%s\n", output.c_str());
+  ++failures;
+}
+
+// Returns the number of steps per 48 MHz tick in effect, and whether it
+// is the dead time variant.
+static unsigned set_resolution(unsigned steps_per_tick, bool * dead_time)
+{
+  send("R" + std::to_string(steps_per_tick) + "\n");
+  std::string out = run_until("DONE\r\n");
+  run_until("READY\r\n");
+  *dead_time = out.find("DEAD TIME") != std::string::npos;
+  size_t at = out.find("RESOLUTION ");
+  if (at == std::string::npos)
+  {
+    fail("no RESOLUTION reply", out);
+    return 1;
+  }
+  return out[at + strlen("RESOLUTION ")] - '0';
+}
+
+// Run 1 glitch. Expected offset/width in 96 MHz steps. With too_long,
+// the firmware must refuse it.
+static void glitch(unsigned post, unsigned width, unsigned steps_per_tick, bool dead_time,
+                   bool too_long = false)
+{
+  char command[32];
+  snprintf(command, sizeof(command), "G%u,%u\n", post, width);
+  run_edges.clear();
+  send(command);
+  std::string out = run_until("READY\r\n");
+
+  uint64_t expected_offset = post * (2 / steps_per_tick);
+  uint64_t expected_width = width * (2 / steps_per_tick);
+  if (dead_time)
+  {
+    // The end of the glitch is rounded up to a 48 MHz tick.
+    expected_width = (post + width + 1) / 2 * 2 - post;
+  }
+
+  // Minimum post reset: see command_glitch(). The firmware must refuse,
+  // not glitch at the wrong moment.
+  if (out.find("FAIL") != std::string::npos)
+  {
+    bool rises = std::any_of(run_edges.begin(), run_edges.end(),
+      [](const Edge & e) { return !strcmp(e.signal, "glitch") && e.level; });
+    printf("G%u,%u: refused%s\n", post, width, rises ? ", BUT GLITCHED" : "");
+    if (rises)
+      fail("glitch after FAIL", out);
+    return;
+  }
+  if (too_long)
+  {
+    printf("G%u,%u: accepted\n", post, width);
+    fail("accepted a glitch over the maximum width", out);
+    return;
+  }
+
+  uint64_t release = 0, rise = 0, fall = 0;
+  unsigned releases = 0, rises = 0, falls = 0;
+  for (const Edge & e : run_edges)
+  {
+    if (!strcmp(e.signal, "reset") && !e.level)
+    {
+      release = e.step;
+      ++releases;
+    }
+    if (!strcmp(e.signal, "glitch"))
+    {
+      if (e.level)
+      {
+        rise = e.step;
+        ++rises;
+      }
+      else
+      {
+        fall = e.step;
+        ++falls;
+      }
+    }
+  }
+
+  if (releases != 1 || rises != 1 || falls != 1)
+  {
+    printf("G%u,%u: %u reset releases, %u rising, %u falling edges\n",
+      post, width, releases, rises, falls);
+    fail("expected exactly 1 reset and 1 glitch", out);
+    return;
+  }
+
+  int64_t offset_error = (int64_t) (rise - release) - (int64_t) expected_offset;
+  int64_t width_error = (int64_t) (fall - rise) - (int64_t) expected_width;
+  printf("G%u,%u: offset %+lld, width %+lld (96 MHz steps)\n", post, width,
+    (long long) offset_error, (long long) width_error);
+  if (offset_error || width_error)
+    fail("timing mismatch", out);
+}
+
+int main(int argc, char * argv[])
+{
+  const char * vcd = "glitcher-bench.vcd";
+  const char * elf = NULL;
+  bool can_count_at_96mhz = true;
+  for (int n = 1; n < argc; ++n)
+  {
+    if (!strcmp(argv[n], "--vcd") && n + 1 < argc)
+      vcd = argv[++n];
+    else if (!strcmp(argv[n], "--no-96mhz"))
+      can_count_at_96mhz = false;
+    else
+      elf = argv[n];
+  }
+  if (!elf)
+  {
+    fprintf(stderr, "Usage: %s [--vcd <file>] [--no-96mhz] <glitcher.elf>\n", argv[0]);
+    return 2;
+  }
+
+  elf_firmware_t firmware;
+  memset(&firmware, 0, sizeof(firmware));
+  if (elf_read_firmware(elf, &firmware))
+  {
+    fprintf(stderr, "%s: cannot read firmware\n", elf);
+    return 2;
+  }
+  avr = avr_make_mcu_by_name("atmega32u4");
+  avr_init(avr);
+  firmware.frequency = 16000000;
+  avr_load_firmware(avr, &firmware);
+
+  Timer4 timer4(avr, can_count_at_96mhz);
+
+  uint32_t flags = 0;
+  avr_ioctl(avr, AVR_IOCTL_UART_GET_FLAGS('1'), &flags);
+  flags &= ~AVR_UART_FLAG_STDIO;
+  avr_ioctl(avr, AVR_IOCTL_UART_SET_FLAGS('1'), &flags);
+  uart_input = avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('1'), UART_IRQ_INPUT);
+  avr_irq_register_notify(
+    avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('1'), UART_IRQ_OUTPUT),
+    uart_output_hook, NULL);
+  avr_irq_register_notify(
+    avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('B'), RESET_PIN),
+    reset_pin_hook, NULL);
+
+  if (run_until("READY\r\n").empty())
+  {
+    fprintf(stderr, "The firmware never said READY.\n");
+    return 1;
+  }
+
+  // Both sides of every boundary in command_glitch(): the split between
+  // timer 1 and timer 4 (all remainders), the minimum post reset delay
+  // (109 steps at R1, 154 at R2, 218 with dead time), and the delays of
+  // the README. The same numbers are used as steps for both resolutions.
+  static const unsigned posts[] = {
+    64, 65, 108, 109, 110, 111, 153, 154, 155, 156, 157, 158,
+    1000, 1001, 1002, 1003, 1004, 1005, 2736, 9900, 9901, 9902,
+  };
+  static const unsigned widths[] = {2, 3, 4, 5, 17, 135, 264, 900};
+
+  for (unsigned wanted = 1; wanted <= 2; ++wanted)
+  {
+    bool dead_time;
+    unsigned steps_per_tick = set_resolution(wanted, &dead_time);
+    printf("R%u: %u steps per 48 MHz tick%s\n", wanted, steps_per_tick,
+      dead_time ? " (dead time)" : "");
+    for (unsigned post : posts)
+      for (unsigned width : widths)
+        glitch(post, width, steps_per_tick, dead_time);
+    
+    // The longest glitch command_glitch() accepts, and 1 tick more. With 
+    // dead time the counter runs at 48 MHz, at 2 steps per tick.
+    unsigned longest = MAX_GLITCH_TICKS_48MHZ;
+    unsigned over = MAX_GLITCH_TICKS_48MHZ + 1;
+    if (dead_time)
+    {
+      longest = 2 * MAX_GLITCH_TICKS_48MHZ - 1;
+      over = 2 * MAX_GLITCH_TICKS_48MHZ + 1;
+    }
+    else if (steps_per_tick == 2)
+    {
+      longest = MAX_GLITCH_TICKS_96MHZ;
+      over = MAX_GLITCH_TICKS_96MHZ + 1;
+    }
+    for (unsigned post : {1000u, 1001u, 9901u})
+    {
+      glitch(post, longest, steps_per_tick, dead_time);
+      glitch(post, over, steps_per_tick, dead_time, true);
+    }
+  }
+
+  write_vcd(vcd);
+  printf("%s, VCD in %s\n", failures ? "FAILED" : "PASSED", vcd);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,155 @@
+#include "swd-target.hpp"
+
+// Request bits, LSB first: Start, APnDP, RnW, A2, A3, Parity, Stop, Park.
+#define REQUEST_AP(r)		(((r) >> 1) & 1)
+#define REQUEST_READ(r)		(((r) >> 2) & 1)
+#define REQUEST_ADDRESS(r)	(((r) >> 1) & 0x0C)
+#define REQUEST_PARITY(r)	(((r) >> 5) & 1)
+#define REQUEST_STOP(r)		(((r) >> 6) & 1)
+#define REQUEST_PARK(r)		(((r) >> 7) & 1)
+
+#define ACK_OK		0x1
+#define ACK_WAIT	0x2
+
+SwdTarget::SwdTarget(Mode mode, uint32_t idcode)
+: mode(mode)
+, idcode(idcode)
+{
+}
+
+
+
+void SwdTarget::rising_edge(bool swdio_in)
+{
+  // A line reset is recognized in any state, as long as the host drives.
+  if (!driving && swdio_in)
+  {
+    if (++high_cycles == 50)
+    {
+      ++line_resets;
+      state = RESET;
+      output.clear();
+      return;
+    }
+  }
+  else
+  {
+    high_cycles = 0;
+  }
+  
+  switch (state)
+  {
+    case RESET:
+      if (!swdio_in)
+        state = IDLE;
+      break;
+    
+    case IDLE:
+      if (swdio_in)
+      {
+        request = 1;
+        bits = 1;
+        state = REQUEST;
+      }
+      break;
+    
+    case REQUEST:
+      request |= swdio_in << bits;
+      if (++bits < 8)
+        break;
+      ++requests;
+      {
+        uint8_t parity = REQUEST_AP(request) ^ REQUEST_READ(request)
+                       ^ ((request >> 3) & 1) ^ ((request >> 4) & 1);
+        if (parity != REQUEST_PARITY(request)
+         || REQUEST_STOP(request) || !REQUEST_PARK(request))
+        {
+          ++protocol_errors;
+          state = LOCKOUT;
+          break;
+        }
+      }
+      state = mode == DISABLED ? LOCKOUT : TURNAROUND_TO_TARGET;
+      break;
+    
+    case TURNAROUND_TO_TARGET:
+      start_response();
+      driving = true;
+      level = output.front();
+      output.erase(output.begin());
+      state = OUTPUT;
+      break;
+    
+    case OUTPUT:
+      if (!output.empty())
+      {
+        level = output.front();
+        output.erase(output.begin());
+        break;
+      }
+      // The host has sampled our last bit. Let go of SWDIO.
+      driving = false;
+      level = true;
+      if (mode != WAIT && !REQUEST_READ(request))
+      {
+        // A write continues with a turnaround and the data from the 
+        // host.
+        bits = 0;
+        state = WRITE_DATA;
+        break;
+      }
+      state = TURNAROUND_TO_HOST;
+      break;
+    
+    case TURNAROUND_TO_HOST:
+      state = IDLE;
+      break;
+    
+    case WRITE_DATA:
+      // Turnaround, 32 data bits and parity. We don't keep the data.
+      if (++bits == 1 + 32 + 1)
+        state = IDLE;
+      break;
+    
+    case LOCKOUT:
+      break;
+  }
+}
+
+
+
+void SwdTarget::start_response()
+{
+  uint8_t ack = mode == WAIT ? ACK_WAIT : ACK_OK;
+  output.clear();
+  for (unsigned n = 0; n < 3; ++n)
+  {
+    output.push_back((ack >> n) & 1);
+  }
+  if (ack != ACK_OK || !REQUEST_READ(request))
+  {
+    return;
+  }
+  
+  uint32_t data = read_register(REQUEST_AP(request), REQUEST_ADDRESS(request));
+  bool parity = false;
+  for (unsigned n = 0; n < 32; ++n)
+  {
+    bool bit = (data >> n) & 1;
+    output.push_back(bit);
+    parity ^= bit;
+  }
+  output.push_back(mode == BAD_PARITY ? !parity : parity);
+}
+
+
+
+uint32_t SwdTarget::read_register(bool ap, uint8_t address)
+{
+  // Only DP IDCODE matters; everything else reads as 0.
+  if (!ap && address == 0x0)
+  {
+    return idcode;
+  }
+  return 0;
+}
@@ -0,0 +1,64 @@
+#ifndef _SWD_TARGET_HPP_
+#define _SWD_TARGET_HPP_
+
+#include <stdint.h>
+#include <vector>
+
+// Bit level model of the SW-DP of the LPC11U35, to test ../swd.cpp (and 
+// the glitcher firmware under simavr) without hardware.
+// 
+// The host calls rising_edge() on every rising edge of SWCLK, with the 
+// level of SWDIO at that moment. In between, drives() and swdio() tell 
+// whether, and what, the target drives on SWDIO.
+class SwdTarget
+{
+  public:
+    enum Mode
+    {
+      ENABLED,		// Answers with OK.
+      DISABLED,		// CRP3: the boot ROM has disabled SWD, never answers.
+      WAIT,		// Answers every request with WAIT.
+      BAD_PARITY,	// Answers with OK, but with a wrong data parity bit.
+    };
+    
+    // DP IDCODE of the Cortex-M0 (see the LPC11Uxx user manual).
+    static const uint32_t CORTEX_M0_IDCODE = 0x0BB11477;
+    
+    SwdTarget(Mode mode = ENABLED, uint32_t idcode = CORTEX_M0_IDCODE);
+    
+    void rising_edge(bool swdio_in);
+    bool drives() const { return driving; }
+    bool swdio() const { return level; }
+    
+    unsigned line_resets = 0;
+    unsigned requests = 0;
+    unsigned protocol_errors = 0;
+    
+  private:
+    enum State
+    {
+      RESET,		// Line reset seen, waiting for idle.
+      IDLE,
+      REQUEST,
+      TURNAROUND_TO_TARGET,
+      OUTPUT,
+      TURNAROUND_TO_HOST,
+      WRITE_DATA,
+      LOCKOUT,		// Only a line reset gets us out.
+    };
+    
+    void start_response();
+    uint32_t read_register(bool ap, uint8_t address);
+    
+    Mode mode;
+    uint32_t idcode;
+    State state = LOCKOUT;
+    unsigned high_cycles = 0;
+    uint8_t request = 0;
+    unsigned bits = 0;
+    std::vector<bool> output;
+    bool driving = false;
+    bool level = true;
+};
+
+#endif /* _SWD_TARGET_HPP_ */
@@ -0,0 +1,89 @@
+// Runs ../swd.cpp (built with -DSWD_SIMULATION) against SwdTarget.
+
+#include <stdio.h>
+
+#include "../swd.hpp"
+#include "swd-target.hpp"
+#include "test-check.hpp"
+
+static SwdTarget * target;
+static bool host_drives = false;
+static bool host_level = true;
+static bool swclk = true;
+static unsigned contention = 0;
+
+// The level on SWDIO. Nobody driving: the pull-up wins.
+static bool swdio()
+{
+  if (host_drives && target->drives())
+    ++contention;
+  if (host_drives)
+    return host_level;
+  if (target->drives())
+    return target->swdio();
+  return true;
+}
+
+bool swd_sim_swdio_read()		{ return swdio(); }
+void swd_sim_swdio_output(bool high)	{ host_drives = true; host_level = high; }
+void swd_sim_swdio_input()		{ host_drives = false; }
+void swd_sim_swclk(bool high)
+{
+  if (high && !swclk)
+    target->rising_edge(swdio());
+  swclk = high;
+}
+
+
+
+static uint8_t read_idcode(SwdTarget & t, bool line_reset, uint32_t * idcode)
+{
+  target = &t;
+  swd_init();
+  if (line_reset)
+    swd_line_reset();
+  uint8_t ack = swd_read_idcode(idcode);
+  swd_release();
+  return ack;
+}
+
+int main()
+{
+  uint32_t idcode = 0;
+  
+  {
+    SwdTarget t(SwdTarget::ENABLED);
+    check(read_idcode(t, true, &idcode) == SWD_ACK_OK, "enabled target answers OK");
+    check(idcode == SwdTarget::CORTEX_M0_IDCODE, "IDCODE is that of the Cortex-M0");
+    check(t.line_resets == 1 && t.requests == 1 && !t.protocol_errors, "1 line reset, 1 clean request");
+    
+    idcode = 0;
+    check(read_idcode(t, true, &idcode) == SWD_ACK_OK && idcode == SwdTarget::CORTEX_M0_IDCODE, "second attempt answers as well");
+  }
+  
+  {
+    SwdTarget t(SwdTarget::DISABLED);
+    check(read_idcode(t, true, &idcode) == SWD_ACK_NONE, "disabled (CRP3) target does not answer");
+  }
+  
+  {
+    SwdTarget t(SwdTarget::ENABLED);
+    check(read_idcode(t, false, &idcode) == SWD_ACK_NONE, "no answer without a line reset");
+    check(read_idcode(t, true, &idcode) == SWD_ACK_OK, "line reset recovers");
+  }
+  
+  {
+    SwdTarget t(SwdTarget::WAIT);
+    check(read_idcode(t, true, &idcode) == SWD_ACK_WAIT, "WAIT is reported");
+    check(read_idcode(t, true, &idcode) == SWD_ACK_WAIT, "bus is in sync after WAIT");
+  }
+  
+  {
+    SwdTarget t(SwdTarget::BAD_PARITY);
+    check(read_idcode(t, true, &idcode) == SWD_ACK_PARITY_ERROR, "parity error is detected");
+  }
+  
+  check(contention == 0, "host and target never drive SWDIO at the same time");
+  
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,166 @@
+#include "glitcher.hpp"
+#include "swd.hpp"
+
+#ifdef SWD_SIMULATION
+
+// Host build (see sim/): the pins are those of a simulated SWD target.
+bool swd_sim_swdio_read();
+void swd_sim_swdio_output(bool high);
+void swd_sim_swdio_input();
+void swd_sim_swclk(bool high);
+
+static inline bool swdio_read()			{ return swd_sim_swdio_read(); }
+static inline void swdio_output(bool high)	{ swd_sim_swdio_output(high); }
+static inline void swdio_input()		{ swd_sim_swdio_input(); }
+static inline void swclk_low()			{ swd_sim_swclk(false); }
+static inline void swclk_high()			{ swd_sim_swclk(true); }
+
+#else
+
+#include <avr/io.h>
+
+static inline bool swdio_read()
+{
+  return SWD_PIN_REGISTER & _BV(SWD_SWDIO_PIN);
+}
+
+static inline void swdio_output(bool high)
+{
+  if (high)
+    SWD_PORT |= _BV(SWD_SWDIO_PIN);
+  else
+    SWD_PORT &= ~_BV(SWD_SWDIO_PIN);
+  SWD_DDR |= _BV(SWD_SWDIO_PIN);
+}
+
+// Input with pull-up.
+static inline void swdio_input()
+{
+  SWD_DDR &= ~_BV(SWD_SWDIO_PIN);
+  SWD_PORT |= _BV(SWD_SWDIO_PIN);
+}
+
+static inline void swclk_low()	{ SWD_PORT &= ~_BV(SWD_SWCLK_PIN); }
+static inline void swclk_high()	{ SWD_PORT |= _BV(SWD_SWCLK_PIN); }
+
+#endif
+
+// No delays: at 16 MHz the port instructions themselves keep SWCLK well 
+// below the few MHz the SW-DP can take.
+static inline void write_bit(bool bit)
+{
+  swdio_output(bit);
+  swclk_low();
+  swclk_high();
+}
+
+static inline bool read_bit()
+{
+  swclk_low();
+  bool bit = swdio_read();
+  swclk_high();
+  return bit;
+}
+
+static inline void turnaround()
+{
+  swclk_low();
+  swclk_high();
+}
+
+
+
+void swd_init()
+{
+#ifndef SWD_SIMULATION
+  // Disable JTAG, so PF4..PF7 are ordinary pins. JTD must be written 
+  // twice within 4 cycles.
+  uint8_t mcucr = MCUCR | _BV(JTD);
+  MCUCR = mcucr;
+  MCUCR = mcucr;
+  
+  SWD_DDR |= _BV(SWD_SWCLK_PIN);
+#endif
+  swclk_high();
+  swdio_input();
+}
+
+
+
+// Let go of both pins (inputs, no pull-up), so the debug probe can take 
+// over after a hit.
+void swd_release()
+{
+#ifdef SWD_SIMULATION
+  swdio_input();
+#else
+  SWD_DDR &= ~(_BV(SWD_SWCLK_PIN) | _BV(SWD_SWDIO_PIN));
+  SWD_PORT &= ~(_BV(SWD_SWCLK_PIN) | _BV(SWD_SWDIO_PIN));
+#endif
+}
+
+
+
+// Line reset, followed by 2 idle cycles. The SW-DP then expects a read 
+// of IDCODE.
+void swd_line_reset()
+{
+#ifndef SWD_SIMULATION
+  SWD_DDR |= _BV(SWD_SWCLK_PIN);
+#endif
+  for (uint8_t cycle = 0; cycle < SWD_LINE_RESET_CYCLES; ++cycle)
+  {
+    write_bit(1);
+  }
+  write_bit(0);
+  write_bit(0);
+}
+
+
+
+// Returns the acknowledgement (SWD_ACK_*). Only for SWD_ACK_OK, 
+// *idcode is valid.
+uint8_t swd_read_idcode(uint32_t * idcode)
+{
+  uint8_t request = SWD_REQUEST_READ_DP_IDCODE;
+  for (uint8_t n = 0; n < 8; ++n)
+  {
+    write_bit(request & 1);
+    request >>= 1;
+  }
+  
+  swdio_input();
+  turnaround();
+  
+  uint8_t ack = 0;
+  for (uint8_t n = 0; n < 3; ++n)
+  {
+    ack |= read_bit() << n;
+  }
+  
+  if (ack == SWD_ACK_OK)
+  {
+    uint32_t data = 0;
+    uint8_t parity = 0;
+    for (uint8_t n = 0; n < 32; ++n)
+    {
+      uint32_t bit = read_bit();
+      data |= bit << n;
+      parity ^= bit;
+    }
+    if (read_bit() != parity)
+    {
+      ack = SWD_ACK_PARITY_ERROR;
+    }
+    *idcode = data;
+  }
+  
+  // Turnaround back to the host, then idle.
+  turnaround();
+  for (uint8_t n = 0; n < SWD_IDLE_CYCLES; ++n)
+  {
+    write_bit(0);
+  }
+  swdio_input();
+  return ack;
+}
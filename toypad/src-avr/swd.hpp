@@ -0,0 +1,60 @@
+#ifndef _SWD_HPP_
+#define _SWD_HPP_
+
+#include <stdint.h>
+
+// Minimal Serial Wire Debug host, just enough to see whether the SW-DP 
+// of the LPC11U35 answers. With CRP3 the boot ROM disables SWD, so an 
+// answer means the glitch hit.
+// 
+// From ARM IHI 0031 ("ARM Debug Interface Architecture Specification"):
+// the host changes SWDIO while SWCLK is low, the target samples it on 
+// the rising edge. The target changes SWDIO after the rising edge, the 
+// host samples it while SWCLK is low again.
+// 
+// Pins (spare on both our boards):
+// 
+//   SWD    | ATmega32U4 | Arduino Leonardo | SparkFun Pro Micro | LPC11U35
+//   -------+------------+------------------+--------------------+---------
+//   SWCLK  |     PF4    |        A3        |          A3        | PIO0_10
+//   SWDIO  |     PF5    |        A2        |          A2        | PIO0_15
+// 
+// The LPC11U35 pins are 5 V tolerant. The glitcher only drives SWDIO 
+// during the request; otherwise the internal pull-up keeps it high, so 
+// a target that does not answer reads as all ones.
+// 
+// Note: PF4..PF7 are the JTAG pins of the ATmega32U4. swd_init() 
+// disables JTAG.
+#define SWD_PORT_GROUP		F
+#define SWD_PORT		CONCAT3(PORT, SWD_PORT_GROUP, )
+#define SWD_DDR			CONCAT3(DDR, SWD_PORT_GROUP, )
+#define SWD_PIN_REGISTER	CONCAT3(PIN, SWD_PORT_GROUP, )
+#define SWD_SWCLK_PIN		CONCAT3(PIN, SWD_PORT_GROUP, 4)
+#define SWD_SWDIO_PIN		CONCAT3(PIN, SWD_PORT_GROUP, 5)
+
+// Acknowledgements (3 bits, LSB first on the wire).
+#define SWD_ACK_OK		0x1
+#define SWD_ACK_WAIT		0x2
+#define SWD_ACK_FAULT		0x4
+#define SWD_ACK_NONE		0x7	// Nobody pulled SWDIO low.
+// Not an acknowledgement: ACK was OK, but the data had a parity error.
+#define SWD_ACK_PARITY_ERROR	0x8
+
+// Request for reading DP register IDCODE (address 0x0), LSB first:
+// 
+//   Start | APnDP | RnW | A[2:3] | Parity | Stop | Park
+//     1   |   0   |  1  |  0  0  |    1   |   0  |   1
+#define SWD_REQUEST_READ_DP_IDCODE	0xA5
+
+// Idle cycles (SWDIO low) after a transfer, so the target finishes it.
+#define SWD_IDLE_CYCLES		8
+
+// Line reset: more than 50 cycles with SWDIO high.
+#define SWD_LINE_RESET_CYCLES	56
+
+void swd_init();
+void swd_release();
+void swd_line_reset();
+uint8_t swd_read_idcode(uint32_t * idcode);
+
+#endif /* _SWD_HPP_ */
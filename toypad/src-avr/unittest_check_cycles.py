@@ -0,0 +1,94 @@
+#!/usr/bin/env python3
+
+import importlib.util
+import os
+import unittest
+
+
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+spec = importlib.util.spec_from_file_location('check_cycles',
+	os.path.join(HERE, 'check-cycles.py'))
+check_cycles = importlib.util.module_from_spec(spec)
+spec.loader.exec_module(check_cycles)
+
+VECTORS = '''
+  50:	18 95       	reti
+  52:	00 00       	nop
+  9c:	18 95       	reti
+  9e:	00 00       	nop
+'''
+
+SEQUENCE = '''
+ 3d4:	95 b9       	out	0x05, r25	; 5
+ 3d6:	80 93 81 00 	sts	0x0081, r24	; 0x800081 <__TEXT_REGION_LENGTH__+0x7e0081>
+ 3da:	88 95       	sleep
+ 3dc:	20 93 c1 00 	sts	0x00C1, r18	; 0x8000c1 <__TEXT_REGION_LENGTH__+0x7e00c1>
+ 3e0:	10 92 81 00 	sts	0x0081, r1	; 0x800081 <__TEXT_REGION_LENGTH__+0x7e0081>
+ 3e4:	88 95       	sleep
+ 3e6:	10 92 c1 00 	sts	0x00C1, r1	; 0x8000c1 <__TEXT_REGION_LENGTH__+0x7e00c1>
+'''
+
+# command_calibrate(): the start of the same sequence, then polling.
+CALIBRATION = '''
+ 5a0:	95 b9       	out	0x05, r25	; 5
+ 5a2:	80 93 81 00 	sts	0x0081, r24	; 0x800081 <__TEXT_REGION_LENGTH__+0x7e0081>
+ 5a6:	86 b3       	in	r24, 0x16	; 22
+ 5a8:	81 72       	andi	r24, 0x21	; 33
+ 5aa:	e9 f3       	breq	.-6      	; 0x5a6
+'''
+
+class TestCheckCycles(unittest.TestCase):
+	def setUp(self):
+		self.defines = check_cycles.read_defines(os.path.join(HERE, 'glitcher.hpp'))
+
+	def check(self, objdump):
+		return check_cycles.check(check_cycles.parse(objdump), self.defines)
+
+	def test_header_constants(self):
+		self.assertEqual(self.defines['CPU_CYCLES_BEFORE_STARTING_TIMER1'], 3)
+		self.assertEqual(self.defines['TIMER1_INTERRUPT_CPU_CYCLES_BEFORE_STARTING_TIMER4'], 17)
+
+	def test_good(self):
+		self.assertEqual(self.check(VECTORS + SEQUENCE), [])
+
+	def test_inlined_twice(self):
+		self.assertEqual(self.check(VECTORS + SEQUENCE + SEQUENCE), [])
+
+	def test_vector_not_reti(self):
+		objdump = VECTORS.replace('9c:	18 95       	reti', '9c:	0c 94 00 00 	jmp	0')
+		self.assertEqual(len(self.check(objdump + SEQUENCE)), 1)
+
+	def test_extra_instruction(self):
+		objdump = SEQUENCE.replace(' 3da:', ' 3d9:	00 00       	nop\n 3da:')
+		errors = self.check(VECTORS + objdump)
+		self.assertEqual(len(errors), 2)
+
+	def test_calibration(self):
+		self.assertEqual(self.check(VECTORS + SEQUENCE + CALIBRATION), [])
+
+	def test_calibration_wrong_constant(self):
+		self.defines['CALIBRATION_CPU_CYCLES_BEFORE_STARTING_TIMER1'] = 4
+		self.assertEqual(len(self.check(VECTORS + SEQUENCE + CALIBRATION)), 1)
+
+	def test_counted_from_disassembly(self):
+		# Both copies of "out" + "sts" are counted, with the cycles of the
+		# instructions themselves.
+		cycles = dict(check_cycles.INSTRUCTION_CYCLES)
+		check_cycles.INSTRUCTION_CYCLES['out'] = 2
+		try:
+			errors = self.check(VECTORS + SEQUENCE + CALIBRATION)
+		finally:
+			check_cycles.INSTRUCTION_CYCLES.update(cycles)
+		self.assertEqual(len(errors), 2)
+		self.assertIn('CALIBRATION_CPU_CYCLES_BEFORE_STARTING_TIMER1', errors[1])
+
+	def test_missing_sequence(self):
+		self.assertEqual(len(self.check(VECTORS)), 1)
+
+	def test_wrong_constant(self):
+		self.defines['TIMER1_INTERRUPT_CPU_CYCLES_BEFORE_STARTING_TIMER4'] = 16
+		self.assertEqual(len(self.check(VECTORS + SEQUENCE)), 1)
+
+if __name__ == '__main__':
+	unittest.main()
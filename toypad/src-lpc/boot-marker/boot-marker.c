@@ -0,0 +1,104 @@
+#include <stdint.h>
+
+#define NULL ( (void *) 0)
+#define _BV(bit) (1ULL << (bit))
+
+#define NT "\n\t"
+#define NX "\n"
+
+// Firmware to measure the boot timing of the LPC11U35, see "Determine
+// the start of the glitch window with respect to end of reset" in the
+// README. The glitcher (command 'C', src-pc/calibrate-boot.py)
+// timestamps the falling edges on the marker pin with its input capture
+// unit:
+//
+//   1. The boot ROM starts us. Pulse. (End of pulse = MEASUREMENT#1.)
+//   2. Jump back into the boot ROM, to the start of the glitch window
+//      (0x1fff00a8).
+//   3. The boot ROM starts us again. Pulse. (Time between the ends of
+//      both pulses = MEASUREMENT#2.)
+//   4. Hang.
+//
+// Both pulses run exactly the same code, so the pulse itself cancels
+// out of MEASUREMENT#1 - MEASUREMENT#2.
+
+#define GPIO_BASE	0x50000000
+#define GPIO_PORT_DIR0	(*(volatile uint32_t *)(GPIO_BASE | 0x2000))
+#define GPIO_PORT_SET0	(*(volatile uint32_t *)(GPIO_BASE | 0x2200))
+#define GPIO_PORT_CLR0	(*(volatile uint32_t *)(GPIO_BASE | 0x2280))
+
+// PIO0_2, to ICP1 (PD4) of the glitcher.
+#define MARKER_PIN	2
+#define MARKER_MASK	(1 << MARKER_PIN)
+
+// Start of the glitch window in the boot ROM. Thumb code, so bit 0 set.
+#define BOOT_ROM_GLITCH_WINDOW_START	0x1fff00a9
+
+// Number of delay loop iterations the marker pin is high. 4 cycles per
+// iteration @ 12 MHz, so 1 microsecond. Long enough for the glitcher to
+// see the pulse, short enough to not matter.
+#define MARKER_PULSE_LOOPS	3
+
+
+
+int main()
+{
+	// GPIO_PORT_DIR0 is 0 after a reset, and the boot ROM leaves it
+	// alone. We use it to know whether this is the first or the
+	// second time the boot ROM started us. (RAM would survive the jump
+	// as well, but its contents after power up are random.)
+	uint32_t first_pass = !(GPIO_PORT_DIR0 & MARKER_MASK);
+
+	uint32_t loops = MARKER_PULSE_LOOPS;
+	GPIO_PORT_DIR0 |= MARKER_MASK;
+	asm volatile (
+		NT "str %[mask], [%[set]]"
+		NX "1:"
+		NT "subs %[loops], #1"
+		NT "bne 1b"
+		NT "str %[mask], [%[clr]]"
+	: // Output operands.
+		[loops] "+l" (loops)
+	: // Input operands.
+		[mask] "l" (MARKER_MASK),
+		[set] "l" (&GPIO_PORT_SET0),
+		[clr] "l" (&GPIO_PORT_CLR0)
+	: "cc", "memory"
+	);
+
+	if (first_pass)
+	{
+		asm volatile (
+			NT "bx %0"
+		: // Output operands.
+		: // Input operands.
+			"l" (BOOT_ROM_GLITCH_WINDOW_START)
+		);
+	}
+
+	while (1) {}
+}
+
+void hang(){while(1);}
+
+struct vectors {
+	uint32_t stack;
+	void * core_interrupts[1];
+};
+
+#define initial_stack 0x10000ffc
+const struct vectors vectors __attribute__((section (".fault_vector"))) =
+{
+	initial_stack,		// 0 Initial stack pointer
+	&main,			// 1 Reset handler
+};
+const void * irqs[32] __attribute__((section (".irq_vector"))) =
+{
+	NULL,
+};
+
+void _close_r() {}
+void _lseek_r() {}
+void _read_r() {}
+void _write_r() {}
+void _sbrk() {}
@@ -0,0 +1,431 @@
+#include <stdint.h>
+
+#define NULL ( (void *) 0)
+#define _BV(bit) (1ULL << (bit))
+
+#define NT "\n\t"
+#define NX "\n"
+
+// Replica of the code read protection check of the boot ROM
+// (0x1fff00a8 - 0x1fff00c4 in bootloader.lst), to tune the width and
+// the offset of the glitch on the development board before spending
+// attempts on the toypad:
+//
+//   ldr	r2, [pc, #..]	r2 = CRP register (here: crp_register)
+//   ldr	r3, [pc, #..]	r3 = &crp_literals[0]
+//   ldr	r3, [r3, #0]	r3 = 000002fc
+//   ldr	r5, [pc, #..]	r5 = &crp_literals[2]
+//   ldr	r5, [r5, #0]	r5 = CRP3 (here: REPLICA_CRP3)
+//   ldr	r6, [pc, #..]	r6 = &crp_literals[3]
+//   ldr	r6, [r6, #0]	r6 = CRP1
+//   ldr	r4, [r3, #0]	r4 = *2fc
+//   cmp	r4, r5
+//   beq.n	1f
+//   cmp	r4, r6
+//   bne.n	2f		"CRP disabled": store *2fc as it is.
+// 1:
+//   ldr	r4, [pc, #..]	r4 = &crp_literals[1]
+//   ldr	r4, [r4, #0]	r4 = CRP2
+// 2:
+//   str	r4, [r2, #0]
+//
+// Same instructions, same registers, same literal pool indirection, and
+// the same flash read at 0x2fc. Two differences:
+//
+//   1. 0x2fc holds REPLICA_CRP3, not CRP3. With CRP3 in our own flash
+//      the boot ROM would lock SWD and ISP of the development board for
+//      good. REPLICA_CRP3 has the same number of ones as CRP3.
+//   2. r4 is stored in RAM (crp_register), not in the CRP register of
+//      the boot ROM (0x400483f0).
+//
+// Without a glitch crp_register ends up CRP2, like on the toypad.
+// Anything else: the glitch got us past the check.
+//
+// SysTick runs the replica every PERIOD_CYCLES, from its interrupt
+// handler. The core sleeps (wfi) in between, so the interrupt latency,
+// and so the position of the replica within the period, is the same
+// every iteration. The marker pin is high during the replica (falling
+// edge right after the store), the bypass pin tells the outcome of the
+// last iteration. The UART reports every bypass (see the records below).
+
+// 40 us @ 12 MHz: 25000 iterations per second. The glitcher ('L') sweeps
+// the offset by giving its pulses at a slightly different period.
+#define PERIOD_CYCLES	480
+
+#define CRP1		0x12345678
+#define CRP2		0x87654321
+#define CRP3		0x43218765
+#define REPLICA_CRP3	0x43218766
+
+// PIO0_2, to ICP1 (PD4) of the glitcher (as src-lpc/boot-marker).
+#define MARKER_PIN	2
+#define MARKER_MASK	(1 << MARKER_PIN)
+// PIO0_7: high after an iteration that got past the check.
+#define BYPASS_PIN	7
+#define BYPASS_MASK	(1 << BYPASS_PIN)
+
+#define LED_RED		24
+#define LED_GREEN	25
+#define LED_BLUE	26
+#define LEDS_MASK	((1 << LED_RED) | (1 << LED_GREEN) | (1 << LED_BLUE))
+
+// Records (all numbers little endian), ended by the XOR of all bytes
+// after the sync:
+//
+//   0xFB <iteration> <crp_register> <checksum>
+//        After every iteration that did not store CRP2.
+//   0xFC <iterations> <bypasses> <dropped> <checksum>
+//        At boot, and every STATUS_INTERVAL iterations. <dropped>:
+//        uint8_t, records that did not fit in the transmit buffer since
+//        the previous status record (saturates at 255).
+//
+// <iteration>, <iterations>, <bypasses> and <crp_register> are uint32_t.
+// See src-pc/crp_replica.py.
+#define RECORD_BYPASS	0xFB
+#define RECORD_STATUS	0xFC
+#define STATUS_INTERVAL	(1 << 16)
+
+#define SYST_CSR	(*(volatile uint32_t*)0xE000E010)
+#define SYST_CSR_ENABLE	(0)
+#define SYST_CSR_TICKINT (1)
+#define SYST_CSR_CLKSOURCE (2)
+#define SYST_RVR	(*(volatile uint32_t*)0xE000E014)
+#define SYST_CVR	(*(volatile uint32_t*)0xE000E018)
+
+#define NVIC_ISER	(*(volatile uint32_t*)0xE000E100)
+#define NVIC_ISER_USART	(21)
+
+#define SCB_AIRCR	(*(volatile uint32_t*)0xE000ED0C)
+#define AIRCR_VECTKEY	(0x05FA << 16)
+#define SYSRESETREQ	(1 << 2)
+
+// Flash access time, bits 1:0. Reset value: 3 system clocks. At 12 MHz
+// 1 clock is enough, which is closer to the boot ROM.
+#define FLASHCFG	(*(volatile uint32_t*)0x4003C010)
+#define FLASHTIM_MASK	(3)
+#define FLASHTIM_1	(0)
+
+#define SYSAHBCLKCTRL	(*(volatile uint32_t*)0x40048080)
+#define UARTCLKDIV	(*(volatile uint32_t*)0x40048098)
+
+#define IOCON_BASE	0x40044000
+#define IOCON_PIO0_18	(*(volatile uint32_t*)(IOCON_BASE + 4 * 18))	// UART0: RXD
+#define IOCON_PIO0_19	(*(volatile uint32_t*)(IOCON_BASE + 4 * 19))	// UART0: TXD
+
+#define UART0_BASE	0x40008000
+#define UART0_RBR	(*(volatile uint32_t*)(UART0_BASE + 0x00))
+#define UART0_THR	(*(volatile uint32_t*)(UART0_BASE + 0x00))
+#define UART0_DLL	(*(volatile uint32_t*)(UART0_BASE + 0x00))
+#define UART0_DLM	(*(volatile uint32_t*)(UART0_BASE + 0x04))
+#define UART0_IER	(*(volatile uint32_t*)(UART0_BASE + 0x04))
+#define IER_RBRINTEN	(0)
+#define IER_THREINTEN	(1)
+#define UART0_IIR	(*(volatile uint32_t*)(UART0_BASE + 0x08))	// Read
+#define IIR_INTSTATUS	(0)						// 0: interrupt pending
+#define IIR_INTID_MASK	(7 << 1)
+#define IIR_INTID_THRE	(1 << 1)
+#define IIR_INTID_RDA	(2 << 1)
+#define IIR_INTID_CTI	(6 << 1)
+#define UART0_FCR	(*(volatile uint32_t*)(UART0_BASE + 0x08))	// Write
+#define FCR_FIFOEN	(0)
+#define FCR_RXFIFORES	(1)
+#define FCR_TXFIFORES	(2)
+#define UART_FIFO_SIZE	16
+#define UART0_LCR	(*(volatile uint32_t*)(UART0_BASE + 0x0C))
+#define UART0_LSR	(*(volatile uint32_t*)(UART0_BASE + 0x14))	// Line Status Register
+#define LSR_RDR		(0)						// Receiver Data Ready
+#define LSR_THRE	(5)						// Transmit FIFO empty
+#define UART0_FDR	(*(volatile uint32_t*)(UART0_BASE + 0x28))
+
+#define GPIO_BASE	0x50000000
+#define GPIO_PORT_DIR0	(*(volatile uint32_t *)(GPIO_BASE | 0x2000))
+#define GPIO_PORT_DIR1	(*(volatile uint32_t *)(GPIO_BASE | 0x2004))
+#define GPIO_PORT_SET0_ADDRESS	(GPIO_BASE | 0x2200)
+#define GPIO_PORT_SET0	(*(volatile uint32_t *)GPIO_PORT_SET0_ADDRESS)
+#define GPIO_PORT_SET1	(*(volatile uint32_t *)(GPIO_BASE | 0x2204))
+#define GPIO_PORT_CLR0_ADDRESS	(GPIO_BASE | 0x2280)
+#define GPIO_PORT_CLR0	(*(volatile uint32_t *)GPIO_PORT_CLR0_ADDRESS)
+#define GPIO_PORT_CLR1	(*(volatile uint32_t *)(GPIO_BASE | 0x2284))
+
+static inline void set_red()	{ GPIO_PORT_CLR1 = 1 << LED_RED; }
+static inline void set_green()	{ GPIO_PORT_CLR1 = 1 << LED_GREEN; }
+static inline void clear_red()	{ GPIO_PORT_SET1 = 1 << LED_RED; }
+static inline void clear_green(){ GPIO_PORT_SET1 = 1 << LED_GREEN; }
+static inline void clear_blue()	{ GPIO_PORT_SET1 = 1 << LED_BLUE; }
+
+
+
+// The code protection word the replica reads. At 0x2fc, see memory.ld.
+const uint32_t crp_word __attribute__((section (".crp"))) = REPLICA_CRP3;
+
+// Like the literals of the boot ROM at 0x1fff0128 - 0x1fff0137.
+const uint32_t crp_literals[4] =
+{
+	0x000002fc,
+	CRP2,
+	REPLICA_CRP3,
+	CRP1,
+};
+
+// There is no C runtime to initialize .data, and .bss is not cleared:
+// main() sets these.
+volatile uint32_t crp_register;
+static uint32_t iterations;
+static uint32_t bypasses;
+
+// Transmit buffer of the UART, emptied by uart_irq_handler(). Power of 2.
+#define TX_BUFFER_SIZE		256
+#define TX_BUFFER_MASK		(TX_BUFFER_SIZE - 1)
+static uint8_t tx_buffer[TX_BUFFER_SIZE];
+static volatile uint32_t tx_head;	// Written by the SysTick handler.
+static volatile uint32_t tx_tail;	// Written by uart_irq_handler().
+static uint8_t records_dropped;
+
+
+
+void uart_init()
+{
+	// Enable clocks to UART and IOCON.
+	SYSAHBCLKCTRL |= (1 << 12) | (1 << 16);
+
+	// Set UART clock divider to 1 (system clock).
+	UARTCLKDIV = 1;
+
+	// Configure RXD (PIO0_18) and TXD (PIO0_19).
+	IOCON_PIO0_18 = 0x01;	// RXD
+	IOCON_PIO0_19 = 0x01;	// TXD
+
+	// 115200 baud @ 12 MHz, see uart_init() of voltage-glitch-loop.c.
+	UART0_LCR = 0x80;			// Enable access to Divisor Latches.
+	UART0_DLM = 0;
+	UART0_DLL = 4;
+	UART0_FDR = (5 << 0) | (8 << 4);	// DivAddVal = 5, MulVal = 8
+	UART0_LCR = 0x03;			// 8 bits, no parity, 1 stop bit
+
+	UART0_FCR = _BV(FCR_FIFOEN) | _BV(FCR_RXFIFORES) | _BV(FCR_TXFIFORES);
+	UART0_IER = _BV(IER_RBRINTEN) | _BV(IER_THREINTEN);
+	NVIC_ISER = _BV(NVIC_ISER_USART);
+}
+
+// Move bytes from the transmit buffer to the (empty) transmit FIFO.
+// Called by uart_irq_handler(), or with interrupts disabled.
+static void uart_fill_fifo()
+{
+	if (!(UART0_LSR & _BV(LSR_THRE)))
+		return;
+	uint32_t tail = tx_tail;
+	for (uint32_t n = 0; n < UART_FIFO_SIZE && tail != tx_head; n++)
+	{
+		UART0_THR = tx_buffer[tail];
+		tail = (tail + 1) & TX_BUFFER_MASK;
+	}
+	tx_tail = tail;
+}
+
+// Queue a record: sync, size bytes of payload, checksum. Dropped (and
+// counted) if it does not fit.
+void send_record(uint8_t sync, const uint8_t * payload, uint32_t size)
+{
+	uint32_t head = tx_head;
+	uint32_t room = (tx_tail - head - 1) & TX_BUFFER_MASK;
+	if (size + 2 > room)
+	{
+		if (records_dropped != 0xFF)
+			records_dropped++;
+		return;
+	}
+	uint8_t checksum = 0;
+	tx_buffer[head] = sync;
+	for (uint32_t i = 0; i < size; i++)
+	{
+		tx_buffer[(head + 1 + i) & TX_BUFFER_MASK] = payload[i];
+		checksum ^= payload[i];
+	}
+	tx_buffer[(head + 1 + size) & TX_BUFFER_MASK] = checksum;
+	tx_head = (head + size + 2) & TX_BUFFER_MASK;
+
+	// The transmit interrupt only fires when the FIFO becomes empty. If
+	// it already is, nobody would start sending.
+	asm volatile ("cpsid i" ::: "memory");
+	uart_fill_fifo();
+	asm volatile ("cpsie i" ::: "memory");
+}
+
+static inline void put_uint32(uint8_t * p, uint32_t value)
+{
+	p[0] = value;
+	p[1] = value >> 8;
+	p[2] = value >> 16;
+	p[3] = value >> 24;
+}
+
+void send_status()
+{
+	uint8_t payload[9];
+	put_uint32(payload, iterations);
+	put_uint32(payload + 4, bypasses);
+	payload[8] = records_dropped;
+	records_dropped = 0;
+	send_record(RECORD_STATUS, payload, sizeof payload);
+}
+
+void uart_irq_handler()
+{
+	uint32_t iir;
+	while (!((iir = UART0_IIR) & _BV(IIR_INTSTATUS)))
+	{
+		switch (iir & IIR_INTID_MASK)
+		{
+			case IIR_INTID_THRE:
+				uart_fill_fifo();
+				break;
+
+			case IIR_INTID_RDA:
+			case IIR_INTID_CTI:
+				// R: We must reset. Anything else is ignored.
+				if (UART0_RBR == 'R')
+				{
+					SCB_AIRCR = AIRCR_VECTKEY | SYSRESETREQ;
+					while (1);	// Wait for reset.
+				}
+				break;
+
+			default:
+				// Line status (overrun, framing error, ...).
+				// Reading the LSR clears it.
+				(void) UART0_LSR;
+		}
+	}
+}
+
+
+
+void systick_handler()
+{
+	asm volatile (
+		NT "ldr r0, =%c[set]"
+		NT "ldr r1, =%c[marker]"
+		NT "str r1, [r0, #0]"
+		// The replica, see the top of this file.
+		NT "ldr r2, =crp_register"
+		NT "ldr r3, =crp_literals + 0"
+		NT "ldr r3, [r3, #0]"
+		NT "ldr r5, =crp_literals + 8"
+		NT "ldr r5, [r5, #0]"
+		NT "ldr r6, =crp_literals + 12"
+		NT "ldr r6, [r6, #0]"
+		NT "ldr r4, [r3, #0]"
+		NT "cmp r4, r5"
+		NT "beq.n 1f"
+		NT "cmp r4, r6"
+		NT "bne.n 2f"
+		NX "1:"
+		NT "ldr r4, =crp_literals + 4"
+		NT "ldr r4, [r4, #0]"
+		NX "2:"
+		NT "str r4, [r2, #0]"
+		// End of the replica.
+		NT "ldr r0, =%c[clr]"
+		NT "str r1, [r0, #0]"
+	: // Output operands.
+	: // Input operands.
+		[set] "i" (GPIO_PORT_SET0_ADDRESS),
+		[clr] "i" (GPIO_PORT_CLR0_ADDRESS),
+		[marker] "i" (MARKER_MASK)
+	: "r0", "r1", "r2", "r3", "r4", "r5", "r6", "cc", "memory"
+	);
+
+	uint32_t stored = crp_register;
+	iterations++;
+	if (stored != CRP2)
+	{
+		GPIO_PORT_SET0 = BYPASS_MASK;
+		set_red();
+		bypasses++;
+		uint8_t payload[8];
+		put_uint32(payload, iterations);
+		put_uint32(payload + 4, stored);
+		send_record(RECORD_BYPASS, payload, sizeof payload);
+	}
+	else
+	{
+		GPIO_PORT_CLR0 = BYPASS_MASK;
+	}
+	if (!(iterations & (STATUS_INTERVAL - 1)))
+		send_status();
+}
+
+
+
+int main()
+{
+	crp_register = 0;
+	iterations = 0;
+	bypasses = 0;
+	tx_head = 0;
+	tx_tail = 0;
+	records_dropped = 0;
+
+	FLASHCFG = (FLASHCFG & ~FLASHTIM_MASK) | FLASHTIM_1;
+
+	GPIO_PORT_CLR0 = MARKER_MASK | BYPASS_MASK;
+	GPIO_PORT_DIR0 |= MARKER_MASK | BYPASS_MASK;
+	GPIO_PORT_DIR1 |= LEDS_MASK;
+	clear_red();
+	clear_green();
+	clear_blue();
+	set_green();
+
+	uart_init();
+	send_status();
+
+	// Processor clock, interrupt on every wrap.
+	SYST_RVR = PERIOD_CYCLES - 1;
+	SYST_CVR = 0;
+	SYST_CSR = _BV(SYST_CSR_ENABLE) | _BV(SYST_CSR_TICKINT) | _BV(SYST_CSR_CLKSOURCE);
+
+	while (1)
+	{
+		asm volatile ("wfi");
+	}
+}
+
+void hang(){while(1);}
+
+struct vectors {
+	uint32_t stack;
+	void * core_interrupts[15];
+};
+
+#define initial_stack 0x10000ffc
+const struct vectors vectors __attribute__((section (".fault_vector"))) =
+{
+	initial_stack,		// 0 Initial stack pointer
+	{
+		&main,		// 1 Reset handler
+		&hang,		// 2 NMI
+		&hang,		// 3 HardFault
+		NULL,		// 4 Reserved
+		NULL,		// 5 Reserved
+		NULL,		// 6 Reserved
+		NULL,		// 7 Checksum, see cm3_checksum.py
+		NULL,		// 8 Reserved
+		NULL,		// 9 Reserved
+		NULL,		// 10 Reserved
+		&hang,		// 11 SVCall
+		NULL,		// 12 Reserved
+		NULL,		// 13 Reserved
+		&hang,		// 14 PendSV
+		&systick_handler,	// 15 SysTick
+	},
+};
+const void * irqs[32] __attribute__((section (".irq_vector"))) =
+{
+	[21] = &uart_irq_handler,	// IRQ 21: USART
+};
+
+void _close_r() {}
+void _lseek_r() {}
+void _read_r() {}
+void _write_r() {}
+void _sbrk() {}
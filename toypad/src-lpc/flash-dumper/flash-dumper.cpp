@@ -0,0 +1,175 @@
+#include <stdint.h>
+
+#include "../lpc11u3x.hpp"
+
+using namespace lpc11u3x;
+
+// Flash dumper: a small payload to load into the RAM of the LPC11U35
+// over SWD ("make run"), once a glitch got us past the code read
+// protection. It sends the 32k of flash over UART0 in blocks, each with
+// its own CRC32, and sends single blocks again on request. The host side
+// is src-pc/flash_dump.py.
+//
+// Position independent: no data, no function pointers, only relative
+// branches and the (absolute) addresses of peripherals. memory.ld
+// discards .data and .bss, so using either fails the link. It runs
+// wherever it is loaded, in the first 6k of the RAM.
+//
+// It does not trust whatever ran before (e.g. the firmware of the
+// toypad, with its PLL for USB): interrupts off, back to the 12 MHz IRC,
+// and the watchdog fed (once it runs, it cannot be stopped).
+//
+// Frames to the host, all numbers little endian:
+//
+//   0xD5 'H' <flash size: uint32_t> <block size: uint16_t> <crc32>
+//        Hello, when we start and on command 'H'.
+//   0xD5 'D' <block: uint16_t> <BLOCK_SIZE bytes of flash> <crc32>
+//
+// <crc32>: CRC-32 (as zlib) of everything after the sync byte.
+//
+// Commands from the host:
+//
+//   'H'               Hello.
+//   'A'               All blocks, in order.
+//   'B' <block: uint16_t>
+//                     One block.
+
+// Override with "make BAUD=...".
+#ifndef BAUD
+#define BAUD 1000000
+#endif
+
+#define FLASH_SIZE	(32 * 1024)
+#define BLOCK_SIZE	256
+#define NUM_BLOCKS	(FLASH_SIZE / BLOCK_SIZE)
+#define FRAME_SYNC	0xD5
+
+// The stack: the top 2k of the RAM.
+#define STACK_TOP	0x10001ff8
+
+#define STRINGIFY_(x) #x
+#define STRINGIFY(x) STRINGIFY_(x)
+
+// Bit by bit: no table (no data), and still faster than the UART.
+static uint32_t crc32_update(uint32_t crc, uint8_t byte)
+{
+	crc ^= byte;
+	for (int bit = 0; bit < 8; bit++)
+		crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+	return crc;
+}
+
+// Send a byte and add it to the CRC. The CRC of one byte takes less
+// than the 10 bits of the previous one on the wire.
+static uint32_t send(uint32_t crc, uint8_t byte)
+{
+	uart0_send_byte(byte);
+	return crc32_update(crc, byte);
+}
+
+static uint32_t send_uint16(uint32_t crc, uint16_t value)
+{
+	crc = send(crc, value);
+	return send(crc, value >> 8);
+}
+
+static uint32_t send_uint32(uint32_t crc, uint32_t value)
+{
+	crc = send_uint16(crc, value);
+	return send_uint16(crc, value >> 16);
+}
+
+static void send_crc(uint32_t crc)
+{
+	crc = ~crc;
+	for (int i = 0; i < 4; i++)
+		uart0_send_byte(crc >> (8 * i));
+}
+
+static void send_hello()
+{
+	uart0_send_byte(FRAME_SYNC);
+	uint32_t crc = send(0xFFFFFFFF, 'H');
+	crc = send_uint32(crc, FLASH_SIZE);
+	crc = send_uint16(crc, BLOCK_SIZE);
+	send_crc(crc);
+}
+
+static void send_block(uint16_t block)
+{
+	if (block >= NUM_BLOCKS)
+		return;
+	wwdt::feed();
+	const volatile uint8_t * flash = (const volatile uint8_t *) (uintptr_t) (block * BLOCK_SIZE);
+	uart0_send_byte(FRAME_SYNC);
+	uint32_t crc = send(0xFFFFFFFF, 'D');
+	crc = send_uint16(crc, block);
+	for (int i = 0; i < BLOCK_SIZE; i++)
+		crc = send(crc, flash[i]);
+	send_crc(crc);
+}
+
+static uint8_t receive()
+{
+	while (!(uart0::LSR::read() & uart0::LSR_RDR))
+		wwdt::feed();
+	return uart0::RBR::read();
+}
+
+static void clock_init()
+{
+	// IRC on, main clock from the IRC. The UART runs from the main
+	// clock (UARTCLKDIV = 1 in uart0_init()).
+	syscon::PDRUNCFG::clear_bits(syscon::PD_IRCOUT | syscon::PD_IRC);
+	syscon::MAINCLKSEL::write(syscon::MAINCLK_IRC);
+	syscon::MAINCLKUEN::write(0);
+	syscon::MAINCLKUEN::write(1);
+
+	// The first 512 bytes could still be the vectors of the boot ROM 
+	// or the RAM.
+	syscon::SYSMEMREMAP::write(syscon::SYSMEMREMAP_USER_FLASH);
+}
+
+extern "C" void __attribute__((noreturn)) dumper_main()
+{
+	clock_init();
+	uart0_init<BAUD>();
+	send_hello();
+
+	while (1)
+	{
+		switch (receive())
+		{
+			case 'H':
+				send_hello();
+				break;
+
+			case 'A':
+				for (uint16_t block = 0; block < NUM_BLOCKS; block++)
+					send_block(block);
+				break;
+
+			case 'B':
+			{
+				uint16_t block = receive();
+				block |= receive() << 8;
+				send_block(block);
+				break;
+			}
+		}
+	}
+}
+
+// The entry point, at the start of the payload (see memory.ld). Only
+// relative branches from here on.
+extern "C" void __attribute__((naked, noreturn, section (".text.entry"))) _start()
+{
+	// Basic asm only in a naked function.
+	asm volatile (
+		"\n\tcpsid i"
+		"\n\tldr r0, =" STRINGIFY(STACK_TOP)
+		"\n\tmov sp, r0"
+		"\n\tbl dumper_main"
+		"\n\t.ltorg"
+	);
+}
@@ -0,0 +1,181 @@
+#ifndef _LPC11U3X_TIMING_HPP_
+#define _LPC11U3X_TIMING_HPP_
+
+// Timing service for the C++ target firmwares, instead of "volatile"
+// delay loops with a guessed number of cycles per iteration:
+//
+//   - cycles(): a free-running 32-bit cycle counter (CT32B1, prescaler
+//     1, so one count per system clock; wraps after 358 s @ 12 MHz).
+//   - delay_cycles<N>(): exactly N cycles, for N known at compile time.
+//   - wait_cycles(), wait_until(), delay_us(), delay_ms(): long waits on
+//     the counter. They end up to WAIT_JITTER_CYCLES late.
+//   - Marker<port, pin>::pulse<N>(): a marker pulse exactly N cycles
+//     wide, with the counter value at both edges.
+//
+// The exact counts assume the flash answers in 1 system clock, which
+// init() sets (good up to 20 MHz). Cortex-M0: "subs" takes 1 cycle, a
+// taken "bne" 3, an untaken one 1, "ldr" 2, "nop" 1.
+
+#include <stdint.h>
+
+#include "lpc11u3x.hpp"
+
+namespace lpc11u3x
+{
+namespace timing
+{
+
+constexpr uint32_t CPU_HZ = 12000000;	// IRC, no PLL
+constexpr uint32_t CYCLES_PER_US = CPU_HZ / 1000000;
+
+// The poll loop of wait_until(): ldr (the counter), subs, cmp/bmi.
+constexpr uint32_t WAIT_JITTER_CYCLES = 8;
+
+using counter = ct32b1;
+
+inline void init()
+{
+	flash::FLASHCFG::write(flash::FLASHCFG::read() & ~flash::FLASHTIM_MASK);
+	syscon::SYSAHBCLKCTRL::set_bits(syscon::CLK_CT32B1);
+	counter::TCR::write(counter::TCR_CRST);
+	counter::CTCR::write(0);	// Timer mode: count PCLK
+	counter::PR::write(0);
+	counter::MCR::write(0);		// Free running, no match actions
+	counter::TCR::write(counter::TCR_CEN);
+}
+
+inline uint32_t cycles() { return counter::TC::read(); }
+
+// Exactly N cycles, the loading of the loop counter included.
+template <uint32_t N>
+inline void delay_cycles()
+{
+	// "ldr =" (2) + 4 per loop iteration - 2 for the last "bne": 4 *
+	// loops. The rest with nops.
+	constexpr uint32_t loops = N / 4;
+	constexpr uint32_t nops = N % 4;
+	if (loops)
+	{
+		uint32_t n;
+		asm volatile (
+			"\n\tldr %[n], =%c[loops]"
+			"\n1:"
+			"\n\tsubs %[n], #1"
+			"\n\tbne 1b"
+		: [n] "=l" (n)
+		: [loops] "i" (loops)
+		: "cc"
+		);
+	}
+	asm volatile (
+		"\n\t.rept %c[nops]"
+		"\n\tnop"
+		"\n\t.endr"
+	:
+	: [nops] "i" (nops)
+	);
+}
+
+// Until cycles() passes deadline (wraps are fine for waits below 2^31
+// cycles).
+inline void wait_until(uint32_t deadline)
+{
+	while ((int32_t) (cycles() - deadline) < 0)
+	{}
+}
+
+inline void wait_cycles(uint32_t n)
+{
+	wait_until(cycles() + n);
+}
+
+inline void delay_us(uint32_t us)
+{
+	wait_cycles(us * CYCLES_PER_US);
+}
+
+inline void delay_ms(uint32_t ms)
+{
+	// In 1 ms steps, so the cycle count does not overflow.
+	uint32_t deadline = cycles();
+	for (uint32_t i = 0; i < ms; i++)
+	{
+		deadline += 1000 * CYCLES_PER_US;
+		wait_until(deadline);
+	}
+}
+
+// The counter values right after both edges of a marker pulse. Both are
+// read by the same instruction at the same distance from its edge, so
+// fall - rise is the width of the pulse.
+struct MarkerPulse
+{
+	uint32_t rise;
+	uint32_t fall;
+};
+
+template <unsigned Port, unsigned Pin>
+struct Marker
+{
+	static constexpr uint32_t MASK = 1 << Pin;
+
+	// Output, low.
+	static void init()
+	{
+		gpio::CLR<Port>::write(MASK);
+		gpio::DIR<Port>::set_bits(MASK);
+	}
+
+	// High for exactly Width cycles (store to store).
+	template <uint32_t Width>
+	static MarkerPulse pulse()
+	{
+		// From the end of the first store to the end of the second:
+		// ldr (counter) 2, ldr (loops) 2, the loop 4 * loops - 2, the
+		// nops and the second str 2. CT32B1 sits on the APB; the 2
+		// cycles of its ldr assume the bridge adds no wait state at
+		// the 12 MHz of init(). At least one loop: with none, "subs"
+		// would wrap and loop 2^32 times.
+		static_assert(Width >= 8, "marker pulse too short");
+		constexpr uint32_t loops = (Width - 4) / 4;
+		constexpr uint32_t nops = (Width - 4) % 4;
+		MarkerPulse p;
+		uint32_t n;
+		asm volatile (
+			"\n\tstr %[mask], [%[set]]"
+			"\n\tldr %[rise], [%[tc]]"
+			"\n\tldr %[n], =%c[loops]"
+			"\n1:"
+			"\n\tsubs %[n], #1"
+			"\n\tbne 1b"
+			"\n\t.rept %c[nops]"
+			"\n\tnop"
+			"\n\t.endr"
+			"\n\tstr %[mask], [%[clr]]"
+			"\n\tldr %[fall], [%[tc]]"
+		: [rise] "=&l" (p.rise),
+		  [fall] "=&l" (p.fall),
+		  [n] "=&l" (n)
+		: [mask] "l" (MASK),
+		  [set] "l" (&gpio::SET<Port>::ref()),
+		  [clr] "l" (&gpio::CLR<Port>::ref()),
+		  [tc] "l" (&counter::TC::ref()),
+		  [loops] "i" (loops),
+		  [nops] "i" (nops)
+		: "cc", "memory"
+		);
+		return p;
+	}
+};
+
+// "<8 hex digits>", e.g. for a cycle count.
+inline void uart0_send_hex32(uint32_t value)
+{
+	for (int shift = 28; shift >= 0; shift -= 4)
+		uart0_send_byte("0123456789abcdef"[(value >> shift) & 0xF]);
+}
+
+}
+}
+
+#endif
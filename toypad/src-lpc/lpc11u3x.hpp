@@ -0,0 +1,339 @@
+#ifndef _LPC11U3X_HPP_
+#define _LPC11U3X_HPP_
+
+// Register map of the LPC11U3x (UM10462), for the C++ target firmwares.
+// Header only: every access is an inline function of a constant
+// address, so it compiles to the same single load or store as the
+// "#define X (*(volatile uint32_t*)0x...)" of the C firmwares.
+//
+//   lpc11u3x::uart0::LCR::write(0x03);
+//   lpc11u3x::gpio::SET<1>::write(1 << 24);
+//
+// And the UART divisors for any baud rate, computed by the compiler:
+//
+//   lpc11u3x::uart0_init<1000000>();	// 1 Mbps @ 12 MHz
+//
+// A baud rate the UART cannot make (within max_error_ppm) does not
+// compile.
+
+#include <stdint.h>
+
+namespace lpc11u3x
+{
+
+template <uint32_t Address>
+struct Register
+{
+	static volatile uint32_t & ref() { return *reinterpret_cast<volatile uint32_t *>(Address); }
+	static uint32_t read() { return ref(); }
+	static void write(uint32_t value) { ref() = value; }
+	// Read-modify-write.
+	static void set_bits(uint32_t mask) { ref() |= mask; }
+	static void clear_bits(uint32_t mask) { ref() &= ~mask; }
+};
+
+// System control. Chapter 3.
+namespace syscon
+{
+	constexpr uint32_t BASE = 0x40048000;
+	using SYSMEMREMAP	= Register<BASE + 0x000>;
+	using SYSPLLCLKSEL	= Register<BASE + 0x040>;
+	using SYSPLLCLKUEN	= Register<BASE + 0x044>;
+	using MAINCLKSEL	= Register<BASE + 0x070>;
+	using MAINCLKUEN	= Register<BASE + 0x074>;
+	using SYSAHBCLKCTRL	= Register<BASE + 0x080>;
+	using UARTCLKDIV	= Register<BASE + 0x098>;
+	using PDRUNCFG		= Register<BASE + 0x238>;
+
+	// SYSMEMREMAP: what is mapped at 0x00000000 - 0x000001ff.
+	constexpr uint32_t SYSMEMREMAP_USER_FLASH = 2;
+	// MAINCLKSEL.
+	constexpr uint32_t MAINCLK_IRC	= 0;
+	// Bits of PDRUNCFG (1: powered down).
+	constexpr uint32_t PD_IRCOUT	= 1 << 0;
+	constexpr uint32_t PD_IRC	= 1 << 1;
+
+	// Bits of SYSAHBCLKCTRL.
+	constexpr uint32_t CLK_GPIO	= 1 << 6;
+	constexpr uint32_t CLK_CT32B0	= 1 << 9;
+	constexpr uint32_t CLK_CT32B1	= 1 << 10;
+	constexpr uint32_t CLK_USART	= 1 << 12;
+	constexpr uint32_t CLK_IOCON	= 1 << 16;
+}
+
+// Flash controller. FLASHTIM (bits 1:0): access time - 1, in system
+// clocks. Reset value 2; 0 is enough up to 20 MHz.
+namespace flash
+{
+	using FLASHCFG		= Register<0x4003C010>;
+	constexpr uint32_t FLASHTIM_MASK = 3;
+}
+
+// Windowed watchdog. Chapter 17, see also ../watchdog.h.
+namespace wwdt
+{
+	using MOD		= Register<0x40004000>;
+	using FEED		= Register<0x40004008>;
+
+	// Harmless if the watchdog does not run. Once it does, it cannot
+	// be stopped.
+	inline void feed()
+	{
+		FEED::write(0xAA);
+		FEED::write(0x55);
+	}
+}
+
+// Pin configuration, port 0 only. Chapter 7.
+namespace iocon
+{
+	template <unsigned Pin>
+	using PIO0 = Register<0x40044000 + 4 * Pin>;
+
+	constexpr uint32_t FUNC_UART = 0x01;	// PIO0_18: RXD, PIO0_19: TXD
+}
+
+// USART. Chapter 12.
+namespace uart0
+{
+	constexpr uint32_t BASE = 0x40008000;
+	using RBR		= Register<BASE + 0x00>;	// DLAB = 0, read
+	using THR		= Register<BASE + 0x00>;	// DLAB = 0, write
+	using DLL		= Register<BASE + 0x00>;	// DLAB = 1
+	using DLM		= Register<BASE + 0x04>;	// DLAB = 1
+	using IER		= Register<BASE + 0x04>;	// DLAB = 0
+	using IIR		= Register<BASE + 0x08>;	// Read
+	using FCR		= Register<BASE + 0x08>;	// Write
+	using LCR		= Register<BASE + 0x0C>;
+	using LSR		= Register<BASE + 0x14>;
+	using FDR		= Register<BASE + 0x28>;
+	using OSR		= Register<BASE + 0x2C>;
+
+	constexpr uint32_t IER_RBRINTEN	= 1 << 0;
+	constexpr uint32_t IER_THREINTEN = 1 << 1;
+	constexpr uint32_t FCR_FIFOEN	= 1 << 0;
+	constexpr uint32_t FCR_RXFIFORES = 1 << 1;
+	constexpr uint32_t FCR_TXFIFORES = 1 << 2;
+	constexpr uint32_t LCR_8N1	= 0x03;
+	constexpr uint32_t LCR_DLAB	= 0x80;
+	constexpr uint32_t LSR_RDR	= 1 << 0;	// Receiver data ready
+	constexpr uint32_t LSR_THRE	= 1 << 5;	// Transmit FIFO empty
+	constexpr uint32_t LSR_TEMT	= 1 << 6;	// Transmitter empty
+	constexpr unsigned FIFO_SIZE	= 16;
+}
+
+// GPIO, by port. Chapter 9.
+namespace gpio
+{
+	constexpr uint32_t BASE = 0x50000000;
+	template <unsigned Port> using PIN = Register<BASE + 0x2100 + 4 * Port>;
+	template <unsigned Port> using DIR = Register<BASE + 0x2000 + 4 * Port>;
+	template <unsigned Port> using SET = Register<BASE + 0x2200 + 4 * Port>;
+	template <unsigned Port> using CLR = Register<BASE + 0x2280 + 4 * Port>;
+	template <unsigned Port> using NOT = Register<BASE + 0x2300 + 4 * Port>;
+}
+
+// 32-bit counter/timers. Chapter 16.
+template <uint32_t Base>
+struct Ct32b
+{
+	using IR		= Register<Base + 0x00>;
+	using TCR		= Register<Base + 0x04>;
+	using TC		= Register<Base + 0x08>;
+	using PR		= Register<Base + 0x0C>;
+	using PC		= Register<Base + 0x10>;
+	using MCR		= Register<Base + 0x14>;
+	using MR0		= Register<Base + 0x18>;
+	using MR1		= Register<Base + 0x1C>;
+	using MR2		= Register<Base + 0x20>;
+	using MR3		= Register<Base + 0x24>;
+	using CTCR		= Register<Base + 0x70>;
+
+	static constexpr uint32_t TCR_CEN = 1 << 0;	// Counter enable
+	static constexpr uint32_t TCR_CRST = 1 << 1;	// Counter reset
+};
+using ct32b0 = Ct32b<0x40014000>;
+using ct32b1 = Ct32b<0x40018000>;
+
+// Cortex-M0 core peripherals.
+namespace systick
+{
+	using CSR		= Register<0xE000E010>;
+	using RVR		= Register<0xE000E014>;
+	using CVR		= Register<0xE000E018>;
+
+	constexpr uint32_t CSR_ENABLE	= 1 << 0;
+	constexpr uint32_t CSR_TICKINT	= 1 << 1;
+	constexpr uint32_t CSR_CLKSOURCE = 1 << 2;	// Processor clock
+	constexpr uint32_t CSR_COUNTFLAG = 1 << 16;
+}
+
+namespace nvic
+{
+	using ISER		= Register<0xE000E100>;
+	using ICER		= Register<0xE000E180>;
+
+	constexpr unsigned IRQ_CT32B0	= 18;
+	constexpr unsigned IRQ_CT32B1	= 19;
+	constexpr unsigned IRQ_USART	= 21;
+}
+
+namespace scb
+{
+	using AIRCR		= Register<0xE000ED0C>;
+	constexpr uint32_t AIRCR_VECTKEY = 0x05FA << 16;
+	constexpr uint32_t AIRCR_SYSRESETREQ = 1 << 2;
+}
+
+// The RGB LED of the LPCXpresso board, active low.
+struct Leds
+{
+	static constexpr uint32_t RED	= 1 << 24;
+	static constexpr uint32_t GREEN	= 1 << 25;
+	static constexpr uint32_t BLUE	= 1 << 26;
+	static constexpr uint32_t ALL	= RED | GREEN | BLUE;
+
+	// Outputs, all off.
+	static void init()
+	{
+		gpio::SET<1>::write(ALL);
+		gpio::DIR<1>::set_bits(ALL);
+	}
+	static void on(uint32_t leds)	{ gpio::CLR<1>::write(leds); }
+	static void off(uint32_t leds)	{ gpio::SET<1>::write(leds); }
+	static void flip(uint32_t leds)	{ gpio::NOT<1>::write(leds); }
+};
+
+
+
+// Section 12.5.14 ("USART Fractional Divider Register") and 12.5.16
+// ("USART Oversampling Register"):
+//
+//   Baudrate = PCLK / (oversampling * (256 * DLM + DLL) * (1 + DivAddVal / MulVal))
+//
+// with 1 <= MulVal <= 15, 0 <= DivAddVal < MulVal, and DLL >= 3 if
+// DivAddVal > 0. We only use whole oversampling ratios of 5 to 16.
+struct UartDivisors
+{
+	uint16_t divisor;	// 256 * DLM + DLL, 0: no solution
+	uint8_t divaddval;
+	uint8_t mulval;
+	uint8_t oversampling;
+	uint32_t baud;		// The one we get, rounded
+	uint32_t error_ppm;	// |baud - wanted| / wanted
+
+	constexpr uint32_t fdr() const { return divaddval | (mulval << 4); }
+	constexpr uint32_t osr() const { return (oversampling - 1) << 4; }
+};
+
+// The divisors closest to the wanted baud rate. 16x oversampling
+// samples each bit the most robustly, so it wins if it gets within
+// good_ppm; only if not do the lower ratios get a chance. On a tie: the
+// highest oversampling, then no fractional divider, then the smallest
+// MulVal. So 115200 @ 12 MHz gives exactly example 2 of section
+// 12.5.14.1.2.
+constexpr UartDivisors solve_baud(uint32_t pclk, uint32_t baud, uint32_t good_ppm = 2000)
+{
+	UartDivisors best = {0, 0, 1, 16, 0, UINT32_MAX};
+	double best_error = 2;
+	for (uint32_t oversampling = 16; oversampling >= 5; --oversampling)
+	{
+		if (oversampling < 16 && best.error_ppm <= good_ppm)
+			break;
+		for (uint32_t mulval = 1; mulval <= 15; ++mulval)
+		{
+			for (uint32_t divaddval = 0; divaddval < mulval; ++divaddval)
+			{
+				// DivAddVal 0 means no fractional divider,
+				// whatever MulVal is.
+				if (divaddval == 0 && mulval != 1)
+					continue;
+				double ideal = (double) pclk * mulval
+				             / ((double) oversampling * baud * (mulval + divaddval));
+				uint32_t floor = ideal < 1 ? 1 : (uint32_t) ideal;
+				for (uint32_t divisor = floor; divisor <= floor + 1; ++divisor)
+				{
+					if (divisor > 0xFFFF || (divaddval && divisor < 3))
+						continue;
+					double actual = (double) pclk * mulval
+					              / ((double) oversampling * divisor * (mulval + divaddval));
+					double error = actual > baud ? (actual - baud) / baud : (baud - actual) / baud;
+					// Not strictly better: the same rate,
+					// and we prefer the earlier one.
+					if (error >= best_error - 1e-12)
+						continue;
+					best_error = error;
+					best = {(uint16_t) divisor, (uint8_t) divaddval, (uint8_t) mulval,
+					        (uint8_t) oversampling, (uint32_t) (actual + 0.5),
+					        (uint32_t) (error * 1e6 + 0.5)};
+				}
+			}
+		}
+	}
+	return best;
+}
+
+// The divisors, checked at compile time. 1% is what a UART on the other
+// end usually takes.
+template <uint32_t Pclk, uint32_t Baud, uint32_t MaxErrorPpm = 10000>
+struct UartBaud
+{
+	static constexpr UartDivisors value = solve_baud(Pclk, Baud);
+	static_assert(value.divisor != 0, "baud rate out of reach of this PCLK");
+	static_assert(value.error_ppm <= MaxErrorPpm, "baud rate error too large");
+};
+
+static_assert(UartBaud<12000000, 115200>::value.divisor == 4
+           && UartBaud<12000000, 115200>::value.divaddval == 5
+           && UartBaud<12000000, 115200>::value.mulval == 8
+           && UartBaud<12000000, 115200>::value.oversampling == 16,
+              "not example 2 of section 12.5.14.1.2");
+static_assert(UartBaud<12000000, 1000000, 0>::value.oversampling == 12,
+              "1 Mbps @ 12 MHz is exact with 12x oversampling");
+
+// UART0 on PIO0_18 (RXD) and PIO0_19 (TXD), 8N1, FIFOs on. Pclk: the
+// system clock (UARTCLKDIV = 1), the IRC after reset.
+template <uint32_t Baud, uint32_t Pclk = 12000000, uint32_t MaxErrorPpm = 10000>
+inline void uart0_init()
+{
+	constexpr UartDivisors divisors = UartBaud<Pclk, Baud, MaxErrorPpm>::value;
+
+	syscon::SYSAHBCLKCTRL::set_bits(syscon::CLK_USART | syscon::CLK_IOCON);
+	syscon::UARTCLKDIV::write(1);
+	iocon::PIO0<18>::write(iocon::FUNC_UART);
+	iocon::PIO0<19>::write(iocon::FUNC_UART);
+
+	uart0::LCR::write(uart0::LCR_DLAB);
+	uart0::DLM::write(divisors.divisor >> 8);
+	uart0::DLL::write(divisors.divisor & 0xFF);
+	uart0::FDR::write(divisors.fdr());
+	uart0::LCR::write(uart0::LCR_8N1);
+	// Reset value: 16x. Skip the store if that is what we want.
+	if (divisors.oversampling != 16)
+		uart0::OSR::write(divisors.osr());
+	uart0::FCR::write(uart0::FCR_FIFOEN | uart0::FCR_RXFIFORES | uart0::FCR_TXFIFORES);
+}
+
+inline void uart0_send_byte(uint8_t b)
+{
+	while (!(uart0::LSR::read() & uart0::LSR_THRE))
+	{}
+	uart0::THR::write(b);
+}
+
+inline void uart0_send_string(const char * str)
+{
+	while (*str)
+		uart0_send_byte(*str++);
+}
+
+inline uint8_t uart0_read_byte__blocking()
+{
+	while (!(uart0::LSR::read() & uart0::LSR_RDR))
+	{}
+	return uart0::RBR::read() & 0xFF;
+}
+
+}
+
+#endif
@@ -0,0 +1,95 @@
+#include <stdint.h>
+
+#include "../lpc11u3x.hpp"
+#include "../lpc11u3x-timing.hpp"
+
+using namespace lpc11u3x;
+
+// Firmware to check the timing service (../lpc11u3x-timing.hpp) against
+// the glitcher or a scope. Commands over UART0, one byte each, replies
+// in hex:
+//
+//   'T': "T <cycles>\r\n", the free-running cycle counter.
+//   'M': A marker pulse of MARKER_PULSE_CYCLES on PIO0_2 (to ICP1 of the
+//        glitcher, as src-lpc/boot-marker). "M <rise> <fall>\r\n": the
+//        cycle counter at both edges.
+//   'W': Wait 1 second. "W <start> <end>\r\n".
+//   'E': "E", to check we are alive.
+
+// Override with "make BAUD=...", e.g. 1000000.
+#ifndef BAUD
+#define BAUD 115200
+#endif
+
+// 1 us @ 12 MHz, like the pulses of boot-marker.
+#define MARKER_PULSE_CYCLES	12
+
+using marker = timing::Marker<0, 2>;
+
+static void reply(char command, uint32_t first, uint32_t second)
+{
+	uart0_send_byte(command);
+	uart0_send_byte(' ');
+	timing::uart0_send_hex32(first);
+	uart0_send_byte(' ');
+	timing::uart0_send_hex32(second);
+	uart0_send_string("\r\n");
+}
+
+int main()
+{
+	timing::init();
+	marker::init();
+	Leds::init();
+	Leds::on(Leds::GREEN);
+	uart0_init<BAUD>();
+
+	while (1)
+	{
+		switch (uart0_read_byte__blocking())
+		{
+			case 'T':
+			{
+				uint32_t now = timing::cycles();
+				uart0_send_string("T ");
+				timing::uart0_send_hex32(now);
+				uart0_send_string("\r\n");
+				break;
+			}
+
+			case 'M':
+			{
+				timing::MarkerPulse p = marker::pulse<MARKER_PULSE_CYCLES>();
+				reply('M', p.rise, p.fall);
+				break;
+			}
+
+			case 'W':
+			{
+				uint32_t start = timing::cycles();
+				timing::delay_ms(1000);
+				reply('W', start, timing::cycles());
+				break;
+			}
+
+			case 'E':
+				uart0_send_byte('E');
+				break;
+
+			default:
+				uart0_send_byte('?');
+		}
+		Leds::flip(Leds::GREEN | Leds::BLUE);
+	}
+}
+
+struct vectors {
+	uint32_t stack;
+	void * entry;
+};
+
+const struct vectors vectors __attribute__((section (".isr_vector"))) =
+{
+	0x10000ffc,
+	(void *) &main
+};
@@ -0,0 +1,39 @@
+#include <stdint.h>
+
+#include "../lpc11u3x.hpp"
+#include "../lpc11u3x-timing.hpp"
+
+using namespace lpc11u3x;
+
+// Override with "make BAUD=...", e.g. 1000000.
+#ifndef BAUD
+#define BAUD 115200
+#endif
+
+int main()
+{
+	timing::init();
+	Leds::init();
+	Leds::on(Leds::GREEN);
+
+	// The divisors come from the compiler, see solve_baud() in 
+	// lpc11u3x.hpp.
+	uart0_init<BAUD>();
+	while (1)
+	{
+		timing::delay_ms(1000);
+		uart0_send_string("hello world\r\n");
+		Leds::flip(Leds::GREEN | Leds::BLUE);
+	}
+}
+
+struct vectors {
+	uint32_t stack;
+	void * entry;
+};
+
+const struct vectors vectors __attribute__((section (".isr_vector"))) =
+{
+	0x10000ffc,
+	(void *) &main
+};
@@ -4,12 +4,18 @@
 #define _BV(bit) (1ULL << (bit))
 
 #define MAGIC 0x015ac37f
+#define NUM_MAGICS 7
 #define NT "\n\t"
 #define NX "\n"
 
 #define NVIC_ISER	(*(volatile uint32_t*)0xE000E100)
 #define NVIC_ISER_USART	(21)
 
+// Fault characterization (make CHARACTERIZE=1): instead of hanging 
+// after the first fault, send a fault record (see below) and re-arm. 
+// Without it: pull the fault pin low, print "!" and hang until the next 
+// reset, as command 'L' of the glitcher expects.
+
 #define SCB_AIRCR	(*(volatile uint32_t*)0xE000ED0C)
 #define AIRCR_VECTKEY	(0x05FA << 16)
 #define SYSRESETREQ	(1 << 2)
@@ -31,11 +37,24 @@
 #define UART0_DLL	(*(volatile uint32_t*)(UART0_BASE + 0x00))
 #define UART0_DLM	(*(volatile uint32_t*)(UART0_BASE + 0x04))
 #define UART0_IER	(*(volatile uint32_t*)(UART0_BASE + 0x04))
-#define IER_RBRINTEN	(1)
-#define UART0_IIR	(*(volatile uint32_t*)(UART0_BASE + 0x08))
+#define IER_RBRINTEN	(0)
+#define IER_THREINTEN	(1)
+#define UART0_IIR	(*(volatile uint32_t*)(UART0_BASE + 0x08))	// Read
+#define IIR_INTSTATUS	(0)						// 0: interrupt pending
+#define IIR_INTID_MASK	(7 << 1)
+#define IIR_INTID_THRE	(1 << 1)
+#define IIR_INTID_RDA	(2 << 1)
+#define IIR_INTID_RLS	(3 << 1)
+#define IIR_INTID_CTI	(6 << 1)
+#define UART0_FCR	(*(volatile uint32_t*)(UART0_BASE + 0x08))	// Write
+#define FCR_FIFOEN	(0)
+#define FCR_RXFIFORES	(1)
+#define FCR_TXFIFORES	(2)
+#define UART_FIFO_SIZE	16
 #define UART0_LCR	(*(volatile uint32_t*)(UART0_BASE + 0x0C))
 #define UART0_LSR	(*(volatile uint32_t*)(UART0_BASE + 0x14))	// Line Status Register
 #define LSR_RDR		(0)						// Receiver Data Ready
+#define LSR_THRE	(5)						// Transmit FIFO empty
 #define UART0_FDR	(*(volatile uint32_t*)(UART0_BASE + 0x28))
 
 #define GPIO_BASE	0x50000000
@@ -48,6 +67,12 @@
 #define GPIO_PORT_NOT0	(*(volatile uint32_t *)(GPIO_BASE | 0x2300))
 #define GPIO_PORT_NOT1	(*(volatile uint32_t *)(GPIO_BASE | 0x2304))
 
+// Fault pin, to ICP1 (PD4) of the glitcher. See command 'L' of 
+// src-avr/glitcher.cpp: a short low pulse means we are armed, low means 
+// we faulted.
+#define FAULT_PIN	2
+#define FAULT_MASK	(1 << FAULT_PIN)
+
 #define LED_RED		24
 #define LED_GREEN	25
 #define LED_BLUE	26
@@ -65,6 +90,83 @@ static inline void flip_blue()	{ GPIO_PORT_NOT1 = 1 << LED_BLUE; }
 
 
 
+// Number of delay loop iterations of the armed pulse. From the "str" 
+// that pulls the pin low to the "str" that lets it go: the iterations 
+// take 4 cycles (subs 1, taken bne 3), the last one 2 (bne not taken), 
+// and the second "str" 2. So 4 * FAULT_ARMED_PULSE_LOOPS cycles, 24 @ 
+// 12 MHz = 2 microseconds. Command 'L' takes the pin for faulted if it 
+// is still low LOOP_FAULT_CONFIRM_US (10) microseconds after the edge: 
+// 5 times as long.
+#define FAULT_ARMED_PULSE_LOOPS	6
+
+static inline void fault_pin_armed()
+{
+	// Drive the pin high first (it is high already, from the pull-up), 
+	// so the only falling edge is the one of the asm. No interrupt (the 
+	// UART of CHARACTERIZE) may stretch the pulse.
+	uint32_t loops = FAULT_ARMED_PULSE_LOOPS;
+	GPIO_PORT_SET0 = FAULT_MASK;
+	GPIO_PORT_DIR0 |= FAULT_MASK;
+	asm volatile (
+		NT "cpsid i"
+		NT "str %[mask], [%[clr]]"
+		NX "1:"
+		NT "subs %[loops], #1"
+		NT "bne 1b"
+		NT "str %[mask], [%[set]]"
+		NT "cpsie i"
+	: // Output operands.
+		[loops] "+l" (loops)
+	: // Input operands.
+		[mask] "l" (FAULT_MASK),
+		[set] "l" (&GPIO_PORT_SET0),
+		[clr] "l" (&GPIO_PORT_CLR0)
+	: "cc", "memory"
+	);
+}
+
+static inline void fault_pin_faulted()	{ GPIO_PORT_CLR0 = FAULT_MASK; }
+
+
+
+// Fault records (CHARACTERIZE), all numbers little endian:
+//
+//   0xFA                      FAULT_RECORD_SYNC
+//   <sequence>                uint8_t, 0 for the boot record, then + 1 
+//                             per record (wraps).
+//   <compare>                 uint8_t, which "cmp" of the asm loop in 
+//                             main() took us out: 1 (magic1) to 6 
+//                             (magic6). 0 for the boot record.
+//   <corrupted>               uint8_t, bit i set if magic<i> is no 
+//                             longer MAGIC (bit 0: the reference magic0).
+//   <dropped>                 uint8_t, records that did not fit in the 
+//                             transmit buffer since the previous record 
+//                             (saturates at 255).
+//   <value> ...               uint32_t for every bit set in <corrupted>, 
+//                             lowest bit first.
+//   <checksum>                uint8_t, XOR of all bytes after the sync.
+//
+// So 6 bytes if only the branch was glitched, at most 34. The first 
+// record after a reset is the boot record, so the host can tell a fault 
+// from a reboot. See src-pc/fault_records.py.
+#define FAULT_RECORD_SYNC	0xFA
+#define FAULT_RECORD_MAX_SIZE	(6 + 4 * NUM_MAGICS)
+
+// Transmit buffer of the UART, emptied by uart_irq_handler(). Power of 
+// 2. At 115200 baud it holds about 22 ms worth of records.
+#define TX_BUFFER_SIZE		256
+#define TX_BUFFER_MASK		(TX_BUFFER_SIZE - 1)
+
+// There is no C runtime to initialize .data, and .bss is not cleared: 
+// main() sets these.
+static uint8_t tx_buffer[TX_BUFFER_SIZE];
+static volatile uint32_t tx_head;	// Written by main().
+static volatile uint32_t tx_tail;	// Written by uart_irq_handler().
+static uint8_t fault_sequence;
+static uint8_t faults_dropped;
+
+
+
 void reset_chip()
 {
 
@@ -126,8 +228,12 @@ void uart_init()
 	UART0_LCR = 0x03;			// 8 bits, no parity, 1 stop bit
 	// UART is ready.
 
-	// Enable receive interrrupt.
-	UART0_IER = _BV(IER_RBRINTEN);
+	// Enable (and reset) the FIFOs, so that the transmit interrupt can 
+	// hand over 16 bytes at a time.
+	UART0_FCR = _BV(FCR_FIFOEN) | _BV(FCR_RXFIFORES) | _BV(FCR_TXFIFORES);
+
+	// Enable receive and transmit interrrupts.
+	UART0_IER = _BV(IER_RBRINTEN) | _BV(IER_THREINTEN);
 
 	// Enable USART0 IRQ in NVIC's Interrupt Set-enable Register.
 	NVIC_ISER = _BV(NVIC_ISER_USART);
@@ -151,6 +257,46 @@ void uart_send_string(const char * str)
 	}
 }
 
+// Move bytes from the transmit buffer to the (empty) transmit FIFO. 
+// Called by uart_irq_handler(), or with interrupts disabled.
+static void uart_fill_fifo()
+{
+	if (!(UART0_LSR & _BV(LSR_THRE)))
+		return;
+	uint32_t tail = tx_tail;
+	for (uint32_t n = 0; n < UART_FIFO_SIZE && tail != tx_head; n++)
+	{
+		UART0_THR = tx_buffer[tail];
+		tail = (tail + 1) & TX_BUFFER_MASK;
+	}
+	tx_tail = tail;
+}
+
+// Queue bytes for transmission, without waiting. All or nothing: returns 
+// 0 (and queues nothing) if they do not fit.
+int uart_queue(const uint8_t * bytes, uint32_t size)
+{
+	uint32_t head = tx_head;
+	uint32_t room = (tx_tail - head - 1) & TX_BUFFER_MASK;
+	if (size > room)
+		return 0;
+	for (uint32_t i = 0; i < size; i++)
+		tx_buffer[(head + i) & TX_BUFFER_MASK] = bytes[i];
+	tx_head = (head + size) & TX_BUFFER_MASK;
+
+	// The transmit interrupt only fires when the FIFO becomes empty. If 
+	// it already is, nobody would start sending.
+	asm volatile ("cpsid i" ::: "memory");
+	uart_fill_fifo();
+	asm volatile ("cpsie i" ::: "memory");
+	return 1;
+}
+
+void uart_queue_byte(uint8_t b)
+{
+	uart_queue(&b, 1);
+}
+
 uint8_t uart_read_byte__blocking()
 {
 	// Wait until RDR (Receiver Data Read).
@@ -161,7 +307,7 @@ uint8_t uart_read_byte__blocking()
 	return UART0_RBR & 0xFF;
 }
 
-void uart_irq_handler()
+static void uart_receive()
 {
 	if (!(UART0_LSR & _BV(LSR_RDR)))
 	{
@@ -183,11 +329,80 @@ void uart_irq_handler()
 
 		// 'E': echo (to check if we are still alive).
 		case 'E':
-			uart_send_byte('E');
+			uart_queue_byte('E');
 			break;
 
 		default:
-			uart_send_byte('?');
+			uart_queue_byte('?');
+	}
+}
+
+void uart_irq_handler()
+{
+	uint32_t iir;
+	while (!((iir = UART0_IIR) & _BV(IIR_INTSTATUS)))
+	{
+		switch (iir & IIR_INTID_MASK)
+		{
+			case IIR_INTID_THRE:
+				uart_fill_fifo();
+				break;
+
+			case IIR_INTID_RDA:
+			case IIR_INTID_CTI:
+				uart_receive();
+				break;
+
+			default:
+				// Line status (overrun, framing error, ...). 
+				// Reading the LSR clears it.
+				(void) UART0_LSR;
+		}
+	}
+}
+
+
+
+// Queue a fault record (see FAULT_RECORD_SYNC). magics[0] is the 
+// reference the other magics were compared to.
+void send_fault_record(uint8_t compare, const uint32_t * magics)
+{
+	uint8_t record[FAULT_RECORD_MAX_SIZE];
+	uint32_t size = 0;
+	uint8_t corrupted = 0;
+	for (uint32_t i = 0; i < NUM_MAGICS; i++)
+		if (magics[i] != MAGIC)
+			corrupted |= 1 << i;
+
+	record[size++] = FAULT_RECORD_SYNC;
+	record[size++] = fault_sequence;
+	record[size++] = compare;
+	record[size++] = corrupted;
+	record[size++] = faults_dropped;
+	for (uint32_t i = 0; i < NUM_MAGICS; i++)
+	{
+		if (!(corrupted & (1 << i)))
+			continue;
+		record[size++] = magics[i];
+		record[size++] = magics[i] >> 8;
+		record[size++] = magics[i] >> 16;
+		record[size++] = magics[i] >> 24;
+	}
+	uint8_t checksum = 0;
+	for (uint32_t i = 1; i < size; i++)
+		checksum ^= record[i];
+	record[size++] = checksum;
+
+	// Faults come in faster than 115200 baud can report them? Count 
+	// the ones we lose, and tell in the next record.
+	if (uart_queue(record, size))
+	{
+		fault_sequence++;
+		faults_dropped = 0;
+	}
+	else if (faults_dropped != 0xFF)
+	{
+		faults_dropped++;
 	}
 }
 
@@ -208,6 +423,17 @@ int main()
 	// glitching may commence.
 	uart_send_string("B");
 #endif
+#ifdef CHARACTERIZE
+	tx_head = 0;
+	tx_tail = 0;
+	fault_sequence = 0;
+	faults_dropped = 0;
+	uart_init();
+	send_fault_record(0, (const uint32_t[NUM_MAGICS]) {
+		MAGIC, MAGIC, MAGIC, MAGIC, MAGIC, MAGIC, MAGIC
+	});
+#endif
+	fault_pin_armed();
 	while (1)
 	{
 		volatile uint32_t magic0 = MAGIC;
@@ -217,20 +443,39 @@ int main()
 		volatile uint32_t magic4 = MAGIC;
 		volatile uint32_t magic5 = MAGIC;
 		volatile uint32_t magic6 = MAGIC;
+		uint32_t compare;
+		// The loop itself is the same for every compare, only the 
+		// exits differ: they tell which compare failed.
 		asm volatile (
 			NX ".loop:"
 			NT "cmp %0, %1"
-			NT "bne .glitch"
+			NT "bne .compare1"
 			NT "cmp %0, %2"
-			NT "bne .glitch"
+			NT "bne .compare2"
 			NT "cmp %0, %3"
-			NT "bne .glitch"
+			NT "bne .compare3"
 			NT "cmp %0, %4"
-			NT "bne .glitch"
+			NT "bne .compare4"
 			NT "cmp %0, %5"
-			NT "bne .glitch"
+			NT "bne .compare5"
 			NT "cmp %0, %6"
 			NT "beq .loop"
+			NT "movs %7, #6"
+			NT "b .glitch"
+			NX ".compare1:"
+			NT "movs %7, #1"
+			NT "b .glitch"
+			NX ".compare2:"
+			NT "movs %7, #2"
+			NT "b .glitch"
+			NX ".compare3:"
+			NT "movs %7, #3"
+			NT "b .glitch"
+			NX ".compare4:"
+			NT "movs %7, #4"
+			NT "b .glitch"
+			NX ".compare5:"
+			NT "movs %7, #5"
 			NX ".glitch:"
 		: // Output operands.
 			"=r" (magic0),
@@ -239,7 +484,8 @@ int main()
 			"=r" (magic3),
 			"=r" (magic4),
 			"=r" (magic5),
-			"=r" (magic6)
+			"=r" (magic6),
+			"=l" (compare)
 		: // Input operands.
 			"0" (magic0),
 			"1" (magic1),
@@ -248,11 +494,23 @@ int main()
 			"4" (magic4),
 			"5" (magic5),
 			"6" (magic6)
-		: "memory"
+		: "cc", "memory"
 		);
 
 		// If we broke free of the asm loop, a glitch happened. 
 		// Report.
+#ifdef CHARACTERIZE
+		// Only the short pulse of fault_pin_armed(): command 'L' of 
+		// the glitcher takes it for a reboot (RESETS) and keeps on 
+		// pulsing. The records tell faults and reboots apart.
+		send_fault_record(compare, (const uint32_t[NUM_MAGICS]) {
+			magic0, magic1, magic2, magic3, magic4, magic5, magic6
+		});
+		fault_pin_armed();
+		continue;
+#endif
+		(void) compare;
+		fault_pin_faulted();
 		uart_send_string("!");
 		while (1) {}
 	}
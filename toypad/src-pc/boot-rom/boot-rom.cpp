@@ -0,0 +1,262 @@
+#include <errno.h>
+#include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "boot-rom.hpp"
+
+#define BINARY_MAGIC	"BROM"
+#define BINARY_VERSION	1
+
+BootRom::BootRom()
+  : image(BOOT_ROM_SIZE), flags(BOOT_ROM_SIZE / 2)
+{
+}
+
+uint16_t BootRom::read16(uint32_t address) const
+{
+  uint32_t offset = address - base;
+  return image[offset] | image[offset + 1] << 8;
+}
+
+uint32_t BootRom::read32(uint32_t address) const
+{
+  return read16(address) | (uint32_t) read16(address + 2) << 16;
+}
+
+const BootRom::Line * BootRom::line(uint32_t address) const
+{
+  if (!contains(address, 2))
+    return nullptr;
+  int32_t index = line_index[(address - base) / 2];
+  if (index < 0 || lines[index].address != address)
+    return nullptr;
+  return &lines[index];
+}
+
+void BootRom::index_lines()
+{
+  line_index.assign(image.size() / 2, -1);
+  for (size_t i = 0; i < lines.size(); ++i)
+    line_index[(lines[i].address - base) / 2] = i;
+}
+
+static bool is_hex(const char * text, size_t length)
+{
+  for (size_t i = 0; i < length; ++i)
+    if (!text[i] || !strchr("0123456789abcdef", text[i]))
+      return false;
+  return true;
+}
+
+// The fields after the raw halfwords, separated by tabs: mnemonic, 
+// operands, gdb's own "@ ..." comment, then our note in one or more 
+// fields.
+static void split_text(const std::string & text, BootRom::Line & line)
+{
+  std::vector<std::string> fields;
+  size_t start = 0;
+  while (start <= text.size())
+  {
+    size_t end = text.find('\t', start);
+    if (end == std::string::npos)
+      end = text.size();
+    fields.push_back(text.substr(start, end - start));
+    start = end + 1;
+  }
+  size_t i = 0;
+  for (; i < fields.size() && i < 3; ++i)
+  {
+    if (fields[i].empty())
+      continue;
+    // The third field is only gdb's if it is a "@" comment.
+    if (i == 2 && fields[i][0] != '@')
+      break;
+    if (!line.disassembly.empty())
+      line.disassembly += ' ';
+    line.disassembly += fields[i];
+  }
+  for (; i < fields.size(); ++i)
+  {
+    if (fields[i].empty() || fields[i] == "|")
+      continue;
+    if (!line.note.empty())
+      line.note += "  ";
+    line.note += fields[i];
+  }
+}
+
+void BootRom::load_listing(const std::string & path)
+{
+  FILE * file = fopen(path.c_str(), "r");
+  if (!file)
+    throw std::runtime_error(path + ": " + strerror(errno));
+  base = BOOT_ROM_BASE;
+  image.assign(BOOT_ROM_SIZE, 0);
+  flags.assign(BOOT_ROM_SIZE / 2, 0);
+  lines.clear();
+  
+  char buffer[1024];
+  while (fgets(buffer, sizeof buffer, file))
+  {
+    // "   0x1fff00a8:\t4a1a    \tldr\tr2, ...", or "=> 0x..." for the 
+    // instruction gdb stopped at.
+    const char * p = buffer;
+    while (*p == ' ' || *p == '=' || *p == '>')
+      ++p;
+    if (strncmp(p, "0x", 2) || !is_hex(p + 2, 8) || p[10] != ':' || p[11] != '\t')
+      continue;
+    uint32_t address = strtoul(p + 2, nullptr, 16);
+    p += 12;
+    
+    // One or two halfwords, in the order of the addresses.
+    Line line;
+    line.address = address;
+    uint32_t size = 0;
+    while (is_hex(p, 4) && (p[4] == ' ' || p[4] == '\t'))
+    {
+      uint32_t halfword = strtoul(std::string(p, 4).c_str(), nullptr, 16);
+      uint32_t at = address + size;
+      if (!contains(at, 2) || at % 2)
+      {
+        fclose(file);
+        throw std::runtime_error(path + ": address out of the boot ROM: " + std::string(buffer));
+      }
+      image[at - base] = halfword;
+      image[at - base + 1] = halfword >> 8;
+      flags[(at - base) / 2] |= FLAG_LISTED | (size ? 0 : FLAG_START);
+      size += 2;
+      p += 5;
+    }
+    if (!size)
+      continue;
+    while (*p == ' ' || *p == '\t')
+      ++p;
+    std::string text(p);
+    while (!text.empty() && (text.back() == '\n' || text.back() == '\r'))
+      text.pop_back();
+    split_text(text, line);
+    lines.push_back(line);
+  }
+  fclose(file);
+  if (lines.empty())
+    throw std::runtime_error(path + ": no disassembly");
+  index_lines();
+}
+
+static void put_uint32(std::string & out, uint32_t value)
+{
+  for (int i = 0; i < 4; ++i)
+    out += (char) (value >> (8 * i));
+}
+
+static void put_string(std::string & out, const std::string & text)
+{
+  out += (char) text.size();
+  out += (char) (text.size() >> 8);
+  out += text;
+}
+
+void BootRom::save(const std::string & path) const
+{
+  std::string out = BINARY_MAGIC;
+  put_uint32(out, BINARY_VERSION);
+  put_uint32(out, base);
+  put_uint32(out, image.size());
+  out.append((const char *) image.data(), image.size());
+  out.append((const char *) flags.data(), flags.size());
+  put_uint32(out, lines.size());
+  for (const Line & line : lines)
+  {
+    put_uint32(out, (line.address - base) / 2);
+    put_string(out, line.disassembly);
+    put_string(out, line.note);
+  }
+  
+  FILE * file = fopen(path.c_str(), "wb");
+  if (!file)
+    throw std::runtime_error(path + ": " + strerror(errno));
+  bool ok = fwrite(out.data(), 1, out.size(), file) == out.size();
+  ok = fclose(file) == 0 && ok;
+  if (!ok)
+    throw std::runtime_error(path + ": cannot write");
+}
+
+// Reads of the binary form, with bounds checks.
+class Reader
+{
+  public:
+    Reader(const std::string & data, const std::string & path) : data(data), path(path) {}
+    
+    const char * take(size_t size)
+    {
+      if (size > data.size() - offset)
+        throw std::runtime_error(path + ": truncated");
+      const char * p = data.data() + offset;
+      offset += size;
+      return p;
+    }
+    uint32_t uint32()
+    {
+      const uint8_t * p = (const uint8_t *) take(4);
+      return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t) p[3] << 24;
+    }
+    std::string string()
+    {
+      const uint8_t * p = (const uint8_t *) take(2);
+      size_t size = p[0] | p[1] << 8;
+      return std::string(take(size), size);
+    }
+  
+  private:
+    const std::string & data;
+    const std::string & path;
+    size_t offset = 0;
+};
+
+void BootRom::load(const std::string & path)
+{
+  FILE * file = fopen(path.c_str(), "rb");
+  if (!file)
+    throw std::runtime_error(path + ": " + strerror(errno));
+  std::string data;
+  char buffer[65536];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof buffer, file)) > 0)
+    data.append(buffer, n);
+  fclose(file);
+  
+  if (data.compare(0, 4, BINARY_MAGIC) != 0)
+  {
+    load_listing(path);
+    return;
+  }
+  
+  Reader in(data, path);
+  in.take(4);
+  if (in.uint32() != BINARY_VERSION)
+    throw std::runtime_error(path + ": unknown version");
+  base = in.uint32();
+  uint32_t size = in.uint32();
+  if (size % 2 || size > (1 << 24))
+    throw std::runtime_error(path + ": bad size");
+  const char * p = in.take(size);
+  image.assign(p, p + size);
+  p = in.take(size / 2);
+  flags.assign(p, p + size / 2);
+  uint32_t count = in.uint32();
+  lines.clear();
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    Line line;
+    uint32_t halfword = in.uint32();
+    if (halfword >= size / 2)
+      throw std::runtime_error(path + ": bad line index");
+    line.address = base + 2 * halfword;
+    line.disassembly = in.string();
+    line.note = in.string();
+    lines.push_back(line);
+  }
+  index_lines();
+}
@@ -0,0 +1,87 @@
+#ifndef _BOOT_ROM_HPP_
+#define _BOOT_ROM_HPP_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#define BOOT_ROM_BASE		0x1fff0000
+#define BOOT_ROM_SIZE		(16 * 1024)
+
+// The boot ROM of the LPC11U35, as toypad/bootloader.lst has it: the 
+// disassembly of gdb ("x/i", "disassemble /r") from 0x1fff0000 to 
+// 0x1fff4000, with our notes after it and fold markers in between.
+// 
+// Parsing the listing gives the image (every halfword gdb printed, in 
+// little endian), and for every halfword the line of the listing it came 
+// from: the disassembly ("ldr r2, [pc, #104]") and our note ("r2 = 
+// 400483f0 ..."), if any.
+// 
+// save() writes the same as an indexed binary file, so the tools that 
+// run the boot ROM many times do not parse the listing every time:
+// 
+//   "BROM" <version: uint32_t> <base: uint32_t> <size: uint32_t> 
+//   <size bytes of image> 
+//   <size / 2 flags: uint8_t>          FLAG_* 
+//   <number of lines: uint32_t> 
+//   per line: <halfword: uint32_t> <length: uint16_t> <disassembly> 
+//             <length: uint16_t> <note>
+// 
+// All numbers little endian. load() takes either form.
+// 
+// Throws std::runtime_error.
+class BootRom
+{
+  public:
+    enum
+    {
+      FLAG_LISTED	= 0x01,	// gdb printed this halfword.
+      FLAG_START	= 0x02,	// The first halfword of a line.
+    };
+    
+    struct Line
+    {
+      uint32_t address;
+      std::string disassembly;
+      std::string note;
+    };
+    
+    BootRom();
+    
+    void load(const std::string & path);
+    void load_listing(const std::string & path);
+    void save(const std::string & path) const;
+    
+    bool contains(uint32_t address, uint32_t size = 1) const
+    {
+      return address >= base && address - base + size <= image.size();
+    }
+    bool listed(uint32_t address) const
+    {
+      return contains(address, 2) && (flags[(address - base) / 2] & FLAG_LISTED);
+    }
+    
+    // Little endian reads; contains() must be true.
+    uint16_t read16(uint32_t address) const;
+    uint32_t read32(uint32_t address) const;
+    
+    // The line of the listing that starts at address, or nullptr.
+    const Line * line(uint32_t address) const;
+    
+    // The reset vector (with the Thumb bit) and the initial stack 
+    // pointer.
+    uint32_t reset_vector() const { return read32(base + 4); }
+    uint32_t initial_sp() const { return read32(base); }
+    
+    uint32_t base = BOOT_ROM_BASE;
+    std::vector<uint8_t> image;
+    std::vector<uint8_t> flags;
+    std::vector<Line> lines;
+  
+  private:
+    // Index in lines of the line of every halfword, or -1.
+    std::vector<int32_t> line_index;
+    void index_lines();
+};
+
+#endif /* _BOOT_ROM_HPP_ */
@@ -0,0 +1,603 @@
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "cfg.hpp"
+
+using namespace thumb;
+
+#define PC	15
+#define LR	14
+#define SP	13
+
+static uint32_t add_cycles(uint32_t a, uint32_t b)
+{
+  if (a == CYCLES_UNBOUNDED || b == CYCLES_UNBOUNDED)
+    return CYCLES_UNBOUNDED;
+  return a + b;
+}
+
+CycleRange CycleRange::operator+(const CycleRange & other) const
+{
+  return CycleRange{add_cycles(min, other.min), add_cycles(max, other.max)};
+}
+
+static std::string hex(uint32_t value)
+{
+  char text[16];
+  snprintf(text, sizeof text, "0x%08x", value);
+  return text;
+}
+
+bool ControlFlowGraph::Registers::merge(const Registers & other)
+{
+  uint16_t both = known & other.known;
+  for (unsigned r = 0; r < 16; ++r)
+    if ((both & (1 << r)) && value[r] != other.value[r])
+      both &= ~(1 << r);
+  bool changed = both != known;
+  known = both;
+  return changed;
+}
+
+ControlFlowGraph::ControlFlowGraph(const BootRom & rom, uint32_t entry, const TimingModel & model)
+  : entry(entry & ~1u), rom(rom), model(model)
+{
+  explore(this->entry);
+  form_blocks();
+  compute_costs();
+}
+
+// The registers after the instruction: the values we can know, the rest 
+// unknown.
+void ControlFlowGraph::step(const Instruction & i, Registers & regs) const
+{
+  auto known = [&regs](unsigned r) { return (regs.known >> r) & 1; };
+  auto set = [&regs](unsigned r, uint32_t value)
+  {
+    regs.value[r] = value;
+    regs.known |= 1 << r;
+  };
+  auto forget = [&regs](unsigned r) { regs.known &= ~(1 << r); };
+  auto load = [this, &set, &forget](unsigned r, uint32_t address)
+  {
+    if (rom.contains(address, 4) && address % 4 == 0)
+      set(r, rom.read32(address));
+    else
+      forget(r);
+  };
+  
+  switch (i.op)
+  {
+    case MOVS_IMM:
+      set(i.rd, i.imm);
+      break;
+    case LDR_LIT:
+      load(i.rd, i.target);
+      break;
+    case LDR_IMM:
+      if (known(i.rn))
+        load(i.rd, regs.value[i.rn] + i.imm);
+      else
+        forget(i.rd);
+      break;
+    case ADR:
+      set(i.rd, i.target);
+      break;
+    case MOV_HI:
+      if (known(i.rm) && i.rm != PC)
+        set(i.rd, regs.value[i.rm]);
+      else
+        forget(i.rd);
+      break;
+    case ADDS_IMM3: case ADDS_IMM8: case SUBS_IMM3: case SUBS_IMM8:
+      if (known(i.rn))
+        set(i.rd, i.op == ADDS_IMM3 || i.op == ADDS_IMM8 ? regs.value[i.rn] + i.imm
+                                                          : regs.value[i.rn] - i.imm);
+      else
+        forget(i.rd);
+      break;
+    case LSLS_IMM:
+      if (known(i.rm))
+        set(i.rd, regs.value[i.rm] << i.imm);
+      else
+        forget(i.rd);
+      break;
+    case CMP_IMM: case CMP_REG: case CMN: case TST: case CMP_HI:
+    case STR_REG: case STRH_REG: case STRB_REG: case STR_IMM: case STRB_IMM: case STRH_IMM:
+    case STR_SP: case B_COND: case B: case BX:
+    case CPSIE: case CPSID: case NOP: case YIELD: case WFE: case WFI: case SEV:
+    case MSR: case DSB: case DMB: case ISB: case BKPT: case SVC: case UDF: case UNDEFINED:
+      break;
+    case PUSH: case ADD_SP: case SUB_SP:
+      forget(SP);
+      break;
+    case STM:
+      forget(i.rn);
+      break;
+    case LDM: case POP:
+      for (unsigned r = 0; r < 16; ++r)
+        if (i.registers & (1 << r))
+          forget(r);
+      forget(i.op == POP ? SP : i.rn);
+      break;
+    case BL: case BLX:
+      // The function we call may change r0 to r3, r12 and lr.
+      for (unsigned r : {0, 1, 2, 3, 12, LR})
+        forget(r);
+      break;
+    default:
+      forget(i.rd);
+  }
+}
+
+void ControlFlowGraph::explore(uint32_t start)
+{
+  function_entries.insert(start);
+  leaders.insert(start);
+  std::vector<uint32_t> work = {start};
+  states[start] = Registers();
+  
+  // Visit address with regs; again if what we know there shrinks.
+  auto go = [this, &work](uint32_t address, const Registers & regs)
+  {
+    auto state = states.find(address);
+    if (state == states.end())
+    {
+      states[address] = regs;
+      work.push_back(address);
+    }
+    else if (state->second.merge(regs))
+      work.push_back(address);
+  };
+  
+  while (!work.empty())
+  {
+    uint32_t address = work.back();
+    work.pop_back();
+    if (!rom.listed(address))
+      continue;
+    uint16_t first = rom.read16(address);
+    uint16_t second = rom.contains(address + 2, 2) ? rom.read16(address + 2) : 0;
+    Instruction i = decode(address, first, second);
+    instructions[address] = i;
+    
+    Registers regs = states[address];
+    Registers before = regs;
+    step(i, regs);
+    uint32_t next = address + i.size;
+    
+    if (!ends_block(i))
+    {
+      go(next, regs);
+      continue;
+    }
+    leaders.insert(next);
+    switch (i.op)
+    {
+      case B_COND:
+        leaders.insert(i.target);
+        go(i.target, regs);
+        go(next, regs);
+        break;
+      case B:
+        leaders.insert(i.target);
+        go(i.target, regs);
+        break;
+      case BL:
+      case BLX:
+      {
+        uint32_t target = i.target;
+        if (i.op == BLX)
+        {
+          if (!((before.known >> i.rm) & 1))
+            break;
+          target = before.value[i.rm] & ~1u;
+        }
+        // Every call merges into the registers of the function.
+        if (rom.contains(target))
+        {
+          function_entries.insert(target);
+          leaders.insert(target);
+          Registers callee = regs;
+          callee.value[LR] = next | 1;
+          callee.known |= 1 << LR;
+          go(target, callee);
+        }
+        go(next, regs);
+        break;
+      }
+      case BX: case MOV_HI: case ADD_HI:
+        if (i.op == BX && i.rm == LR)
+          break;
+        if (i.op == BX && ((before.known >> i.rm) & 1))
+        {
+          uint32_t target = before.value[i.rm] & ~1u;
+          leaders.insert(target);
+          go(target, regs);
+        }
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+void ControlFlowGraph::form_blocks()
+{
+  for (uint32_t leader : leaders)
+  {
+    if (!instructions.count(leader))
+      continue;
+    Block block;
+    block.start = leader;
+    uint32_t address = leader;
+    while (true)
+    {
+      const Instruction & i = instructions.at(address);
+      block.instructions.push_back(i);
+      address += i.size;
+      if (ends_block(i) || leaders.count(address) || !instructions.count(address))
+        break;
+    }
+    block.end = address;
+    
+    const Instruction & last = block.instructions.back();
+    const Registers & before = states.at(last.address);
+    if (!ends_block(last))
+    {
+      if (instructions.count(block.end))
+        block.successors.push_back({block.end, FALL_THROUGH});
+    }
+    else switch (last.op)
+    {
+      case B_COND:
+        block.successors.push_back({last.target, BRANCH});
+        block.successors.push_back({block.end, FALL_THROUGH});
+        break;
+      case B:
+        block.successors.push_back({last.target, BRANCH});
+        break;
+      case BL: case BLX:
+        block.callee = last.op == BL ? last.target
+                     : ((before.known >> last.rm) & 1) ? before.value[last.rm] & ~1u : 0;
+        block.unresolved = !block.callee || !rom.contains(block.callee);
+        block.successors.push_back({block.end, CALL_RETURN});
+        break;
+      case BX:
+        if (last.rm == LR)
+          block.returns = true;
+        else if ((before.known >> last.rm) & 1)
+          block.successors.push_back({before.value[last.rm] & ~1u, JUMP});
+        else
+          block.unresolved = true;
+        break;
+      case POP:
+        block.returns = true;
+        break;
+      case MOV_HI: case ADD_HI:
+        block.unresolved = true;
+        break;
+      default:
+        break;
+    }
+    block_map[leader] = block;
+  }
+}
+
+CycleRange ControlFlowGraph::access_cost(const Instruction & i, const Registers & before) const
+{
+  unsigned accesses = data_accesses(i);
+  if (!accesses)
+    return CycleRange();
+  uint32_t address;
+  bool known = true;
+  switch (i.op)
+  {
+    case LDR_LIT:
+      address = i.target;
+      break;
+    case LDR_IMM: case STR_IMM: case LDRB_IMM: case STRB_IMM: case LDRH_IMM: case STRH_IMM:
+      known = (before.known >> i.rn) & 1;
+      address = before.value[i.rn] + i.imm;
+      break;
+    case LDM: case STM:
+      known = (before.known >> i.rn) & 1;
+      address = before.value[i.rn];
+      break;
+    case PUSH: case POP: case LDR_SP: case STR_SP:
+      // The stack is in the RAM.
+      return CycleRange();
+    default:
+      known = false;
+  }
+  uint32_t waits = accesses * model.flash_wait_states;
+  if (!known)
+    return CycleRange{0, waits};
+  return address < model.flash_end ? CycleRange{waits, waits} : CycleRange();
+}
+
+void ControlFlowGraph::compute_costs()
+{
+  for (auto & entry : block_map)
+  {
+    Block & block = entry.second;
+    for (const Instruction & i : block.instructions)
+    {
+      CycleRange cost{cycles(i, false), cycles(i, true)};
+      if (i.op != B_COND)
+        cost.min = cost.max;
+      block.costs.push_back(cost + access_cost(i, states.at(i.address)));
+    }
+  }
+}
+
+const ControlFlowGraph::Block * ControlFlowGraph::block_at(uint32_t address) const
+{
+  auto it = block_map.upper_bound(address);
+  if (it == block_map.begin())
+    return nullptr;
+  --it;
+  if (address >= it->second.end)
+    return nullptr;
+  return &it->second;
+}
+
+const Instruction * ControlFlowGraph::instruction_at(uint32_t address) const
+{
+  const Block * block = block_at(address);
+  if (!block)
+    return nullptr;
+  for (const Instruction & i : block->instructions)
+    if (i.address == address)
+      return &i;
+  return nullptr;
+}
+
+CycleRange ControlFlowGraph::cost_at(uint32_t address) const
+{
+  const Block * block = block_at(address);
+  if (block)
+    for (size_t n = 0; n < block->instructions.size(); ++n)
+      if (block->instructions[n].address == address)
+        return block->costs[n];
+  throw std::runtime_error(hex(address) + ": not an instruction of the graph");
+}
+
+ControlFlowGraph::FunctionTiming & ControlFlowGraph::timing(uint32_t function)
+{
+  FunctionTiming & t = timings[function];
+  if (t.done)
+    return t;
+  t.busy = true;
+  
+  // The blocks of the function: everything from the entry, calls not 
+  // followed.
+  std::vector<uint32_t> nodes;
+  std::map<uint32_t, unsigned> index;
+  std::vector<uint32_t> work = {function};
+  while (!work.empty())
+  {
+    uint32_t start = work.back();
+    work.pop_back();
+    if (index.count(start) || !block_map.count(start))
+      continue;
+    index[start] = nodes.size();
+    nodes.push_back(start);
+    for (const Edge & edge : block_map.at(start).successors)
+      work.push_back(edge.target);
+  }
+  
+  // The cycles from the start of a block to the start of a successor.
+  struct Arc
+  {
+    unsigned to;
+    CycleRange cycles;
+  };
+  std::vector<std::vector<Arc>> arcs(nodes.size());
+  std::vector<CycleRange> to_return(nodes.size(), CycleRange{CYCLES_UNBOUNDED, CYCLES_UNBOUNDED});
+  for (unsigned n = 0; n < nodes.size(); ++n)
+  {
+    const Block & block = block_map.at(nodes[n]);
+    CycleRange body;
+    for (size_t k = 0; k + 1 < block.costs.size(); ++k)
+      body = body + block.costs[k];
+    const Instruction & last = block.instructions.back();
+    if (block.returns)
+      to_return[n] = body + block.costs.back();
+    for (const Edge & edge : block.successors)
+    {
+      if (!index.count(edge.target))
+        continue;
+      CycleRange cost = block.costs.back();
+      if (last.op == B_COND)
+        cost.min = cost.max = edge.kind == BRANCH ? cost.max : cost.min;
+      if (edge.kind == CALL_RETURN)
+      {
+        CycleRange callee{CYCLES_UNBOUNDED, CYCLES_UNBOUNDED};
+        if (block.callee && block_map.count(block.callee))
+        {
+          if (timings[block.callee].busy)
+            callee = CycleRange{0, CYCLES_UNBOUNDED};	// Recursion.
+          else
+            callee = timing(block.callee).duration;
+        }
+        else
+          callee = CycleRange{0, CYCLES_UNBOUNDED};	// Outside the boot ROM.
+        // A function that never returns: no way past the call.
+        if (callee.min == CYCLES_UNBOUNDED)
+          continue;
+        cost = cost + callee;
+      }
+      arcs[n].push_back({index.at(edge.target), body + cost});
+    }
+  }
+  
+  // Earliest: shortest paths.
+  std::vector<uint32_t> earliest(nodes.size(), CYCLES_UNBOUNDED);
+  typedef std::pair<uint32_t, unsigned> Item;
+  std::priority_queue<Item, std::vector<Item>, std::greater<Item>> queue;
+  earliest[0] = 0;
+  queue.push({0, 0});
+  while (!queue.empty())
+  {
+    Item item = queue.top();
+    queue.pop();
+    if (item.first != earliest[item.second])
+      continue;
+    for (const Arc & arc : arcs[item.second])
+    {
+      uint32_t at = add_cycles(item.first, arc.cycles.min);
+      if (at < earliest[arc.to])
+      {
+        earliest[arc.to] = at;
+        queue.push({at, arc.to});
+      }
+    }
+  }
+  
+  // Latest: longest paths over the strongly connected components 
+  // (Tarjan, which finds them in reverse topological order). A block 
+  // in or after a loop can start arbitrarily late.
+  std::vector<int> order(nodes.size(), -1), low(nodes.size()), component(nodes.size(), -1);
+  std::vector<unsigned> stack;
+  std::vector<std::vector<unsigned>> components;
+  int counter = 0;
+  std::function<void(unsigned)> connect = [&](unsigned n)
+  {
+    order[n] = low[n] = counter++;
+    stack.push_back(n);
+    for (const Arc & arc : arcs[n])
+    {
+      if (order[arc.to] < 0)
+      {
+        connect(arc.to);
+        low[n] = std::min(low[n], low[arc.to]);
+      }
+      else if (component[arc.to] < 0)
+        low[n] = std::min(low[n], order[arc.to]);
+    }
+    if (low[n] == order[n])
+    {
+      components.emplace_back();
+      unsigned m;
+      do
+      {
+        m = stack.back();
+        stack.pop_back();
+        component[m] = components.size() - 1;
+        components.back().push_back(m);
+      } while (m != n);
+    }
+  };
+  for (unsigned n = 0; n < nodes.size(); ++n)
+    if (order[n] < 0)
+      connect(n);
+  
+  std::vector<uint32_t> latest(nodes.size(), 0);
+  std::vector<bool> reached(nodes.size(), false);
+  reached[0] = true;
+  for (size_t c = components.size(); c-- > 0; )
+  {
+    const std::vector<unsigned> & members = components[c];
+    bool loop = members.size() > 1;
+    for (const Arc & arc : arcs[members[0]])
+      loop = loop || arc.to == members[0];
+    if (loop)
+      for (unsigned n : members)
+        if (reached[n])
+          latest[n] = CYCLES_UNBOUNDED;
+    for (unsigned n : members)
+    {
+      if (!reached[n])
+        continue;
+      for (const Arc & arc : arcs[n])
+      {
+        reached[arc.to] = true;
+        latest[arc.to] = std::max(latest[arc.to], add_cycles(latest[n], arc.cycles.max));
+      }
+    }
+  }
+  
+  t.block_start.clear();
+  t.duration = CycleRange{CYCLES_UNBOUNDED, 0};
+  bool returns = false;
+  for (unsigned n = 0; n < nodes.size(); ++n)
+  {
+    if (earliest[n] == CYCLES_UNBOUNDED)
+      continue;
+    t.block_start[nodes[n]] = CycleRange{earliest[n], latest[n]};
+    if (to_return[n].min != CYCLES_UNBOUNDED)
+    {
+      returns = true;
+      t.duration.min = std::min(t.duration.min, add_cycles(earliest[n], to_return[n].min));
+      t.duration.max = std::max(t.duration.max, add_cycles(latest[n], to_return[n].max));
+    }
+  }
+  if (!returns)
+    t.duration = CycleRange{CYCLES_UNBOUNDED, CYCLES_UNBOUNDED};
+  t.busy = false;
+  t.done = true;
+  return t;
+}
+
+CycleRange ControlFlowGraph::start_of(uint32_t address)
+{
+  const Block * block = block_at(address);
+  FunctionTiming & t = timing(entry);
+  if (!block || !t.block_start.count(block->start))
+    throw std::runtime_error(hex(address) + ": not reached from " + hex(entry));
+  CycleRange start = t.block_start.at(block->start);
+  for (size_t n = 0; n < block->instructions.size(); ++n)
+  {
+    if (block->instructions[n].address == address)
+      return start;
+    start = start + block->costs[n];
+  }
+  throw std::runtime_error(hex(address) + ": not the start of an instruction");
+}
+
+CycleRange ControlFlowGraph::duration(uint32_t function)
+{
+  return timing(function & ~1u).duration;
+}
+
+static std::string cycles_text(const CycleRange & range)
+{
+  std::string max = range.bounded() ? std::to_string(range.max) : "inf";
+  if (range.min == range.max)
+    return max;
+  return std::to_string(range.min) + ".." + max;
+}
+
+void ControlFlowGraph::write_dot(const std::string & path) const
+{
+  FILE * file = fopen(path.c_str(), "w");
+  if (!file)
+    throw std::runtime_error(path + ": cannot write");
+  fprintf(file, "digraph boot_rom {\n  node [shape=box, fontname=monospace];\n");
+  for (const auto & entry : block_map)
+  {
+    const Block & block = entry.second;
+    std::string label;
+    for (size_t n = 0; n < block.instructions.size(); ++n)
+      label += hex(block.instructions[n].address) + "  " + cycles_text(block.costs[n])
+             + "  " + disassemble(block.instructions[n]) + "\\l";
+    if (block.returns)
+      label += "return\\l";
+    if (block.unresolved)
+      label += "unresolved branch\\l";
+    fprintf(file, "  b%08x [label=\"%s\"%s];\n", block.start, label.c_str(),
+            function_entries.count(block.start) ? ", penwidth=3" : "");
+    static const char * const styles[] = {"solid", "bold", "dashed", "dotted"};
+    for (const Edge & edge : block.successors)
+      if (block_map.count(edge.target))
+        fprintf(file, "  b%08x -> b%08x [style=%s];\n", block.start, edge.target, styles[edge.kind]);
+    if (block.callee && block_map.count(block.callee))
+      fprintf(file, "  b%08x -> b%08x [color=blue];\n", block.start, block.callee);
+  }
+  fprintf(file, "}\n");
+  fclose(file);
+}
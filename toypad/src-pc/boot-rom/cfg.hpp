@@ -0,0 +1,135 @@
+#ifndef _CFG_HPP_
+#define _CFG_HPP_
+
+#include <map>
+#include <set>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "boot-rom.hpp"
+#include "thumb.hpp"
+
+// The control flow graph of the boot ROM, from the reset vector, and the 
+// cycles it takes to get anywhere in it.
+// 
+// Indirect branches ("ldr r2, [pc, #0]; bx r2") are followed as far as 
+// the registers are known: constants from the literal pools and from 
+// loads out of the boot ROM itself are propagated, everything else is 
+// unknown. A BL is a call: its target is the entry of a function, and 
+// the instruction after it follows once the function returns (bx lr, 
+// pop {pc}). The registers r4 to r11 survive a call, as the AAPCS wants.
+// 
+// Timing (Cortex-M0, see thumb::cycles()): the boot ROM and the RAM have 
+// no wait states, a data access to the flash has flash_wait_states 
+// (FLASHTIM after a reset: 3 system clocks per access, so 2 waits). An 
+// access to an unknown address might go to the flash: 0 to 
+// flash_wait_states.
+// 
+// Throws std::runtime_error.
+
+#define CYCLES_UNBOUNDED	UINT32_MAX
+
+struct CycleRange
+{
+  uint32_t min = 0;
+  uint32_t max = 0;
+  
+  bool bounded() const { return max != CYCLES_UNBOUNDED; }
+  CycleRange operator+(const CycleRange & other) const;
+};
+
+struct TimingModel
+{
+  unsigned flash_wait_states = 2;
+  uint32_t flash_end = 0x8000;	// Flash from 0 to here.
+};
+
+class ControlFlowGraph
+{
+  public:
+    enum EdgeKind
+    {
+      FALL_THROUGH,	// To the next instruction.
+      BRANCH,		// B, or taken B<cond>.
+      JUMP,		// BX / MOV pc / POP {pc} to a known address.
+      CALL_RETURN,	// From a BL to the instruction after it.
+    };
+    
+    struct Edge
+    {
+      uint32_t target;
+      EdgeKind kind;
+    };
+    
+    struct Block
+    {
+      uint32_t start;
+      uint32_t end;				// After the last instruction.
+      std::vector<thumb::Instruction> instructions;
+      std::vector<CycleRange> costs;		// Of every instruction.
+      std::vector<Edge> successors;
+      uint32_t callee = 0;			// Of a BL at the end.
+      bool returns = false;			// Ends with a return.
+      bool unresolved = false;		// Ends with a branch to an unknown address.
+    };
+    
+    // Follows everything from entry (with or without the Thumb bit).
+    ControlFlowGraph(const BootRom & rom, uint32_t entry, const TimingModel & model = TimingModel());
+    
+    const std::map<uint32_t, Block> & blocks() const { return block_map; }
+    const std::set<uint32_t> & functions() const { return function_entries; }
+    
+    // The block that holds the instruction at address, or nullptr.
+    const Block * block_at(uint32_t address) const;
+    const thumb::Instruction * instruction_at(uint32_t address) const;
+    CycleRange cost_at(uint32_t address) const;
+    
+    // When the instruction at address starts, in cycles after the first 
+    // instruction at the entry, over every path of the function of the 
+    // entry. A call takes as long as its function (see duration()).
+    // Throws if the instruction is not in that function.
+    CycleRange start_of(uint32_t address);
+    
+    // From the entry of the function to its return (with every call in 
+    // it); max is CYCLES_UNBOUNDED if there is a loop on the way.
+    CycleRange duration(uint32_t function);
+    
+    // Graphviz, every block with its instructions and cycles.
+    void write_dot(const std::string & path) const;
+    
+    uint32_t entry;
+  
+  private:
+    struct Registers
+    {
+      uint32_t value[16];
+      uint16_t known = 0;		// Bit per register.
+      bool merge(const Registers & other);
+    };
+    struct FunctionTiming
+    {
+      std::map<uint32_t, CycleRange> block_start;
+      CycleRange duration;
+      bool done = false;
+      bool busy = false;
+    };
+    
+    void explore(uint32_t entry);
+    void form_blocks();
+    void compute_costs();
+    CycleRange access_cost(const thumb::Instruction & instruction, const Registers & before) const;
+    FunctionTiming & timing(uint32_t function);
+    void step(const thumb::Instruction & instruction, Registers & registers) const;
+    
+    const BootRom & rom;
+    TimingModel model;
+    std::map<uint32_t, thumb::Instruction> instructions;
+    std::map<uint32_t, Registers> states;
+    std::set<uint32_t> leaders;
+    std::set<uint32_t> function_entries;
+    std::map<uint32_t, Block> block_map;
+    std::map<uint32_t, FunctionTiming> timings;
+};
+
+#endif /* _CFG_HPP_ */
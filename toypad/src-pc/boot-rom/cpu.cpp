@@ -0,0 +1,552 @@
+#include "cpu.hpp"
+
+using namespace thumb;
+
+#define SP	13
+#define LR	14
+#define PC	15
+
+Target::Target(const BootRom & rom, const std::vector<uint8_t> & flash, const TimingModel & model)
+  : rom(rom), flash(flash), model(model), decoded(rom.image.size() / 2)
+{
+  for (size_t n = 0; n < decoded.size(); ++n)
+  {
+    uint32_t address = rom.base + 2 * n;
+    uint16_t second = rom.contains(address + 2, 2) ? rom.read16(address + 2) : 0;
+    decoded[n] = decode(address, rom.read16(address), second);
+  }
+}
+
+Cpu::Cpu(const Target & target)
+  : target(&target)
+{
+  for (uint32_t & value : r)
+    value = 0;
+  r[SP] = target.rom.initial_sp();
+  r[LR] = 0xFFFFFFFF;
+  r[PC] = target.rom.reset_vector() & ~1u;
+}
+
+// Peripheral registers: APB, AHB (GPIO, USB) and the private peripheral 
+// bus.
+static bool is_peripheral(uint32_t address)
+{
+  return (address >= 0x40000000 && address < 0x40080000)
+      || (address >= 0x50000000 && address < 0x50004000)
+      || address >= 0xE0000000;
+}
+
+static bool is_ram(uint32_t address)
+{
+  return (address >= RAM_BASE && address - RAM_BASE < RAM_SIZE)
+      || (address >= USB_RAM_BASE && address - USB_RAM_BASE < USB_RAM_SIZE);
+}
+
+bool Cpu::read(uint32_t address, unsigned size, uint32_t & value) const
+{
+  if (address % size)
+    return false;
+  const BootRom & rom = target->rom;
+  value = 0;
+  if (address < target->flash.size() && target->flash.size() - address >= size)
+  {
+    for (unsigned i = 0; i < size; ++i)
+      value |= (uint32_t) target->flash[address + i] << (8 * i);
+    return true;
+  }
+  if (rom.contains(address, size))
+  {
+    for (unsigned i = 0; i < size; ++i)
+      value |= (uint32_t) rom.image[address - rom.base + i] << (8 * i);
+    return true;
+  }
+  if (!is_ram(address) && !is_peripheral(address))
+    return false;
+  auto word = written.find(address & ~3u);
+  if (word != written.end())
+    value = (word->second >> (8 * (address & 3))) & (size == 4 ? 0xFFFFFFFF : (1u << (8 * size)) - 1);
+  return true;
+}
+
+bool Cpu::write(uint32_t address, unsigned size, uint32_t value)
+{
+  if (address % size || (!is_ram(address) && !is_peripheral(address)))
+    return false;
+  if (size == 4)
+  {
+    written[address] = value;
+    return true;
+  }
+  uint32_t & word = written[address & ~3u];
+  unsigned shift = 8 * (address & 3);
+  uint32_t mask = ((1u << (8 * size)) - 1) << shift;
+  word = (word & ~mask) | ((value << shift) & mask);
+  return true;
+}
+
+Instruction Cpu::fetch() const
+{
+  uint32_t pc = r[PC];
+  const BootRom & rom = target->rom;
+  if (rom.contains(pc, 2))
+    return target->decoded[(pc - rom.base) / 2];
+  uint32_t first, second = 0;
+  if (!read(pc & ~1u, 2, first))
+  {
+    Instruction none;
+    none.address = pc;
+    return none;
+  }
+  if (is_32bit(first))
+    read(pc + 2, 2, second);
+  return decode(pc, first, second);
+}
+
+void Cpu::stop(Status status, const char * why)
+{
+  if (this->status != RUNNING)
+    return;
+  this->status = status;
+  fault = why;
+}
+
+bool Cpu::load(uint32_t address, unsigned size, uint32_t & value)
+{
+  if (!read(address, size, value))
+  {
+    stop(FAULT, address % size ? "unaligned load" : "bus error on a load");
+    return false;
+  }
+  if (address < target->model.flash_end)
+    ++flash_accesses;
+  if (load_fault == LOAD_SET)
+    value = load_value;
+  else if (load_fault == LOAD_XOR)
+    value ^= load_value;
+  if (size < 4)
+    value &= (1u << (8 * size)) - 1;
+  return true;
+}
+
+bool Cpu::store(uint32_t address, unsigned size, uint32_t value)
+{
+  if (!write(address, size, value))
+  {
+    stop(FAULT, address % size ? "unaligned store" : "bus error on a store");
+    return false;
+  }
+  if (address < target->model.flash_end)
+    ++flash_accesses;
+  if (watch_address && (address & ~3u) == watch_address)
+  {
+    read(watch_address, 4, watched_value);
+    stop(WATCHPOINT);
+  }
+  return true;
+}
+
+void Cpu::branch(uint32_t address, bool interworking)
+{
+  // Only Thumb: a 0 in bit 0 is a HardFault (INVSTATE).
+  if (interworking && !(address & 1))
+    stop(FAULT, "branch to ARM state");
+  r[PC] = address & ~1u;
+}
+
+uint32_t Cpu::add_with_carry(uint32_t x, uint32_t y, bool carry, bool set_flags)
+{
+  uint64_t unsigned_sum = (uint64_t) x + y + carry;
+  int64_t signed_sum = (int64_t) (int32_t) x + (int32_t) y + carry;
+  uint32_t result = unsigned_sum;
+  if (set_flags)
+  {
+    set_nz(result);
+    c = unsigned_sum >> 32;
+    v = signed_sum != (int32_t) result;
+  }
+  return result;
+}
+
+void Cpu::set_nz(uint32_t result)
+{
+  n = result >> 31;
+  z = result == 0;
+}
+
+bool Cpu::condition(unsigned cond) const
+{
+  switch (cond)
+  {
+    case EQ: return z;
+    case NE: return !z;
+    case CS: return c;
+    case CC: return !c;
+    case MI: return n;
+    case PL: return !n;
+    case VS: return v;
+    case VC: return !v;
+    case HI: return c && !z;
+    case LS: return !c || z;
+    case GE: return n == v;
+    case LT: return n != v;
+    case GT: return !z && n == v;
+    case LE: return z || n != v;
+    default: return true;
+  }
+}
+
+void Cpu::skip(unsigned cycles)
+{
+  if (status != RUNNING)
+    return;
+  r[PC] += fetch().size;
+  cycle += cycles;
+  ++instructions;
+  load_fault = LOAD_AS_IS;
+}
+
+void Cpu::flip(unsigned reg, uint32_t mask)
+{
+  if (reg < 16)
+  {
+    r[reg] ^= mask;
+    if (reg == PC)
+      r[PC] &= ~1u;
+    return;
+  }
+  n ^= (mask >> 31) & 1;
+  z ^= (mask >> 30) & 1;
+  c ^= (mask >> 29) & 1;
+  v ^= (mask >> 28) & 1;
+}
+
+void Cpu::step()
+{
+  if (status != RUNNING)
+    return;
+  Instruction i = fetch();
+  flash_accesses = 0;
+  uint32_t start = r[PC];
+  execute(i);
+  load_fault = LOAD_AS_IS;
+  bool taken = i.op != B_COND || r[PC] != start + i.size;
+  cycle += cycles(i, taken) + flash_accesses * target->model.flash_wait_states;
+  ++instructions;
+}
+
+void Cpu::run(uint64_t max_cycles)
+{
+  uint64_t end = cycle + max_cycles;
+  while (status == RUNNING && cycle < end)
+    step();
+}
+
+void Cpu::execute(const Instruction & i)
+{
+  uint32_t next = i.address + i.size;
+  // Operands of the special data processing: the pc reads 4 ahead.
+  auto operand = [this, &i](unsigned reg) { return reg == PC ? i.address + 4 : r[reg]; };
+  uint32_t rn = r[i.rn], rm = r[i.rm];
+  uint32_t value, result;
+  unsigned shift;
+  
+  r[PC] = next;
+  switch (i.op)
+  {
+    case LSLS_IMM:
+      result = rm << i.imm;
+      if (i.imm)
+        c = (rm >> (32 - i.imm)) & 1;
+      set_nz(r[i.rd] = result);
+      break;
+    case LSRS_IMM:
+      c = (rm >> (i.imm - 1)) & 1;
+      set_nz(r[i.rd] = i.imm == 32 ? 0 : rm >> i.imm);
+      break;
+    case ASRS_IMM:
+      c = (rm >> (i.imm == 32 ? 31 : i.imm - 1)) & 1;
+      set_nz(r[i.rd] = i.imm == 32 ? (uint32_t) ((int32_t) rm >> 31) : (uint32_t) ((int32_t) rm >> i.imm));
+      break;
+    case ADDS_REG:
+      r[i.rd] = add_with_carry(rn, rm, false, true);
+      break;
+    case SUBS_REG:
+      r[i.rd] = add_with_carry(rn, ~rm, true, true);
+      break;
+    case ADDS_IMM3: case ADDS_IMM8:
+      r[i.rd] = add_with_carry(rn, i.imm, false, true);
+      break;
+    case SUBS_IMM3: case SUBS_IMM8:
+      r[i.rd] = add_with_carry(rn, ~i.imm, true, true);
+      break;
+    case MOVS_IMM:
+      set_nz(r[i.rd] = i.imm);
+      break;
+    case CMP_IMM:
+      add_with_carry(rn, ~i.imm, true, true);
+      break;
+    case ANDS:
+      set_nz(r[i.rd] = rn & rm);
+      break;
+    case EORS:
+      set_nz(r[i.rd] = rn ^ rm);
+      break;
+    case ORRS:
+      set_nz(r[i.rd] = rn | rm);
+      break;
+    case BICS:
+      set_nz(r[i.rd] = rn & ~rm);
+      break;
+    case MVNS:
+      set_nz(r[i.rd] = ~rm);
+      break;
+    case MULS:
+      set_nz(r[i.rd] = rn * rm);
+      break;
+    case TST:
+      set_nz(rn & rm);
+      break;
+    case LSLS_REG:
+      shift = rm & 0xFF;
+      result = shift < 32 ? rn << shift : 0;
+      if (shift)
+        c = shift <= 32 ? (rn >> (32 - shift)) & 1 : 0;
+      set_nz(r[i.rd] = result);
+      break;
+    case LSRS_REG:
+      shift = rm & 0xFF;
+      result = shift < 32 ? rn >> shift : 0;
+      if (shift)
+        c = shift <= 32 ? (rn >> (shift - 1)) & 1 : 0;
+      set_nz(r[i.rd] = result);
+      break;
+    case ASRS_REG:
+      shift = rm & 0xFF;
+      result = (int32_t) rn >> (shift < 32 ? shift : 31);
+      if (shift)
+        c = (rn >> (shift < 32 ? shift - 1 : 31)) & 1;
+      set_nz(r[i.rd] = result);
+      break;
+    case RORS:
+      shift = rm & 0xFF;
+      result = rn;
+      if (shift)
+      {
+        shift %= 32;
+        result = shift ? rn >> shift | rn << (32 - shift) : rn;
+        c = result >> 31;
+      }
+      set_nz(r[i.rd] = result);
+      break;
+    case ADCS:
+      r[i.rd] = add_with_carry(rn, rm, c, true);
+      break;
+    case SBCS:
+      r[i.rd] = add_with_carry(rn, ~rm, c, true);
+      break;
+    case RSBS:
+      r[i.rd] = add_with_carry(~rm, 0, true, true);
+      break;
+    case CMP_REG:
+      add_with_carry(rn, ~rm, true, true);
+      break;
+    case CMN:
+      add_with_carry(rn, rm, false, true);
+      break;
+    case ADD_HI:
+      result = operand(i.rn) + operand(i.rm);
+      if (i.rd == PC)
+        branch(result, false);
+      else
+        r[i.rd] = result;
+      break;
+    case CMP_HI:
+      add_with_carry(operand(i.rn), ~operand(i.rm), true, true);
+      break;
+    case MOV_HI:
+      result = operand(i.rm);
+      if (i.rd == PC)
+        branch(result, false);
+      else
+        r[i.rd] = result;
+      break;
+    case BX:
+      branch(operand(i.rm), true);
+      break;
+    case BLX:
+      result = operand(i.rm);
+      r[LR] = next | 1;
+      branch(result, true);
+      break;
+    case LDR_LIT:
+      if (load(i.target, 4, value))
+        r[i.rd] = value;
+      break;
+    case LDR_REG: case LDRH_REG: case LDRB_REG: case LDRSB_REG: case LDRSH_REG:
+    {
+      unsigned size = i.op == LDR_REG ? 4 : i.op == LDRH_REG || i.op == LDRSH_REG ? 2 : 1;
+      if (!load(rn + rm, size, value))
+        break;
+      if (i.op == LDRSB_REG)
+        value = (int32_t) (int8_t) value;
+      else if (i.op == LDRSH_REG)
+        value = (int32_t) (int16_t) value;
+      r[i.rd] = value;
+      break;
+    }
+    case STR_REG:
+      store(rn + rm, 4, r[i.rd]);
+      break;
+    case STRH_REG:
+      store(rn + rm, 2, r[i.rd]);
+      break;
+    case STRB_REG:
+      store(rn + rm, 1, r[i.rd]);
+      break;
+    case LDR_IMM: case LDR_SP:
+      if (load(rn + i.imm, 4, value))
+        r[i.rd] = value;
+      break;
+    case LDRH_IMM:
+      if (load(rn + i.imm, 2, value))
+        r[i.rd] = value;
+      break;
+    case LDRB_IMM:
+      if (load(rn + i.imm, 1, value))
+        r[i.rd] = value;
+      break;
+    case STR_IMM: case STR_SP:
+      store(rn + i.imm, 4, r[i.rd]);
+      break;
+    case STRH_IMM:
+      store(rn + i.imm, 2, r[i.rd]);
+      break;
+    case STRB_IMM:
+      store(rn + i.imm, 1, r[i.rd]);
+      break;
+    case ADR:
+      r[i.rd] = i.target;
+      break;
+    case ADD_SP_IMM:
+      r[i.rd] = r[SP] + i.imm;
+      break;
+    case ADD_SP:
+      r[SP] += i.imm;
+      break;
+    case SUB_SP:
+      r[SP] -= i.imm;
+      break;
+    case SXTH:
+      r[i.rd] = (int32_t) (int16_t) rm;
+      break;
+    case SXTB:
+      r[i.rd] = (int32_t) (int8_t) rm;
+      break;
+    case UXTH:
+      r[i.rd] = rm & 0xFFFF;
+      break;
+    case UXTB:
+      r[i.rd] = rm & 0xFF;
+      break;
+    case REV:
+      r[i.rd] = rm >> 24 | (rm >> 8 & 0xFF00) | (rm << 8 & 0xFF0000) | rm << 24;
+      break;
+    case REV16:
+      r[i.rd] = (rm >> 8 & 0x00FF00FF) | (rm << 8 & 0xFF00FF00);
+      break;
+    case REVSH:
+      r[i.rd] = (int32_t) (int16_t) ((rm >> 8 & 0xFF) | (rm << 8 & 0xFF00));
+      break;
+    case PUSH: case STM:
+    {
+      unsigned count = 0;
+      for (unsigned reg = 0; reg < 16; ++reg)
+        count += (i.registers >> reg) & 1;
+      uint32_t address = i.op == PUSH ? r[SP] - 4 * count : rn;
+      // The base is written back after the stores; a STM that stores its 
+      // base stores the original value (it has to be the lowest).
+      for (unsigned reg = 0; reg < 16 && status == RUNNING; ++reg)
+        if (i.registers & (1 << reg))
+        {
+          store(address, 4, r[reg]);
+          address += 4;
+        }
+      if (i.op == PUSH)
+        r[SP] -= 4 * count;
+      else
+        r[i.rn] = address;
+      break;
+    }
+    case POP: case LDM:
+    {
+      uint32_t address = i.op == POP ? r[SP] : rn;
+      for (unsigned reg = 0; reg < 16 && status == RUNNING; ++reg)
+        if (i.registers & (1 << reg))
+        {
+          if (!load(address, 4, value))
+            break;
+          if (reg == PC)
+            branch(value, true);
+          else
+            r[reg] = value;
+          address += 4;
+        }
+      if (i.op == POP)
+        r[SP] = address;
+      else if (!(i.registers & (1 << i.rn)))
+        r[i.rn] = address;
+      break;
+    }
+    case CPSIE:
+      primask = false;
+      break;
+    case CPSID:
+      primask = true;
+      break;
+    case NOP: case YIELD: case SEV: case DSB: case DMB: case ISB:
+      break;
+    case WFE: case WFI:
+      stop(SLEEPING);
+      break;
+    case B_COND:
+      if (condition(i.cond))
+        r[PC] = i.target;
+      break;
+    case B:
+      r[PC] = i.target;
+      break;
+    case BL:
+      r[LR] = next | 1;
+      r[PC] = i.target;
+      break;
+    case MSR:
+      // SYSm: 8 MSP, 9 PSP (one stack here), 16 PRIMASK; CONTROL and the 
+      // flags are not worth it.
+      if (i.imm == 8 || i.imm == 9)
+        r[SP] = r[i.rn] & ~3u;
+      else if (i.imm == 16)
+        primask = r[i.rn] & 1;
+      break;
+    case MRS:
+      if (i.imm == 8 || i.imm == 9)
+        r[i.rd] = r[SP];
+      else if (i.imm == 16)
+        r[i.rd] = primask;
+      else if (i.imm <= 7)
+        r[i.rd] = (uint32_t) n << 31 | (uint32_t) z << 30 | (uint32_t) c << 29 | (uint32_t) v << 28;
+      else
+        r[i.rd] = 0;
+      break;
+    case SVC:
+      r[PC] = i.address;
+      stop(FAULT, "svc");
+      break;
+    case BKPT:
+      r[PC] = i.address;
+      stop(FAULT, "bkpt");
+      break;
+    default:
+      r[PC] = i.address;
+      stop(FAULT, "undefined instruction");
+  }
+}
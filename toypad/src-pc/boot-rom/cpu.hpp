@@ -0,0 +1,125 @@
+#ifndef _CPU_HPP_
+#define _CPU_HPP_
+
+#include <map>
+#include <stdint.h>
+#include <vector>
+
+#include "boot-rom.hpp"
+#include "cfg.hpp"
+#include "thumb.hpp"
+
+// A Cortex-M0 that runs the boot ROM of the LPC11U35 (see boot-rom.hpp) 
+// with a flash image of our choice, instruction by instruction, and 
+// counts the cycles like ControlFlowGraph does: thumb::cycles() plus the 
+// wait states of every data access to the flash.
+// 
+// The memory map of the LPC11U35: the flash from 0, the RAM at 
+// 0x10000000 (8 kB), the USB RAM at 0x20004000 (2 kB), the peripherals 
+// (APB, AHB, the private peripheral bus). Peripheral registers are plain 
+// memory: they read what was written last, or 0. Anything else is a bus 
+// error.
+// 
+// Out of reset r0 to r12 are 0 (on the core they are UNKNOWN), sp and 
+// the pc come from the vectors of the boot ROM.
+// 
+// There are no exceptions: what would be a HardFault (a bus error, an 
+// unaligned access, an undefined instruction, a BX to ARM state) stops 
+// the core with status FAULT. So do SVC and BKPT. WFI and WFE stop it 
+// with SLEEPING: nothing would wake it.
+// 
+// A Cpu is a value: copying it forks the machine. The boot ROM and the 
+// flash are in the Target the copies share; the state of a Cpu is its 
+// registers and the words written so far, which is a handful for the 
+// start of the boot ROM.
+
+// What the Cpus of a run share, read only.
+struct Target
+{
+  Target(const BootRom & rom, const std::vector<uint8_t> & flash,
+         const TimingModel & model = TimingModel());
+  
+  const BootRom & rom;
+  std::vector<uint8_t> flash;
+  TimingModel model;
+  std::vector<thumb::Instruction> decoded;	// Every halfword of the boot ROM.
+};
+
+#define RAM_BASE	0x10000000
+#define RAM_SIZE	(8 * 1024)
+#define USB_RAM_BASE	0x20004000
+#define USB_RAM_SIZE	(2 * 1024)
+
+#define APSR		16	// Register number of the flags, for flip().
+
+class Cpu
+{
+  public:
+    enum Status
+    {
+      RUNNING,
+      WATCHPOINT,	// Stored to watch_address.
+      FAULT,
+      SLEEPING,
+    };
+    
+    // What the next instruction loads instead of what is in memory.
+    enum LoadFault
+    {
+      LOAD_AS_IS,
+      LOAD_SET,		// load_value.
+      LOAD_XOR,		// What is in memory ^ load_value.
+    };
+    
+    // Out of reset: sp and pc from the vectors of the boot ROM.
+    explicit Cpu(const Target & target);
+    
+    // The instruction at the pc (UNDEFINED if the pc is not in memory).
+    thumb::Instruction fetch() const;
+    
+    // Runs one instruction. Nothing if the status is not RUNNING.
+    void step();
+    // Runs until the status is not RUNNING, or for max_cycles.
+    void run(uint64_t max_cycles);
+    
+    // The next instruction is fetched, but does nothing, in cycles.
+    void skip(unsigned cycles = 1);
+    // XOR of a register (0 to 15, or APSR for N, Z, C and V in bits 31 
+    // to 28).
+    void flip(unsigned reg, uint32_t mask);
+    
+    // Data reads and writes, as the core does them. A read of a word 
+    // nobody wrote is 0. False: bus error.
+    bool read(uint32_t address, unsigned size, uint32_t & value) const;
+    bool write(uint32_t address, unsigned size, uint32_t value);
+    
+    uint32_t r[16];
+    bool n = false, z = false, c = false, v = false;
+    bool primask = false;
+    uint64_t cycle = 0;
+    uint64_t instructions = 0;
+    Status status = RUNNING;
+    const char * fault = nullptr;	// Why, with FAULT.
+    
+    uint32_t watch_address = 0;	// 0: none.
+    uint32_t watched_value = 0;
+    
+    LoadFault load_fault = LOAD_AS_IS;
+    uint32_t load_value = 0;
+  
+  private:
+    void stop(Status status, const char * why = nullptr);
+    bool load(uint32_t address, unsigned size, uint32_t & value);
+    bool store(uint32_t address, unsigned size, uint32_t value);
+    void branch(uint32_t address, bool interworking);
+    uint32_t add_with_carry(uint32_t x, uint32_t y, bool carry, bool set_flags);
+    void set_nz(uint32_t result);
+    bool condition(unsigned cond) const;
+    void execute(const thumb::Instruction & instruction);
+    
+    const Target * target;
+    std::map<uint32_t, uint32_t> written;	// Word address: value.
+    unsigned flash_accesses = 0;		// Of the instruction.
+};
+
+#endif /* _CPU_HPP_ */
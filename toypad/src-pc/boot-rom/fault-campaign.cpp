@@ -0,0 +1,285 @@
+#include <atomic>
+#include <stdexcept>
+#include <stdio.h>
+#include <thread>
+
+#include "fault-campaign.hpp"
+
+using namespace thumb;
+
+#define PC	15
+
+// Of the golden run, until it stores to the CRP register.
+#define GOLDEN_MAX_CYCLES	100000
+
+static const char * register_name(unsigned reg)
+{
+  static const char * const names[] =
+  {
+    "r0", "r1", "r2", "r3", "r4", "r5", "r6", "r7",
+    "r8", "r9", "r10", "r11", "r12", "sp", "lr", "pc", "apsr",
+  };
+  return names[reg <= APSR ? reg : APSR];
+}
+
+std::string Fault::model() const
+{
+  char text[32];
+  switch (kind)
+  {
+    case SKIP:
+      snprintf(text, sizeof text, "skip/%u", width);
+      break;
+    case FLIP:
+      snprintf(text, sizeof text, "flip/%u", width);
+      break;
+    case LOAD_SET:
+      return mask ? "load=~0" : "load=0";
+    default:
+      return "load^1";
+  }
+  return text;
+}
+
+std::string Fault::describe() const
+{
+  char text[64];
+  switch (kind)
+  {
+    case SKIP:
+      snprintf(text, sizeof text, "skip %u cycle%s", width, width == 1 ? "" : "s");
+      break;
+    case FLIP:
+      snprintf(text, sizeof text, "flip %s ^ 0x%08x", register_name(reg), mask);
+      break;
+    case LOAD_SET:
+      snprintf(text, sizeof text, "load = 0x%08x", mask);
+      break;
+    default:
+      snprintf(text, sizeof text, "load ^ 0x%08x", mask);
+  }
+  return text;
+}
+
+const char * outcome_name(Outcome outcome)
+{
+  static const char * const names[] = {"protected", "swd-enabled", "no-store", "crash"};
+  return names[outcome];
+}
+
+static bool is_load(Op op)
+{
+  switch (op)
+  {
+    case LDR_LIT: case LDR_REG: case LDRH_REG: case LDRB_REG: case LDRSB_REG: case LDRSH_REG:
+    case LDR_IMM: case LDRB_IMM: case LDRH_IMM: case LDR_SP: case LDM: case POP:
+      return true;
+    default:
+      return false;
+  }
+}
+
+FaultCampaign::FaultCampaign(const Target & target, uint32_t from, uint32_t to, uint64_t max_cycles)
+  : target(target), golden(target), window_start(0), window_end(0), max_cycles(max_cycles)
+{
+  golden.watch_address = CRP_REGISTER;
+  bool started = false, ended = false;
+  while (golden.status == Cpu::RUNNING && golden.cycle < GOLDEN_MAX_CYCLES)
+  {
+    snapshots.push_back(golden);
+    uint32_t address = golden.r[PC];
+    if (address == from && !started)
+    {
+      window_start = golden.cycle;
+      started = true;
+    }
+    golden.step();
+    if (address == to && started && !ended)
+    {
+      window_end = golden.cycle;
+      ended = true;
+    }
+  }
+  if (golden.status != Cpu::WATCHPOINT)
+    throw std::runtime_error("the golden run does not store to the CRP register");
+  if (!ended || window_end <= window_start)
+    throw std::runtime_error("the golden run does not run the window");
+}
+
+const Cpu & FaultCampaign::snapshot_at(uint32_t cycle) const
+{
+  size_t n = 0;
+  while (n + 1 < snapshots.size() && snapshots[n + 1].cycle <= cycle)
+    ++n;
+  return snapshots[n];
+}
+
+std::vector<Injection> FaultCampaign::single_faults(unsigned max_skip_width) const
+{
+  std::vector<Injection> injections;
+  auto add = [&injections](const Fault & fault)
+  {
+    Injection injection;
+    injection.faults[0] = fault;
+    injections.push_back(injection);
+  };
+  for (uint32_t cycle = window_start; cycle < window_end; ++cycle)
+  {
+    Fault fault;
+    fault.cycle = cycle;
+    fault.kind = Fault::SKIP;
+    for (fault.width = 1; fault.width <= max_skip_width; ++fault.width)
+      add(fault);
+    
+    fault.kind = Fault::FLIP;
+    static const unsigned regs[] = {0, 1, 2, 3, 4, 5, 6, 7, PC, APSR};
+    for (unsigned reg : regs)
+      for (unsigned width : {1, 2, 4, 8})
+      {
+        // The flags are bits 31 to 28; bit 0 of the pc is not there.
+        unsigned low = reg == APSR ? 28 : reg == PC ? 1 : 0;
+        for (unsigned shift = low; shift + width <= 32; ++shift)
+        {
+          fault.reg = reg;
+          fault.width = width;
+          fault.mask = (width == 32 ? 0xFFFFFFFF : (1u << width) - 1) << shift;
+          add(fault);
+        }
+      }
+    
+    if (!is_load(snapshot_at(cycle).fetch().op))
+      continue;
+    fault.kind = Fault::LOAD_SET;
+    fault.width = 32;
+    for (uint32_t value : {0x00000000u, 0xFFFFFFFFu})
+    {
+      fault.mask = value;
+      add(fault);
+    }
+    fault.kind = Fault::LOAD_XOR;
+    fault.width = 1;
+    for (unsigned bit = 0; bit < 32; ++bit)
+    {
+      fault.mask = 1u << bit;
+      add(fault);
+    }
+  }
+  return injections;
+}
+
+std::vector<Injection> FaultCampaign::double_faults(unsigned max_skip_width) const
+{
+  std::vector<Fault> faults;
+  for (const Injection & injection : single_faults(max_skip_width))
+    if (injection.faults[0].kind != Fault::FLIP)
+      faults.push_back(injection.faults[0]);
+  
+  std::vector<Injection> injections;
+  for (size_t a = 0; a < faults.size(); ++a)
+    for (size_t b = a + 1; b < faults.size(); ++b)
+      if (faults[a].cycle < faults[b].cycle)
+      {
+        Injection injection;
+        injection.faults[0] = faults[a];
+        injection.faults[1] = faults[b];
+        injection.count = 2;
+        injections.push_back(injection);
+      }
+  return injections;
+}
+
+InjectionResult FaultCampaign::run(const Injection & injection) const
+{
+  const Fault * faults = injection.faults;
+  Cpu cpu = snapshot_at(faults[0].cycle);
+  InjectionResult result;
+  result.address = cpu.r[PC];
+  uint64_t end = golden.cycle + max_cycles;
+  
+  unsigned next = 0;
+  while (cpu.status == Cpu::RUNNING && cpu.cycle < end)
+  {
+    if (next == injection.count)
+    {
+      cpu.run(end - cpu.cycle);
+      break;
+    }
+    // The instruction without the fault: when it is in flight.
+    const Fault & fault = faults[next];
+    Cpu plain = cpu;
+    plain.step();
+    uint64_t start = cpu.cycle;
+    uint64_t stop = plain.cycle > start ? plain.cycle : start + 1;
+    bool in_flight = start <= fault.cycle && fault.cycle < stop;
+    
+    switch (fault.kind)
+    {
+      case Fault::SKIP:
+        if (start >= fault.cycle + fault.width)
+          ++next;
+        else if (stop > fault.cycle)
+          cpu.skip(stop - start);
+        else
+          cpu = plain;
+        break;
+      case Fault::FLIP:
+        cpu = plain;
+        if (in_flight)
+          cpu.flip(fault.reg, fault.mask);
+        // Lost, if an earlier fault made us pass the cycle.
+        if (in_flight || start > fault.cycle)
+          ++next;
+        break;
+      default:
+        if (in_flight)
+        {
+          cpu.load_fault = fault.kind == Fault::LOAD_SET ? Cpu::LOAD_SET : Cpu::LOAD_XOR;
+          cpu.load_value = fault.mask;
+          cpu.step();
+          ++next;
+        }
+        else
+        {
+          if (start > fault.cycle)
+            ++next;
+          cpu = plain;
+        }
+    }
+  }
+  
+  result.crp_register = cpu.watched_value;
+  if (cpu.status == Cpu::WATCHPOINT)
+    result.outcome = cpu.watched_value == CRP2 ? PROTECTED : SWD_ENABLED;
+  else if (cpu.status == Cpu::RUNNING)
+    result.outcome = NO_STORE;
+  else
+    result.outcome = CRASH;
+  return result;
+}
+
+std::vector<InjectionResult> FaultCampaign::run_all(const std::vector<Injection> & injections, unsigned threads) const
+{
+  if (!threads)
+    threads = std::thread::hardware_concurrency();
+  if (!threads)
+    threads = 1;
+  std::vector<InjectionResult> results(injections.size());
+  
+  // In chunks, so the threads do not fight over the counter.
+  const size_t chunk = 256;
+  std::atomic<size_t> next(0);
+  auto work = [&]()
+  {
+    size_t first;
+    while ((first = next.fetch_add(chunk)) < injections.size())
+      for (size_t n = first; n < first + chunk && n < injections.size(); ++n)
+        results[n] = run(injections[n]);
+  };
+  std::vector<std::thread> workers;
+  for (unsigned n = 1; n < threads; ++n)
+    workers.emplace_back(work);
+  work();
+  for (std::thread & worker : workers)
+    worker.join();
+  return results;
+}
@@ -0,0 +1,118 @@
+#ifndef _FAULT_CAMPAIGN_HPP_
+#define _FAULT_CAMPAIGN_HPP_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "cpu.hpp"
+
+// Simulated glitches of the code read protection check of the boot ROM:
+// what a fault at a cycle of the glitch window does to the value the 
+// boot ROM stores in the CRP register (0x400483f0).
+// 
+// As src-lpc/crp-replica (and crp_replica.py) has it: the boot ROM 
+// stores CRP2 there for CRP1, CRP2 and CRP3, so the store of anything 
+// else is a boot with SWD enabled.
+// 
+// The fault models, at cycle c (cycles after the reset vector, as 
+// rom-timing counts them):
+// 
+//   skip      Every instruction in flight during c .. c + width - 1 is 
+//             fetched, but does nothing (in the cycles it would take):
+//             the width of the glitch.
+//   flip      XOR of a register (r0 to r7, the pc, or the flags) as the 
+//             instruction in flight at c leaves it: one bit, or a burst 
+//             of 2, 4 or 8 adjacent bits.
+//   load      The instruction in flight at c, if it loads, gets 0, 
+//             0xffffffff, or the value with one bit flipped.
+// 
+// An injection is one fault, or two at different cycles.
+// 
+// The golden run (no fault) takes a snapshot at the start of every 
+// instruction; an injection forks the snapshot of the instruction in 
+// flight at its first fault. run_all() spreads the injections over 
+// threads.
+
+#define CRP_REGISTER	0x400483f0
+#define CRP1		0x12345678
+#define CRP2		0x87654321
+#define CRP3		0x43218765
+
+struct Fault
+{
+  enum Kind
+  {
+    SKIP,
+    FLIP,
+    LOAD_SET,
+    LOAD_XOR,
+  };
+  
+  Kind kind = SKIP;
+  uint32_t cycle = 0;
+  unsigned width = 1;		// SKIP: cycles; FLIP, LOAD_XOR: bits.
+  unsigned reg = 0;		// FLIP: 0 to 15, or APSR.
+  uint32_t mask = 0;		// FLIP, LOAD_XOR: bits; LOAD_SET: value.
+  
+  // The fault model, without the cycle: "skip/2", "flip/1", "load=0", 
+  // "load^1".
+  std::string model() const;
+  // E.g. "flip r4 ^ 0x00000300".
+  std::string describe() const;
+};
+
+struct Injection
+{
+  Fault faults[2];
+  unsigned count = 1;
+};
+
+enum Outcome
+{
+  PROTECTED,	// CRP2 stored.
+  SWD_ENABLED,	// Anything else stored.
+  NO_STORE,	// Not within the cycles of the run.
+  CRASH,		// HardFault, or asleep.
+};
+
+const char * outcome_name(Outcome outcome);
+
+struct InjectionResult
+{
+  Outcome outcome;
+  uint32_t crp_register;		// What was stored, with PROTECTED and SWD_ENABLED.
+  uint32_t address;		// Of the instruction of the first fault.
+};
+
+class FaultCampaign
+{
+  public:
+    // Runs the golden run: the first instruction of the window at from, 
+    // the last at to. max_cycles: after the golden store of the CRP 
+    // register, until NO_STORE.
+    FaultCampaign(const Target & target, uint32_t from, uint32_t to, uint64_t max_cycles = 2000);
+    
+    // Every single fault of every model at every cycle of the window.
+    std::vector<Injection> single_faults(unsigned max_skip_width = 8) const;
+    // Every pair of skips and load faults at two different cycles of the 
+    // window (flips would make it too many).
+    std::vector<Injection> double_faults(unsigned max_skip_width = 4) const;
+    
+    InjectionResult run(const Injection & injection) const;
+    // threads: 0 for one per core.
+    std::vector<InjectionResult> run_all(const std::vector<Injection> & injections, unsigned threads = 0) const;
+    
+    const Target & target;
+    Cpu golden;			// At the golden store.
+    uint32_t window_start;	// First cycle of the window.
+    uint32_t window_end;	// After the last cycle.
+    uint64_t max_cycles;
+  
+  private:
+    // The snapshot of the instruction in flight at cycle.
+    const Cpu & snapshot_at(uint32_t cycle) const;
+    std::vector<Cpu> snapshots;	// In the order of their cycles.
+};
+
+#endif /* _FAULT_CAMPAIGN_HPP_ */
@@ -0,0 +1,131 @@
+// Checks the Cortex-M0 interpreter (cpu.cpp) on a few instructions in 
+// the flash and on the boot ROM of toypad/bootloader.lst, against the 
+// cycles of rom-timing (cfg.cpp), and a few faults of the campaign 
+// (fault-campaign.cpp) whose outcome we know by hand.
+// 
+// Usage: rom-faults-test [listing] (../../bootloader.lst)
+
+#include <stdexcept>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "../controller/test-check.hpp"
+#include "boot-rom.hpp"
+#include "cfg.hpp"
+#include "cpu.hpp"
+#include "fault-campaign.hpp"
+
+static std::vector<uint8_t> flash_with_crp(uint32_t crp)
+{
+  std::vector<uint8_t> flash(32 * 1024, 0xFF);
+  for (unsigned i = 0; i < 4; ++i)
+    flash[0x2fc + i] = crp >> (8 * i);
+  return flash;
+}
+
+static Outcome outcome(const FaultCampaign & campaign, Fault fault)
+{
+  Injection injection;
+  injection.faults[0] = fault;
+  return campaign.run(injection).outcome;
+}
+
+int main(int argc, char ** argv)
+{
+  std::string listing = argc > 1 ? argv[1] : "../../bootloader.lst";
+  try
+  {
+    BootRom rom;
+    rom.load(listing);
+    
+    // movs r0, #5; subs r0, #6; movs r1, #1; adds r0, r0, r1; 
+    // push {r0, r1}; pop {r2, r3}; bkpt 0
+    static const uint16_t program[] = {0x2005, 0x3806, 0x2101, 0x1840, 0xb403, 0xbc0c, 0xbe00};
+    std::vector<uint8_t> flash = flash_with_crp(CRP3);
+    for (unsigned i = 0; i < sizeof program / sizeof program[0]; ++i)
+    {
+      flash[0x100 + 2 * i] = program[i];
+      flash[0x100 + 2 * i + 1] = program[i] >> 8;
+    }
+    Target flash_target(rom, flash);
+    Cpu cpu(flash_target);
+    cpu.r[15] = 0x100;
+    cpu.step();
+    cpu.step();
+    check(cpu.r[0] == 0xFFFFFFFF && cpu.n && !cpu.z && !cpu.c && !cpu.v, "subs: borrow");
+    cpu.step();
+    cpu.step();
+    check(cpu.r[0] == 0 && !cpu.n && cpu.z && cpu.c && !cpu.v, "adds: carry");
+    uint32_t sp = cpu.r[13];
+    cpu.step();
+    cpu.step();
+    check(cpu.r[2] == 0 && cpu.r[3] == 1 && cpu.r[13] == sp, "push, pop");
+    cpu.run(100);
+    check(cpu.status == Cpu::FAULT && cpu.r[15] == 0x10c, "bkpt stops");
+    check(cpu.cycle == 1 + 1 + 1 + 1 + 3 + 3 + 1, "cycles");
+    
+    // The boot ROM, as rom-timing counts it.
+    Target target(rom, flash_with_crp(CRP3));
+    FaultCampaign campaign(target, 0x1fff00a8, 0x1fff00c2);
+    ControlFlowGraph cfg(rom, rom.reset_vector());
+    CycleRange store = cfg.start_of(0x1fff00c4) + cfg.cost_at(0x1fff00c4);
+    check(campaign.golden.watched_value == CRP2, "CRP3: CRP2 stored");
+    // rom-timing has the two paths to the store, the golden run the one 
+    // of CRP3.
+    check(store.min == 31 && campaign.golden.cycle == store.max, "cycles as rom-timing");
+    check(campaign.window_start == cfg.start_of(0x1fff00a8).min && campaign.window_end == 31,
+          "window as rom-timing");
+    
+    Target open_target(rom, flash_with_crp(0xFFFFFFFF));
+    // Without CRP the bne skips 0x1fff00c0 and 0x1fff00c2.
+    FaultCampaign open(open_target, 0x1fff00a8, 0x1fff00be);
+    check(open.golden.watched_value == 0xFFFFFFFF, "no CRP: stored as it is");
+    Target crp1_target(rom, flash_with_crp(CRP1));
+    FaultCampaign crp1(crp1_target, 0x1fff00a8, 0x1fff00c2);
+    check(crp1.golden.watched_value == CRP2, "CRP1: CRP2 stored");
+    
+    // With 2 wait states: beq at 0x1fff00ba runs at cycle 24.
+    Fault fault;
+    fault.kind = Fault::SKIP;
+    fault.cycle = 24;
+    check(outcome(campaign, fault) == SWD_ENABLED, "skip beq: CRP3 stored as it is");
+    fault.cycle = 27;
+    check(outcome(campaign, fault) == CRASH, "skip ldr r4, [pc]: ldr r4, [r4] of CRP3");
+    fault.kind = Fault::FLIP;
+    fault.cycle = 14;
+    fault.reg = 5;
+    fault.mask = 1;
+    check(outcome(campaign, fault) == SWD_ENABLED, "flip r5 after ldr r5, [r5]");
+    fault.kind = Fault::LOAD_SET;
+    fault.cycle = 20;
+    fault.mask = 0;
+    check(outcome(campaign, fault) == SWD_ENABLED, "ldr r4, [r3] loads 0");
+    fault.kind = Fault::LOAD_XOR;
+    fault.cycle = 28;
+    fault.mask = 1;
+    check(outcome(campaign, fault) == CRASH, "ldr r4, [pc] gets 0x1fff011d: unaligned");
+    
+    std::vector<Injection> injections = campaign.single_faults();
+    std::vector<InjectionResult> one = campaign.run_all(injections, 1);
+    std::vector<InjectionResult> four = campaign.run_all(injections, 4);
+    bool same = one.size() == four.size();
+    unsigned enabled = 0;
+    for (size_t n = 0; same && n < one.size(); ++n)
+    {
+      same = one[n].outcome == four[n].outcome && one[n].crp_register == four[n].crp_register;
+      enabled += one[n].outcome == SWD_ENABLED;
+    }
+    check(same, "threads do not change the results");
+    check(injections.size() > 10000 && enabled > 0 && enabled < injections.size() / 2,
+          "some injections enable SWD");
+  }
+  catch (const std::exception & e)
+  {
+    printf("FAIL: %s\n", e.what());
+    ++failures;
+  }
+  
+  printf("%u failures\n", failures);
+  return failures ? 1 : 0;
+}
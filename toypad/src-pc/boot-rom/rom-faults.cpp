@@ -0,0 +1,251 @@
+// Where to aim the glitch: simulated faults at every cycle of the glitch 
+// window of the boot ROM (see fault-campaign.hpp), on the boot ROM of 
+// toypad/bootloader.lst and a flash with CRP3 at 0x2fc.
+// 
+// Prints every (cycle, fault model) that gets the boot ROM to store 
+// anything but CRP2 in the CRP register (a boot with SWD enabled), with 
+// the glitcher ticks of the cycle, and per skip width the cycles it 
+// works at.
+// 
+// Usage: rom-faults [options] [listing or binary]
+// 
+//   listing or binary        (../../bootloader.lst)
+//   --flash <file>           the flash image (default: erased, with
+//                            --crp at 0x2fc)
+//   --crp <value>            (0x43218765, CRP3)
+//   --from <address>         (0x1fff00a8)
+//   --to <address>           (0x1fff00c2)
+//   --flash-wait-states <n>  (2)
+//   --max-skip-width <n>     in cycles (8)
+//   --double                 also every pair of skips and load faults
+//   --threads <n>            (0: one per core)
+//   --window-start-ticks <n> the ticks of the first cycle of the window 
+//                            (2736, see rom-timing)
+//   --csv <file>             write every injection that enabled SWD
+
+#include <chrono>
+#include <getopt.h>
+#include <map>
+#include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "boot-rom.hpp"
+#include "fault-campaign.hpp"
+#include "thumb.hpp"
+
+#define TICKS_PER_CYCLE	4	// 48 MHz glitcher, 12 MHz LPC11U35.
+#define FLASH_SIZE	(32 * 1024)
+#define CRP_ADDRESS	0x2fc
+
+static void usage(const char * program)
+{
+  fprintf(stderr,
+    "Usage: %s [--flash <file>] [--crp <value>] [--from <address>] [--to <address>]\n"
+    "       [--flash-wait-states <n>] [--max-skip-width <n>] [--double]\n"
+    "       [--threads <n>] [--window-start-ticks <n>] [--csv <file>]\n"
+    "       [listing or binary]\n", program);
+  exit(2);
+}
+
+static std::vector<uint8_t> read_file(const std::string & path)
+{
+  FILE * file = fopen(path.c_str(), "rb");
+  if (!file)
+    throw std::runtime_error(path + ": cannot read");
+  std::vector<uint8_t> data;
+  uint8_t buffer[4096];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof buffer, file)) > 0)
+    data.insert(data.end(), buffer, buffer + n);
+  fclose(file);
+  return data;
+}
+
+// The successes and tries of one (cycle, fault model), or of a pair.
+struct Tally
+{
+  unsigned tried = 0;
+  unsigned enabled = 0;
+  uint32_t address = 0;
+};
+
+int main(int argc, char ** argv)
+{
+  std::string input = "../../bootloader.lst";
+  std::string flash_path;
+  uint32_t crp = CRP3;
+  uint32_t from = 0x1fff00a8;
+  uint32_t to = 0x1fff00c2;
+  TimingModel model;
+  unsigned max_skip_width = 8;
+  bool pairs = false;
+  unsigned threads = 0;
+  uint32_t window_start_ticks = 2736;
+  std::string csv;
+  
+  static const option options[] = {
+    {"flash",              required_argument, nullptr, 'F'},
+    {"crp",                required_argument, nullptr, 'c'},
+    {"from",               required_argument, nullptr, 'f'},
+    {"to",                 required_argument, nullptr, 't'},
+    {"flash-wait-states",  required_argument, nullptr, 'w'},
+    {"max-skip-width",     required_argument, nullptr, 's'},
+    {"double",             no_argument,       nullptr, 'd'},
+    {"threads",            required_argument, nullptr, 'j'},
+    {"window-start-ticks", required_argument, nullptr, 'a'},
+    {"csv",                required_argument, nullptr, 'o'},
+    {nullptr,              0,                 nullptr, 0},
+  };
+  int option;
+  while ((option = getopt_long(argc, argv, "", options, nullptr)) != -1)
+  {
+    switch (option)
+    {
+      case 'F': flash_path = optarg; break;
+      case 'c': crp = strtoul(optarg, nullptr, 0); break;
+      case 'f': from = strtoul(optarg, nullptr, 0); break;
+      case 't': to = strtoul(optarg, nullptr, 0); break;
+      case 'w': model.flash_wait_states = strtoul(optarg, nullptr, 0); break;
+      case 's': max_skip_width = strtoul(optarg, nullptr, 0); break;
+      case 'd': pairs = true; break;
+      case 'j': threads = strtoul(optarg, nullptr, 0); break;
+      case 'a': window_start_ticks = strtoul(optarg, nullptr, 0); break;
+      case 'o': csv = optarg; break;
+      default: usage(argv[0]);
+    }
+  }
+  if (optind + 1 < argc)
+    usage(argv[0]);
+  if (optind < argc)
+    input = argv[optind];
+  if (!threads)
+    threads = std::thread::hardware_concurrency();
+  if (!threads)
+    threads = 1;
+  
+  try
+  {
+    BootRom rom;
+    rom.load(input);
+    std::vector<uint8_t> flash;
+    if (flash_path.empty())
+    {
+      flash.assign(FLASH_SIZE, 0xFF);
+      for (unsigned i = 0; i < 4; ++i)
+        flash[CRP_ADDRESS + i] = crp >> (8 * i);
+    }
+    else
+      flash = read_file(flash_path);
+    Target target(rom, flash, model);
+    FaultCampaign campaign(target, from, to);
+    printf("golden run: stores 0x%08x to the CRP register at cycle %llu (%s)\n",
+           campaign.golden.watched_value, (unsigned long long) campaign.golden.cycle,
+           campaign.golden.watched_value == CRP2 ? "protected" : "SWD enabled");
+    printf("window 0x%08x..0x%08x: cycles %u..%u\n", from, to,
+           campaign.window_start, campaign.window_end - 1);
+    
+    std::vector<Injection> injections = campaign.single_faults(max_skip_width);
+    if (pairs)
+    {
+      std::vector<Injection> more = campaign.double_faults();
+      injections.insert(injections.end(), more.begin(), more.end());
+    }
+    auto start = std::chrono::steady_clock::now();
+    std::vector<InjectionResult> results = campaign.run_all(injections, threads);
+    double seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+    printf("%zu injections in %.2f s on %u threads (%.0f per second)\n",
+           injections.size(), seconds, threads, injections.size() / seconds);
+    
+    unsigned outcomes[CRASH + 1] = {};
+    // Per cycle and model (and the second ones), in the order of cycles.
+    std::map<std::pair<uint32_t, std::string>, Tally> tallies;
+    std::map<unsigned, std::map<uint32_t, bool>> skip_cycles;	// Width: cycle: enabled.
+    auto ticks = [&campaign, window_start_ticks](uint32_t cycle)
+    {
+      return window_start_ticks + (cycle - campaign.window_start) * TICKS_PER_CYCLE;
+    };
+    FILE * out = nullptr;
+    if (!csv.empty())
+    {
+      out = fopen(csv.c_str(), "w");
+      if (!out)
+        throw std::runtime_error(csv + ": cannot write");
+      fprintf(out, "cycle,ticks,address,fault,cycle2,fault2,crp_register\n");
+    }
+    for (size_t n = 0; n < injections.size(); ++n)
+    {
+      const Injection & injection = injections[n];
+      const InjectionResult & result = results[n];
+      ++outcomes[result.outcome];
+      bool enabled = result.outcome == SWD_ENABLED;
+      
+      const Fault & fault = injection.faults[0];
+      std::string models = fault.model();
+      if (injection.count == 2)
+        models += " + " + std::to_string(injection.faults[1].cycle) + " "
+                + injection.faults[1].model();
+      Tally & tally = tallies[{fault.cycle, models}];
+      ++tally.tried;
+      tally.enabled += enabled;
+      tally.address = result.address;
+      if (injection.count == 1 && fault.kind == Fault::SKIP)
+        skip_cycles[fault.width][fault.cycle] = enabled;
+      
+      if (out && enabled)
+      {
+        fprintf(out, "%u,%u,0x%08x,%s,", fault.cycle, ticks(fault.cycle), result.address,
+                fault.describe().c_str());
+        if (injection.count == 2)
+          fprintf(out, "%u,%s,", injection.faults[1].cycle, injection.faults[1].describe().c_str());
+        else
+          fprintf(out, ",,");
+        fprintf(out, "0x%08x\n", result.crp_register);
+      }
+    }
+    if (out)
+      fclose(out);
+    
+    for (unsigned outcome = PROTECTED; outcome <= CRASH; ++outcome)
+      printf("  %-12s %u\n", outcome_name((Outcome) outcome), outcomes[outcome]);
+    
+    printf("\n%6s  %-6s  %-10s  %-22s  %-20s  %s\n", "cycle", "ticks", "address",
+           "instruction", "fault", "SWD enabled");
+    for (const auto & entry : tallies)
+    {
+      const Tally & tally = entry.second;
+      if (!tally.enabled)
+        continue;
+      uint32_t cycle = entry.first.first;
+      std::string instruction = "?";
+      if (rom.contains(tally.address, 2))
+        instruction = thumb::disassemble(target.decoded[(tally.address - rom.base) / 2]);
+      printf("%6u  %-6u  0x%08x  %-22s  %-20s  %u of %u\n", cycle, ticks(cycle), tally.address,
+             instruction.c_str(), entry.first.second.c_str(), tally.enabled, tally.tried);
+    }
+    
+    printf("\nskip width  cycles that enable SWD\n");
+    for (const auto & width : skip_cycles)
+    {
+      std::string list;
+      unsigned count = 0;
+      for (const auto & cycle : width.second)
+        if (cycle.second)
+        {
+          list += " " + std::to_string(cycle.first);
+          ++count;
+        }
+      printf("%10u  %u of %zu:%s\n", width.first, count, width.second.size(), list.c_str());
+    }
+  }
+  catch (const std::exception & e)
+  {
+    fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+  return 0;
+}
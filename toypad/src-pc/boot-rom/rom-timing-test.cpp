@@ -0,0 +1,141 @@
+// Checks the boot ROM tools against toypad/bootloader.lst: the parse and 
+// the binary form (boot-rom.cpp), the decoder against the disassembly of 
+// gdb (thumb.cpp), and the graph and its cycles (cfg.cpp) against the 
+// "Time: a+b" notes of the reset code.
+// 
+// Usage: rom-timing-test [listing] (../../bootloader.lst)
+
+#include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+
+#include "../controller/test-check.hpp"
+#include "boot-rom.hpp"
+#include "cfg.hpp"
+#include "thumb.hpp"
+
+// gdb's text without its "@" comment and with single spaces.
+static std::string gdb_text(const std::string & disassembly)
+{
+  std::string text = disassembly.substr(0, disassembly.find(" @"));
+  while (!text.empty() && text.back() == ' ')
+    text.pop_back();
+  return text;
+}
+
+int main(int argc, char ** argv)
+{
+  std::string listing = argc > 1 ? argv[1] : "../../bootloader.lst";
+  try
+  {
+    BootRom rom;
+    rom.load(listing);
+    check(rom.reset_vector() == 0x1fff00a1, "reset vector");
+    check(rom.listed(0x1fff00a8) && rom.read16(0x1fff00a8) == 0x4a1a, "halfword at 0x1fff00a8");
+    const BootRom::Line * line = rom.line(0x1fff00b6);
+    check(line && line->disassembly == "ldr r4, [r3, #0]"
+          && line->note.find("Time: 19+2") != std::string::npos, "line of 0x1fff00b6");
+    
+    char path[] = "/tmp/rom-timing-test-XXXXXX";
+    int fd = mkstemp(path);
+    close(fd);
+    rom.save(path);
+    BootRom copy;
+    copy.load(path);
+    unlink(path);
+    bool same = copy.base == rom.base && copy.image == rom.image && copy.flags == rom.flags
+             && copy.lines.size() == rom.lines.size();
+    for (size_t i = 0; same && i < rom.lines.size(); ++i)
+      same = copy.lines[i].address == rom.lines[i].address
+          && copy.lines[i].disassembly == rom.lines[i].disassembly
+          && copy.lines[i].note == rom.lines[i].note;
+    check(same, "binary form round trip");
+    
+    // The decoder says what gdb says, but for the data gdb took for 
+    // instructions of other architectures.
+    unsigned decoded = 0, mismatches = 0;
+    for (const BootRom::Line & l : rom.lines)
+    {
+      uint16_t first = rom.read16(l.address);
+      uint16_t second = rom.listed(l.address + 2) ? rom.read16(l.address + 2) : 0;
+      thumb::Instruction i = thumb::decode(l.address, first, second);
+      if (i.op == thumb::UNDEFINED || l.disassembly.find("UNDEFINED") != std::string::npos)
+        continue;
+      ++decoded;
+      std::string expected = gdb_text(l.disassembly);
+      for (char & c : expected)
+        if (c == '\t')
+          c = ' ';
+      if (thumb::disassemble(i) != expected)
+      {
+        if (mismatches++ < 5)
+          printf("  0x%08x: %s, gdb: %s\n", l.address, thumb::disassemble(i).c_str(), expected.c_str());
+      }
+    }
+    check(decoded > 1000 && mismatches == 0, "decoder against gdb");
+    
+    TimingModel no_waits;
+    no_waits.flash_wait_states = 0;
+    ControlFlowGraph cfg(rom, rom.reset_vector(), no_waits);
+    const ControlFlowGraph::Block * reset = cfg.block_at(0x1fff00a2);
+    check(reset && reset->successors.size() == 1 && reset->successors[0].target == 0x1fff00a8
+          && reset->successors[0].kind == ControlFlowGraph::JUMP, "bx r2 to 0x1fff00a8");
+    const ControlFlowGraph::Block * to_main = cfg.block_at(0x1fff00ea);
+    check(to_main && to_main->successors.size() == 1 && to_main->successors[0].target == 0x1fff0470,
+          "bx r2 to main at 0x1fff0470");
+    check(cfg.instruction_at(0x1fff0470) != nullptr, "main explored");
+    
+    // "Time: a+b": starts at cycle a, takes b (without wait states); "or" 
+    // gives the cycles of a taken branch.
+    unsigned annotated = 0;
+    bool times = true;
+    for (uint32_t address = 0x1fff00a0; address <= 0x1fff00c4; address += 2)
+    {
+      const BootRom::Line * l = rom.line(address);
+      size_t at = l ? l->note.find("Time: ") : std::string::npos;
+      if (at == std::string::npos)
+        continue;
+      unsigned start, cost, taken;
+      int n = sscanf(l->note.c_str() + at, "Time: %u+%u or %*u+%u", &start, &cost, &taken);
+      CycleRange when = cfg.start_of(address);
+      CycleRange expected_cost{cost, n == 3 ? taken : cost};
+      CycleRange got = cfg.cost_at(address);
+      ++annotated;
+      // A lone cost of a conditional branch is the one of its path.
+      bool cost_ok = n == 3 ? got.min == expected_cost.min && got.max == expected_cost.max
+                            : got.min == cost || got.max == cost;
+      if (when.min > start || when.max < start || !cost_ok)
+      {
+        times = false;
+        printf("  0x%08x: %u..%u +%u..%u, note: %u+%u\n", address, when.min, when.max,
+               got.min, got.max, start, cost);
+      }
+    }
+    check(annotated == 17 && times, "every Time note without wait states");
+    CycleRange window = cfg.start_of(0x1fff00c2) + cfg.cost_at(0x1fff00c2);
+    check(window.min == 29 && window.max == 29 && cfg.start_of(0x1fff00a8).min == 5,
+          "window of 24 cycles without wait states");
+    
+    // The CRP is read from the flash: that one load has the wait states.
+    ControlFlowGraph waits(rom, rom.reset_vector());
+    check(waits.cost_at(0x1fff00b6).min == 4 && waits.cost_at(0x1fff00b6).max == 4,
+          "ldr r4, [r3] of the flash: 2 wait states");
+    check(waits.cost_at(0x1fff00ac).max == 2, "ldr r3, [r3] of the boot ROM: none");
+    check(waits.start_of(0x1fff00c0).min == 27 && waits.start_of(0x1fff00c0).max == 27,
+          "both paths to 0x1fff00c0");
+    window = waits.start_of(0x1fff00c2) + waits.cost_at(0x1fff00c2);
+    check(window.min == 31 && window.max == 31, "window of 26 cycles with wait states");
+    check(!waits.duration(rom.reset_vector()).bounded(), "the loops of main: no upper bound");
+  }
+  catch (const std::exception & e)
+  {
+    printf("FAIL: %s\n", e.what());
+    ++failures;
+  }
+  
+  printf("%u failures\n", failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,230 @@
+// When does the boot ROM of the LPC11U35 execute the instructions of the 
+// glitch window? Statically, from toypad/bootloader.lst: the control 
+// flow graph from the reset vector (see cfg.hpp), every instruction with 
+// its cycles at 12 MHz (the IRC) and the wait states of the flash, and 
+// for every instruction of the window the cycles after the reset vector 
+// at which it may start and end.
+// 
+// The glitcher counts in 48 MHz ticks (4 per cycle) from the end of the 
+// reset pulse, and the boot ROM starts some time after that. So the 
+// ticks are anchored: the first instruction of the window starts at
+// --window-start-ticks (default 2736, the 57 us measured in the README), 
+// or at delay_min..delay_max of the boot-timing.json of 
+// calibrate-boot.py.
+// 
+// Usage: rom-timing [options] [listing or binary]
+// 
+//   listing or binary        bootloader.lst, or what --save wrote 
+//                            (../../bootloader.lst)
+//   --save <file>            write the indexed binary form of the 
+//                            listing
+//   --from <address>         the first instruction of the window 
+//                            (0x1fff00a8)
+//   --to <address>           the last instruction of the window 
+//                            (0x1fff00c2)
+//   --flash-wait-states <n>  per data access to the flash (2)
+//   --window-start-ticks <min>[:<max>]
+//   --boot-timing <file>     take the ticks from boot-timing.json
+//   --cfg                    print every block of the graph
+//   --dot <file>             write the graph for graphviz
+
+#include <getopt.h>
+#include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#include "boot-rom.hpp"
+#include "cfg.hpp"
+#include "thumb.hpp"
+
+#define TICKS_PER_CYCLE	4	// 48 MHz glitcher, 12 MHz LPC11U35.
+
+static void usage(const char * program)
+{
+  fprintf(stderr,
+    "Usage: %s [--save <file>] [--from <address>] [--to <address>]\n"
+    "       [--flash-wait-states <n>] [--window-start-ticks <min>[:<max>]]\n"
+    "       [--boot-timing <file>] [--cfg] [--dot <file>] [listing or binary]\n", program);
+  exit(2);
+}
+
+// A number of the flat JSON of calibrate-boot.py.
+static uint32_t json_number(const std::string & path, const std::string & key)
+{
+  FILE * file = fopen(path.c_str(), "r");
+  if (!file)
+    throw std::runtime_error(path + ": cannot read");
+  std::string text;
+  char buffer[4096];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof buffer, file)) > 0)
+    text.append(buffer, n);
+  fclose(file);
+  
+  size_t at = text.find("\"" + key + "\"");
+  if (at == std::string::npos)
+    throw std::runtime_error(path + ": no " + key);
+  at = text.find(':', at);
+  if (at == std::string::npos)
+    throw std::runtime_error(path + ": bad " + key);
+  return strtoul(text.c_str() + at + 1, nullptr, 10);
+}
+
+static std::string range_text(const CycleRange & range, unsigned width)
+{
+  char text[32];
+  if (!range.bounded())
+    snprintf(text, sizeof text, "%u..", range.min);
+  else if (range.min == range.max)
+    snprintf(text, sizeof text, "%u", range.min);
+  else
+    snprintf(text, sizeof text, "%u..%u", range.min, range.max);
+  return std::string(text) + std::string(strlen(text) < width ? width - strlen(text) : 0, ' ');
+}
+
+int main(int argc, char ** argv)
+{
+  std::string input = "../../bootloader.lst";
+  std::string save;
+  uint32_t from = 0x1fff00a8;
+  uint32_t to = 0x1fff00c2;
+  TimingModel model;
+  CycleRange anchor{2736, 2736};
+  std::string boot_timing;
+  bool print_cfg = false;
+  std::string dot;
+  
+  static const option options[] = {
+    {"save",               required_argument, nullptr, 's'},
+    {"from",               required_argument, nullptr, 'f'},
+    {"to",                 required_argument, nullptr, 't'},
+    {"flash-wait-states",  required_argument, nullptr, 'w'},
+    {"window-start-ticks", required_argument, nullptr, 'a'},
+    {"boot-timing",        required_argument, nullptr, 'b'},
+    {"cfg",                no_argument,       nullptr, 'c'},
+    {"dot",                required_argument, nullptr, 'd'},
+    {nullptr,              0,                 nullptr, 0},
+  };
+  int option;
+  while ((option = getopt_long(argc, argv, "", options, nullptr)) != -1)
+  {
+    switch (option)
+    {
+      case 's': save = optarg; break;
+      case 'f': from = strtoul(optarg, nullptr, 0); break;
+      case 't': to = strtoul(optarg, nullptr, 0); break;
+      case 'w': model.flash_wait_states = strtoul(optarg, nullptr, 0); break;
+      case 'a':
+      {
+        char * end;
+        anchor.min = anchor.max = strtoul(optarg, &end, 0);
+        if (*end == ':')
+          anchor.max = strtoul(end + 1, nullptr, 0);
+        break;
+      }
+      case 'b': boot_timing = optarg; break;
+      case 'c': print_cfg = true; break;
+      case 'd': dot = optarg; break;
+      default: usage(argv[0]);
+    }
+  }
+  if (optind + 1 < argc)
+    usage(argv[0]);
+  if (optind < argc)
+    input = argv[optind];
+  
+  try
+  {
+    if (!boot_timing.empty())
+    {
+      anchor.min = json_number(boot_timing, "delay_min");
+      anchor.max = json_number(boot_timing, "delay_max");
+    }
+    BootRom rom;
+    rom.load(input);
+    if (!save.empty())
+      rom.save(save);
+    
+    ControlFlowGraph cfg(rom, rom.reset_vector(), model);
+    printf("reset vector 0x%08x, %zu blocks, %zu functions, %u flash wait states\n",
+           rom.reset_vector(), cfg.blocks().size(), cfg.functions().size(),
+           model.flash_wait_states);
+    if (print_cfg)
+    {
+      for (const auto & entry : cfg.blocks())
+      {
+        const ControlFlowGraph::Block & block = entry.second;
+        printf("\nblock 0x%08x..0x%08x%s%s%s\n", block.start, block.end,
+               cfg.functions().count(block.start) ? " (function)" : "",
+               block.returns ? " (returns)" : "",
+               block.unresolved ? " (unresolved)" : "");
+        for (size_t n = 0; n < block.instructions.size(); ++n)
+          printf("  0x%08x  %s  %s\n", block.instructions[n].address,
+                 range_text(block.costs[n], 6).c_str(),
+                 thumb::disassemble(block.instructions[n]).c_str());
+        for (const ControlFlowGraph::Edge & edge : block.successors)
+          printf("  -> 0x%08x\n", edge.target);
+        if (block.callee)
+          printf("  calls 0x%08x\n", block.callee);
+      }
+      printf("\n");
+    }
+    if (!dot.empty())
+      cfg.write_dot(dot);
+    
+    // Ticks after the end of the reset, with the first instruction of 
+    // the window at the anchor. It is on every path, so the offset of 
+    // the others against it is exact per bound.
+    CycleRange first = cfg.start_of(from);
+    auto ticks = [&first, &anchor](const CycleRange & cycles)
+    {
+      CycleRange t{anchor.min + (cycles.min - first.min) * TICKS_PER_CYCLE, CYCLES_UNBOUNDED};
+      if (cycles.bounded() && first.bounded())
+        t.max = anchor.max + (cycles.max - first.max) * TICKS_PER_CYCLE;
+      return t;
+    };
+    
+    printf("%-10s  %-6s  %-10s  %-10s  %-12s  %-12s  %s\n", "address", "cycles",
+           "start", "end", "start ticks", "end ticks", "instruction");
+    CycleRange window_end;
+    for (uint32_t address = from; address <= to; )
+    {
+      const thumb::Instruction * i = cfg.instruction_at(address);
+      if (!i)
+      {
+        char text[64];
+        snprintf(text, sizeof text, "0x%08x: not reached from the reset vector", address);
+        throw std::runtime_error(text);
+      }
+      CycleRange start = cfg.start_of(address);
+      CycleRange end = start + cfg.cost_at(address);
+      window_end = end;
+      const BootRom::Line * line = rom.line(address);
+      printf("0x%08x  %s  %s  %s  %s  %s  %-24s %s\n", address,
+             range_text(cfg.cost_at(address), 6).c_str(),
+             range_text(start, 10).c_str(), range_text(end, 10).c_str(),
+             range_text(ticks(start), 12).c_str(), range_text(ticks(end), 12).c_str(),
+             thumb::disassemble(*i).c_str(), line ? line->note.c_str() : "");
+      address += i->size;
+    }
+    
+    CycleRange length{window_end.min - first.max, window_end.max - first.min};
+    if (!window_end.bounded() || !first.bounded())
+      length.max = CYCLES_UNBOUNDED;
+    CycleRange sweep{ticks(first).min, ticks(window_end).max};
+    printf("\nwindow 0x%08x..0x%08x: %s cycles after the reset vector, "
+           "%s cycles long\n", from, to,
+           range_text(CycleRange{first.min, window_end.max}, 0).c_str(),
+           range_text(length, 0).c_str());
+    printf("suggested G sweep: %s ticks after the end of the reset\n",
+           range_text(sweep, 0).c_str());
+  }
+  catch (const std::exception & e)
+  {
+    fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+  return 0;
+}
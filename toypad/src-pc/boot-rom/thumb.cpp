@@ -0,0 +1,457 @@
+#include <stdio.h>
+
+#include "thumb.hpp"
+
+namespace thumb
+{
+
+static uint32_t bits(uint32_t value, unsigned high, unsigned low)
+{
+  return (value >> low) & ((1u << (high - low + 1)) - 1);
+}
+
+static uint32_t sign_extend(uint32_t value, unsigned width)
+{
+  uint32_t sign = 1u << (width - 1);
+  return (value ^ sign) - sign;
+}
+
+static unsigned count(uint16_t registers)
+{
+  unsigned n = 0;
+  for (; registers; registers &= registers - 1)
+    ++n;
+  return n;
+}
+
+static Instruction decode_32bit(Instruction i, uint16_t first, uint16_t second)
+{
+  i.size = 4;
+  if ((first & 0xF800) == 0xF000 && (second & 0xD000) == 0xD000)
+  {
+    uint32_t s = bits(first, 10, 10);
+    uint32_t i1 = !(bits(second, 13, 13) ^ s);
+    uint32_t i2 = !(bits(second, 11, 11) ^ s);
+    uint32_t offset = s << 24 | i1 << 23 | i2 << 22
+                    | bits(first, 9, 0) << 12 | bits(second, 10, 0) << 1;
+    i.op = BL;
+    i.target = i.address + 4 + sign_extend(offset, 25);
+  }
+  else if ((first & 0xFFF0) == 0xF380 && (second & 0xFF00) == 0x8800)
+  {
+    i.op = MSR;
+    i.rn = bits(first, 3, 0);
+    i.imm = bits(second, 7, 0);
+  }
+  else if (first == 0xF3EF && (second & 0xF000) == 0x8000)
+  {
+    i.op = MRS;
+    i.rd = bits(second, 11, 8);
+    i.imm = bits(second, 7, 0);
+  }
+  else if (first == 0xF3BF && (second & 0xFFF0) == 0x8F40)
+    i.op = DSB;
+  else if (first == 0xF3BF && (second & 0xFFF0) == 0x8F50)
+    i.op = DMB;
+  else if (first == 0xF3BF && (second & 0xFFF0) == 0x8F60)
+    i.op = ISB;
+  return i;
+}
+
+Instruction decode(uint32_t address, uint16_t first, uint16_t second)
+{
+  Instruction i;
+  i.address = address;
+  if (is_32bit(first))
+    return decode_32bit(i, first, second);
+  
+  uint32_t pc = address + 4;
+  uint16_t h = first;
+  unsigned lo0 = bits(h, 2, 0), lo3 = bits(h, 5, 3), lo6 = bits(h, 8, 6), lo8 = bits(h, 10, 8);
+  switch (bits(h, 15, 11))
+  {
+    case 0x00: case 0x01: case 0x02:
+    {
+      static const Op ops[] = {LSLS_IMM, LSRS_IMM, ASRS_IMM};
+      i.op = ops[bits(h, 12, 11)];
+      i.rd = lo0;
+      i.rm = lo3;
+      i.imm = bits(h, 10, 6);
+      // LSR and ASR: 0 means 32.
+      if (i.op != LSLS_IMM && i.imm == 0)
+        i.imm = 32;
+      break;
+    }
+    case 0x03:
+    {
+      static const Op ops[] = {ADDS_REG, SUBS_REG, ADDS_IMM3, SUBS_IMM3};
+      i.op = ops[bits(h, 10, 9)];
+      i.rd = lo0;
+      i.rn = lo3;
+      i.rm = lo6;
+      i.imm = lo6;
+      break;
+    }
+    case 0x04: case 0x05: case 0x06: case 0x07:
+    {
+      static const Op ops[] = {MOVS_IMM, CMP_IMM, ADDS_IMM8, SUBS_IMM8};
+      i.op = ops[bits(h, 12, 11)];
+      i.rd = i.rn = lo8;
+      i.imm = bits(h, 7, 0);
+      break;
+    }
+    case 0x08:
+      if (bits(h, 10, 10) == 0)
+      {
+        static const Op ops[] =
+        {
+          ANDS, EORS, LSLS_REG, LSRS_REG, ASRS_REG, ADCS, SBCS, RORS,
+          TST, RSBS, CMP_REG, CMN, ORRS, MULS, BICS, MVNS,
+        };
+        i.op = ops[bits(h, 9, 6)];
+        i.rd = i.rn = lo0;
+        i.rm = lo3;
+      }
+      else
+      {
+        static const Op ops[] = {ADD_HI, CMP_HI, MOV_HI, BX};
+        i.op = ops[bits(h, 9, 8)];
+        i.rd = i.rn = bits(h, 7, 7) << 3 | lo0;
+        i.rm = bits(h, 6, 3);
+        if (i.op == BX)
+        {
+          if (bits(h, 7, 7))
+            i.op = BLX;
+          if (lo0)
+            i.op = UNDEFINED;
+        }
+      }
+      break;
+    case 0x09:
+      i.op = LDR_LIT;
+      i.rd = lo8;
+      i.imm = bits(h, 7, 0) * 4;
+      i.target = (pc & ~3u) + i.imm;
+      break;
+    case 0x0A: case 0x0B:
+    {
+      static const Op ops[] =
+      {
+        STR_REG, STRH_REG, STRB_REG, LDRSB_REG, LDR_REG, LDRH_REG, LDRB_REG, LDRSH_REG,
+      };
+      i.op = ops[bits(h, 11, 9)];
+      i.rd = lo0;
+      i.rn = lo3;
+      i.rm = lo6;
+      break;
+    }
+    case 0x0C: case 0x0D: case 0x0E: case 0x0F: case 0x10: case 0x11:
+    {
+      static const Op ops[] = {STR_IMM, LDR_IMM, STRB_IMM, LDRB_IMM, STRH_IMM, LDRH_IMM};
+      static const unsigned scale[] = {4, 4, 1, 1, 2, 2};
+      unsigned n = bits(h, 15, 11) - 0x0C;
+      i.op = ops[n];
+      i.rd = lo0;
+      i.rn = lo3;
+      i.imm = bits(h, 10, 6) * scale[n];
+      break;
+    }
+    case 0x12: case 0x13:
+      i.op = bits(h, 11, 11) ? LDR_SP : STR_SP;
+      i.rd = lo8;
+      i.rn = 13;
+      i.imm = bits(h, 7, 0) * 4;
+      break;
+    case 0x14:
+      i.op = ADR;
+      i.rd = lo8;
+      i.imm = bits(h, 7, 0) * 4;
+      i.target = (pc & ~3u) + i.imm;
+      break;
+    case 0x15:
+      i.op = ADD_SP_IMM;
+      i.rd = lo8;
+      i.rn = 13;
+      i.imm = bits(h, 7, 0) * 4;
+      break;
+    case 0x16: case 0x17:
+      if ((h & 0xFF00) == 0xB000)
+      {
+        i.op = bits(h, 7, 7) ? SUB_SP : ADD_SP;
+        i.imm = bits(h, 6, 0) * 4;
+      }
+      else if ((h & 0xFF00) == 0xB200)
+      {
+        static const Op ops[] = {SXTH, SXTB, UXTH, UXTB};
+        i.op = ops[bits(h, 7, 6)];
+        i.rd = lo0;
+        i.rm = lo3;
+      }
+      else if ((h & 0xFE00) == 0xB400)
+      {
+        i.op = PUSH;
+        i.registers = bits(h, 7, 0) | bits(h, 8, 8) << 14;
+      }
+      else if ((h & 0xFFEF) == 0xB662)
+        i.op = bits(h, 4, 4) ? CPSID : CPSIE;
+      else if ((h & 0xFF00) == 0xBA00 && bits(h, 7, 6) != 2)
+      {
+        static const Op ops[] = {REV, REV16, UNDEFINED, REVSH};
+        i.op = ops[bits(h, 7, 6)];
+        i.rd = lo0;
+        i.rm = lo3;
+      }
+      else if ((h & 0xFE00) == 0xBC00)
+      {
+        i.op = POP;
+        i.registers = bits(h, 7, 0) | bits(h, 8, 8) << 15;
+      }
+      else if ((h & 0xFF00) == 0xBE00)
+      {
+        i.op = BKPT;
+        i.imm = bits(h, 7, 0);
+      }
+      else if ((h & 0xFF0F) == 0xBF00 && bits(h, 7, 4) <= 4)
+      {
+        static const Op ops[] = {NOP, YIELD, WFE, WFI, SEV};
+        i.op = ops[bits(h, 7, 4)];
+      }
+      break;
+    case 0x18: case 0x19:
+      i.op = bits(h, 11, 11) ? LDM : STM;
+      i.rn = lo8;
+      i.registers = bits(h, 7, 0);
+      break;
+    case 0x1A: case 0x1B:
+      i.cond = bits(h, 11, 8);
+      if (i.cond == 0xE)
+      {
+        i.op = UDF;
+        i.imm = bits(h, 7, 0);
+      }
+      else if (i.cond == 0xF)
+      {
+        i.op = SVC;
+        i.imm = bits(h, 7, 0);
+      }
+      else
+      {
+        i.op = B_COND;
+        i.target = pc + sign_extend(bits(h, 7, 0) << 1, 9);
+      }
+      break;
+    case 0x1C:
+      i.op = B;
+      i.target = pc + sign_extend(bits(h, 10, 0) << 1, 12);
+      break;
+  }
+  return i;
+}
+
+const char * op_name(Op op)
+{
+  static const char * const names[] =
+  {
+    "undefined",
+    "lsls", "lsrs", "asrs",
+    "adds", "subs",
+    "adds", "subs",
+    "movs", "cmp", "adds", "subs",
+    "ands", "eors", "lsls", "lsrs", "asrs", "adcs", "sbcs", "rors",
+    "tst", "rsbs", "cmp", "cmn", "orrs", "muls", "bics", "mvns",
+    "add", "cmp", "mov", "bx", "blx",
+    "ldr",
+    "str", "strh", "strb", "ldrsb", "ldr", "ldrh", "ldrb", "ldrsh",
+    "str", "ldr", "strb", "ldrb", "strh", "ldrh",
+    "str", "ldr",
+    "adr", "add",
+    "add", "sub",
+    "sxth", "sxtb", "uxth", "uxtb", "rev", "rev16", "revsh",
+    "push", "pop",
+    "stmia", "ldmia",
+    "cpsie", "cpsid",
+    "bkpt", "nop", "yield", "wfe", "wfi", "sev",
+    "b",
+    "b", "bl",
+    "svc", "udf",
+    "msr", "mrs",
+    "dsb", "dmb", "isb",
+  };
+  return names[op];
+}
+
+static std::string reg(unsigned r)
+{
+  static const char * const names[] =
+  {
+    "r0", "r1", "r2", "r3", "r4", "r5", "r6", "r7",
+    "r8", "r9", "r10", "r11", "r12", "sp", "lr", "pc",
+  };
+  return names[r & 15];
+}
+
+static std::string register_list(uint16_t registers)
+{
+  std::string text = "{";
+  for (unsigned r = 0; r < 16; ++r)
+    if (registers & (1 << r))
+      text += (text.size() > 1 ? ", " : "") + reg(r);
+  return text + "}";
+}
+
+std::string disassemble(const Instruction & i)
+{
+  static const char * const conditions[] =
+  {
+    "eq", "ne", "cs", "cc", "mi", "pl", "vs", "vc", "hi", "ls", "ge", "lt", "gt", "le",
+  };
+  char text[64];
+  std::string name = op_name(i.op);
+  std::string rd = reg(i.rd), rn = reg(i.rn), rm = reg(i.rm);
+  // The aliases gdb prints.
+  if (i.op == LSLS_IMM && i.imm == 0)
+    return "movs " + rd + ", " + rm;
+  if (i.op == RSBS)
+    return "negs " + rd + ", " + rm;
+  if (i.op == MOV_HI && i.rd == 8 && i.rm == 8)
+    return "nop";
+  switch (i.op)
+  {
+    case LSLS_IMM: case LSRS_IMM: case ASRS_IMM:
+    case ADDS_IMM3: case SUBS_IMM3:
+      snprintf(text, sizeof text, "%s %s, %s, #%u", name.c_str(), rd.c_str(),
+               (i.op == ADDS_IMM3 || i.op == SUBS_IMM3 ? rn : rm).c_str(), i.imm);
+      break;
+    case ADDS_REG: case SUBS_REG:
+      snprintf(text, sizeof text, "%s %s, %s, %s", name.c_str(), rd.c_str(), rn.c_str(), rm.c_str());
+      break;
+    case MOVS_IMM: case CMP_IMM: case ADDS_IMM8: case SUBS_IMM8:
+      snprintf(text, sizeof text, "%s %s, #%u", name.c_str(), rd.c_str(), i.imm);
+      break;
+    case LDR_LIT:
+      snprintf(text, sizeof text, "ldr %s, [pc, #%u]", rd.c_str(), i.imm);
+      break;
+    case STR_REG: case STRH_REG: case STRB_REG: case LDRSB_REG:
+    case LDR_REG: case LDRH_REG: case LDRB_REG: case LDRSH_REG:
+      snprintf(text, sizeof text, "%s %s, [%s, %s]", name.c_str(), rd.c_str(), rn.c_str(), rm.c_str());
+      break;
+    case STR_IMM: case LDR_IMM: case STRB_IMM: case LDRB_IMM: case STRH_IMM: case LDRH_IMM:
+    case STR_SP: case LDR_SP:
+      snprintf(text, sizeof text, "%s %s, [%s, #%u]", name.c_str(), rd.c_str(), rn.c_str(), i.imm);
+      break;
+    case ADR:
+      snprintf(text, sizeof text, "add %s, pc, #%u", rd.c_str(), i.imm);
+      break;
+    case ADD_SP_IMM:
+      snprintf(text, sizeof text, "add %s, sp, #%u", rd.c_str(), i.imm);
+      break;
+    case ADD_SP: case SUB_SP:
+      snprintf(text, sizeof text, "%s sp, #%u", name.c_str(), i.imm);
+      break;
+    case PUSH: case POP:
+      return name + " " + register_list(i.registers);
+    case STM: case LDM:
+      // No write back for a LDM that loads its base register.
+      if (i.op == LDM && (i.registers & (1 << i.rn)))
+        return name + " " + rn + ", " + register_list(i.registers);
+      return name + " " + rn + "!, " + register_list(i.registers);
+    case CPSIE: case CPSID:
+      return name + " i";
+    case BKPT: case SVC: case UDF:
+      snprintf(text, sizeof text, "%s %u", name.c_str(), i.imm);
+      break;
+    case B_COND:
+      snprintf(text, sizeof text, "b%s.n 0x%08x", conditions[i.cond], i.target);
+      break;
+    case B:
+      snprintf(text, sizeof text, "b.n 0x%08x", i.target);
+      break;
+    case BL:
+      snprintf(text, sizeof text, "bl 0x%08x", i.target);
+      break;
+    case BX: case BLX:
+      return name + " " + rm;
+    case MSR:
+      snprintf(text, sizeof text, "msr %u, %s", i.imm, rn.c_str());
+      break;
+    case MRS:
+      snprintf(text, sizeof text, "mrs %s, %u", rd.c_str(), i.imm);
+      break;
+    case NOP: case YIELD: case WFE: case WFI: case SEV:
+    case DSB: case DMB: case ISB: case UNDEFINED:
+      return name;
+    default:
+      // Data processing and the other two register forms.
+      return name + " " + rd + ", " + rm;
+  }
+  return text;
+}
+
+unsigned cycles(const Instruction & i, bool taken)
+{
+  switch (i.op)
+  {
+    case ADD_HI: case MOV_HI:
+      return i.rd == 15 ? 3 : 1;
+    case LDR_LIT:
+    case STR_REG: case STRH_REG: case STRB_REG: case LDRSB_REG:
+    case LDR_REG: case LDRH_REG: case LDRB_REG: case LDRSH_REG:
+    case STR_IMM: case LDR_IMM: case STRB_IMM: case LDRB_IMM: case STRH_IMM: case LDRH_IMM:
+    case STR_SP: case LDR_SP:
+      return 2;
+    case STM: case LDM: case PUSH:
+      return 1 + count(i.registers);
+    case POP:
+      // N: the registers besides the pc.
+      if (i.registers & (1 << 15))
+        return 4 + count(i.registers & 0xFF);
+      return 1 + count(i.registers);
+    case B_COND:
+      return taken ? 3 : 1;
+    case B: case BX: case BLX:
+      return 3;
+    case BL:
+      return 4;
+    case WFE: case WFI:
+      return 2;
+    case MSR: case MRS: case DSB: case DMB: case ISB:
+      return 4;
+    default:
+      return 1;
+  }
+}
+
+bool ends_block(const Instruction & i)
+{
+  switch (i.op)
+  {
+    case B_COND: case B: case BL: case BX: case BLX:
+    case SVC: case UDF: case BKPT: case UNDEFINED:
+      return true;
+    case ADD_HI: case MOV_HI:
+      return i.rd == 15;
+    case POP:
+      return i.registers & (1 << 15);
+    default:
+      return false;
+  }
+}
+
+unsigned data_accesses(const Instruction & i)
+{
+  switch (i.op)
+  {
+    case LDR_LIT:
+    case STR_REG: case STRH_REG: case STRB_REG: case LDRSB_REG:
+    case LDR_REG: case LDRH_REG: case LDRB_REG: case LDRSH_REG:
+    case STR_IMM: case LDR_IMM: case STRB_IMM: case LDRB_IMM: case STRH_IMM: case LDRH_IMM:
+    case STR_SP: case LDR_SP:
+      return 1;
+    case STM: case LDM: case PUSH: case POP:
+      return count(i.registers);
+    default:
+      return 0;
+  }
+}
+
+}
@@ -0,0 +1,93 @@
+#ifndef _THUMB_HPP_
+#define _THUMB_HPP_
+
+#include <stdint.h>
+#include <string>
+
+// The instruction set of the Cortex-M0 (ARMv6-M): all 16 bit Thumb 
+// instructions, plus the 32 bit BL, MSR, MRS, DSB, DMB and ISB.
+// 
+// decode() takes the first halfword and (for 32 bit instructions) the 
+// second one; everything it does not know is UNDEFINED, like the core.
+namespace thumb
+{
+
+enum Op
+{
+  UNDEFINED,
+  // Shift (immediate), add, subtract, move and compare.
+  LSLS_IMM, LSRS_IMM, ASRS_IMM,			// rd, rm, imm
+  ADDS_REG, SUBS_REG,				// rd, rn, rm
+  ADDS_IMM3, SUBS_IMM3,				// rd, rn, imm
+  MOVS_IMM, CMP_IMM, ADDS_IMM8, SUBS_IMM8,	// rd (= rn), imm
+  // Data processing: rd (= rn), rm.
+  ANDS, EORS, LSLS_REG, LSRS_REG, ASRS_REG, ADCS, SBCS, RORS,
+  TST, RSBS, CMP_REG, CMN, ORRS, MULS, BICS, MVNS,
+  // Special data processing and branch: any register, rd (= rn), rm.
+  ADD_HI, CMP_HI, MOV_HI, BX, BLX,
+  // Loads and stores: rd, [rn, rm] or [rn, #imm] (imm in bytes).
+  LDR_LIT,					// rd, [pc, #imm]
+  STR_REG, STRH_REG, STRB_REG, LDRSB_REG, LDR_REG, LDRH_REG, LDRB_REG, LDRSH_REG,
+  STR_IMM, LDR_IMM, STRB_IMM, LDRB_IMM, STRH_IMM, LDRH_IMM,
+  STR_SP, LDR_SP,					// rd, [sp, #imm]
+  ADR, ADD_SP_IMM,				// rd = pc / sp + imm
+  ADD_SP, SUB_SP,					// sp +/-= imm
+  SXTH, SXTB, UXTH, UXTB, REV, REV16, REVSH,	// rd, rm
+  PUSH, POP,					// registers (bit 14: lr, bit 15: pc)
+  STM, LDM,					// rn!, registers
+  CPSIE, CPSID,
+  BKPT, NOP, YIELD, WFE, WFI, SEV,
+  B_COND,						// cond, target
+  B, BL,						// target
+  SVC, UDF,					// imm
+  MSR, MRS,					// rd / rn, imm (SYSm)
+  DSB, DMB, ISB,
+};
+
+// Conditions of B_COND, as encoded.
+enum Cond
+{
+  EQ, NE, CS, CC, MI, PL, VS, VC, HI, LS, GE, LT, GT, LE, AL,
+};
+
+struct Instruction
+{
+  uint32_t address = 0;
+  unsigned size = 2;		// Bytes.
+  Op op = UNDEFINED;
+  unsigned rd = 0, rn = 0, rm = 0;
+  uint32_t imm = 0;
+  uint16_t registers = 0;
+  unsigned cond = AL;
+  uint32_t target = 0;		// Of branches, and the address of LDR_LIT.
+};
+
+// Whether the halfword is the first of a 32 bit instruction.
+inline bool is_32bit(uint16_t first)
+{
+  return (first & 0xF800) >= 0xE800;
+}
+
+Instruction decode(uint32_t address, uint16_t first, uint16_t second = 0);
+
+const char * op_name(Op op);
+
+// E.g. "ldr r2, [pc, #104]", close to what gdb prints.
+std::string disassemble(const Instruction & instruction);
+
+// Cycles of the Cortex-M0 (Technical Reference Manual, "Instruction set 
+// summary"), without wait states: the bus is the boot ROM or the RAM.
+// taken: for B_COND, whether it branches. Wait states of the data 
+// accesses are the business of the caller (see data_accesses()).
+unsigned cycles(const Instruction & instruction, bool taken = true);
+
+// Whether the instruction ends the basic block: every branch, and every 
+// write to the pc.
+bool ends_block(const Instruction & instruction);
+
+// Loads and stores of the instruction (data, not instruction fetches).
+unsigned data_accesses(const Instruction & instruction);
+
+}
+
+#endif /* _THUMB_HPP_ */
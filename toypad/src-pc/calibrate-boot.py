@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+# Measure the delay between the end of the reset pulse and the start of
+# the glitch window of the LPC11U35. See "Determine the start of the
+# glitch window with respect to end of reset" in the README.
+#
+# The LPC11U35 must run src-lpc/boot-marker, with its marker pin
+# (PIO0_2) connected to ICP1 (PD4) of the glitcher. The glitcher resets
+# the LPC11U35 and timestamps both marker pulses in CPU cycles (16 MHz):
+#
+#   MEASUREMENT#1 = marker1 + CPU_CYCLES_BEFORE_STARTING_TIMER1
+#   MEASUREMENT#2 = marker2 - marker1
+#
+#   delay = MEASUREMENT#1 - MEASUREMENT#2
+#
+# The result is written to boot-timing.json, in 48 MHz ticks (the unit of
+# the glitcher's G command), together with a suggested sweep range.
+#
+# Usage: ./calibrate-boot.py [number of boots] [serial port]
+
+import json
+import serial
+import sys
+
+# See CALIBRATION_CPU_CYCLES_BEFORE_STARTING_TIMER1 in glitcher.hpp.
+CPU_CYCLES_BEFORE_STARTING_TIMER1 = 3
+
+# Timer 4 ticks (48 MHz) per CPU cycle (16 MHz).
+TICKS_PER_CPU_CYCLE = 3
+
+# The glitch window is 24 LPC11U35 CPU cycles (12 MHz), so 96 ticks.
+GLITCH_WINDOW_TICKS = 24 * 4
+
+OUTPUT_FILE = 'boot-timing.json'
+
+do_trace = True
+do_trace = False
+if do_trace:
+	trace = print
+else:
+	trace = lambda *args: None
+
+def calibrate(avr, num_boots):
+	'''Let the glitcher boot the LPC11U35 num_boots times. Return the list
+	of (marker1, marker2) in CPU cycles, and the number of timeouts.'''
+	avr.write(b'C%d\n' % num_boots)
+	markers = []
+	timeouts = 0
+	for line in avr:
+		trace(b'avr: ' + line)
+		if b'DONE' in line:
+			break
+		if line.startswith(b'FAIL'):
+			print('Glitcher: %s' % line.decode(errors='replace').strip())
+			sys.exit(1)
+		fields = line.split()
+		if len(fields) < 3 or fields[0] != b'C':
+			continue
+		if fields[2] == b'TIMEOUT':
+			timeouts += 1
+			continue
+		markers.append((int(fields[2], 16), int(fields[3], 16)))
+	return markers, timeouts
+
+def delay_ticks(marker1, marker2):
+	'''Delay from end of reset to start of the glitch window, in ticks.'''
+	measurement1 = marker1 + CPU_CYCLES_BEFORE_STARTING_TIMER1
+	measurement2 = marker2 - marker1
+	return (measurement1 - measurement2) * TICKS_PER_CPU_CYCLE
+
+def percentile(values, p):
+	'''Nearest rank percentile of sorted values.'''
+	index = max(0, min(len(values) - 1, int(round(p / 100 * len(values))) - 1))
+	return values[index]
+
+def print_histogram(values, width = 60):
+	counts = {}
+	for value in values:
+		counts[value] = counts.get(value, 0) + 1
+	most = max(counts.values())
+	for value in range(min(counts), max(counts) + 1):
+		count = counts.get(value, 0)
+		print('%6d ticks (%7.3f us): %5d %s' % (value, value / 48,
+			count, '#' * (count * width // most)))
+
+def main():
+	num_boots = int(sys.argv[1]) if len(sys.argv) > 1 else 1000
+	port = sys.argv[2] if len(sys.argv) > 2 else '/dev/ttyUSB0'
+	avr = serial.Serial(port, 115200)
+
+	markers, timeouts = calibrate(avr, num_boots)
+	if not markers:
+		print('No markers seen. Is boot-marker flashed and PIO0_2 connected to PD4?')
+		sys.exit(1)
+
+	delays = sorted(delay_ticks(m1, m2) for m1, m2 in markers)
+	print_histogram(delays)
+	print()
+	print('boots: %d, timeouts: %d' % (len(markers), timeouts))
+	for p in (0, 1, 50, 99, 100):
+		print('p%-3d %6d ticks' % (p, percentile(delays, p)))
+
+	# A voltage drop is not immediate, so sweep from the earliest start
+	# of the glitch window until the latest end of it.
+	timing = {
+		'unit': '48 MHz ticks',
+		'boots': len(markers),
+		'timeouts': timeouts,
+		'delay_min': delays[0],
+		'delay_median': percentile(delays, 50),
+		'delay_max': delays[-1],
+		'sweep_start': delays[0],
+		'sweep_end': delays[-1] + GLITCH_WINDOW_TICKS,
+	}
+	with open(OUTPUT_FILE, 'w') as f:
+		json.dump(timing, f, indent = '\t')
+	print('Suggested post-reset delay sweep: %d..%d (written to %s)' %
+		(timing['sweep_start'], timing['sweep_end'], OUTPUT_FILE))
+
+if __name__ == '__main__':
+	main()
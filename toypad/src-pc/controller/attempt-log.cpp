@@ -0,0 +1,228 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "attempt-log.hpp"
+#include "crc32.hpp"
+
+using namespace attempt_log;
+
+Columns::Columns(const uint8_t * data, size_t count)
+  : count(count)
+{
+  time_us = (const uint64_t *) data;
+  data += pad16(8 * count);
+  pc = (const uint32_t *) data;
+  data += pad16(4 * count);
+  delay = (const uint16_t *) data;
+  data += pad16(2 * count);
+  width = (const uint16_t *) data;
+  data += pad16(2 * count);
+  rig = data;
+  data += pad16(count);
+  target = data;
+  data += pad16(count);
+  outcome = data;
+}
+
+static std::runtime_error log_error(const std::string & path, const char * what)
+{
+  return std::runtime_error(path + ": " + what + ": " + strerror(errno));
+}
+
+static void write_all(int fd, const void * data, size_t size, const std::string & path)
+{
+  const uint8_t * bytes = (const uint8_t *) data;
+  while (size)
+  {
+    ssize_t n = ::write(fd, bytes, size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0)
+      throw log_error(path, "write");
+    bytes += n;
+    size -= n;
+  }
+}
+
+AttemptLogWriter::AttemptLogWriter(const std::string & path, unsigned checkpoint_ms)
+  : path(path), checkpoint_interval(checkpoint_ms)
+{
+  uint64_t good_size = 0;
+  {
+    struct stat st;
+    // Shorter than the file header: the crash was right after creating 
+    // the log.
+    if (stat(path.c_str(), &st) == 0 && st.st_size >= (off_t) sizeof(FileHeader))
+    {
+      AttemptLogReader reader(path, true);
+      logged = reader.attempts();
+      good_size = reader.good_size;
+      recovered_bytes = st.st_size - good_size;
+    }
+  }
+  
+  fd = open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0)
+    throw log_error(path, "open");
+  if (good_size == 0)
+  {
+    FileHeader header = {};
+    memcpy(header.magic, MAGIC, sizeof MAGIC);
+    header.version = VERSION;
+    if (ftruncate(fd, 0) < 0)
+      throw log_error(path, "truncate");
+    write_all(fd, &header, sizeof header, path);
+    good_size = sizeof header;
+  }
+  else if (recovered_bytes && ftruncate(fd, good_size) < 0)
+  {
+    throw log_error(path, "truncate");
+  }
+  if (lseek(fd, good_size, SEEK_SET) < 0)
+    throw log_error(path, "seek");
+  
+  pending.reserve(RECORDS_PER_BLOCK);
+  last_checkpoint = std::chrono::steady_clock::now();
+}
+
+AttemptLogWriter::~AttemptLogWriter()
+{
+  try
+  {
+    checkpoint();
+  }
+  catch (const std::exception &)
+  {
+  }
+  close(fd);
+}
+
+void AttemptLogWriter::append(const Attempt & attempt)
+{
+  pending.push_back(attempt);
+  if (pending.size() == RECORDS_PER_BLOCK)
+    write_block();
+  if (std::chrono::steady_clock::now() - last_checkpoint >= checkpoint_interval)
+    checkpoint();
+}
+
+void AttemptLogWriter::checkpoint()
+{
+  write_block();
+  if (fdatasync(fd) < 0)
+    throw log_error(path, "fdatasync");
+  last_checkpoint = std::chrono::steady_clock::now();
+}
+
+void AttemptLogWriter::write_block()
+{
+  size_t count = pending.size();
+  if (!count)
+    return;
+  
+  block.assign(sizeof(BlockHeader) + columns_size(count), 0);
+  uint8_t * columns = block.data() + sizeof(BlockHeader);
+  uint8_t * p = columns;
+  uint64_t * time_us = (uint64_t *) p;   p += pad16(8 * count);
+  uint32_t * pc = (uint32_t *) p;        p += pad16(4 * count);
+  uint16_t * delay = (uint16_t *) p;     p += pad16(2 * count);
+  uint16_t * width = (uint16_t *) p;     p += pad16(2 * count);
+  uint8_t * rig = p;                     p += pad16(count);
+  uint8_t * target = p;                  p += pad16(count);
+  uint8_t * outcome = p;
+  for (size_t i = 0; i < count; ++i)
+  {
+    const Attempt & a = pending[i];
+    time_us[i] = a.time_us;
+    pc[i] = a.pc;
+    delay[i] = a.delay;
+    width[i] = a.width;
+    rig[i] = a.rig;
+    target[i] = a.target;
+    outcome[i] = a.outcome;
+  }
+  
+  BlockHeader header = {};
+  header.magic = BLOCK_MAGIC;
+  header.count = count;
+  header.crc = crc32(columns, block.size() - sizeof header);
+  memcpy(block.data(), &header, sizeof header);
+  
+  // One write per block: if it tears, the CRC tells.
+  write_all(fd, block.data(), block.size(), path);
+  logged += count;
+  pending.clear();
+}
+
+AttemptLogReader::AttemptLogReader(const std::string & path, bool verify_all)
+{
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    throw log_error(path, "open");
+  struct stat st;
+  if (fstat(fd, &st) < 0)
+  {
+    close(fd);
+    throw log_error(path, "stat");
+  }
+  size = st.st_size;
+  if (size < sizeof(FileHeader))
+  {
+    close(fd);
+    throw std::runtime_error(path + ": not an attempt log");
+  }
+  void * map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    throw log_error(path, "mmap");
+  data = (const uint8_t *) map;
+  madvise(map, size, MADV_SEQUENTIAL);
+  
+  const FileHeader * header = (const FileHeader *) data;
+  if (memcmp(header->magic, MAGIC, sizeof MAGIC) || header->version != VERSION)
+  {
+    munmap(map, size);
+    throw std::runtime_error(path + ": not an attempt log (version 1)");
+  }
+  
+  size_t offset = sizeof(FileHeader);
+  std::vector<uint32_t> crcs;
+  while (offset + sizeof(BlockHeader) <= size)
+  {
+    const BlockHeader * block = (const BlockHeader *) (data + offset);
+    if (block->magic != BLOCK_MAGIC || block->count == 0 || block->count > RECORDS_PER_BLOCK)
+      break;
+    size_t length = columns_size(block->count);
+    const uint8_t * columns = data + offset + sizeof(BlockHeader);
+    if (offset + sizeof(BlockHeader) + length > size)
+      break;
+    if (verify_all && crc32(columns, length) != block->crc)
+      break;
+    good_blocks.emplace_back(columns, block->count);
+    crcs.push_back(block->crc);
+    total += block->count;
+    offset += sizeof(BlockHeader) + length;
+  }
+  
+  if (!verify_all && !good_blocks.empty())
+  {
+    const Columns & last = good_blocks.back();
+    if (crc32(last.time_us, columns_size(last.count)) != crcs.back())
+    {
+      total -= last.count;
+      offset -= sizeof(BlockHeader) + columns_size(last.count);
+      good_blocks.pop_back();
+    }
+  }
+  good_size = offset;
+}
+
+AttemptLogReader::~AttemptLogReader()
+{
+  munmap((void *) data, size);
+}
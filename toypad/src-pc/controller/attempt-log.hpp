@@ -0,0 +1,152 @@
+#ifndef _ATTEMPT_LOG_HPP_
+#define _ATTEMPT_LOG_HPP_
+
+#include <chrono>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// One glitch attempt.
+struct Attempt
+{
+  uint64_t time_us;	// Since the epoch.
+  uint8_t rig;		// Which glitcher/target pair.
+  uint8_t target;	// Mode of the campaign (see Mode in campaign.hpp).
+  uint16_t delay;	// Post-reset delay, in steps.
+  uint16_t width;	// Glitch width, in steps.
+  char outcome;		// '.', '!', 'r', '0', '?' (see campaign.hpp).
+  uint32_t pc;		// PC after the attempt, 0 if unknown.
+};
+
+// The file format of the attempt log. Little endian, append only:
+// 
+//   file header   "GLITCHLG", version, 4 reserved bytes
+//   block         block header, columns
+//   block         ...
+// 
+// A block holds up to RECORDS_PER_BLOCK attempts, column by column, 
+// every column padded to 16 bytes so the columns of an mmap()ed file 
+// can be scanned with SIMD instructions:
+// 
+//   uint64_t time_us[count]
+//   uint32_t pc[count]
+//   uint16_t delay[count]
+//   uint16_t width[count]
+//   uint8_t  rig[count]
+//   uint8_t  target[count]
+//   uint8_t  outcome[count]
+// 
+// The CRC of the block header covers all columns, so a block torn by a 
+// crash is recognized (and cut off) when the log is opened again.
+namespace attempt_log
+{
+  static const char MAGIC[8] = {'G', 'L', 'I', 'T', 'C', 'H', 'L', 'G'};
+  static const uint32_t VERSION = 1;
+  static const uint32_t BLOCK_MAGIC = 0x314b4c42;	// "BLK1"
+  static const uint32_t RECORDS_PER_BLOCK = 4096;
+  
+  struct FileHeader
+  {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+  };
+  
+  struct BlockHeader
+  {
+    uint32_t magic;
+    uint32_t count;
+    uint32_t crc;
+    uint32_t reserved;
+  };
+  
+  inline size_t pad16(size_t size) { return (size + 15) & ~(size_t) 15; }
+  
+  // Size of the columns of a block of count attempts.
+  inline size_t columns_size(size_t count)
+  {
+    return pad16(8 * count) + pad16(4 * count) + 2 * pad16(2 * count) + 3 * pad16(count);
+  }
+  
+  // The columns of a block, pointing into a buffer or a mapped file.
+  struct Columns
+  {
+    size_t count;
+    const uint64_t * time_us;
+    const uint32_t * pc;
+    const uint16_t * delay;
+    const uint16_t * width;
+    const uint8_t * rig;
+    const uint8_t * target;
+    const uint8_t * outcome;
+    
+    Columns(const uint8_t * data, size_t count);
+  };
+}
+
+// Appends attempts to a log. Opening an existing log checks every block, 
+// and cuts off whatever follows the last good one (what a crash left 
+// behind); attempts() then tells how many attempts the log holds, so a 
+// campaign can resume after them.
+// 
+// Attempts are buffered, and written as a block when the block is full. 
+// At least every checkpoint_ms the buffered attempts are written as a 
+// (short) block, and the file is fsync()ed: a crash loses at most that 
+// much.
+// 
+// Throws std::runtime_error.
+class AttemptLogWriter
+{
+  public:
+    AttemptLogWriter(const std::string & path, unsigned checkpoint_ms = 1000);
+    ~AttemptLogWriter();
+    AttemptLogWriter(const AttemptLogWriter &) = delete;
+    AttemptLogWriter & operator=(const AttemptLogWriter &) = delete;
+    
+    void append(const Attempt & attempt);
+    void checkpoint();
+    
+    uint64_t attempts() const { return logged + pending.size(); }
+    
+    // Bytes cut off when the log was opened.
+    uint64_t recovered_bytes = 0;
+    
+  private:
+    void write_block();
+    
+    int fd = -1;
+    std::string path;
+    uint64_t logged = 0;
+    std::vector<Attempt> pending;
+    std::vector<uint8_t> block;
+    std::chrono::milliseconds checkpoint_interval;
+    std::chrono::steady_clock::time_point last_checkpoint;
+};
+
+// Read only view of a whole log, mmap()ed. Only the good blocks (see 
+// AttemptLogWriter) are visible. Only a crash tears a block, and only 
+// the last one, so only the CRC of the last block is checked, unless 
+// verify_all.
+class AttemptLogReader
+{
+  public:
+    AttemptLogReader(const std::string & path, bool verify_all = false);
+    ~AttemptLogReader();
+    AttemptLogReader(const AttemptLogReader &) = delete;
+    AttemptLogReader & operator=(const AttemptLogReader &) = delete;
+    
+    const std::vector<attempt_log::Columns> & blocks() const { return good_blocks; }
+    uint64_t attempts() const { return total; }
+    
+    // The size of the file up to the end of the last good block.
+    uint64_t good_size = 0;
+    
+  private:
+    const uint8_t * data = nullptr;
+    size_t size = 0;
+    std::vector<attempt_log::Columns> good_blocks;
+    uint64_t total = 0;
+};
+
+#endif /* _ATTEMPT_LOG_HPP_ */
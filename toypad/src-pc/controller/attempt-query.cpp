@@ -0,0 +1,178 @@
+// Success, reset and no-effect rates by post-reset delay and glitch 
+// width, over one or more attempt logs (see attempt-log.hpp) of 
+// glitch-controller --log.
+// 
+// Usage: attempt-query [options] <log>...
+// 
+//   --rig <n>            only attempts of rig n
+//   --target <mode>      only attempts of mode find-length, find-delay 
+//                        or final
+//   --since <seconds>    only attempts since this time (epoch seconds)
+//   --until <seconds>    only attempts before this time
+//   --csv <file>         write every cell as CSV
+//   --heatmap <prefix>   write <prefix>-success.ppm, -reset.ppm, 
+//                        -no-effect.ppm
+//   --top <n>            print the n cells with the best success rate 
+//                        (10)
+//   --verify             check the CRC of every block
+//   --threads <n>        (0: all cores)
+
+#include <algorithm>
+#include <chrono>
+#include <getopt.h>
+#include <memory>
+#include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include "attempt-log.hpp"
+#include "attempt-stats.hpp"
+#include "campaign.hpp"
+
+static void usage(const char * program)
+{
+  fprintf(stderr,
+    "Usage: %s [--rig <n>] [--target <mode>] [--since <s>] [--until <s>]\n"
+    "       [--csv <file>] [--heatmap <prefix>] [--top <n>] [--verify]\n"
+    "       [--threads <n>] <log>...\n", program);
+  exit(2);
+}
+
+int main(int argc, char ** argv)
+{
+  AttemptFilter filter;
+  std::string csv;
+  std::string heatmap;
+  unsigned top = 10;
+  bool verify = false;
+  unsigned threads = 0;
+  
+  static const option options[] = {
+    {"rig",     required_argument, nullptr, 'r'},
+    {"target",  required_argument, nullptr, 't'},
+    {"since",   required_argument, nullptr, 's'},
+    {"until",   required_argument, nullptr, 'u'},
+    {"csv",     required_argument, nullptr, 'c'},
+    {"heatmap", required_argument, nullptr, 'h'},
+    {"top",     required_argument, nullptr, 'n'},
+    {"verify",  no_argument,       nullptr, 'v'},
+    {"threads", required_argument, nullptr, 'j'},
+    {nullptr,   0,                 nullptr, 0},
+  };
+  int option;
+  while ((option = getopt_long(argc, argv, "", options, nullptr)) != -1)
+  {
+    switch (option)
+    {
+      case 'r': filter.rig = strtoul(optarg, nullptr, 0); break;
+      case 't':
+      {
+        Mode mode;
+        if (!parse_mode(optarg, mode))
+          usage(argv[0]);
+        filter.target = (int) mode;
+        break;
+      }
+      case 's': filter.since_us = strtoull(optarg, nullptr, 0) * 1000000; break;
+      case 'u': filter.until_us = strtoull(optarg, nullptr, 0) * 1000000; break;
+      case 'c': csv = optarg; break;
+      case 'h': heatmap = optarg; break;
+      case 'n': top = strtoul(optarg, nullptr, 0); break;
+      case 'v': verify = true; break;
+      case 'j': threads = strtoul(optarg, nullptr, 0); break;
+      default: usage(argv[0]);
+    }
+  }
+  if (optind == argc)
+    usage(argv[0]);
+  
+  try
+  {
+    auto start = std::chrono::steady_clock::now();
+    AttemptGrid grid;
+    uint64_t attempts = 0;
+    for (int i = optind; i < argc; ++i)
+    {
+      AttemptLogReader log(argv[i], verify);
+      attempts += log.attempts();
+      AttemptGrid g = aggregate(log, filter, threads);
+      if (g.empty())
+        continue;
+      if (grid.empty())
+      {
+        grid = g;
+        continue;
+      }
+      // Merge into a grid that covers both.
+      AttemptGrid both(std::min(grid.delay_first, g.delay_first),
+                       std::max(grid.delay_last, g.delay_last),
+                       std::min(grid.width_first, g.width_first),
+                       std::max(grid.width_last, g.width_last));
+      for (const AttemptGrid * from : {&grid, &g})
+        for (unsigned d = from->delay_first; d <= from->delay_last; ++d)
+          for (unsigned w = from->width_first; w <= from->width_last; ++w)
+            for (int c = 0; c < AttemptGrid::NUM_CLASSES; ++c)
+              both.counts[((d - both.delay_first) * (both.width_last - both.width_first + 1)
+                          + (w - both.width_first)) * AttemptGrid::NUM_CLASSES + c]
+                += from->count(d, w, (AttemptGrid::Class) c);
+      grid = both;
+    }
+    double seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+    
+    if (grid.empty())
+    {
+      printf("No attempts.\n");
+      return 0;
+    }
+    
+    uint64_t counted = 0;
+    for (int c = 0; c < AttemptGrid::NUM_CLASSES; ++c)
+      counted += grid.total((AttemptGrid::Class) c);
+    printf("%llu attempts, %llu counted, in %.2f s\n",
+           (unsigned long long) attempts, (unsigned long long) counted, seconds);
+    for (int c = 0; c < AttemptGrid::NUM_CLASSES; ++c)
+    {
+      uint64_t n = grid.total((AttemptGrid::Class) c);
+      printf("  %-9s %12llu  %6.2f%%\n", AttemptGrid::class_name((AttemptGrid::Class) c),
+             (unsigned long long) n, counted ? 100.0 * n / counted : 0.0);
+    }
+    printf("delays %u..%u, widths %u..%u\n", grid.delay_first, grid.delay_last,
+           grid.width_first, grid.width_last);
+    
+    struct Cell { unsigned delay, width; uint64_t attempts, success, reset; };
+    std::vector<Cell> cells;
+    for (unsigned d = grid.delay_first; d <= grid.delay_last; ++d)
+      for (unsigned w = grid.width_first; w <= grid.width_last; ++w)
+        if (uint64_t n = grid.attempts(d, w))
+          cells.push_back({d, w, n, grid.count(d, w, AttemptGrid::SUCCESS),
+                           grid.count(d, w, AttemptGrid::RESET)});
+    std::sort(cells.begin(), cells.end(), [](const Cell & a, const Cell & b)
+    {
+      return a.success * b.attempts > b.success * a.attempts;
+    });
+    if (top && !cells.empty() && cells[0].success)
+    {
+      printf("\ndelay  width  attempts  success   reset\n");
+      for (size_t i = 0; i < cells.size() && i < top && cells[i].success; ++i)
+        printf("%5u  %5u  %8llu  %6.2f%%  %6.2f%%\n", cells[i].delay, cells[i].width,
+               (unsigned long long) cells[i].attempts,
+               100.0 * cells[i].success / cells[i].attempts,
+               100.0 * cells[i].reset / cells[i].attempts);
+    }
+    
+    if (!csv.empty())
+      grid.write_csv(csv);
+    if (!heatmap.empty())
+      for (AttemptGrid::Class c : {AttemptGrid::SUCCESS, AttemptGrid::RESET, AttemptGrid::NO_EFFECT})
+        grid.write_heatmap(heatmap + "-" + AttemptGrid::class_name(c) + ".ppm", c);
+  }
+  catch (const std::exception & e)
+  {
+    fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,253 @@
+#include <algorithm>
+#include <errno.h>
+#include <stdexcept>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "attempt-stats.hpp"
+
+AttemptGrid::Class AttemptGrid::class_of(char outcome)
+{
+  switch (outcome)
+  {
+    case '.': return NO_EFFECT;
+    case '!': return SUCCESS;
+    case 'r': return RESET;
+  }
+  return OTHER;
+}
+
+const char * AttemptGrid::class_name(Class c)
+{
+  switch (c)
+  {
+    case NO_EFFECT: return "no-effect";
+    case SUCCESS:   return "success";
+    case RESET:     return "reset";
+    default:        return "other";
+  }
+}
+
+AttemptGrid::AttemptGrid(uint16_t delay_first, uint16_t delay_last,
+                         uint16_t width_first, uint16_t width_last)
+  : delay_first(delay_first), delay_last(delay_last),
+    width_first(width_first), width_last(width_last),
+    counts((size_t) (delay_last - delay_first + 1) * (width_last - width_first + 1) * NUM_CLASSES)
+{
+}
+
+uint64_t AttemptGrid::attempts(uint16_t delay, uint16_t width) const
+{
+  uint64_t sum = 0;
+  for (int c = 0; c < NUM_CLASSES; ++c)
+    sum += count(delay, width, (Class) c);
+  return sum;
+}
+
+uint64_t AttemptGrid::total(Class c) const
+{
+  uint64_t sum = 0;
+  for (size_t i = c; i < counts.size(); i += NUM_CLASSES)
+    sum += counts[i];
+  return sum;
+}
+
+void AttemptGrid::add(const AttemptGrid & other)
+{
+  for (size_t i = 0; i < counts.size(); ++i)
+    counts[i] += other.counts[i];
+}
+
+void AttemptGrid::write_csv(const std::string & path) const
+{
+  FILE * f = fopen(path.c_str(), "w");
+  if (!f)
+    throw std::runtime_error(path + ": " + strerror(errno));
+  fprintf(f, "delay,width,attempts,success,reset,no_effect,other\n");
+  for (unsigned delay = delay_first; !empty() && delay <= delay_last; ++delay)
+  {
+    for (unsigned width = width_first; width <= width_last; ++width)
+    {
+      uint64_t n = attempts(delay, width);
+      if (n)
+        fprintf(f, "%u,%u,%llu,%llu,%llu,%llu,%llu\n", delay, width,
+                (unsigned long long) n,
+                (unsigned long long) count(delay, width, SUCCESS),
+                (unsigned long long) count(delay, width, RESET),
+                (unsigned long long) count(delay, width, NO_EFFECT),
+                (unsigned long long) count(delay, width, OTHER));
+    }
+  }
+  fclose(f);
+}
+
+void AttemptGrid::write_heatmap(const std::string & path, Class c, unsigned scale) const
+{
+  if (empty())
+    throw std::runtime_error(path + ": no attempts");
+  unsigned columns = width_last - width_first + 1;
+  unsigned rows = delay_last - delay_first + 1;
+  
+  double highest = 0;
+  for (unsigned delay = delay_first; delay <= delay_last; ++delay)
+    for (unsigned width = width_first; width <= width_last; ++width)
+      if (uint64_t n = attempts(delay, width))
+        highest = std::max(highest, (double) count(delay, width, c) / n);
+  
+  FILE * f = fopen(path.c_str(), "wb");
+  if (!f)
+    throw std::runtime_error(path + ": " + strerror(errno));
+  fprintf(f, "P6\n%u %u\n255\n", columns * scale, rows * scale);
+  std::vector<uint8_t> row(3 * columns * scale);
+  for (unsigned delay = delay_first; delay <= delay_last; ++delay)
+  {
+    for (unsigned width = width_first; width <= width_last; ++width)
+    {
+      // Black - red - yellow - white.
+      uint8_t rgb[3] = {0, 0, 64};
+      if (uint64_t n = attempts(delay, width))
+      {
+        double v = highest > 0 ? count(delay, width, c) / (n * highest) : 0;
+        rgb[0] = std::min(255.0, 3 * 255 * v);
+        rgb[1] = std::min(255.0, std::max(0.0, 3 * 255 * v - 255));
+        rgb[2] = std::min(255.0, std::max(0.0, 3 * 255 * v - 510));
+      }
+      for (unsigned x = 0; x < scale; ++x)
+        memcpy(&row[3 * ((width - width_first) * scale + x)], rgb, 3);
+    }
+    for (unsigned y = 0; y < scale; ++y)
+      fwrite(row.data(), 1, row.size(), f);
+  }
+  fclose(f);
+}
+
+
+
+// Lowest and highest value of a uint16_t column.
+static void min_max(const uint16_t * column, size_t count, uint16_t & low, uint16_t & high)
+{
+  size_t i = 0;
+#ifdef __SSE2__
+  // SSE2 only compares signed 16 bit numbers: flip the sign bits.
+  const __m128i sign = _mm_set1_epi16((short) 0x8000);
+  __m128i lows = _mm_set1_epi16((short) (low ^ 0x8000));
+  __m128i highs = _mm_set1_epi16((short) (high ^ 0x8000));
+  for (; i + 8 <= count; i += 8)
+  {
+    __m128i v = _mm_xor_si128(_mm_load_si128((const __m128i *) (column + i)), sign);
+    lows = _mm_min_epi16(lows, v);
+    highs = _mm_max_epi16(highs, v);
+  }
+  uint16_t l[8], h[8];
+  _mm_storeu_si128((__m128i *) l, _mm_xor_si128(lows, sign));
+  _mm_storeu_si128((__m128i *) h, _mm_xor_si128(highs, sign));
+  for (int k = 0; k < 8; ++k)
+  {
+    low = std::min(low, l[k]);
+    high = std::max(high, h[k]);
+  }
+#endif
+  for (; i < count; ++i)
+  {
+    low = std::min(low, column[i]);
+    high = std::max(high, column[i]);
+  }
+}
+
+// Bit i set if attempt first + i (of 16) passes the rig and target 
+// filters.
+static inline unsigned match16(const attempt_log::Columns & b, size_t first,
+                               const AttemptFilter & filter)
+{
+#ifdef __SSE2__
+  __m128i pass = _mm_set1_epi8((char) 0xFF);
+  if (filter.rig >= 0)
+    pass = _mm_and_si128(pass, _mm_cmpeq_epi8(
+      _mm_load_si128((const __m128i *) (b.rig + first)), _mm_set1_epi8((char) filter.rig)));
+  if (filter.target >= 0)
+    pass = _mm_and_si128(pass, _mm_cmpeq_epi8(
+      _mm_load_si128((const __m128i *) (b.target + first)), _mm_set1_epi8((char) filter.target)));
+  return _mm_movemask_epi8(pass);
+#else
+  unsigned mask = 0;
+  for (unsigned i = 0; i < 16; ++i)
+    if ((filter.rig < 0 || b.rig[first + i] == filter.rig)
+     && (filter.target < 0 || b.target[first + i] == filter.target))
+      mask |= 1 << i;
+  return mask;
+#endif
+}
+
+static void count_blocks(const std::vector<attempt_log::Columns> & blocks,
+                         size_t first, size_t last,
+                         const AttemptFilter & filter, AttemptGrid & grid)
+{
+  uint8_t classes[256];
+  for (int o = 0; o < 256; ++o)
+    classes[o] = AttemptGrid::class_of((char) o);
+  const size_t columns = grid.width_last - grid.width_first + 1;
+  uint64_t * counts = grid.counts.data();
+  const bool by_time = filter.since_us > 0 || filter.until_us < UINT64_MAX;
+  
+  for (size_t n = first; n < last; ++n)
+  {
+    const attempt_log::Columns & b = blocks[n];
+    // The columns are padded to 16 bytes, so the last group may read 
+    // (but must not count) up to 15 attempts past the end.
+    for (size_t i = 0; i < b.count; i += 16)
+    {
+      unsigned mask = match16(b, i, filter);
+      if (b.count - i < 16)
+        mask &= (1u << (b.count - i)) - 1;
+      while (mask)
+      {
+        unsigned k = __builtin_ctz(mask);
+        mask &= mask - 1;
+        size_t j = i + k;
+        if (by_time && (b.time_us[j] < filter.since_us || b.time_us[j] >= filter.until_us))
+          continue;
+        size_t cell = (size_t) (b.delay[j] - grid.delay_first) * columns
+                    + (b.width[j] - grid.width_first);
+        ++counts[cell * AttemptGrid::NUM_CLASSES + classes[b.outcome[j]]];
+      }
+    }
+  }
+}
+
+AttemptGrid aggregate(const AttemptLogReader & log, const AttemptFilter & filter, unsigned threads)
+{
+  const std::vector<attempt_log::Columns> & blocks = log.blocks();
+  if (blocks.empty())
+    return AttemptGrid();
+  
+  uint16_t delay_low = 0xFFFF, delay_high = 0, width_low = 0xFFFF, width_high = 0;
+  for (const attempt_log::Columns & b : blocks)
+  {
+    min_max(b.delay, b.count, delay_low, delay_high);
+    min_max(b.width, b.count, width_low, width_high);
+  }
+  
+  if (!threads)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  threads = std::min<size_t>(threads, blocks.size());
+  std::vector<AttemptGrid> grids(threads,
+    AttemptGrid(delay_low, delay_high, width_low, width_high));
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < threads; ++t)
+  {
+    size_t first = blocks.size() * t / threads;
+    size_t last = blocks.size() * (t + 1) / threads;
+    workers.emplace_back(count_blocks, std::cref(blocks), first, last,
+                         std::cref(filter), std::ref(grids[t]));
+  }
+  for (std::thread & worker : workers)
+    worker.join();
+  for (unsigned t = 1; t < threads; ++t)
+    grids[0].add(grids[t]);
+  return grids[0];
+}
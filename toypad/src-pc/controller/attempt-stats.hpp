@@ -0,0 +1,77 @@
+#ifndef _ATTEMPT_STATS_HPP_
+#define _ATTEMPT_STATS_HPP_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "attempt-log.hpp"
+
+// Which attempts of a log to count. -1: any.
+struct AttemptFilter
+{
+  int rig = -1;
+  int target = -1;
+  uint64_t since_us = 0;
+  uint64_t until_us = UINT64_MAX;
+};
+
+// What became of the attempts, by post-reset delay and glitch width.
+class AttemptGrid
+{
+  public:
+    enum Class
+    {
+      NO_EFFECT,	// '.'
+      SUCCESS,		// '!'
+      RESET,		// 'r'
+      OTHER,		// '0', '?', anything else
+      NUM_CLASSES,
+    };
+    static Class class_of(char outcome);
+    static const char * class_name(Class c);
+    
+    AttemptGrid() {}
+    AttemptGrid(uint16_t delay_first, uint16_t delay_last,
+                uint16_t width_first, uint16_t width_last);
+    
+    uint16_t delay_first = 0;
+    uint16_t delay_last = 0;
+    uint16_t width_first = 0;
+    uint16_t width_last = 0;
+    bool empty() const { return counts.empty(); }
+    
+    uint64_t count(uint16_t delay, uint16_t width, Class c) const
+    {
+      return counts[cell(delay, width) * NUM_CLASSES + c];
+    }
+    uint64_t attempts(uint16_t delay, uint16_t width) const;
+    uint64_t total(Class c) const;
+    
+    void add(const AttemptGrid & other);
+    
+    // All cells with at least one attempt, as CSV.
+    void write_csv(const std::string & path) const;
+    
+    // The rate of class c per cell as a binary PPM picture: delays from 
+    // top to bottom, widths from left to right, scale x scale pixels 
+    // per cell. Black is 0, white the highest rate; cells without 
+    // attempts are dark blue.
+    void write_heatmap(const std::string & path, Class c, unsigned scale = 4) const;
+    
+    std::vector<uint64_t> counts;
+    
+  private:
+    size_t cell(uint16_t delay, uint16_t width) const
+    {
+      return (size_t) (delay - delay_first) * (width_last - width_first + 1)
+           + (width - width_first);
+    }
+};
+
+// Count the attempts of the log that pass the filter, with SIMD scans 
+// of the columns, on threads threads (0: all cores).
+AttemptGrid aggregate(const AttemptLogReader & log, const AttemptFilter & filter,
+                      unsigned threads = 0);
+
+#endif /* _ATTEMPT_STATS_HPP_ */
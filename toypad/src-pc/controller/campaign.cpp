@@ -0,0 +1,194 @@
+#include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "campaign.hpp"
+
+// Tries per attempt if the serial link fails.
+#define ATTEMPT_TRIES	3
+
+bool parse_mode(const std::string & name, Mode & mode)
+{
+  for (Mode m : {Mode::FIND_LENGTH, Mode::FIND_DELAY, Mode::FINAL})
+  {
+    if (name == mode_name(m))
+    {
+      mode = m;
+      return true;
+    }
+  }
+  return false;
+}
+
+const char * mode_name(Mode mode)
+{
+  switch (mode)
+  {
+    case Mode::FIND_LENGTH: return "find-length";
+    case Mode::FIND_DELAY:  return "find-delay";
+    case Mode::FINAL:       return "final";
+  }
+  return "?";
+}
+
+char classify_pc(Mode mode, const std::string & reply)
+{
+  // SWD does not work (any more).
+  if (TclRpc::is_error(reply))
+    return mode == Mode::FINAL ? '.' : 'r';
+  if (mode == Mode::FINAL)
+    return '!';
+  
+  uint32_t pc = parse_pc(reply);
+  if (!pc)
+    return '?';
+  
+  if (TEST_LPC_LOOP_FIRST <= pc && pc <= TEST_LPC_LOOP_LAST)
+    return '.';
+  if (pc == TEST_LPC_GLITCHED)
+    return '!';
+  if (pc == TEST_LPC_START)
+    return '0';
+  return '?';
+}
+
+char classify_crp(const std::string & flash_reply, const std::string & register_reply)
+{
+  if (TclRpc::is_error(flash_reply) || TclRpc::is_error(register_reply))
+    return 'r';
+  uint32_t flash_crp, stored;
+  if (!parse_word(flash_reply, flash_crp) || !parse_word(register_reply, stored))
+    return '?';
+  return stored == expected_crp_register(flash_crp) ? '.' : '!';
+}
+
+uint32_t parse_pc(const std::string & reply)
+{
+  // "pc 0x000008f0"
+  size_t at = reply.find("pc 0x");
+  if (TclRpc::is_error(reply) || at == std::string::npos)
+    return 0;
+  return strtoul(reply.c_str() + at + 3, nullptr, 16);
+}
+
+bool parse_word(const std::string & reply, uint32_t & word)
+{
+  // "0x400483f0: 87654321 "
+  size_t at = reply.find(": ");
+  if (TclRpc::is_error(reply) || reply.compare(0, 2, "0x") || at == std::string::npos)
+    return false;
+  char * end;
+  word = strtoul(reply.c_str() + at + 2, &end, 16);
+  return end != reply.c_str() + at + 2;
+}
+
+Campaign::Campaign(Mode mode, GlitcherLink & glitcher, TclRpc * ocd, bool swd_oracle)
+  : mode(mode), glitcher(glitcher), ocd(ocd), swd_oracle(swd_oracle)
+{
+  if (!ocd && !(mode == Mode::FINAL && swd_oracle))
+    throw std::runtime_error(std::string("mode ") + mode_name(mode) + " needs openocd");
+}
+
+// The setup of find-length: restart test-lpc, and put it at the start of 
+// its loop.
+static const std::vector<std::string> TEST_LPC_SETUP = {
+  "reset run",
+  "halt",
+  "set_reg {pc 0x8f0}",
+  "resume",
+};
+
+static const std::vector<std::string> CHECK = {
+  "halt 0",
+  TclRpc::catch_error("get_reg -force pc"),
+};
+
+static std::string mdw(uint32_t address)
+{
+  char command[32];
+  snprintf(command, sizeof command, "mdw 0x%08x", address);
+  return TclRpc::catch_error(command);
+}
+
+// The check of find-delay: the CRP register, and the word in flash it 
+// is to be compared with.
+static const std::vector<std::string> CHECK_CRP = {
+  mdw(CRP_FLASH_ADDRESS),
+  mdw(CRP_REGISTER),
+};
+
+char Campaign::attempt(uint16_t post_reset_steps, uint16_t glitch_steps)
+{
+  auto start = Metrics::Clock::now();
+  if (mode == Mode::FIND_LENGTH && !setup_done)
+  {
+    auto setup_start = Metrics::Clock::now();
+    ocd->batch(TEST_LPC_SETUP);
+    setup_done = true;
+    if (metrics)
+      metrics->record("setup", setup_start);
+  }
+  
+  // A glitch lost on the serial link is simply done again. The target 
+  // may have been glitched (or not) in the meantime, so set it up again.
+  char status;
+  for (unsigned tries = 1; ; ++tries)
+  {
+    try
+    {
+      auto glitch_start = Metrics::Clock::now();
+      status = glitcher.glitch(post_reset_steps, glitch_steps);
+      if (metrics)
+        metrics->record("glitch", glitch_start);
+      break;
+    }
+    catch (const GlitcherError & e)
+    {
+      if (e.kind == GlitcherError::FAILED || tries == ATTEMPT_TRIES)
+        throw;
+      ++link_errors;
+      if (mode == Mode::FIND_LENGTH)
+      {
+        auto setup_start = Metrics::Clock::now();
+        ocd->batch(TEST_LPC_SETUP);
+        if (metrics)
+          metrics->record("setup", setup_start);
+      }
+    }
+  }
+  char result;
+  last_pc = 0;
+  if (swd_oracle)
+  {
+    result = status ? status : '?';
+  }
+  else
+  {
+    // Check this attempt, and set up the next one, in one round trip. 
+    // openocd runs them in order, so the setup cannot disturb the 
+    // check.
+    std::vector<std::string> commands = CHECK;
+    if (mode == Mode::FIND_LENGTH)
+      commands.insert(commands.end(), TEST_LPC_SETUP.begin(), TEST_LPC_SETUP.end());
+    if (mode == Mode::FIND_DELAY)
+      commands.insert(commands.end(), CHECK_CRP.begin(), CHECK_CRP.end());
+    auto check_start = Metrics::Clock::now();
+    std::vector<std::string> replies = ocd->batch(commands);
+    if (metrics)
+      metrics->record("check", check_start);
+    if (mode == Mode::FIND_DELAY)
+      result = classify_crp(replies[2], replies[3]);
+    else
+      result = classify_pc(mode, replies[1]);
+    last_pc = parse_pc(replies[1]);
+  }
+  
+  ++attempts;
+  ++counts[result & 0x7f];
+  if (metrics)
+  {
+    metrics->record("attempt", start);
+    metrics->count_attempt(result);
+  }
+  return result;
+}
@@ -0,0 +1,115 @@
+#ifndef _CAMPAIGN_HPP_
+#define _CAMPAIGN_HPP_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "glitcher-link.hpp"
+#include "metrics.hpp"
+#include "tcl-rpc.hpp"
+
+// One glitch attempt after another, with the outcome of each attempt 
+// in the characters of run-glitch.py:
+// 
+//   '.'  Nothing happened.
+//   '!'  Glitched.
+//   'r'  The target reset (browned out): no SWD.
+//   '0'  The target is at the start of the loop again: the pre-glitch 
+//        setup failed, or a reset happened.
+//   '?'  Unknown program counter.
+// 
+// The modes:
+// 
+//   find-length: The target runs src-lpc/test-lpc. Before every glitch 
+//                the PC is forced to the start of its compare loop; 
+//                after the glitch the PC tells whether a compare was 
+//                skipped (0x908).
+//   find-delay:  The target boots with a breakable CRP check (no CRP 
+//                in flash); after the glitch the CRP register tells 
+//                whether the glitch landed in the CRP check of the boot 
+//                ROM.
+//   final:       The real toypad, with CRP3: a glitch is a hit if SWD 
+//                works afterwards. With the SWD oracle of the glitcher 
+//                ('S'), openocd is not involved at all.
+enum class Mode
+{
+  FIND_LENGTH,
+  FIND_DELAY,
+  FINAL,
+};
+
+bool parse_mode(const std::string & name, Mode & mode);
+const char * mode_name(Mode mode);
+
+// The PC ranges of test-lpc (see check_glitch() in run-glitch.py).
+#define TEST_LPC_LOOP_FIRST	0x8f0
+#define TEST_LPC_LOOP_LAST	0x906
+#define TEST_LPC_GLITCHED	0x908
+#define TEST_LPC_START		0x8ee
+
+// The CRP check of the boot ROM (0x1fff00a8 to 0x1fff00c4, see 
+// bootloader.lst) is over some 30 cycles after the reset, long before 
+// openocd can look at the PC. What it leaves behind is the CRP register: 
+// CRP2 if the word at CRP_FLASH_ADDRESS is CRP1 or CRP3, that word 
+// otherwise. A glitch that landed in the check stores something else 
+// (see src-pc/boot-rom and src-lpc/crp-replica).
+#define CRP_REGISTER		0x400483f0
+#define CRP_FLASH_ADDRESS	0x2fc
+#define CRP1			0x12345678
+#define CRP2			0x87654321
+#define CRP3			0x43218765
+
+// What the CRP check stores for this word at CRP_FLASH_ADDRESS.
+inline uint32_t expected_crp_register(uint32_t flash_crp)
+{
+  return flash_crp == CRP1 || flash_crp == CRP3 ? CRP2 : flash_crp;
+}
+
+// Classify the reply to "get_reg -force pc" (wrapped in catch_error()), 
+// in modes find-length and final.
+char classify_pc(Mode mode, const std::string & reply);
+
+// Classify the replies to "mdw" of CRP_FLASH_ADDRESS and of 
+// CRP_REGISTER (wrapped in catch_error()), in mode find-delay.
+char classify_crp(const std::string & flash_reply, const std::string & register_reply);
+
+// The PC in that reply, 0 if none.
+uint32_t parse_pc(const std::string & reply);
+
+// The word in the reply to "mdw <address>", false if none.
+bool parse_word(const std::string & reply, uint32_t & word);
+
+class Campaign
+{
+  public:
+    // ocd may be null in mode final with the SWD oracle.
+    Campaign(Mode mode, GlitcherLink & glitcher, TclRpc * ocd, bool swd_oracle);
+    
+    char attempt(uint16_t post_reset_steps, uint16_t glitch_steps);
+    
+    // Number of attempts per outcome character.
+    unsigned counts[128] = {};
+    unsigned attempts = 0;
+    
+    // Attempts done again because the serial link failed.
+    unsigned link_errors = 0;
+    
+    // The PC after the last attempt, 0 if unknown (SWD failed, or the 
+    // SWD oracle).
+    uint32_t last_pc = 0;
+    
+    // If set: the time of the attempts, their glitches, checks and 
+    // setups, and their outcomes (see Metrics). Set the metrics of the 
+    // glitcher and openocd too for the details.
+    Metrics * metrics = nullptr;
+    
+  private:
+    Mode mode;
+    GlitcherLink & glitcher;
+    TclRpc * ocd;
+    bool swd_oracle;
+    bool setup_done = false;
+};
+
+#endif /* _CAMPAIGN_HPP_ */
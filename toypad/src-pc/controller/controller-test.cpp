@@ -0,0 +1,167 @@
+// Runs the controller (campaign.cpp, glitcher-link.cpp, serial-port.cpp, 
+// tcl-rpc.cpp) against the fake openocd and the fake glitcher, and 
+// checks that every attempt is classified as the fake target says.
+
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "campaign.hpp"
+#include "fake-glitcher.hpp"
+#include "fake-openocd.hpp"
+#include "fake-target.hpp"
+#include "glitcher-link.hpp"
+#include "serial-port.hpp"
+#include "tcl-rpc.hpp"
+#include "test-check.hpp"
+
+// What the controller should report for the fake target's outcome.
+static char expected(Mode mode, bool swd_oracle, char outcome)
+{
+  if (swd_oracle)
+    return outcome == 'r' ? '?' : outcome == '!' ? '!' : '.';
+  if (mode == Mode::FINAL)
+    return outcome == '!' ? '!' : '.';
+  if (mode == Mode::FIND_DELAY && outcome == '0')
+    return '.';
+  return outcome;
+}
+
+static void run(const char * what, Mode mode, bool swd_oracle, FakeTarget::Config config)
+{
+  FakeTarget target(config);
+  FakeOpenocd fake_ocd(target);
+  FakeGlitcher fake_glitcher(target);
+  
+  SerialPort port(fake_glitcher.path(), 115200);
+  GlitcherLink glitcher(port);
+  glitcher.set_swd_oracle(swd_oracle);
+  std::unique_ptr<TclRpc> ocd;
+  if (!(mode == Mode::FINAL && swd_oracle))
+    ocd.reset(new TclRpc("127.0.0.1", fake_ocd.port()));
+  Campaign campaign(mode, glitcher, ocd.get(), swd_oracle);
+  
+  unsigned wrong = 0;
+  unsigned hits = 0;
+  for (uint16_t delay = 998; delay <= 1005; ++delay)
+  {
+    for (uint16_t width = 18; width <= 32; ++width)
+    {
+      char outcome = target.expected(delay, width, campaign.attempts + 1);
+      char result = campaign.attempt(delay, width);
+      wrong += result != expected(mode, swd_oracle, outcome);
+      hits += result == '!';
+    }
+  }
+  
+  char text[200];
+  snprintf(text, sizeof text, "%s: %u attempts, %u hits, %u misclassified",
+           what, campaign.attempts, hits, wrong);
+  check(wrong == 0 && hits == 4 * 3, text);
+  if (ocd)
+  {
+    // One round trip per attempt, plus the first setup.
+    snprintf(text, sizeof text, "%s: %u openocd round trips", what, ocd->round_trips);
+    check(ocd->round_trips == campaign.attempts + (mode == Mode::FIND_LENGTH), text);
+  }
+}
+
+int main()
+{
+  check(classify_pc(Mode::FIND_LENGTH, "pc 0x000008f0") == '.', "classify loop");
+  check(classify_pc(Mode::FIND_LENGTH, "pc 0x00000906") == '.', "classify end of loop");
+  check(classify_pc(Mode::FIND_LENGTH, "pc 0x00000908") == '!', "classify glitched");
+  check(classify_pc(Mode::FIND_LENGTH, "pc 0x000008ee") == '0', "classify restarted");
+  check(classify_pc(Mode::FIND_LENGTH, "pc 0x00001234") == '?', "classify unknown");
+  check(classify_pc(Mode::FIND_LENGTH, "ERROR Target not examined yet") == 'r', "classify no SWD");
+  check(classify_crp("0x000002fc: ffffffff ", "0x400483f0: ffffffff ") == '.', "classify CRP unchanged");
+  check(classify_crp("0x000002fc: 12345678 ", "0x400483f0: 87654321 ") == '.', "classify CRP1 stored as CRP2");
+  check(classify_crp("0x000002fc: ffffffff ", "0x400483f0: 87654321 ") == '!', "classify CRP check glitched");
+  check(classify_crp("0x000002fc: 43218765 ", "0x400483f0: 43218765 ") == '!', "classify CRP3 not stored as CRP2");
+  check(classify_crp("0x000002fc: ffffffff ", "ERROR Target not examined yet") == 'r', "classify CRP without SWD");
+  check(classify_crp("0x000002fc: ffffffff ", "pc 0x1fff00c6") == '?', "classify CRP unreadable");
+  check(classify_pc(Mode::FINAL, "pc 0x1fff0000") == '!', "classify SWD in final");
+  check(classify_pc(Mode::FINAL, "ERROR Target not examined yet") == '.', "classify no SWD in final");
+  
+  try
+  {
+    FakeTarget::Config config;
+    config.restart_every = 37;
+    run("find-length", Mode::FIND_LENGTH, false, config);
+    
+    // Long after the CRP check, wherever the hits end up.
+    config = FakeTarget::Config();
+    config.hit_pc = config.miss_pc = 0x1fff0100;
+    run("find-delay", Mode::FIND_DELAY, false, config);
+    
+    config = FakeTarget::Config();
+    config.crp3 = true;
+    run("final", Mode::FINAL, false, config);
+    run("final, SWD oracle", Mode::FINAL, true, config);
+    
+    FakeTarget target{FakeTarget::Config()};
+    FakeGlitcher slow_glitcher(target, false);
+    SerialPort port(slow_glitcher.path(), 115200);
+    GlitcherLink glitcher(port);
+    check(glitcher.set_resolution(2) == 2 && glitcher.dead_time, "resolution fallback to dead time");
+    check(glitcher.set_resolution(1) == 1 && !glitcher.dead_time, "resolution 48 MHz");
+    bool failed = false;
+    try
+    {
+      glitcher.glitch(1000, 1);
+    }
+    catch (const std::runtime_error &)
+    {
+      failed = true;
+    }
+    check(failed, "FAIL ends a command with an error");
+    check(glitcher.glitch(1000, 20) == 0, "next command after FAIL");
+    // Timer 4 would wrap around to a second glitch before it is stopped.
+    failed = false;
+    try
+    {
+      glitcher.glitch(1000, 974);
+    }
+    catch (const std::runtime_error &)
+    {
+      failed = true;
+    }
+    check(failed && glitcher.glitch(1000, 973) == 0, "longest glitch at 48 MHz");
+    
+    // A hung openocd: the command times out, and so does the rest.
+    FakeOpenocd hung_ocd(target);
+    hung_ocd.command_latency_us = 1000000;
+    TclRpc slow_ocd("127.0.0.1", hung_ocd.port(), 100);
+    auto start = std::chrono::steady_clock::now();
+    failed = false;
+    try
+    {
+      slow_ocd.command("halt");
+    }
+    catch (const std::runtime_error &)
+    {
+      failed = true;
+    }
+    double waited = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    check(failed && waited < 1, "openocd timeout");
+    failed = false;
+    try
+    {
+      slow_ocd.command("halt");
+    }
+    catch (const std::runtime_error &)
+    {
+      failed = true;
+    }
+    check(failed, "openocd after a timeout");
+  }
+  catch (const std::exception & e)
+  {
+    printf("FAIL: %s\n", e.what());
+    ++failures;
+  }
+  
+  printf("%u failures\n", failures);
+  return failures ? 1 : 0;
+}
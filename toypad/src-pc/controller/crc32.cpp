@@ -0,0 +1,26 @@
+#include "crc32.hpp"
+
+static uint32_t table[256];
+
+static bool make_table()
+{
+  for (uint32_t n = 0; n < 256; ++n)
+  {
+    uint32_t c = n;
+    for (int k = 0; k < 8; ++k)
+      c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+    table[n] = c;
+  }
+  return true;
+}
+
+uint32_t crc32(const void * data, size_t size, uint32_t crc)
+{
+  static bool made = make_table();
+  (void) made;
+  const uint8_t * bytes = (const uint8_t *) data;
+  crc = ~crc;
+  for (size_t i = 0; i < size; ++i)
+    crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+  return ~crc;
+}
@@ -0,0 +1,11 @@
+#ifndef _CRC32_HPP_
+#define _CRC32_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC-32 of zlib/PNG/Ethernet (reflected 0xEDB88320). Pass the previous 
+// result as crc to continue over more data.
+uint32_t crc32(const void * data, size_t size, uint32_t crc = 0);
+
+#endif /* _CRC32_HPP_ */
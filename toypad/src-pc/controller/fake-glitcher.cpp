@@ -0,0 +1,358 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "fake-glitcher.hpp"
+
+// The constants of glitcher.hpp the commands depend on.
+#define MIN_TIMER4_TICKS_BEFORE_OVERFLOW			64
+#define CPU_CYCLES_BEFORE_STARTING_TIMER1			3
+#define TIMER1_INTERRUPT_CPU_CYCLES_BEFORE_STARTING_TIMER4	17
+#define TIMER4_INTERRUPT_CPU_CYCLES_BEFORE_STOPPING_TIMER4	17
+#define LOOP_MIN_PERIOD_CPU_CYCLES				512
+#define LOOP_MAX_PULSE_STEPS					1000
+#define MAX_GLITCH_TICKS_48MHZ					973
+#define MAX_GLITCH_TICKS_96MHZ					922
+
+// The markers of src-lpc/boot-marker, in CPU cycles after the release 
+// of the reset.
+#define FAKE_MARKER_1	1700
+#define FAKE_MARKER_2	2540
+
+FakeGlitcher::FakeGlitcher(FakeTarget & target, bool can_do_96mhz)
+  : target(target), can_do_96mhz(can_do_96mhz)
+{
+  master = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+  if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0)
+    throw std::runtime_error(std::string("fake glitcher: ") + strerror(errno));
+  slave_path = ptsname(master);
+  
+  // Raw until the client sets its own mode, so nothing echoes "READY" 
+  // back to us in the meantime.
+  int slave = open(slave_path.c_str(), O_RDWR | O_NOCTTY);
+  if (slave >= 0)
+  {
+    termios tio;
+    tcgetattr(slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+    close(slave);
+  }
+  thread = std::thread(&FakeGlitcher::run, this);
+}
+
+FakeGlitcher::~FakeGlitcher()
+{
+  stop = true;
+  thread.join();
+  close(master);
+}
+
+void FakeGlitcher::inject(Fault new_fault)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  fault = new_fault;
+}
+
+bool FakeGlitcher::read_byte(char & byte)
+{
+  while (!stop)
+  {
+    pollfd p = {master, POLLIN, 0};
+    if (poll(&p, 1, 50) <= 0)
+      continue;
+    ssize_t n = read(master, &byte, 1);
+    if (n == 1)
+      return true;
+    // EIO: nobody has the slave open (yet).
+    if (n < 0 && errno == EIO)
+      usleep(10000);
+  }
+  return false;
+}
+
+void FakeGlitcher::transmit(const std::string & text)
+{
+  if (write(master, text.data(), text.size()) < 0)
+    return;
+}
+
+// Like usart_transmit_num(): 4 hex digits.
+void FakeGlitcher::transmit_num(uint16_t num)
+{
+  char text[8];
+  snprintf(text, sizeof text, "%04X", num);
+  transmit(text);
+}
+
+// Like usart_receive_uint16(): digits until the first non-digit, with 
+// echo.
+uint16_t FakeGlitcher::receive_uint16()
+{
+  uint16_t value = 0;
+  char byte;
+  while (read_byte(byte))
+  {
+    transmit(std::string(1, byte));
+    if (byte < '0' || byte > '9')
+      break;
+    value = value * 10 + (byte - '0');
+  }
+  return value;
+}
+
+void FakeGlitcher::run()
+{
+  while (!stop)
+  {
+    transmit("READY\r\n");
+    char command;
+    if (!read_byte(command))
+      return;
+    ++commands;
+    
+    Fault now;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      now = fault;
+      fault = NONE;
+    }
+    if (reply_latency_us)
+      usleep(reply_latency_us);
+    transmit("\r\n" + std::string(1, command));
+    
+    if (now == RESET || now == SILENCE)
+    {
+      // Swallow the rest of the command.
+      char byte;
+      while (command != '\n' && read_byte(byte) && byte != '\n')
+        ;
+      if (now == SILENCE)
+      {
+        // Wait for the next command without a "READY".
+        if (!read_byte(command))
+          return;
+        transmit("\r\n" + std::string(1, command) + "FAIL\r\n");
+      }
+      continue;
+    }
+    if (now == GARBAGE)
+      transmit(std::string("\xff\x00\xfe", 3));
+    
+    switch (command)
+    {
+      case 'G':
+        command_glitch();
+        break;
+      case 'T':
+        command_timed_glitch();
+        break;
+      case 'R':
+        command_resolution();
+        break;
+      case 'S':
+        command_swd_oracle();
+        break;
+      case 'C':
+        command_calibrate();
+        break;
+      case 'L':
+        command_loop();
+        break;
+      default:
+        transmit("FAIL\r\n");
+    }
+  }
+}
+
+void FakeGlitcher::glitch(uint16_t post_reset_steps, uint16_t glitch_steps)
+{
+  char status = target.glitch(post_reset_steps, glitch_steps);
+  if (swd_oracle)
+    transmit(std::string("STATUS ") + status + "\r\n");
+  transmit("DONE\r\n");
+}
+
+void FakeGlitcher::command_glitch()
+{
+  uint16_t post_reset_steps = receive_uint16();
+  uint16_t glitch_steps = receive_uint16();
+  if (glitch_steps <= 1)
+  {
+    transmit("FAIL: GLITCH TOO SHORT\r\n");
+    return;
+  }
+  // Timer 4 counts glitch_steps ticks, at 96 MHz or 48 MHz; with dead 
+  // time at 48 MHz, the end rounded up to a whole tick.
+  unsigned glitch_ticks = glitch_steps;
+  unsigned max_glitch_ticks = MAX_GLITCH_TICKS_48MHZ;
+  if (resolution == 2 && can_do_96mhz)
+    max_glitch_ticks = MAX_GLITCH_TICKS_96MHZ;
+  else if (resolution == 2)
+    glitch_ticks = (post_reset_steps + glitch_steps + 1) / 2 - post_reset_steps / 2;
+  if (glitch_ticks > max_glitch_ticks)
+  {
+    transmit("FAIL: GLITCH TOO LONG\r\n");
+    return;
+  }
+  if (post_reset_steps / resolution <= MIN_TIMER4_TICKS_BEFORE_OVERFLOW)
+  {
+    transmit("FAIL\r\n");
+    return;
+  }
+  transmit("Timer 1 ticks before glitch: ");
+  transmit_num((post_reset_steps / resolution - MIN_TIMER4_TICKS_BEFORE_OVERFLOW) / 3);
+  transmit("; timer 4 ticks before glitch: ");
+  transmit_num((post_reset_steps / resolution - MIN_TIMER4_TICKS_BEFORE_OVERFLOW) % 3
+               + MIN_TIMER4_TICKS_BEFORE_OVERFLOW);
+  transmit(".\r\n");
+  glitch(post_reset_steps, glitch_steps);
+}
+
+// The inverse of the arithmetic of command 'G' (and of 
+// src-pc/timing.py): back from the registers to steps.
+void FakeGlitcher::command_timed_glitch()
+{
+  uint16_t tcnt1  = receive_uint16();
+  uint16_t tcnt4  = receive_uint16();
+  uint16_t ocr4b  = receive_uint16();
+  uint16_t dt4    = receive_uint16();
+  uint16_t tccr4b = receive_uint16();
+  transmit("\r\n");
+  // CS4: /1 or /2, optionally with PSR4 (0x40); the dead time only 
+  // with PSR4.
+  uint16_t cs4 = tccr4b & ~0x40;
+  bool dead_time = cs4 == 0x02;
+  unsigned ticks_per_cpu_cycle = resolution == 2 && !dead_time ? 6 : 3;
+  if (tcnt1 == 0
+   || tcnt4 > (1 << 10) - MIN_TIMER4_TICKS_BEFORE_OVERFLOW
+   || ocr4b < 1
+   || ocr4b + TIMER4_INTERRUPT_CPU_CYCLES_BEFORE_STOPPING_TIMER4 * ticks_per_cpu_cycle >= (1 << 10)
+   || (cs4 != 0x01 && cs4 != 0x02)
+   || dt4 > 0xFF
+   || (dt4 && !(tccr4b & 0x40)))
+  {
+    transmit("FAIL: BAD REGISTERS\r\n");
+    return;
+  }
+  
+  unsigned timer1_ticks = 0x10000 - tcnt1
+                        + TIMER1_INTERRUPT_CPU_CYCLES_BEFORE_STARTING_TIMER4
+                        - CPU_CYCLES_BEFORE_STARTING_TIMER1;
+  unsigned post_reset_ticks = timer1_ticks * ticks_per_cpu_cycle + (1024 - tcnt4);
+  unsigned glitch_ticks = ocr4b + 1;
+  if (dead_time)
+  {
+    unsigned dead = dt4 >> 4;
+    glitch(2 * post_reset_ticks + dead, 2 * glitch_ticks - dead);
+  }
+  else
+  {
+    glitch(post_reset_ticks, glitch_ticks);
+  }
+}
+
+void FakeGlitcher::command_resolution()
+{
+  uint16_t wanted = receive_uint16();
+  if (wanted != 1 && wanted != 2)
+  {
+    transmit("FAIL: UNKNOWN RESOLUTION\r\n");
+    return;
+  }
+  resolution = wanted;
+  if (wanted == 2 && !can_do_96mhz)
+    transmit("FALLBACK\r\n");
+  if (resolution == 1)
+    transmit("RESOLUTION 1: 48 MHz\r\n");
+  else if (can_do_96mhz)
+    transmit("RESOLUTION 2: 96 MHz\r\n");
+  else
+    transmit("RESOLUTION 2: 96 MHz DEAD TIME\r\n");
+  transmit("DONE\r\n");
+}
+
+void FakeGlitcher::command_swd_oracle()
+{
+  swd_oracle = receive_uint16() != 0;
+  transmit("\r\n");
+  transmit(swd_oracle ? "SWD ORACLE ON\r\n" : "SWD ORACLE OFF\r\n");
+  transmit("DONE\r\n");
+}
+
+void FakeGlitcher::command_calibrate()
+{
+  uint16_t boots = receive_uint16();
+  transmit("\r\n");
+  for (uint16_t boot = 0; boot < boots; ++boot)
+  {
+    transmit("C ");
+    transmit_num(boot);
+    // A little jitter, as the boot ROM has.
+    transmit(" ");
+    transmit_num(FAKE_MARKER_1 + boot % 3);
+    transmit(" ");
+    transmit_num(FAKE_MARKER_2 + boot % 3);
+    transmit("\r\n");
+  }
+  transmit("DONE\r\n");
+}
+
+void FakeGlitcher::command_loop()
+{
+  uint16_t period_cycles = receive_uint16();
+  uint16_t pulse_steps   = receive_uint16();
+  uint16_t max_pulses    = receive_uint16();
+  transmit("\r\n");
+  if (period_cycles < LOOP_MIN_PERIOD_CPU_CYCLES)
+  {
+    transmit("FAIL: PERIOD TOO SHORT\r\n");
+    return;
+  }
+  if (pulse_steps > LOOP_MAX_PULSE_STEPS)
+  {
+    transmit("FAIL: GLITCH TOO LONG\r\n");
+    return;
+  }
+  if (pulse_steps <= 1)
+  {
+    transmit("FAIL: GLITCH TOO SHORT\r\n");
+    return;
+  }
+  transmit("Looping: period = ");
+  transmit_num(period_cycles);
+  transmit("; pulse steps = ");
+  transmit_num(pulse_steps);
+  transmit(".\r\n");
+  
+  // Pulses at any offset: the width decides. A hit width faults after 
+  // a while, a reset width reboots the target every pulse.
+  char outcome = target.expected(target.hit_post(), pulse_steps, 1);
+  bool faulted = outcome == '!';
+  uint16_t pulses = faulted ? 100 + pulse_steps : max_pulses;
+  transmit("PULSES ");
+  transmit_num(0);
+  transmit_num(pulses);
+  transmit("\r\nRESETS ");
+  transmit_num(outcome == 'r' ? pulses : 0);
+  transmit("\r\n");
+  if (faulted)
+  {
+    transmit("FAULT ");
+    transmit_num(16);
+    transmit(" ");
+    transmit_num(16 + pulse_steps / 3);
+    transmit("\r\n");
+  }
+  else
+  {
+    transmit("NO FAULT\r\n");
+  }
+  transmit("DONE\r\n");
+}
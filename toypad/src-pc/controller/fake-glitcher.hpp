@@ -0,0 +1,70 @@
+#ifndef _FAKE_GLITCHER_HPP_
+#define _FAKE_GLITCHER_HPP_
+
+#include <atomic>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+
+#include "fake-target.hpp"
+
+// The serial side of the glitcher firmware (src-avr/glitcher.cpp) on a 
+// pseudo terminal: the main loop ("READY", echo of every character), 
+// and the commands G, T, R, S, C and L, with glitches going to a 
+// FakeTarget. Open path() like the real /dev/ttyUSB0. Runs in its own 
+// thread.
+// 
+// To test the host side, the next reply can be spoiled (inject()), and 
+// every reply can be held back like a USB serial converter does 
+// (reply_latency_us).
+class FakeGlitcher
+{
+  public:
+    enum Fault
+    {
+      NONE,
+      GARBAGE,		// Line noise in the middle of the reply.
+      RESET,		// Reset after the echo: "READY", no reply.
+      SILENCE,		// The reply is lost.
+    };
+    
+    FakeGlitcher(FakeTarget & target, bool can_do_96mhz = true);
+    ~FakeGlitcher();
+    
+    const std::string & path() const { return slave_path; }
+    
+    void inject(Fault fault);
+    std::atomic<unsigned> reply_latency_us{0};
+    
+    std::atomic<unsigned> commands{0};
+    
+  private:
+    void run();
+    bool read_byte(char & byte);
+    uint16_t receive_uint16();
+    void transmit(const std::string & text);
+    void transmit_num(uint16_t num);
+    void command_glitch();
+    void command_timed_glitch();
+    void command_resolution();
+    void command_swd_oracle();
+    void command_calibrate();
+    void command_loop();
+    void glitch(uint16_t post_reset_steps, uint16_t glitch_steps);
+    
+    FakeTarget & target;
+    bool can_do_96mhz;
+    int master = -1;
+    std::string slave_path;
+    std::atomic<bool> stop{false};
+    std::thread thread;
+    
+    std::mutex mutex;
+    Fault fault = NONE;
+    
+    unsigned resolution = 1;
+    bool swd_oracle = false;
+};
+
+#endif /* _FAKE_GLITCHER_HPP_ */
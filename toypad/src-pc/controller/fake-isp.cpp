@@ -0,0 +1,319 @@
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "fake-isp.hpp"
+#include "isp.hpp"
+
+#define RAM_START	0x10000000
+#define RAM_SIZE	(8 * 1024)
+#define CRP_ADDRESS	0x2FC
+
+// The CRP levels that block command 'R' (NO_ISP and CRP3 do not even get 
+// here).
+#define CRP1		0x12345678
+#define CRP2		0x87654321
+#define CRP3		0x43218765
+
+static speed_t termios_speed(unsigned baud)
+{
+  switch (baud)
+  {
+    case   9600: return B9600;
+    case  19200: return B19200;
+    case  38400: return B38400;
+    case  57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+  }
+  return B0;
+}
+
+FakeIsp::FakeIsp(const std::vector<uint8_t> & flash, unsigned baud)
+  : baud(baud), flash(flash), crp(0)
+{
+  if (this->flash.size() >= CRP_ADDRESS + 4)
+    for (int i = 3; i >= 0; --i)
+      crp = crp << 8 | this->flash[CRP_ADDRESS + i];
+  
+  master = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+  if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0)
+    throw std::runtime_error(std::string("fake isp: ") + strerror(errno));
+  slave_path = ptsname(master);
+  
+  // Raw until the client sets its own mode.
+  int slave = open(slave_path.c_str(), O_RDWR | O_NOCTTY);
+  if (slave >= 0)
+  {
+    termios tio;
+    tcgetattr(slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+    close(slave);
+  }
+  thread = std::thread(&FakeIsp::run, this);
+}
+
+FakeIsp::~FakeIsp()
+{
+  stop = true;
+  thread.join();
+  close(master);
+}
+
+bool FakeIsp::read_byte(char & byte)
+{
+  while (!stop)
+  {
+    pollfd p = {master, POLLIN, 0};
+    if (poll(&p, 1, 50) <= 0)
+      continue;
+    ssize_t n = read(master, &byte, 1);
+    if (n == 1)
+      return true;
+    // EIO: nobody has the slave open (yet).
+    if (n < 0 && errno == EIO)
+      usleep(10000);
+  }
+  return false;
+}
+
+// A line without its "\r\n". Garbage at the wrong rate.
+bool FakeIsp::read_line(std::string & line)
+{
+  line.clear();
+  char byte;
+  while (read_byte(byte))
+  {
+    if (byte == '\n')
+    {
+      if (wrong_rate())
+        line = "\xff";
+      return true;
+    }
+    if (byte != '\r')
+      line += byte;
+  }
+  return false;
+}
+
+bool FakeIsp::pending_input()
+{
+  pollfd p = {master, POLLIN, 0};
+  return poll(&p, 1, 0) > 0;
+}
+
+// The rate of the other side: the settings of the slave.
+bool FakeIsp::wrong_rate()
+{
+  int slave = open(slave_path.c_str(), O_RDWR | O_NOCTTY);
+  if (slave < 0)
+    return false;
+  termios tio;
+  bool wrong = tcgetattr(slave, &tio) == 0 && cfgetospeed(&tio) != termios_speed(baud);
+  close(slave);
+  return wrong;
+}
+
+void FakeIsp::transmit(const std::string & text)
+{
+  std::string wire = text;
+  if (wrong_rate() || baud == broken_baud)
+    for (char & c : wire)
+      c = (char) 0xFF;
+  if (write(master, wire.data(), wire.size()) < 0)
+    return;
+}
+
+void FakeIsp::run()
+{
+  // The autobaud: a '?' at the rate of the host, then the handshake.
+  while (!stop)
+  {
+    char byte;
+    if (!read_byte(byte))
+      return;
+    if (byte != '?')
+      continue;
+    transmit("Synchronized\r\n");
+    std::string line;
+    if (!read_line(line))
+      return;
+    if (line != "Synchronized")
+      continue;
+    transmit(line + "\r\nOK\r\n");
+    if (!read_line(line))
+      return;
+    transmit(line + "\r\nOK\r\n");
+    break;
+  }
+  
+  std::string line;
+  while (read_line(line))
+    command(line);
+}
+
+static std::vector<std::string> split(const std::string & line)
+{
+  std::vector<std::string> words;
+  size_t start = 0;
+  while (start < line.size())
+  {
+    size_t end = line.find(' ', start);
+    if (end == std::string::npos)
+      end = line.size();
+    if (end > start)
+      words.push_back(line.substr(start, end - start));
+    start = end + 1;
+  }
+  return words;
+}
+
+static bool number(const std::string & word, uint32_t & value)
+{
+  char * end;
+  value = strtoul(word.c_str(), &end, 10);
+  return !word.empty() && !*end;
+}
+
+void FakeIsp::command(const std::string & line)
+{
+  ++commands;
+  if (echo)
+    transmit(line + "\r\n");
+  auto code = [this](int code)
+  {
+    transmit(std::to_string(code) + "\r\n");
+  };
+  
+  std::vector<std::string> words = split(line);
+  std::vector<uint32_t> args;
+  for (size_t i = 1; i < words.size(); ++i)
+  {
+    uint32_t value;
+    if (!number(words[i], value))
+      return code(ISP_PARAM_ERROR);
+    args.push_back(value);
+  }
+  std::string name = words.empty() ? "" : words[0];
+  
+  if (name == "A" && args.size() == 1)
+  {
+    if (args[0] > 1)
+      return code(ISP_PARAM_ERROR);
+    code(ISP_CMD_SUCCESS);
+    echo = args[0];
+  }
+  else if (name == "U" && args.size() == 1)
+  {
+    code(args[0] == 23130 ? ISP_CMD_SUCCESS : ISP_INVALID_CODE);
+  }
+  else if (name == "B" && args.size() == 2)
+  {
+    if (termios_speed(args[0]) == B0 || args[0] > max_baud)
+      return code(ISP_INVALID_BAUD_RATE);
+    if (args[1] != 1 && args[1] != 2)
+      return code(ISP_INVALID_STOP_BIT);
+    code(ISP_CMD_SUCCESS);
+    baud = args[0];
+  }
+  else if (name == "J" && args.empty())
+  {
+    code(ISP_CMD_SUCCESS);
+    transmit(std::to_string(part_id) + "\r\n");
+  }
+  else if (name == "K" && args.empty())
+  {
+    code(ISP_CMD_SUCCESS);
+    transmit(std::to_string(version_minor) + "\r\n" + std::to_string(version_major) + "\r\n");
+  }
+  else if (name == "N" && args.empty())
+  {
+    code(ISP_CMD_SUCCESS);
+    for (uint32_t word : uid)
+      transmit(std::to_string(word) + "\r\n");
+  }
+  else if (name == "R" && args.size() == 2)
+  {
+    if (crp == CRP1 || crp == CRP2 || crp == CRP3)
+      return code(ISP_CODE_READ_PROTECTION_ENABLED);
+    if (args[0] % 4)
+      return code(ISP_ADDR_ERROR);
+    if (args[1] % 4)
+      return code(ISP_COUNT_ERROR);
+    if (!mapped(args[0], args[1]))
+      return code(ISP_ADDR_NOT_MAPPED);
+    code(ISP_CMD_SUCCESS);
+    command_read(args[0], args[1]);
+  }
+  else
+  {
+    code(ISP_INVALID_COMMAND);
+  }
+}
+
+bool FakeIsp::mapped(uint32_t address, uint32_t count) const
+{
+  uint64_t end = (uint64_t) address + count;
+  if (end <= flash.size())
+    return true;
+  return address >= RAM_START && end <= RAM_START + RAM_SIZE;
+}
+
+uint8_t FakeIsp::byte_at(uint32_t address) const
+{
+  return address < flash.size() ? flash[address] : 0;
+}
+
+void FakeIsp::command_read(uint32_t address, uint32_t count)
+{
+  for (uint32_t done = 0; done < count; )
+  {
+    uint32_t size = std::min<uint32_t>(count - done, ISP_BYTES_PER_CHECKSUM);
+    bool corrupt = false;
+    for (unsigned expected = corrupt_blocks; expected && !corrupt; )
+      corrupt = corrupt_blocks.compare_exchange_weak(expected, expected - 1);
+    
+    std::string text;
+    uint32_t checksum = 0;
+    for (uint32_t line = 0; line < size; line += ISP_BYTES_PER_LINE)
+    {
+      uint8_t bytes[ISP_BYTES_PER_LINE];
+      uint32_t n = std::min<uint32_t>(size - line, ISP_BYTES_PER_LINE);
+      for (uint32_t i = 0; i < n; ++i)
+      {
+        bytes[i] = byte_at(address + done + line + i);
+        checksum += bytes[i];
+      }
+      text += isp_uuencode(bytes, n) + "\r\n";
+    }
+    // The first character of data of the first line.
+    if (corrupt && text.size() > 1)
+      text[1] = text[1] == '!' ? '"' : '!';
+    transmit(text + std::to_string(checksum) + "\r\n");
+    
+    std::string reply;
+    awaiting_ack = true;
+    bool replied = read_line(reply);
+    awaiting_ack = false;
+    if (!replied)
+      return;
+    if (reply == "RESEND")
+    {
+      ++resends;
+      continue;
+    }
+    if (reply != "OK")
+      return;
+    done += size;
+    if (done == count && pending_input())
+      ++pipelined_acks;
+  }
+}
@@ -0,0 +1,76 @@
+#ifndef _FAKE_ISP_HPP_
+#define _FAKE_ISP_HPP_
+
+#include <array>
+#include <atomic>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// The UART ISP of the boot ROM (see isp.hpp) on a pseudo terminal: the 
+// autobaud handshake, echo, and the commands A, B, J, K, N, R and U, on 
+// a flash image and a RAM full of zeroes. Open path() like the real 
+// /dev/ttyUSB0. Runs in its own thread.
+// 
+// After command 'B' it only talks at the new rate: as long as the rate 
+// the other side of the pty is set to differs, everything it sends is 
+// garbage, like a real UART at the wrong rate.
+// 
+// To test the host side, the next corrupt_blocks blocks that command 
+// 'R' sends (again, after a "RESEND", counts too) each get one wrong 
+// character.
+class FakeIsp
+{
+  public:
+    // The code read protection is the word at 0x2FC of the flash, as 
+    // for the boot ROM. baud: the rate of the autobaud.
+    FakeIsp(const std::vector<uint8_t> & flash, unsigned baud = 115200);
+    ~FakeIsp();
+    
+    const std::string & path() const { return slave_path; }
+    
+    // Set these before the host synchronizes.
+    uint32_t part_id = 0x0001BC40;	// LPC11U35/401
+    unsigned version_major = 7;
+    unsigned version_minor = 1;
+    std::array<uint32_t, 4> uid = {{0x4B0C1E25, 0x0E5B4AF8, 0x54A8D5C2, 0xF5000004}};
+    // The fastest rate command 'B' accepts.
+    unsigned max_baud = 230400;
+    // A rate command 'B' accepts, at which the fake still understands 
+    // the host but all it sends is garbage (0: none).
+    unsigned broken_baud = 0;
+    
+    std::atomic<unsigned> corrupt_blocks{0};
+    
+    std::atomic<unsigned> baud;
+    std::atomic<unsigned> commands{0};
+    std::atomic<unsigned> resends{0};
+    // "OK"s of the last block of a command 'R' that arrived together with 
+    // the next command.
+    std::atomic<unsigned> pipelined_acks{0};
+    // Command 'R' sent a block, and waits for its "OK" or "RESEND".
+    std::atomic<bool> awaiting_ack{false};
+  
+  private:
+    void run();
+    bool read_byte(char & byte);
+    bool read_line(std::string & line);
+    bool pending_input();
+    void transmit(const std::string & text);
+    bool wrong_rate();
+    void command(const std::string & line);
+    void command_read(uint32_t address, uint32_t count);
+    bool mapped(uint32_t address, uint32_t count) const;
+    uint8_t byte_at(uint32_t address) const;
+    
+    std::vector<uint8_t> flash;
+    uint32_t crp;
+    bool echo = true;
+    int master = -1;
+    std::string slave_path;
+    std::atomic<bool> stop{false};
+    std::thread thread;
+};
+
+#endif /* _FAKE_ISP_HPP_ */
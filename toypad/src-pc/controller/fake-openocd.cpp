@@ -0,0 +1,170 @@
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "fake-openocd.hpp"
+#include "tcl-rpc.hpp"
+
+FakeOpenocd::FakeOpenocd(FakeTarget & target, uint16_t port)
+  : target(target)
+{
+  listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  int one = 1;
+  setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(port);
+  socklen_t length = sizeof address;
+  if (bind(listen_fd, (sockaddr *) &address, sizeof address) < 0
+   || listen(listen_fd, 1) < 0
+   || getsockname(listen_fd, (sockaddr *) &address, &length) < 0)
+    throw std::runtime_error(std::string("fake openocd: ") + strerror(errno));
+  listen_port = ntohs(address.sin_port);
+  thread = std::thread(&FakeOpenocd::serve, this);
+}
+
+FakeOpenocd::~FakeOpenocd()
+{
+  stop = true;
+  thread.join();
+  close(listen_fd);
+}
+
+void FakeOpenocd::serve()
+{
+  while (!stop)
+  {
+    pollfd p = {listen_fd, POLLIN, 0};
+    if (poll(&p, 1, 50) <= 0)
+      continue;
+    int client = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (client < 0)
+      continue;
+    int one = 1;
+    setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+    serve_client(client);
+    close(client);
+  }
+}
+
+void FakeOpenocd::serve_client(int client)
+{
+  std::string buffer;
+  while (!stop)
+  {
+    pollfd p = {client, POLLIN, 0};
+    if (poll(&p, 1, 50) <= 0)
+      continue;
+    char chunk[4096];
+    ssize_t n = recv(client, chunk, sizeof chunk, 0);
+    if (n <= 0)
+      return;
+    buffer.append(chunk, n);
+    
+    // Answer all complete commands of a pipelined batch in one send, 
+    // unless they take time.
+    std::string out;
+    size_t end;
+    while ((end = buffer.find(TclRpc::TERMINATOR)) != std::string::npos)
+    {
+      std::string command = buffer.substr(0, end);
+      buffer.erase(0, end + 1);
+      unsigned latency_us = command == "reset run" && reset_latency_us
+                          ? reset_latency_us : command_latency_us;
+      if (latency_us)
+      {
+        if (!out.empty() && send(client, out.data(), out.size(), MSG_NOSIGNAL) < 0)
+          return;
+        out.clear();
+        usleep(latency_us);
+      }
+      out += reply(command);
+      out += TclRpc::TERMINATOR;
+    }
+    if (!out.empty() && send(client, out.data(), out.size(), MSG_NOSIGNAL) < 0)
+      return;
+  }
+}
+
+std::string FakeOpenocd::reply(const std::string & command)
+{
+  ++commands;
+  
+  // if {[catch {<command>} r]} {set r "ERROR $r"} else {set r}
+  static const std::string catch_start = "if {[catch {";
+  static const std::string catch_end = "} r]}";
+  if (command.compare(0, catch_start.size(), catch_start) == 0)
+  {
+    size_t end = command.find(catch_end);
+    std::string inner = command.substr(catch_start.size(), end - catch_start.size());
+    std::string result;
+    if (!execute(inner, result))
+      return "ERROR " + result;
+    return result;
+  }
+  
+  std::string result;
+  execute(command, result);
+  return result;
+}
+
+bool FakeOpenocd::execute(const std::string & command, std::string & result)
+{
+  result.clear();
+  if (command == "reset run")
+  {
+    target.reset_run();
+    return true;
+  }
+  if (command == "halt" || command == "halt 0" || command == "resume")
+  {
+    uint32_t pc;
+    if (target.read_pc(pc))
+      return true;
+    result = "Target not examined yet";
+    return false;
+  }
+  if (command.compare(0, 13, "set_reg {pc 0") == 0)
+  {
+    target.set_pc(strtoul(command.c_str() + 12, nullptr, 0));
+    return true;
+  }
+  if (command == "get_reg -force pc")
+  {
+    uint32_t pc;
+    if (!target.read_pc(pc))
+    {
+      result = "Target not examined yet";
+      return false;
+    }
+    char text[32];
+    snprintf(text, sizeof text, "pc 0x%08x", pc);
+    result = text;
+    return true;
+  }
+  if (command.compare(0, 4, "mdw ") == 0)
+  {
+    uint32_t address = strtoul(command.c_str() + 4, nullptr, 0);
+    uint32_t word;
+    if (!target.read_word(address, word))
+    {
+      result = "Target not examined yet";
+      return false;
+    }
+    char text[32];
+    snprintf(text, sizeof text, "0x%08x: %08x ", address, word);
+    result = text;
+    return true;
+  }
+  result = "invalid command name \"" + command + "\"";
+  return false;
+}
@@ -0,0 +1,44 @@
+#ifndef _FAKE_OPENOCD_HPP_
+#define _FAKE_OPENOCD_HPP_
+
+#include <atomic>
+#include <stdint.h>
+#include <string>
+#include <thread>
+
+#include "fake-target.hpp"
+
+// Just enough of the Tcl RPC server of openocd for the controller: 
+// "reset run", "halt", "halt 0", "set_reg {pc ...}", "resume", 
+// "get_reg -force pc", and the catch wrapper of TclRpc::catch_error(). 
+// Listens on 127.0.0.1 (port 0: any free port, see port()), serves one 
+// client at a time in its own thread.
+class FakeOpenocd
+{
+  public:
+    FakeOpenocd(FakeTarget & target, uint16_t port = 0);
+    ~FakeOpenocd();
+    
+    uint16_t port() const { return listen_port; }
+    
+    std::atomic<unsigned> commands{0};
+    
+    // Time every command takes (and "reset run", which takes longer on 
+    // real hardware); the replies of a batch then come one by one.
+    std::atomic<unsigned> command_latency_us{0};
+    std::atomic<unsigned> reset_latency_us{0};
+    
+  private:
+    void serve();
+    void serve_client(int client);
+    bool execute(const std::string & command, std::string & result);
+    std::string reply(const std::string & command);
+    
+    FakeTarget & target;
+    int listen_fd = -1;
+    uint16_t listen_port = 0;
+    std::atomic<bool> stop{false};
+    std::thread thread;
+};
+
+#endif /* _FAKE_OPENOCD_HPP_ */
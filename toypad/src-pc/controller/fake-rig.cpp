@@ -0,0 +1,106 @@
+// A fake rig for trying glitch-controller without hardware: a fake 
+// openocd (Tcl RPC) and a fake glitcher on a pseudo terminal, around 
+// one FakeTarget. Prints where to find them, then runs until killed.
+// 
+// Usage: fake-rig [--crp3] [--tcl-port <port>] [--latency-us <us>]
+//                 [--rigs <n>] [--flaky <glitches>]
+//                 [--ocd-latency-us <us>] [--reset-latency-us <us>]
+// 
+//   --crp3:       SWD only works after a hit, as on the real toypad 
+//                 (mode final).
+//   --latency-us: hold back every reply of the glitcher, like a USB 
+//                 serial converter does (16000 for an FTDI by default).
+//   --rigs:       that many rigs (for glitch-orchestrator), with Tcl 
+//                 ports from --tcl-port on.
+//   --flaky:      the last rig browns out on every glitch after that 
+//                 many glitches.
+//   --ocd-latency-us, --reset-latency-us: 
+//                 time every openocd command, and "reset run", takes.
+
+#include <memory>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+#include "fake-glitcher.hpp"
+#include "fake-openocd.hpp"
+#include "fake-target.hpp"
+
+static volatile sig_atomic_t stop = 0;
+
+static void on_signal(int)
+{
+  stop = 1;
+}
+
+int main(int argc, char ** argv)
+{
+  FakeTarget::Config config;
+  uint16_t tcl_port = 6666;
+  unsigned latency_us = 0;
+  unsigned rigs = 1;
+  unsigned flaky = 0;
+  unsigned ocd_latency_us = 0;
+  unsigned reset_latency_us = 0;
+  for (int i = 1; i < argc; ++i)
+  {
+    if (!strcmp(argv[i], "--crp3"))
+      config.crp3 = true;
+    else if (!strcmp(argv[i], "--tcl-port") && i + 1 < argc)
+      tcl_port = strtoul(argv[++i], nullptr, 0);
+    else if (!strcmp(argv[i], "--latency-us") && i + 1 < argc)
+      latency_us = strtoul(argv[++i], nullptr, 0);
+    else if (!strcmp(argv[i], "--rigs") && i + 1 < argc)
+      rigs = strtoul(argv[++i], nullptr, 0);
+    else if (!strcmp(argv[i], "--flaky") && i + 1 < argc)
+      flaky = strtoul(argv[++i], nullptr, 0);
+    else if (!strcmp(argv[i], "--ocd-latency-us") && i + 1 < argc)
+      ocd_latency_us = strtoul(argv[++i], nullptr, 0);
+    else if (!strcmp(argv[i], "--reset-latency-us") && i + 1 < argc)
+      reset_latency_us = strtoul(argv[++i], nullptr, 0);
+    else
+    {
+      fprintf(stderr, "Usage: %s [--crp3] [--tcl-port <port>] [--latency-us <us>]\n"
+                      "       [--rigs <n>] [--flaky <glitches>]\n"
+                      "       [--ocd-latency-us <us>] [--reset-latency-us <us>]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (!rigs)
+    rigs = 1;
+  
+  std::vector<std::unique_ptr<FakeTarget>> targets;
+  std::vector<std::unique_ptr<FakeOpenocd>> ocds;
+  std::vector<std::unique_ptr<FakeGlitcher>> glitchers;
+  for (unsigned rig = 0; rig < rigs; ++rig)
+  {
+    FakeTarget::Config rig_config = config;
+    if (rig == rigs - 1)
+      rig_config.brown_out_after = flaky;
+    targets.emplace_back(new FakeTarget(rig_config));
+    ocds.emplace_back(new FakeOpenocd(*targets.back(), tcl_port ? tcl_port + rig : 0));
+    ocds.back()->command_latency_us = ocd_latency_us;
+    ocds.back()->reset_latency_us = reset_latency_us;
+    glitchers.emplace_back(new FakeGlitcher(*targets.back()));
+    glitchers.back()->reply_latency_us = latency_us;
+    if (rigs == 1)
+      printf("glitcher: %s\nopenocd:  localhost:%u\n",
+             glitchers.back()->path().c_str(), ocds.back()->port());
+    else
+      printf("rig %u: --rig %s,localhost:%u\n", rig,
+             glitchers.back()->path().c_str(), ocds.back()->port());
+  }
+  printf("hits at delays %u..%u, widths %u..%u; resets from width %u\n",
+         config.hit_post_first, config.hit_post_last,
+         config.hit_width_first, config.hit_width_last, config.reset_width);
+  fflush(stdout);
+  
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+  while (!stop)
+    pause();
+  return 0;
+}
@@ -0,0 +1,76 @@
+#include "campaign.hpp"
+#include "fake-target.hpp"
+
+FakeTarget::FakeTarget(const Config & config)
+  : config(config), crp_register(expected_crp_register(config.flash_crp))
+{
+}
+
+char FakeTarget::expected(uint16_t post_reset_steps, uint16_t glitch_steps, unsigned number) const
+{
+  if (glitch_steps >= config.reset_width)
+    return 'r';
+  if (config.brown_out_after && number > config.brown_out_after)
+    return 'r';
+  if (config.restart_every && number % config.restart_every == 0)
+    return '0';
+  if (config.hit_post_first <= post_reset_steps && post_reset_steps <= config.hit_post_last
+   && config.hit_width_first <= glitch_steps && glitch_steps <= config.hit_width_last)
+    return '!';
+  return '.';
+}
+
+char FakeTarget::glitch(uint16_t post_reset_steps, uint16_t glitch_steps)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  ++glitches;
+  crp_register = expected_crp_register(config.flash_crp);
+  switch (expected(post_reset_steps, glitch_steps, glitches))
+  {
+    case 'r':
+      swd = false;
+      return '?';
+    case '0':
+      pc = 0x8ee;
+      swd = !config.crp3;
+      break;
+    case '!':
+      pc = config.hit_pc;
+      swd = true;
+      crp_register = config.hit_crp;
+      break;
+    default:
+      pc = config.miss_pc;
+      swd = !config.crp3;
+  }
+  return swd ? '!' : '.';
+}
+
+void FakeTarget::reset_run()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  pc = 0x8f0;
+  swd = !config.crp3;
+  crp_register = expected_crp_register(config.flash_crp);
+}
+
+void FakeTarget::set_pc(uint32_t new_pc)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  pc = new_pc;
+}
+
+bool FakeTarget::read_pc(uint32_t & pc_out)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  pc_out = pc;
+  return swd;
+}
+
+bool FakeTarget::read_word(uint32_t address, uint32_t & word)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  word = address == CRP_FLASH_ADDRESS ? config.flash_crp
+       : address == CRP_REGISTER ? crp_register : 0;
+  return swd;
+}
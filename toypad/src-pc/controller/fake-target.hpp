@@ -0,0 +1,75 @@
+#ifndef _FAKE_TARGET_HPP_
+#define _FAKE_TARGET_HPP_
+
+#include <mutex>
+#include <stdint.h>
+
+// The LPC11U35 as FakeGlitcher and FakeOpenocd see it: the glitcher 
+// glitches it, openocd reads its PC and memory. Thread safe, the two 
+// fakes run in their own threads.
+// 
+// A glitch hits if both its offset and its width are in the hit window, 
+// and browns the target out if it is at least reset_width wide. Every 
+// glitch resets the target, so the CRP check of the boot ROM stores 
+// the CRP register again: what the word at 0x2fc calls for, or after a 
+// hit hit_crp.
+class FakeTarget
+{
+  public:
+    struct Config
+    {
+      uint16_t hit_post_first = 1000;
+      uint16_t hit_post_last = 1003;
+      uint16_t hit_width_first = 20;
+      uint16_t hit_width_last = 22;
+      uint16_t reset_width = 30;
+      
+      // The PC after a hit, and after a miss.
+      uint32_t hit_pc = 0x908;
+      uint32_t miss_pc = 0x8f4;
+      
+      // CRP3: SWD only works after a hit.
+      bool crp3 = false;
+      
+      // The word at 0x2fc (no CRP), and what a hit stores in the CRP 
+      // register instead of it: CRP2, as if the compare with CRP1 had 
+      // been skipped.
+      uint32_t flash_crp = 0xffffffff;
+      uint32_t hit_crp = 0x87654321;
+      
+      // Every so many glitches, the target ends up at pc 0x8ee (0: never).
+      unsigned restart_every = 0;
+      
+      // A flaky rig: after so many glitches, every glitch browns the 
+      // target out (0: never).
+      unsigned brown_out_after = 0;
+    };
+    
+    FakeTarget(const Config & config);
+    
+    // The outcome of a glitch, in the characters of the controller 
+    // (with the PC checks of find-length).
+    char expected(uint16_t post_reset_steps, uint16_t glitch_steps, unsigned number) const;
+    uint16_t hit_post() const { return config.hit_post_first; }
+    
+    // Glitcher side. Returns the status of the SWD oracle.
+    char glitch(uint16_t post_reset_steps, uint16_t glitch_steps);
+    
+    // openocd side. read_pc() returns false if SWD does not work.
+    void reset_run();
+    void set_pc(uint32_t pc);
+    bool read_pc(uint32_t & pc);
+    // 0x2fc, the CRP register; 0 elsewhere.
+    bool read_word(uint32_t address, uint32_t & word);
+    
+    unsigned glitches = 0;
+    
+  private:
+    std::mutex mutex;
+    Config config;
+    uint32_t pc = 0x8f0;
+    bool swd = true;
+    uint32_t crp_register;
+};
+
+#endif /* _FAKE_TARGET_HPP_ */
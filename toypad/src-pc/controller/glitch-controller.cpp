@@ -0,0 +1,356 @@
+// Glitch campaign controller: the loop of run-glitch.py, without gdb.
+// 
+// Talks to openocd over its Tcl RPC port (start openocd with 
+// "-c 'tcl_port 6666'", the default) and to the glitcher over its 
+// serial port. Prints one character per attempt (see campaign.hpp), one 
+// line per post-reset delay, like run-glitch.py.
+// 
+// Usage: glitch-controller [options]
+// 
+//   --mode <find-length|find-delay|final>      (find-length)
+//   --serial <port>                            (/dev/ttyUSB0)
+//   --baud <rate>                              (115200)
+//   --openocd <host>:<port>                    (localhost:6666)
+//   --delays <first>:<last>                    (9900:9908)
+//   --widths <first>:<last>                    (135:264)
+//   --resolution <1|2>                         (1)
+//   --swd-oracle                               let the glitcher check SWD
+//   --rounds <n>                               (0: forever)
+//   --log <file>                               append every attempt to 
+//                                              this attempt log
+//   --rig <n>                                  rig number in the log (0)
+//   --resume                                   skip as many attempts as 
+//                                              the log already holds of 
+//                                              this rig, mode, delays and 
+//                                              widths
+//   --schedule <sweep|adaptive>                (sweep)
+//   --batch <n>                                glitches per batch of the 
+//                                              adaptive scheduler (64)
+//   --explore <rate>                           fraction of random 
+//                                              glitches of the adaptive 
+//                                              scheduler (0.05)
+//   --metrics <port|unix:path>                 serve the metrics (see 
+//                                              metrics.hpp) to Prometheus 
+//                                              on this port of localhost, 
+//                                              or Unix socket
+// 
+// Delays and widths are in steps of the resolution, like command 'G'. 
+// See attempt-query for the log.
+// 
+// The sweep tries every width of a delay, then the next delay, like 
+// run-glitch.py. The adaptive scheduler (see scheduler.hpp) spends its 
+// glitches where the hits are, and prints one line per batch; with 
+// --resume it first learns from the attempts in the log. --rounds then 
+// limits the attempts to as many as that many sweeps. See 
+// schedule-replay for what the scheduler gains on a rig.
+// 
+// At the end (or on Ctrl-C) it prints where the time of the attempts 
+// went, phase by phase.
+
+#include <algorithm>
+#include <chrono>
+#include <getopt.h>
+#include <memory>
+#include <signal.h>
+#include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "attempt-log.hpp"
+#include "campaign.hpp"
+#include "glitcher-link.hpp"
+#include "metrics.hpp"
+#include "scheduler.hpp"
+#include "serial-port.hpp"
+#include "tcl-rpc.hpp"
+
+static volatile sig_atomic_t stop = 0;
+
+static void on_signal(int)
+{
+  stop = 1;
+}
+
+static void usage(const char * program)
+{
+  fprintf(stderr,
+    "Usage: %s [--mode find-length|find-delay|final] [--serial <port>]\n"
+    "       [--baud <rate>] [--openocd <host>:<port>] [--delays <first>:<last>]\n"
+    "       [--widths <first>:<last>] [--resolution 1|2] [--swd-oracle]\n"
+    "       [--rounds <n>] [--log <file>] [--rig <n>] [--resume]\n"
+    "       [--schedule sweep|adaptive] [--batch <n>] [--explore <rate>]\n"
+    "       [--metrics <port|unix:path>]\n", program);
+  exit(2);
+}
+
+int main(int argc, char ** argv)
+{
+  Mode mode = Mode::FIND_LENGTH;
+  std::string serial = "/dev/ttyUSB0";
+  unsigned baud = 115200;
+  std::string ocd_host = "localhost";
+  uint16_t ocd_port = 6666;
+  Range delays = {9900, 9908};
+  Range widths = {135, 264};
+  unsigned resolution = 1;
+  bool swd_oracle = false;
+  unsigned rounds = 0;
+  std::string log_path;
+  unsigned rig = 0;
+  bool resume = false;
+  bool adaptive = false;
+  unsigned batch = 64;
+  double explore = 0.05;
+  std::string metrics_address;
+  
+  static const option options[] = {
+    {"mode",       required_argument, nullptr, 'm'},
+    {"serial",     required_argument, nullptr, 's'},
+    {"baud",       required_argument, nullptr, 'b'},
+    {"openocd",    required_argument, nullptr, 'o'},
+    {"delays",     required_argument, nullptr, 'd'},
+    {"widths",     required_argument, nullptr, 'w'},
+    {"resolution", required_argument, nullptr, 'r'},
+    {"swd-oracle", no_argument,       nullptr, 'S'},
+    {"rounds",     required_argument, nullptr, 'n'},
+    {"log",        required_argument, nullptr, 'l'},
+    {"rig",        required_argument, nullptr, 'g'},
+    {"resume",     no_argument,       nullptr, 'R'},
+    {"schedule",   required_argument, nullptr, 'a'},
+    {"batch",      required_argument, nullptr, 'B'},
+    {"explore",    required_argument, nullptr, 'e'},
+    {"metrics",    required_argument, nullptr, 'M'},
+    {nullptr,      0,                 nullptr, 0},
+  };
+  int option;
+  while ((option = getopt_long(argc, argv, "", options, nullptr)) != -1)
+  {
+    switch (option)
+    {
+      case 'm':
+        if (!parse_mode(optarg, mode))
+          usage(argv[0]);
+        break;
+      case 's': serial = optarg; break;
+      case 'b': baud = strtoul(optarg, nullptr, 0); break;
+      case 'o':
+      {
+        const char * colon = strrchr(optarg, ':');
+        if (!colon)
+          usage(argv[0]);
+        ocd_host.assign(optarg, colon - optarg);
+        ocd_port = strtoul(colon + 1, nullptr, 0);
+        break;
+      }
+      case 'd':
+        if (!parse_range(optarg, delays))
+          usage(argv[0]);
+        break;
+      case 'w':
+        if (!parse_range(optarg, widths))
+          usage(argv[0]);
+        break;
+      case 'r': resolution = strtoul(optarg, nullptr, 0); break;
+      case 'S': swd_oracle = true; break;
+      case 'n': rounds = strtoul(optarg, nullptr, 0); break;
+      case 'l': log_path = optarg; break;
+      case 'g': rig = strtoul(optarg, nullptr, 0); break;
+      case 'R': resume = true; break;
+      case 'a':
+        if (strcmp(optarg, "sweep") && strcmp(optarg, "adaptive"))
+          usage(argv[0]);
+        adaptive = !strcmp(optarg, "adaptive");
+        break;
+      case 'B': batch = strtoul(optarg, nullptr, 0); break;
+      case 'e': explore = strtod(optarg, nullptr); break;
+      case 'M': metrics_address = optarg; break;
+      default: usage(argv[0]);
+    }
+  }
+  if (optind != argc || (resume && log_path.empty()) || rig > 0xFF || !batch)
+    usage(argv[0]);
+  
+  try
+  {
+    Metrics metrics;
+    std::unique_ptr<MetricsServer> metrics_server;
+    if (!metrics_address.empty())
+      metrics_server.reset(new MetricsServer(metrics, metrics_address));
+    
+    SerialPort port(serial, baud);
+    if (!port.low_latency())
+      fprintf(stderr, "%s: no low latency mode, every reply may wait for the latency timer.\n",
+              serial.c_str());
+    GlitcherLink glitcher(port);
+    glitcher.metrics = &metrics;
+    unsigned actual = glitcher.set_resolution(resolution);
+    if (actual != resolution)
+    {
+      fprintf(stderr, "Glitcher cannot do resolution %u, falling back.\n", resolution);
+      delays = {delays.first * actual / resolution, delays.last * actual / resolution};
+      widths = {widths.first * actual / resolution, widths.last * actual / resolution};
+    }
+    glitcher.set_swd_oracle(swd_oracle);
+    
+    std::unique_ptr<TclRpc> ocd;
+    if (!(mode == Mode::FINAL && swd_oracle))
+    {
+      ocd.reset(new TclRpc(ocd_host, ocd_port));
+      ocd->metrics = &metrics;
+    }
+    Campaign campaign(mode, glitcher, ocd.get(), swd_oracle);
+    campaign.metrics = &metrics;
+    
+    std::unique_ptr<AttemptLogWriter> log;
+    uint64_t skip = 0;
+    if (!log_path.empty())
+    {
+      log.reset(new AttemptLogWriter(log_path));
+      if (log->recovered_bytes)
+        fprintf(stderr, "%s: cut off %llu bytes after the last good block.\n",
+                log_path.c_str(), (unsigned long long) log->recovered_bytes);
+      if (resume && !adaptive)
+      {
+        // Only the attempts of this sweep; the log may hold other rigs, 
+        // modes, delays and widths too.
+        AttemptLogReader reader(log_path);
+        for (const attempt_log::Columns & b : reader.blocks())
+          for (size_t i = 0; i < b.count; ++i)
+            if (b.rig[i] == rig && b.target[i] == (uint8_t) mode
+                && b.delay[i] >= delays.first && b.delay[i] <= delays.last
+                && b.width[i] >= widths.first && b.width[i] <= widths.last)
+              ++skip;
+        fprintf(stderr, "%s: resuming after %llu of %llu attempts.\n", log_path.c_str(),
+                (unsigned long long) skip, (unsigned long long) log->attempts());
+      }
+    }
+    
+    std::unique_ptr<ThompsonScheduler> scheduler;
+    if (adaptive)
+    {
+      scheduler.reset(new ThompsonScheduler(delays, widths, explore,
+        std::chrono::steady_clock::now().time_since_epoch().count()));
+      if (resume)
+      {
+        AttemptLogReader reader(log_path);
+        for (const attempt_log::Columns & b : reader.blocks())
+          for (size_t i = 0; i < b.count; ++i)
+            if (b.rig[i] == rig && b.target[i] == (uint8_t) mode)
+              scheduler->record({b.delay[i], b.width[i]}, b.outcome[i]);
+      }
+    }
+    
+    // One attempt, logged.
+    auto attempt = [&](uint16_t delay, uint16_t width)
+    {
+      auto begin = std::chrono::steady_clock::now();
+      char outcome = campaign.attempt(delay, width);
+      if (log)
+      {
+        Attempt attempt;
+        attempt.time_us = std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::system_clock::now().time_since_epoch()).count();
+        attempt.rig = rig;
+        attempt.target = (uint8_t) mode;
+        attempt.delay = delay;
+        attempt.width = width;
+        attempt.outcome = outcome;
+        attempt.pc = campaign.last_pc;
+        log->append(attempt);
+      }
+      if (scheduler)
+        scheduler->record({delay, width}, outcome, std::chrono::duration<double>(
+          std::chrono::steady_clock::now() - begin).count());
+      putchar(outcome);
+      fflush(stdout);
+    };
+    
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    auto start = std::chrono::steady_clock::now();
+    if (scheduler)
+    {
+      uint64_t limit = (uint64_t) rounds * delays.size() * widths.size();
+      for (uint64_t done = 0, number = 1; !stop && (!limit || done < limit); ++number)
+      {
+        printf("batch %6llu: ", (unsigned long long) number);
+        for (const Point & point : scheduler->next_batch(
+               limit ? std::min<uint64_t>(batch, limit - done) : batch))
+        {
+          attempt(point.delay, point.width);
+          ++done;
+        }
+        putchar('\n');
+      }
+    }
+    for (unsigned round = 0; !scheduler && !stop && (!rounds || round < rounds); ++round)
+    {
+      for (unsigned delay = delays.first; !stop && delay <= delays.last; ++delay)
+      {
+        unsigned count = widths.size();
+        if (skip >= count)
+        {
+          skip -= count;
+          continue;
+        }
+        printf("post-reset delay %4u: ", delay);
+        for (unsigned width = widths.first; width <= widths.last; ++width)
+        {
+          if (skip)
+          {
+            --skip;
+            putchar(' ');
+            continue;
+          }
+          attempt(delay, width);
+        }
+        putchar('\n');
+      }
+    }
+    if (log)
+      log->checkpoint();
+    
+    double seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+    printf("%u attempts in %.1f s (%.1f/s):", campaign.attempts, seconds,
+           campaign.attempts / seconds);
+    for (char c : {'.', '!', 'r', '0', '?'})
+      printf(" '%c' %u", c, campaign.counts[(int) c]);
+    printf(" (%u attempts again after a serial error)\n", campaign.link_errors);
+    if (scheduler)
+    {
+      // The cells the scheduler liked best.
+      std::vector<std::pair<uint32_t, Point>> best;
+      for (unsigned delay = delays.first; delay <= delays.last; ++delay)
+        for (unsigned width = widths.first; width <= widths.last; ++width)
+        {
+          Point point = {(uint16_t) delay, (uint16_t) width};
+          best.push_back({scheduler->cell(point).attempts, point});
+        }
+      std::sort(best.begin(), best.end(), [](const std::pair<uint32_t, Point> & a,
+                                             const std::pair<uint32_t, Point> & b)
+      {
+        return a.first > b.first;
+      });
+      printf("%llu of %llu glitches explored; most tried:\n",
+             (unsigned long long) scheduler->explored, (unsigned long long) scheduler->chosen);
+      for (size_t i = 0; i < best.size() && i < 5; ++i)
+      {
+        const ThompsonScheduler::Cell & c = scheduler->cell(best[i].second);
+        printf("  delay %5u width %5u: %u attempts, %u hits, %u resets\n",
+               best[i].second.delay, best[i].second.width, c.attempts, c.hits, c.resets);
+      }
+    }
+    putchar('\n');
+    metrics.print_summary(stdout);
+  }
+  catch (const std::exception & e)
+  {
+    fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,175 @@
+// Glitch campaign on several rigs at once (see orchestrator.hpp): the 
+// delays are cut into shards, every rig works off its own shards and 
+// steals from the others when done, a rig whose reset rate spikes (or 
+// that fails) is quarantined, and all attempts go to one attempt log.
+// 
+// Usage: glitch-orchestrator --rig <serial>[,<host>:<port>] ... [options]
+// 
+//   --rig <serial>[,<host>:<port>]             a rig: the serial port of 
+//                                              its glitcher, and its 
+//                                              openocd (localhost:6666); 
+//                                              once per rig
+//   --mode <find-length|find-delay|final>      (find-length)
+//   --baud <rate>                              (115200)
+//   --delays <first>:<last>                    (9900:9908)
+//   --widths <first>:<last>                    (135:264)
+//   --resolution <1|2>                         (1)
+//   --swd-oracle                               let the glitchers check SWD
+//   --rounds <n>                               (0: forever)
+//   --shard <n>                                delays per shard (1)
+//   --window <n>                               attempts of the reset rate 
+//                                              of a rig (200)
+//   --margin <fraction>                        reset rate above the other 
+//                                              rigs that quarantines a 
+//                                              rig (0.25)
+//   --log <file>                               append every attempt to 
+//                                              this attempt log
+//   --quiet                                    no line per delay
+//   --metrics <port|unix:path>                 serve the metrics of all 
+//                                              rigs (see metrics.hpp) to 
+//                                              Prometheus
+// 
+// The rigs are numbered from 0 in the order of --rig, as in the log. 
+// See fake-rig --rigs for trying it without hardware.
+
+#include <chrono>
+#include <getopt.h>
+#include <memory>
+#include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "attempt-log.hpp"
+#include "campaign.hpp"
+#include "metrics.hpp"
+#include "orchestrator.hpp"
+#include "scheduler.hpp"
+
+static void usage(const char * program)
+{
+  fprintf(stderr,
+    "Usage: %s --rig <serial>[,<host>:<port>] ... [--mode find-length|find-delay|final]\n"
+    "       [--baud <rate>] [--delays <first>:<last>] [--widths <first>:<last>]\n"
+    "       [--resolution 1|2] [--swd-oracle] [--rounds <n>] [--shard <n>]\n"
+    "       [--window <n>] [--margin <fraction>] [--log <file>] [--quiet]\n"
+    "       [--metrics <port|unix:path>]\n", program);
+  exit(2);
+}
+
+int main(int argc, char ** argv)
+{
+  std::vector<RigConfig> rigs;
+  Orchestrator::Options options;
+  options.verbose = true;
+  unsigned rounds = 0;
+  std::string log_path;
+  std::string metrics_address;
+  
+  static const option long_options[] = {
+    {"rig",        required_argument, nullptr, 'g'},
+    {"mode",       required_argument, nullptr, 'm'},
+    {"baud",       required_argument, nullptr, 'b'},
+    {"delays",     required_argument, nullptr, 'd'},
+    {"widths",     required_argument, nullptr, 'w'},
+    {"resolution", required_argument, nullptr, 'r'},
+    {"swd-oracle", no_argument,       nullptr, 'S'},
+    {"rounds",     required_argument, nullptr, 'n'},
+    {"shard",      required_argument, nullptr, 'h'},
+    {"window",     required_argument, nullptr, 'W'},
+    {"margin",     required_argument, nullptr, 'M'},
+    {"log",        required_argument, nullptr, 'l'},
+    {"quiet",      no_argument,       nullptr, 'q'},
+    {"metrics",    required_argument, nullptr, 'P'},
+    {nullptr,      0,                 nullptr, 0},
+  };
+  int option;
+  while ((option = getopt_long(argc, argv, "", long_options, nullptr)) != -1)
+  {
+    switch (option)
+    {
+      case 'g':
+      {
+        RigConfig rig;
+        if (!parse_rig(optarg, rig))
+          usage(argv[0]);
+        rigs.push_back(rig);
+        break;
+      }
+      case 'm':
+        if (!parse_mode(optarg, options.mode))
+          usage(argv[0]);
+        break;
+      case 'b': options.baud = strtoul(optarg, nullptr, 0); break;
+      case 'd':
+        if (!parse_range(optarg, options.delays))
+          usage(argv[0]);
+        break;
+      case 'w':
+        if (!parse_range(optarg, options.widths))
+          usage(argv[0]);
+        break;
+      case 'r': options.resolution = strtoul(optarg, nullptr, 0); break;
+      case 'S': options.swd_oracle = true; break;
+      case 'n': rounds = strtoul(optarg, nullptr, 0); break;
+      case 'h': options.shard_delays = strtoul(optarg, nullptr, 0); break;
+      case 'W': options.quarantine_window = strtoul(optarg, nullptr, 0); break;
+      case 'M': options.quarantine_margin = strtod(optarg, nullptr); break;
+      case 'l': log_path = optarg; break;
+      case 'q': options.verbose = false; break;
+      case 'P': metrics_address = optarg; break;
+      default: usage(argv[0]);
+    }
+  }
+  if (optind != argc || rigs.empty())
+    usage(argv[0]);
+  
+  try
+  {
+    Metrics metrics;
+    options.metrics = &metrics;
+    std::unique_ptr<MetricsServer> metrics_server;
+    if (!metrics_address.empty())
+      metrics_server.reset(new MetricsServer(metrics, metrics_address));
+    
+    std::unique_ptr<AttemptLogWriter> log;
+    if (!log_path.empty())
+      log.reset(new AttemptLogWriter(log_path));
+    Orchestrator orchestrator(rigs, options, log.get());
+    
+    auto start = std::chrono::steady_clock::now();
+    bool done = true;
+    for (unsigned round = 0; done && (!rounds || round < rounds); ++round)
+      done = orchestrator.run();
+    if (log)
+      log->checkpoint();
+    double seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+    
+    unsigned attempts = 0;
+    printf("\nrig  attempts   hits  resets  shards  stolen  serial errors  attempts/s\n");
+    for (unsigned rig = 0; rig < rigs.size(); ++rig)
+    {
+      const Orchestrator::RigStats & s = orchestrator.stats()[rig];
+      attempts += s.attempts;
+      printf("%3u  %8u  %5u  %6u  %6u  %6u  %13u  %10.1f%s%s\n", rig, s.attempts, s.hits,
+             s.resets, s.shards, s.stolen, s.link_errors, s.seconds > 0 ? s.attempts / s.seconds : 0,
+             s.quarantined ? "  quarantined: " : "", s.why.c_str());
+    }
+    printf("%u attempts in %.1f s (%.1f/s)\n\n", attempts, seconds, attempts / seconds);
+    metrics.print_summary(stdout);
+    if (!done)
+    {
+      fprintf(stderr, "All rigs quarantined.\n");
+      return 1;
+    }
+  }
+  catch (const std::exception & e)
+  {
+    fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+  return 0;
+}
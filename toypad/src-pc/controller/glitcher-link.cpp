@@ -0,0 +1,158 @@
+#include <chrono>
+#include <stdlib.h>
+
+#include "glitcher-link.hpp"
+
+// Tries of resync() before giving up.
+#define RESYNC_TRIES	3
+
+// resync() is done when nothing follows a "READY" for this long.
+#define RESYNC_QUIET_MS	20
+
+static bool is_ready(const std::string & line)
+{
+  // The alive dots of the main loop end up in front of it.
+  return line.size() >= 5 && line.compare(line.size() - 5, 5, "READY") == 0;
+}
+
+GlitcherLink::GlitcherLink(SerialPort & port, int timeout_ms)
+  : port(port), timeout_ms(timeout_ms)
+{
+}
+
+void GlitcherLink::resync()
+{
+  ++resyncs;
+  auto start = Metrics::Clock::now();
+  for (unsigned tries = 0; tries < RESYNC_TRIES; ++tries)
+  {
+    port.discard_input();
+    port.write("\n");
+    
+    // A "READY" of before the "\n" may still be on its way, so only the 
+    // last one counts: wait for the line to go quiet.
+    std::string line;
+    bool ready = false;
+    int wait_ms = timeout_ms;
+    while (port.read_line(line, wait_ms))
+    {
+      ready = is_ready(line) && !port.garbled();
+      wait_ms = ready ? RESYNC_QUIET_MS : timeout_ms;
+    }
+    if (ready)
+    {
+      synced = true;
+      if (metrics)
+        metrics->record("resync", start);
+      return;
+    }
+  }
+  throw GlitcherError(GlitcherError::TIMEOUT, "glitcher: does not answer");
+}
+
+const std::vector<std::string> & GlitcherLink::command(const std::string & command, int frame_timeout_ms)
+{
+  if (!synced)
+    resync();
+  
+  auto deadline = std::chrono::steady_clock::now()
+                + std::chrono::milliseconds(frame_timeout_ms ? frame_timeout_ms : timeout_ms);
+  auto left = [&deadline]()
+  {
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+      deadline - std::chrono::steady_clock::now()).count();
+    return ms < 0 ? 0 : (int) ms;
+  };
+  
+  // The phases of the frame, for the metrics.
+  auto start = Metrics::Clock::now();
+  auto phase = [this, &start](const char * name)
+  {
+    if (!metrics)
+      return;
+    auto now = Metrics::Clock::now();
+    metrics->record(name, now - start);
+    start = now;
+  };
+  
+  lines.clear();
+  synced = false;
+  port.write(command);
+  phase("serial_write");
+  bool failed = false;
+  std::string line;
+  while (1)
+  {
+    if (!port.read_line(line, left()))
+      throw GlitcherError(GlitcherError::TIMEOUT, "glitcher: no reply to " + command.substr(0, 1));
+    if (port.garbled())
+      throw GlitcherError(GlitcherError::GARBAGE, "glitcher: garbage in reply to " + command.substr(0, 1));
+    if (is_ready(line))
+      break;
+    lines.push_back(line);
+    if (lines.size() == 1)
+      phase("glitcher_echo");
+    if (line.find("DONE") != std::string::npos)
+    {
+      phase("glitcher_done");
+      // Only the "READY" is left.
+      if (port.read_line(line, left()) && is_ready(line) && !port.garbled())
+      {
+        synced = true;
+        phase("glitcher_ready");
+      }
+      return lines;
+    }
+    // The echo of an unknown command ends up in front of it.
+    if (line.find("FAIL") != std::string::npos)
+      failed = true;
+  }
+  
+  // "READY" without "DONE".
+  synced = true;
+  if (failed)
+    throw GlitcherError(GlitcherError::FAILED, "glitcher: " + lines.back().substr(lines.back().find("FAIL")));
+  throw GlitcherError(GlitcherError::RESET, "glitcher: reset during " + command.substr(0, 1));
+}
+
+unsigned GlitcherLink::set_resolution(unsigned steps_per_tick)
+{
+  command("R" + std::to_string(steps_per_tick) + "\n");
+  for (const std::string & line : lines)
+  {
+    if (line.compare(0, 11, "RESOLUTION ") == 0)
+    {
+      dead_time = line.find("DEAD TIME") != std::string::npos;
+      return strtoul(line.c_str() + 11, nullptr, 10);
+    }
+  }
+  throw GlitcherError(GlitcherError::FAILED, "glitcher: no resolution in reply to R");
+}
+
+void GlitcherLink::set_swd_oracle(bool enable)
+{
+  command(enable ? "S1\n" : "S0\n");
+}
+
+char GlitcherLink::glitch_status() const
+{
+  for (const std::string & line : lines)
+    if (line.compare(0, 7, "STATUS ") == 0 && line.size() > 7)
+      return line[7];
+  return 0;
+}
+
+char GlitcherLink::glitch(uint16_t post_reset_steps, uint16_t glitch_steps)
+{
+  command("G" + std::to_string(post_reset_steps) + ","
+              + std::to_string(glitch_steps) + "\n");
+  return glitch_status();
+}
+
+char GlitcherLink::timed_glitch(uint16_t tcnt1, uint16_t tcnt4, uint16_t ocr4b, uint8_t dt4, uint8_t tccr4b)
+{
+  command("T" + std::to_string(tcnt1) + "," + std::to_string(tcnt4) + ","
+              + std::to_string(ocr4b) + "," + std::to_string(dt4) + ","
+              + std::to_string(tccr4b) + "\n");
+  return glitch_status();
+}
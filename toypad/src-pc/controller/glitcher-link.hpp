@@ -0,0 +1,81 @@
+#ifndef _GLITCHER_LINK_HPP_
+#define _GLITCHER_LINK_HPP_
+
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "metrics.hpp"
+#include "serial-port.hpp"
+
+// Something went wrong with a command of the glitcher:
+// 
+//   FAILED:  The glitcher answered "FAIL...". The link is fine.
+//   TIMEOUT: No complete reply within the timeout of the frame.
+//   GARBAGE: The reply had bytes that the firmware never sends (line 
+//            noise, a wrong baud rate, a glitched glitcher).
+//   RESET:   The glitcher printed "READY" in the middle of a reply: it 
+//            has reset (brown out, watchdog, USB), the command is lost.
+// 
+// After all but FAILED the link resynchronizes itself before the next 
+// command.
+class GlitcherError : public std::runtime_error
+{
+  public:
+    enum Kind { FAILED, TIMEOUT, GARBAGE, RESET };
+    GlitcherError(Kind kind, const std::string & what)
+      : std::runtime_error(what), kind(kind) {}
+    Kind kind;
+};
+
+// The commands of the glitcher firmware (src-avr/glitcher.cpp). 
+// 
+// A frame is one command and its whole reply: up to "DONE" or 
+// "FAIL...", and the "READY" of the main loop after it. Every frame has 
+// its own timeout; only a complete frame leaves the link in sync.
+class GlitcherLink
+{
+  public:
+    GlitcherLink(SerialPort & port, int timeout_ms = 1000);
+    
+    // Send a command (with its "\n"), and return every line of its 
+    // reply. Throws GlitcherError.
+    const std::vector<std::string> & command(const std::string & command, int timeout_ms = 0);
+    
+    // Get back to the "READY" of the main loop, whatever state the 
+    // firmware is in: drop all input, send a lone "\n" (an unknown 
+    // command, or the end of a number), and wait for "READY".
+    void resync();
+    
+    // Command 'R'. Returns the steps per 48 MHz tick the glitcher 
+    // actually uses; dead_time tells whether it fell back to 48 MHz 
+    // plus dead time.
+    unsigned set_resolution(unsigned steps_per_tick);
+    bool dead_time = false;
+    
+    // Command 'S'.
+    void set_swd_oracle(bool enable);
+    
+    // Commands 'G' and 'T'. Return the status of the SWD oracle ('!', 
+    // '.' or '?'), or 0 if the oracle is off.
+    char glitch(uint16_t post_reset_steps, uint16_t glitch_steps);
+    char timed_glitch(uint16_t tcnt1, uint16_t tcnt4, uint16_t ocr4b, uint8_t dt4, uint8_t tccr4b);
+    
+    // Every line of the last command, for tracing.
+    std::vector<std::string> lines;
+    
+    unsigned resyncs = 0;
+    
+    // If set: the time of every part of a frame (see Metrics).
+    Metrics * metrics = nullptr;
+    
+  private:
+    char glitch_status() const;
+    
+    SerialPort & port;
+    int timeout_ms;
+    bool synced = false;
+};
+
+#endif /* _GLITCHER_LINK_HPP_ */
@@ -0,0 +1,199 @@
+// Runs the ISP client (isp.cpp) against the fake boot ROM (fake-isp.cpp):
+// uuencode, the autobaud, identification, pipelined reads with resends, 
+// errors of the boot ROM, and the negotiation of the rate.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "fake-isp.hpp"
+#include "isp.hpp"
+#include "serial-port.hpp"
+#include "test-check.hpp"
+
+// Returns the return code of the IspError of a read, or -2 if it went 
+// well.
+static int read_error(IspClient & isp, uint32_t address, uint32_t size)
+{
+  try
+  {
+    isp.read(address, size);
+  }
+  catch (const IspError & e)
+  {
+    return e.code;
+  }
+  return -2;
+}
+
+// The fake is not left waiting for an "OK" (it may take a moment to 
+// get there).
+static bool acknowledged(FakeIsp & fake)
+{
+  for (unsigned tries = 0; tries < 100 && fake.awaiting_ack; ++tries)
+    usleep(10000);
+  return !fake.awaiting_ack;
+}
+
+static std::vector<uint8_t> test_flash()
+{
+  std::vector<uint8_t> flash(32 * 1024);
+  uint32_t x = 1;
+  for (uint8_t & byte : flash)
+  {
+    x = x * 1103515245 + 12345;
+    byte = x >> 16;
+  }
+  // Long runs of zeroes: '`' in the uuencode.
+  for (size_t i = 0x1000; i < 0x1400; ++i)
+    flash[i] = 0;
+  flash[0x2FC] = flash[0x2FD] = flash[0x2FE] = flash[0x2FF] = 0xFF;
+  return flash;
+}
+
+int main()
+{
+  {
+    bool round_trip = true;
+    bool backquotes = true;
+    std::vector<uint8_t> bytes(ISP_BYTES_PER_LINE);
+    for (size_t i = 0; i < bytes.size(); ++i)
+      bytes[i] = i % 3 ? 0 : 0xA5 + i;
+    for (size_t size = 0; size <= ISP_BYTES_PER_LINE; ++size)
+    {
+      std::string line = isp_uuencode(bytes.data(), size);
+      std::vector<uint8_t> decoded;
+      round_trip = round_trip && isp_uudecode(line, decoded)
+                   && decoded == std::vector<uint8_t>(bytes.begin(), bytes.begin() + size);
+      backquotes = backquotes && line.find(' ') == std::string::npos;
+    }
+    check(round_trip, "uuencode: every length up to 45 bytes");
+    check(backquotes, "uuencode: '`' for 0");
+    std::vector<uint8_t> decoded;
+    check(!isp_uudecode("#abc", decoded) && !isp_uudecode("\"a\x7f" "bc", decoded),
+          "uudecode: wrong length, bad characters");
+  }
+  
+  std::vector<uint8_t> flash = test_flash();
+  {
+    FakeIsp fake(flash);
+    SerialPort port(fake.path(), 115200);
+    IspClient isp(port, 115200);
+    isp.synchronize();
+    check(true, "autobaud");
+    check(isp.part_id() == 0x0001BC40, "J: part ID");
+    IspClient::BootCodeVersion version = isp.boot_code_version();
+    check(version.major == 7 && version.minor == 1, "K: boot code version");
+    check(isp.uid() == fake.uid, "N: serial number");
+    check(!strcmp(isp_part_name(isp.part_id()), "LPC11U35/401"), "part name");
+    
+    unsigned commands = fake.commands;
+    std::vector<uint8_t> data = isp.read(0, flash.size());
+    check(data == flash, "R: all of the flash");
+    unsigned reads = fake.commands - commands;
+    check(reads == (flash.size() + ISP_BYTES_PER_CHECKSUM - 1) / ISP_BYTES_PER_CHECKSUM,
+          "R: one command per checksum");
+    check(fake.pipelined_acks + 1 >= reads, "R: the \"OK\" goes with the next command");
+    check(acknowledged(fake), "R: the \"OK\" of the last block before read() returns");
+    
+    data = isp.read(0x1004, 100);
+    check(data == std::vector<uint8_t>(flash.begin() + 0x1004, flash.begin() + 0x1004 + 100),
+          "R: a short read, right after the last");
+    data = isp.read(0x10000000, 64);
+    check(data == std::vector<uint8_t>(64, 0), "R: RAM");
+    
+    fake.corrupt_blocks = 2;
+    data = isp.read(0x2000, 2000);
+    check(data == std::vector<uint8_t>(flash.begin() + 0x2000, flash.begin() + 0x2000 + 2000),
+          "R: bad checksums, resent");
+    check(isp.resends == 2 && fake.resends == 2, "R: two \"RESEND\"s");
+    
+    check(read_error(isp, 2, 4) == ISP_ADDR_ERROR, "R: unaligned address");
+    check(read_error(isp, 0, 6) == ISP_COUNT_ERROR, "R: count not a multiple of 4");
+    check(read_error(isp, 0x8000, 4) == ISP_ADDR_NOT_MAPPED, "R: not mapped");
+    check(isp.read(0, 4) == std::vector<uint8_t>(flash.begin(), flash.begin() + 4),
+          "R: fine after errors");
+  }
+  
+  {
+    FakeIsp fake(flash);
+    SerialPort port(fake.path(), 115200);
+    IspClient isp(port, 115200);
+    isp.synchronize();
+    check(isp.negotiate_baud(1000000) == 230400 && fake.baud == 230400, "B: 230400");
+    check(isp.read(0, flash.size()) == flash, "R: at 230400");
+    check(isp.negotiate_baud(1000000) == 230400, "B: already the fastest");
+  }
+  
+  {
+    FakeIsp fake(flash, 19200);
+    fake.max_baud = 57600;
+    SerialPort port(fake.path(), 19200);
+    IspClient isp(port, 19200);
+    isp.synchronize();
+    check(isp.negotiate_baud(230400) == 57600 && fake.baud == 57600,
+          "B: the fastest the boot ROM accepts");
+    check(isp.read(0, 4096) == std::vector<uint8_t>(flash.begin(), flash.begin() + 4096),
+          "R: at 57600");
+  }
+  
+  {
+    // Accepted, but nothing readable comes back at 230400.
+    FakeIsp fake(flash, 19200);
+    fake.broken_baud = 230400;
+    SerialPort port(fake.path(), 19200);
+    IspClient isp(port, 19200, 200);
+    isp.synchronize();
+    check(isp.negotiate_baud(230400) == 115200 && fake.baud == 115200,
+          "B: back from a rate without replies, the next lower one");
+    check(isp.part_id() == 0x0001BC40, "J: after going back");
+  }
+  
+  {
+    FakeIsp fake(flash);
+    SerialPort port(fake.path(), 115200);
+    IspClient isp(port, 115200);
+    isp.synchronize();
+    fake.corrupt_blocks = 10;
+    check(read_error(isp, 0x3000, 900) == IspError::NO_REPLY, "R: gives up after 3 resends");
+  }
+  
+  {
+    // Switched behind the back of the client: garbage.
+    FakeIsp fake(flash);
+    SerialPort port(fake.path(), 115200);
+    IspClient isp(port, 115200, 200);
+    isp.synchronize();
+    port.set_baud(57600);
+    bool garbage = false;
+    try
+    {
+      isp.part_id();
+    }
+    catch (const IspError & e)
+    {
+      garbage = e.code == IspError::NO_REPLY;
+    }
+    check(garbage, "wrong rate: no reply");
+  }
+  
+  {
+    std::vector<uint8_t> protected_flash = flash;
+    protected_flash[0x2FC] = 0x78;
+    protected_flash[0x2FD] = 0x56;
+    protected_flash[0x2FE] = 0x34;
+    protected_flash[0x2FF] = 0x12;
+    FakeIsp fake(protected_flash);
+    SerialPort port(fake.path(), 115200);
+    IspClient isp(port, 115200);
+    isp.synchronize();
+    check(read_error(isp, 0, 4) == ISP_CODE_READ_PROTECTION_ENABLED, "R: CRP1");
+    check(isp.part_id() == 0x0001BC40, "J: with CRP1");
+  }
+  
+  printf("%u failures\n", failures);
+  return failures ? 1 : 0;
+}
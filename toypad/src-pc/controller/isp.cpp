@@ -0,0 +1,321 @@
+#include <algorithm>
+#include <stdlib.h>
+
+#include "isp.hpp"
+
+// Tries of '?' in synchronize(), timeout_ms each.
+#define SYNC_TRIES	10
+
+// "RESEND"s per block before giving up.
+#define MAX_RESENDS	3
+
+// Command 'B', fastest first (UM10462, table "ISP Set Baud Rate").
+static const unsigned ISP_BAUDS[] = {230400, 115200, 57600, 38400, 19200, 9600};
+
+const char * isp_return_code_name(int code)
+{
+  static const char * const names[] =
+  {
+    "CMD_SUCCESS",
+    "INVALID_COMMAND",
+    "SRC_ADDR_ERROR",
+    "DST_ADDR_ERROR",
+    "SRC_ADDR_NOT_MAPPED",
+    "DST_ADDR_NOT_MAPPED",
+    "COUNT_ERROR",
+    "INVALID_SECTOR",
+    "SECTOR_NOT_BLANK",
+    "SECTOR_NOT_PREPARED_FOR_WRITE_OPERATION",
+    "COMPARE_ERROR",
+    "BUSY",
+    "PARAM_ERROR",
+    "ADDR_ERROR",
+    "ADDR_NOT_MAPPED",
+    "CMD_LOCKED",
+    "INVALID_CODE",
+    "INVALID_BAUD_RATE",
+    "INVALID_STOP_BIT",
+    "CODE_READ_PROTECTION_ENABLED",
+  };
+  if (code < 0 || code >= (int) (sizeof names / sizeof names[0]))
+    return "unknown return code";
+  return names[code];
+}
+
+const char * isp_part_name(uint32_t part_id)
+{
+  switch (part_id)
+  {
+    case 0x0003D440: return "LPC11U34/311";
+    case 0x0001CC40: return "LPC11U34/421";
+    case 0x0001BC40: return "LPC11U35/401";
+    case 0x0000BC40: return "LPC11U35/501";
+  }
+  return nullptr;
+}
+
+static char uuencode_char(unsigned bits)
+{
+  return bits ? ' ' + bits : '`';
+}
+
+std::string isp_uuencode(const uint8_t * data, size_t size)
+{
+  std::string line(1, uuencode_char(size));
+  for (size_t i = 0; i < size; i += 3)
+  {
+    // Zeroes after the end, to fill the last group.
+    uint32_t group = data[i] << 16;
+    if (i + 1 < size)
+      group |= data[i + 1] << 8;
+    if (i + 2 < size)
+      group |= data[i + 2];
+    for (int shift = 18; shift >= 0; shift -= 6)
+      line += uuencode_char((group >> shift) & 0x3F);
+  }
+  return line;
+}
+
+bool isp_uudecode(const std::string & line, std::vector<uint8_t> & data)
+{
+  if (line.empty())
+    return false;
+  for (char c : line)
+    if (c < ' ' || c > '`')
+      return false;
+  size_t size = (line[0] - ' ') & 0x3F;
+  if (size > ISP_BYTES_PER_LINE || line.size() != 1 + (size + 2) / 3 * 4)
+    return false;
+  for (size_t i = 0; i < size; i += 3)
+  {
+    uint32_t group = 0;
+    for (size_t j = 0; j < 4; ++j)
+      group = group << 6 | ((line[1 + i / 3 * 4 + j] - ' ') & 0x3F);
+    for (size_t j = 0; j < 3 && i + j < size; ++j)
+      data.push_back(group >> (16 - 8 * j));
+  }
+  return true;
+}
+
+static bool parse_number(const std::string & text, uint32_t & value)
+{
+  if (text.empty())
+    return false;
+  char * end;
+  unsigned long number = strtoul(text.c_str(), &end, 10);
+  if (*end || number > UINT32_MAX)
+    return false;
+  value = number;
+  return true;
+}
+
+IspClient::IspClient(SerialPort & port, unsigned baud, int timeout_ms)
+  : port(port), current_baud(baud), timeout_ms(timeout_ms)
+{
+}
+
+void IspClient::send(const std::string & text)
+{
+  port.write(pending_ack + text);
+  pending_ack.clear();
+}
+
+std::string IspClient::receive_line(const char * what)
+{
+  std::string line;
+  if (!port.read_line(line, timeout_ms))
+    throw IspError(IspError::NO_REPLY, std::string("isp: no reply to ") + what);
+  if (port.garbled())
+    throw IspError(IspError::NO_REPLY, std::string("isp: garbled reply to ") + what);
+  return line;
+}
+
+void IspClient::synchronize(unsigned clock_khz)
+{
+  port.discard_input();
+  echo = true;
+  pending_ack.clear();
+  bool synchronized = false;
+  for (unsigned tries = 0; tries < SYNC_TRIES && !synchronized; ++tries)
+  {
+    port.write("?");
+    std::string line;
+    while (!synchronized && port.read_line(line, timeout_ms))
+      synchronized = line == "Synchronized";
+  }
+  if (!synchronized)
+    throw IspError(IspError::NO_REPLY, "isp: no \"Synchronized\" (in ISP mode? at a rate the autobaud can do?)");
+  
+  // Both with echo, and "OK" instead of a return code.
+  std::string handshake[] = {"Synchronized", std::to_string(clock_khz)};
+  for (const std::string & text : handshake)
+  {
+    port.write(text + "\r\n");
+    if (receive_line(text.c_str()) != text)
+      throw IspError(IspError::NO_REPLY, "isp: no echo of " + text);
+    std::string reply = receive_line(text.c_str());
+    if (reply != "OK")
+      throw IspError(IspError::NO_REPLY, "isp: " + text + ": " + reply);
+  }
+  
+  command("A 0");
+  echo = false;
+}
+
+int IspClient::return_code(const std::string & command)
+{
+  std::string line = receive_line(command.c_str());
+  if (echo && line == command)
+    line = receive_line(command.c_str());
+  uint32_t code;
+  if (!parse_number(line, code))
+    throw IspError(IspError::NO_REPLY, "isp: " + command + ": not a return code: " + line);
+  return code;
+}
+
+std::vector<std::string> IspClient::command(const std::string & command, unsigned expected_lines)
+{
+  ++commands;
+  send(command + "\r\n");
+  int code = return_code(command);
+  if (code != ISP_CMD_SUCCESS)
+    throw IspError(code, "isp: " + command + ": " + isp_return_code_name(code));
+  std::vector<std::string> lines;
+  for (unsigned i = 0; i < expected_lines; ++i)
+    lines.push_back(receive_line(command.c_str()));
+  return lines;
+}
+
+uint32_t IspClient::part_id()
+{
+  uint32_t id;
+  if (!parse_number(command("J", 1)[0], id))
+    throw IspError(IspError::NO_REPLY, "isp: J: not a part ID");
+  return id;
+}
+
+IspClient::BootCodeVersion IspClient::boot_code_version()
+{
+  // <byte0 (minor)>, then <byte1 (major)>.
+  std::vector<std::string> lines = command("K", 2);
+  uint32_t minor, major;
+  if (!parse_number(lines[0], minor) || !parse_number(lines[1], major))
+    throw IspError(IspError::NO_REPLY, "isp: K: not a version");
+  return BootCodeVersion{major, minor};
+}
+
+std::array<uint32_t, 4> IspClient::uid()
+{
+  std::vector<std::string> lines = command("N", 4);
+  std::array<uint32_t, 4> words;
+  for (size_t i = 0; i < words.size(); ++i)
+    if (!parse_number(lines[i], words[i]))
+      throw IspError(IspError::NO_REPLY, "isp: N: not a serial number");
+  return words;
+}
+
+unsigned IspClient::negotiate_baud(unsigned max_baud)
+{
+  for (unsigned baud : ISP_BAUDS)
+  {
+    if (baud > max_baud)
+      continue;
+    if (baud <= current_baud)
+      break;
+    try
+    {
+      command("B " + std::to_string(baud) + " 1");
+    }
+    catch (const IspError & e)
+    {
+      if (e.code == ISP_INVALID_BAUD_RATE)
+        continue;
+      throw;
+    }
+    // The boot ROM switches right after its "0".
+    unsigned previous = current_baud;
+    port.set_baud(baud);
+    current_baud = baud;
+    port.discard_input();
+    try
+    {
+      part_id();
+      break;
+    }
+    catch (const IspError & e)
+    {
+      if (e.code != IspError::NO_REPLY)
+        throw;
+    }
+    // No readable reply at the new rate. The boot ROM may still 
+    // understand us (it is the replies that suffer), so ask it to go 
+    // back, whatever it answers, go back too, and try the next lower 
+    // rate.
+    try
+    {
+      command("B " + std::to_string(previous) + " 1");
+    }
+    catch (const IspError &)
+    {
+    }
+    port.set_baud(previous);
+    current_baud = previous;
+    port.discard_input();
+    part_id();
+  }
+  return current_baud;
+}
+
+// One checksummed block of a command 'R': the lines, the checksum, and 
+// our "OK" or "RESEND". The "OK" of the last block of a command waits 
+// for the next command (or the end of read()).
+void IspClient::read_block(std::vector<uint8_t> & data, uint32_t size, bool last)
+{
+  unsigned lines = (size + ISP_BYTES_PER_LINE - 1) / ISP_BYTES_PER_LINE;
+  for (unsigned tries = 0; ; ++tries)
+  {
+    std::vector<uint8_t> block;
+    bool ok = true;
+    for (unsigned i = 0; i < lines; ++i)
+      ok = isp_uudecode(receive_line("R"), block) && ok;
+    uint32_t checksum;
+    ok = parse_number(receive_line("R"), checksum) && ok;
+    
+    uint32_t sum = 0;
+    for (uint8_t byte : block)
+      sum += byte;
+    if (ok && block.size() == size && sum == checksum)
+    {
+      data.insert(data.end(), block.begin(), block.end());
+      if (last)
+        pending_ack = "OK\r\n";
+      else
+        send("OK\r\n");
+      return;
+    }
+    if (tries == MAX_RESENDS)
+      throw IspError(IspError::NO_REPLY, "isp: R: bad checksum, " + std::to_string(MAX_RESENDS) + " times");
+    ++resends;
+    send("RESEND\r\n");
+  }
+}
+
+std::vector<uint8_t> IspClient::read(uint32_t address, uint32_t size)
+{
+  std::vector<uint8_t> data;
+  data.reserve(size);
+  while (data.size() < size)
+  {
+    uint32_t count = std::min<uint32_t>(size - data.size(), ISP_BYTES_PER_CHECKSUM);
+    command("R " + std::to_string(address + data.size()) + " " + std::to_string(count));
+    for (uint32_t done = 0; done < count; done += ISP_BYTES_PER_CHECKSUM)
+    {
+      uint32_t block = std::min<uint32_t>(count - done, ISP_BYTES_PER_CHECKSUM);
+      read_block(data, block, done + block == count);
+    }
+  }
+  // The boot ROM waits for the "OK" of the last block.
+  if (!pending_ack.empty())
+    send("");
+  return data;
+}
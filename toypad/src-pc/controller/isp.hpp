@@ -0,0 +1,129 @@
+#ifndef _ISP_HPP_
+#define _ISP_HPP_
+
+#include <array>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "serial-port.hpp"
+
+// The UART ISP of the boot ROM of the LPC11Uxx (UM10462, chapter 20):
+// the boot ROM enters it after a reset with PIO0_1 low (and PIO0_3 low 
+// for UART instead of USB), unless CRP3 or NO_ISP is set. Another way 
+// to read the flash, without SWD and openocd, as long as the code read 
+// protection is off.
+// 
+// Every command is one line; the boot ROM answers with its return code 
+// (a decimal number, 0 is CMD_SUCCESS) and then the data of the 
+// command, one number per line.
+
+// The return codes of the boot ROM we handle ourselves.
+#define ISP_CMD_SUCCESS				0
+#define ISP_INVALID_COMMAND			1
+#define ISP_COUNT_ERROR				6
+#define ISP_PARAM_ERROR				12
+#define ISP_ADDR_ERROR				13
+#define ISP_ADDR_NOT_MAPPED			14
+#define ISP_INVALID_CODE			16
+#define ISP_INVALID_BAUD_RATE			17
+#define ISP_INVALID_STOP_BIT			18
+#define ISP_CODE_READ_PROTECTION_ENABLED	19
+
+// Command 'R': a checksum after every ISP_LINES_PER_CHECKSUM lines of 
+// ISP_BYTES_PER_LINE bytes (uuencoded), and after the last line.
+#define ISP_BYTES_PER_LINE			45
+#define ISP_LINES_PER_CHECKSUM			20
+#define ISP_BYTES_PER_CHECKSUM			(ISP_BYTES_PER_LINE * ISP_LINES_PER_CHECKSUM)
+
+// The name of a return code, e.g. "CODE_READ_PROTECTION_ENABLED".
+const char * isp_return_code_name(int code);
+
+// The name of a part ID of command 'J', or nullptr if we do not know it.
+const char * isp_part_name(uint32_t part_id);
+
+// One line of uuencoded data as the boot ROM sends it: the length (plus 
+// 0x20), then 4 characters per 3 bytes, with '`' instead of ' ' for 0.
+// At most ISP_BYTES_PER_LINE bytes. Decoding takes either for 0; it 
+// returns false if the line is not uuencoded data.
+std::string isp_uuencode(const uint8_t * data, size_t size);
+bool isp_uudecode(const std::string & line, std::vector<uint8_t> & data);
+
+// The boot ROM returned an error, or did not answer (in time, or 
+// readably: code NO_REPLY).
+class IspError : public std::runtime_error
+{
+  public:
+    static constexpr int NO_REPLY = -1;
+    IspError(int code, const std::string & what)
+      : std::runtime_error(what), code(code) {}
+    int code;
+};
+
+// The host side of the ISP. Throws IspError.
+// 
+// read() is pipelined: it asks for ISP_BYTES_PER_CHECKSUM bytes per 
+// command 'R', so every command ends with the one checksum the boot ROM 
+// waits for an "OK" on, and sends that "OK" together with the next 
+// command. One round trip per 900 bytes instead of two. (The "OK" and 
+// the next command fit in the 16 byte receive FIFO of the UART.) The 
+// "OK" of the last command goes out before read() returns.
+class IspClient
+{
+  public:
+    // baud: the rate of the port, for synchronize().
+    IspClient(SerialPort & port, unsigned baud, int timeout_ms = 1000);
+    
+    // The autobaud: '?' until the boot ROM answers "Synchronized", the 
+    // handshake, the frequency of the clock it runs from (the 12 MHz
+    // IRC: 12000 kHz), and echo off.
+    void synchronize(unsigned clock_khz = 12000);
+    
+    // Command 'J'.
+    uint32_t part_id();
+    
+    // Command 'K': <major>.<minor>.
+    struct BootCodeVersion
+    {
+      unsigned major;
+      unsigned minor;
+    };
+    BootCodeVersion boot_code_version();
+    
+    // Command 'N': the 128 bit serial number, first word first.
+    std::array<uint32_t, 4> uid();
+    
+    // Command 'B': the fastest of the rates the boot ROM can do, up to 
+    // max_baud. Checks the new rate with command 'J'; if that gets no 
+    // readable reply, goes back to the previous rate (both sides) and 
+    // tries the next lower one. Returns the rate both sides use now.
+    unsigned negotiate_baud(unsigned max_baud);
+    unsigned baud() const { return current_baud; }
+    
+    // Command 'R': size bytes from address (both multiples of 4).
+    std::vector<uint8_t> read(uint32_t address, uint32_t size);
+    
+    // Send a command, return the lines of its reply after the return 
+    // code (expected_lines of them). Throws on any other return code 
+    // than 0.
+    std::vector<std::string> command(const std::string & command, unsigned expected_lines = 0);
+    
+    unsigned commands = 0;
+    unsigned resends = 0;
+  
+  private:
+    std::string receive_line(const char * what);
+    int return_code(const std::string & command);
+    void send(const std::string & text);
+    void read_block(std::vector<uint8_t> & data, uint32_t size, bool last);
+    
+    SerialPort & port;
+    unsigned current_baud;
+    int timeout_ms;
+    bool echo = true;
+    // The "OK" of the last block of the previous command 'R'.
+    std::string pending_ack;
+};
+
+#endif /* _ISP_HPP_ */
@@ -0,0 +1,241 @@
+// Checks the attempt log (attempt-log.cpp): attempts read back as 
+// written, a log torn by a crash is cut back to its last good block and 
+// can be appended to again, and aggregate() (attempt-stats.cpp) counts 
+// what a plain loop counts. Also times aggregate() on a few million 
+// attempts.
+
+#include <chrono>
+#include <fcntl.h>
+#include <map>
+#include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <tuple>
+#include <unistd.h>
+#include <vector>
+
+#include "attempt-log.hpp"
+#include "attempt-stats.hpp"
+#include "crc32.hpp"
+#include "test-check.hpp"
+
+// Reproducible attempts: a sweep of delays and widths, over 3 rigs and 
+// 2 targets, with hits in a small window.
+static Attempt make_attempt(uint64_t n)
+{
+  static const char OUTCOMES[] = {'.', '.', '.', 'r', '0', '?'};
+  Attempt a;
+  a.time_us = 1700000000000000ull + n * 1000;
+  a.rig = n % 3;
+  a.target = (n / 7) % 2;
+  a.delay = 9000 + (n / 131) % 200;
+  a.width = 100 + n % 131;
+  bool hit = 9100 <= a.delay && a.delay <= 9103 && 150 <= a.width && a.width <= 152;
+  a.outcome = hit && n % 2 ? '!' : OUTCOMES[(n * 2654435761u >> 7) % 6];
+  a.pc = 0x8f0 + 2 * (n % 12);
+  return a;
+}
+
+static bool same(const Attempt & a, const Attempt & b)
+{
+  return a.time_us == b.time_us && a.rig == b.rig && a.target == b.target
+      && a.delay == b.delay && a.width == b.width && a.outcome == b.outcome
+      && a.pc == b.pc;
+}
+
+static std::vector<Attempt> read_all(const std::string & path)
+{
+  AttemptLogReader reader(path, true);
+  std::vector<Attempt> attempts;
+  for (const attempt_log::Columns & b : reader.blocks())
+    for (size_t i = 0; i < b.count; ++i)
+      attempts.push_back({b.time_us[i], b.rig[i], b.target[i], b.delay[i],
+                          b.width[i], (char) b.outcome[i], b.pc[i]});
+  return attempts;
+}
+
+static bool read_back(const std::string & path, uint64_t count)
+{
+  std::vector<Attempt> attempts = read_all(path);
+  if (attempts.size() != count)
+    return false;
+  for (uint64_t n = 0; n < count; ++n)
+    if (!same(attempts[n], make_attempt(n)))
+      return false;
+  return true;
+}
+
+static off_t file_size(const std::string & path)
+{
+  struct stat st;
+  return stat(path.c_str(), &st) == 0 ? st.st_size : -1;
+}
+
+// The counts of aggregate(), by a plain loop.
+static bool same_as_loop(const std::string & path, const AttemptFilter & filter)
+{
+  typedef std::tuple<uint16_t, uint16_t, int> Key;
+  std::map<Key, uint64_t> expected;
+  for (const Attempt & a : read_all(path))
+    if ((filter.rig < 0 || a.rig == filter.rig)
+     && (filter.target < 0 || a.target == filter.target)
+     && filter.since_us <= a.time_us && a.time_us < filter.until_us)
+      ++expected[Key(a.delay, a.width, AttemptGrid::class_of(a.outcome))];
+  
+  AttemptLogReader reader(path);
+  for (unsigned threads : {1, 3})
+  {
+    AttemptGrid grid = aggregate(reader, filter, threads);
+    uint64_t counted = 0;
+    for (unsigned d = grid.delay_first; d <= grid.delay_last; ++d)
+      for (unsigned w = grid.width_first; w <= grid.width_last; ++w)
+        for (int c = 0; c < AttemptGrid::NUM_CLASSES; ++c)
+        {
+          uint64_t n = grid.count(d, w, (AttemptGrid::Class) c);
+          counted += n;
+          auto it = expected.find(Key(d, w, c));
+          if (n != (it == expected.end() ? 0 : it->second))
+            return false;
+        }
+    uint64_t total = 0;
+    for (auto & e : expected)
+      total += e.second;
+    if (counted != total)
+      return false;
+  }
+  return true;
+}
+
+int main()
+{
+  char dir[] = "/tmp/log-test-XXXXXX";
+  if (!mkdtemp(dir))
+  {
+    perror("mkdtemp");
+    return 1;
+  }
+  const std::string path = std::string(dir) + "/attempts.log";
+  
+  try
+  {
+    // zlib's crc32() of "123456789".
+    check(crc32("123456789", 9) == 0xcbf43926, "crc32 check value");
+    
+    // Full blocks, and a short block at the end.
+    const uint64_t COUNT = 3 * attempt_log::RECORDS_PER_BLOCK + 1000;
+    {
+      AttemptLogWriter writer(path);
+      for (uint64_t n = 0; n < COUNT; ++n)
+        writer.append(make_attempt(n));
+      check(writer.attempts() == COUNT, "writer counts the attempts");
+    }
+    check(read_back(path, COUNT), "attempts read back as written");
+    
+    // Reopen and append: the log continues.
+    {
+      AttemptLogWriter writer(path);
+      check(writer.recovered_bytes == 0, "a clean log is not cut off");
+      check(writer.attempts() == COUNT, "reopened writer counts the attempts");
+      for (uint64_t n = COUNT; n < COUNT + 10; ++n)
+        writer.append(make_attempt(n));
+      writer.checkpoint();
+      check(read_back(path, COUNT + 10), "appended attempts read back");
+    }
+    
+    // A crash in the middle of writing the last block.
+    off_t size = file_size(path);
+    check(truncate(path.c_str(), size - 100) == 0, "truncate");
+    {
+      AttemptLogWriter writer(path);
+      check(writer.recovered_bytes > 0, "torn block is cut off");
+      check(writer.attempts() == COUNT, "torn block is not counted");
+      for (uint64_t n = COUNT; n < COUNT + 20; ++n)
+        writer.append(make_attempt(n));
+    }
+    check(read_back(path, COUNT + 20), "log continues after the torn block");
+    
+    // A complete, but corrupt, last block, followed by junk.
+    size = file_size(path);
+    {
+      int fd = open(path.c_str(), O_WRONLY);
+      char junk[64] = "junk";
+      bool ok = fd >= 0
+        && pwrite(fd, "X", 1, size - 1) == 1
+        && pwrite(fd, junk, sizeof junk, size) == sizeof junk;
+      close(fd);
+      check(ok, "corrupt the last block");
+    }
+    {
+      AttemptLogReader reader(path);
+      check(reader.attempts() == COUNT, "reader skips a corrupt last block");
+    }
+    {
+      AttemptLogWriter writer(path);
+      check(writer.recovered_bytes == 64 + attempt_log::columns_size(20)
+                                      + sizeof(attempt_log::BlockHeader),
+            "corrupt block and junk are cut off");
+      check(writer.attempts() == COUNT, "corrupt block is not counted");
+    }
+    check(read_back(path, COUNT), "good blocks survive");
+    
+    // A crash right after creating the log.
+    {
+      std::string empty = std::string(dir) + "/empty.log";
+      int fd = open(empty.c_str(), O_WRONLY | O_CREAT, 0644);
+      bool ok = fd >= 0 && write(fd, "GLITCH", 6) == 6;
+      close(fd);
+      AttemptLogWriter writer(empty);
+      writer.append(make_attempt(0));
+      writer.checkpoint();
+      check(ok && read_back(empty, 1), "a torn file header starts a new log");
+      unlink(empty.c_str());
+    }
+    
+    // aggregate() against a plain loop.
+    AttemptFilter filter;
+    check(same_as_loop(path, filter), "aggregate: everything");
+    filter.rig = 1;
+    check(same_as_loop(path, filter), "aggregate: one rig");
+    filter.target = 0;
+    check(same_as_loop(path, filter), "aggregate: one rig, one target");
+    filter = AttemptFilter();
+    filter.since_us = make_attempt(5000).time_us;
+    filter.until_us = make_attempt(9000).time_us;
+    check(same_as_loop(path, filter), "aggregate: time range");
+    
+    // Timing.
+    unlink(path.c_str());
+    const uint64_t MANY = 5000000;
+    auto start = std::chrono::steady_clock::now();
+    {
+      AttemptLogWriter writer(path, 60000);
+      for (uint64_t n = 0; n < MANY; ++n)
+        writer.append(make_attempt(n));
+    }
+    double write_seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    AttemptLogReader reader(path);
+    filter = AttemptFilter();
+    filter.rig = 2;
+    AttemptGrid grid = aggregate(reader, filter);
+    double query_seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+    check(reader.attempts() == MANY, "many attempts");
+    check(grid.total(AttemptGrid::SUCCESS) > 0, "many attempts: hits found");
+    printf("%llu attempts (%.1f MB): written in %.2f s, queried in %.3f s (%.0f M/s)\n",
+           (unsigned long long) MANY, file_size(path) / 1e6, write_seconds,
+           query_seconds, MANY / query_seconds / 1e6);
+  }
+  catch (const std::exception & e)
+  {
+    printf("FAIL: %s\n", e.what());
+    ++failures;
+  }
+  
+  unlink(path.c_str());
+  rmdir(dir);
+  printf("%u failures\n", failures);
+  return failures ? 1 : 0;
+}
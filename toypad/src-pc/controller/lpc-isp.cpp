@@ -0,0 +1,131 @@
+// Read the flash of an LPC11Uxx over the UART ISP of its boot ROM (see 
+// isp.hpp), without SWD or openocd. Only with the code read protection 
+// off (or glitched away). Reset the target with PIO0_1 and PIO0_3 low 
+// first.
+// 
+// Prints the part ID, the version of the boot code and the serial 
+// number, then switches to the fastest rate both sides can do and reads.
+// 
+// Usage: lpc-isp [options]
+// 
+//   --serial <port>          (/dev/ttyUSB0)
+//   --baud <rate>            of the autobaud (115200)
+//   --max-baud <rate>        (230400)
+//   --clock-khz <kHz>        the clock the boot ROM runs from (12000, 
+//                            the IRC)
+//   --address <address>      (0)
+//   --size <bytes>           (32768; 0: only identify)
+//   --output <file>          (flash.bin)
+//   --fake                   talk to a FakeIsp with a flash of 
+//                            counting bytes instead, for a dry run
+
+#include <chrono>
+#include <getopt.h>
+#include <memory>
+#include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include "fake-isp.hpp"
+#include "isp.hpp"
+#include "serial-port.hpp"
+
+static void usage(const char * program)
+{
+  fprintf(stderr,
+    "Usage: %s [--serial <port>] [--baud <rate>] [--max-baud <rate>]\n"
+    "       [--clock-khz <kHz>] [--address <address>] [--size <bytes>]\n"
+    "       [--output <file>] [--fake]\n", program);
+  exit(2);
+}
+
+int main(int argc, char ** argv)
+{
+  std::string serial = "/dev/ttyUSB0";
+  unsigned baud = 115200;
+  unsigned max_baud = 230400;
+  unsigned clock_khz = 12000;
+  uint32_t address = 0;
+  uint32_t size = 32 * 1024;
+  std::string output = "flash.bin";
+  bool fake = false;
+  
+  static const option options[] = {
+    {"serial",    required_argument, nullptr, 's'},
+    {"baud",      required_argument, nullptr, 'b'},
+    {"max-baud",  required_argument, nullptr, 'm'},
+    {"clock-khz", required_argument, nullptr, 'k'},
+    {"address",   required_argument, nullptr, 'a'},
+    {"size",      required_argument, nullptr, 'n'},
+    {"output",    required_argument, nullptr, 'o'},
+    {"fake",      no_argument,       nullptr, 'f'},
+    {nullptr,     0,                 nullptr, 0},
+  };
+  int option;
+  while ((option = getopt_long(argc, argv, "", options, nullptr)) != -1)
+  {
+    switch (option)
+    {
+      case 's': serial = optarg; break;
+      case 'b': baud = strtoul(optarg, nullptr, 0); break;
+      case 'm': max_baud = strtoul(optarg, nullptr, 0); break;
+      case 'k': clock_khz = strtoul(optarg, nullptr, 0); break;
+      case 'a': address = strtoul(optarg, nullptr, 0); break;
+      case 'n': size = strtoul(optarg, nullptr, 0); break;
+      case 'o': output = optarg; break;
+      case 'f': fake = true; break;
+      default: usage(argv[0]);
+    }
+  }
+  if (optind != argc)
+    usage(argv[0]);
+  
+  try
+  {
+    std::unique_ptr<FakeIsp> fake_isp;
+    if (fake)
+    {
+      std::vector<uint8_t> flash(32 * 1024);
+      for (size_t i = 0; i < flash.size(); ++i)
+        flash[i] = i;
+      // Not CRP1 to CRP3.
+      flash[0x2FC] = 0xFF;
+      fake_isp.reset(new FakeIsp(flash, baud));
+      serial = fake_isp->path();
+    }
+    SerialPort port(serial, baud);
+    IspClient isp(port, baud);
+    isp.synchronize(clock_khz);
+    
+    uint32_t part_id = isp.part_id();
+    const char * name = isp_part_name(part_id);
+    printf("part ID:   0x%08X (%s)\n", part_id, name ? name : "unknown");
+    IspClient::BootCodeVersion version = isp.boot_code_version();
+    printf("boot code: %u.%u\n", version.major, version.minor);
+    std::array<uint32_t, 4> uid = isp.uid();
+    printf("UID:       %08X %08X %08X %08X\n", uid[0], uid[1], uid[2], uid[3]);
+    printf("baud:      %u\n", isp.negotiate_baud(max_baud));
+    if (!size)
+      return 0;
+    
+    auto start = std::chrono::steady_clock::now();
+    std::vector<uint8_t> data = isp.read(address, size);
+    double seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+    
+    FILE * file = fopen(output.c_str(), "wb");
+    if (!file || fwrite(data.data(), 1, data.size(), file) != data.size())
+      throw std::runtime_error(output + ": cannot write");
+    fclose(file);
+    printf("%u bytes from 0x%08X to %s in %.2f s (%.0f bytes/s), %u resends\n",
+           size, address, output.c_str(), seconds, size / seconds, isp.resends);
+  }
+  catch (const std::exception & e)
+  {
+    fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+  return 0;
+}
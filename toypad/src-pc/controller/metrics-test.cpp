@@ -0,0 +1,203 @@
+// Checks the metrics (metrics.cpp): the percentiles of HdrHistogram, 
+// the phases a campaign against the fakes records (with a slow 
+// "reset run", which has to show up as the phase that dominates), and 
+// the Prometheus endpoint on TCP and on a Unix socket.
+
+#include <arpa/inet.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <stdexcept>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "campaign.hpp"
+#include "fake-glitcher.hpp"
+#include "fake-openocd.hpp"
+#include "fake-target.hpp"
+#include "glitcher-link.hpp"
+#include "metrics.hpp"
+#include "serial-port.hpp"
+#include "tcl-rpc.hpp"
+#include "test-check.hpp"
+
+static bool close_to(double value, double expected, double tolerance)
+{
+  return fabs(value - expected) <= tolerance * expected;
+}
+
+// One HTTP request to the metrics server; the whole response.
+static std::string fetch(const sockaddr * address, socklen_t length, const std::string & path)
+{
+  int fd = socket(address->sa_family, SOCK_STREAM, 0);
+  if (fd < 0 || connect(fd, address, length) < 0)
+    throw std::runtime_error(std::string("connect: ") + strerror(errno));
+  std::string request = "GET " + path + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+  send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+  std::string response;
+  char chunk[4096];
+  ssize_t n;
+  while ((n = recv(fd, chunk, sizeof chunk, 0)) > 0)
+    response.append(chunk, n);
+  close(fd);
+  return response;
+}
+
+static std::string fetch_tcp(uint16_t port, const std::string & path)
+{
+  sockaddr_in in = {};
+  in.sin_family = AF_INET;
+  in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  in.sin_port = htons(port);
+  return fetch((const sockaddr *) &in, sizeof in, path);
+}
+
+static std::string fetch_unix(const std::string & socket_path, const std::string & path)
+{
+  sockaddr_un un = {};
+  un.sun_family = AF_UNIX;
+  strcpy(un.sun_path, socket_path.c_str());
+  return fetch((const sockaddr *) &un, sizeof un, path);
+}
+
+int main()
+{
+  try
+  {
+    // Percentiles of 1..100000.
+    {
+      HdrHistogram h;
+      for (uint64_t v = 1; v <= 100000; ++v)
+        h.record(v);
+      bool ok = true;
+      for (double p : {1.0, 10.0, 50.0, 90.0, 99.0, 99.9})
+        ok = ok && close_to(h.percentile(p), p * 1000, 1.0 / 64);
+      check(ok, "histogram: percentiles within 1/64");
+      check(h.count() == 100000 && h.min() == 1 && h.max() == 100000
+         && h.mean() == 50000.5 && h.percentile(100) == 100000, "histogram: count, min, max, mean");
+      
+      HdrHistogram small, big;
+      for (uint64_t v = 0; v < 100; ++v)
+        small.record(v);
+      big.record(3600000000000ull);
+      check(small.percentile(50) == 49, "histogram: small values exact");
+      small.add(big);
+      check(small.count() == 101 && small.max() == 3600000000000ull
+         && small.percentile(50) == 50, "histogram: add");
+      check(close_to(big.percentile(50), 3600000000000ull, 1.0 / 64), "histogram: an hour in ns");
+    }
+    
+    check(Metrics::command_phase("reset run") == "reset_run"
+       && Metrics::command_phase("halt 0") == "halt"
+       && Metrics::command_phase("set_reg {pc 0x8f0}") == "set_reg"
+       && Metrics::command_phase(TclRpc::catch_error("get_reg -force pc")) == "get_reg",
+          "phase names of openocd commands");
+    
+    // A campaign with a slow "reset run".
+    FakeTarget target{FakeTarget::Config()};
+    FakeOpenocd fake_ocd(target);
+    fake_ocd.command_latency_us = 100;
+    fake_ocd.reset_latency_us = 3000;
+    FakeGlitcher fake_glitcher(target);
+    fake_glitcher.reply_latency_us = 500;
+    
+    Metrics metrics;
+    SerialPort port(fake_glitcher.path(), 115200);
+    GlitcherLink glitcher(port);
+    glitcher.metrics = &metrics;
+    TclRpc ocd("127.0.0.1", fake_ocd.port());
+    ocd.metrics = &metrics;
+    Campaign campaign(Mode::FIND_LENGTH, glitcher, &ocd, false);
+    campaign.metrics = &metrics;
+    const unsigned ATTEMPTS = 100;
+    for (unsigned i = 0; i < ATTEMPTS; ++i)
+      campaign.attempt(1000 + i % 8, 15 + i % 12);
+    
+    bool all = true;
+    for (const char * phase : {"attempt", "glitch", "check", "setup", "serial_write",
+                               "glitcher_echo", "glitcher_done", "glitcher_ready",
+                               "resync", "openocd_send", "reset_run", "halt", "set_reg",
+                               "resume", "get_reg"})
+      all = all && metrics.phase(phase).count() > 0;
+    check(all, "campaign: every phase recorded");
+    check(metrics.phase("attempt").count() == ATTEMPTS && metrics.attempts() == ATTEMPTS,
+          "campaign: every attempt counted");
+    HdrHistogram reset = metrics.phase("reset_run");
+    check(reset.percentile(50) >= 3000000 && reset.percentile(50) < 6000000,
+          "campaign: reset_run takes its 3 ms");
+    check(metrics.phase("glitcher_echo").percentile(50) >= 500000,
+          "campaign: the glitcher's latency is in glitcher_echo");
+    std::string slowest;
+    uint64_t slowest_ns = 0;
+    for (const std::string & phase : metrics.phases())
+    {
+      HdrHistogram h = metrics.phase(phase);
+      if (phase != "attempt" && phase != "check" && phase != "glitch" && phase != "setup"
+       && h.sum() > slowest_ns)
+      {
+        slowest = phase;
+        slowest_ns = h.sum();
+      }
+    }
+    check(slowest == "reset_run", "campaign: reset_run dominates");
+    check(metrics.attempts_per_second() > 0, "campaign: attempts per second");
+    metrics.print_summary(stdout);
+    
+    // The endpoint, on TCP.
+    {
+      MetricsServer server(metrics, "0");
+      std::string response = fetch_tcp(server.port(), "/metrics");
+      check(response.compare(0, 15, "HTTP/1.0 200 OK") == 0, "tcp: 200 OK");
+      check(response.find("\r\nContent-Type: text/plain; version=0.0.4\r\n") != std::string::npos,
+            "tcp: Prometheus content type");
+      check(response.find("# TYPE glitch_phase_seconds summary\n") != std::string::npos
+         && response.find("glitch_phase_seconds{phase=\"reset_run\",quantile=\"0.99\"} 0.00") != std::string::npos
+         && response.find("glitch_phase_seconds_count{phase=\"attempt\"} 100\n") != std::string::npos,
+            "tcp: phases");
+      check(response.find("glitch_attempts_total{outcome=\"no_effect\"}") != std::string::npos
+         && response.find("\nglitch_attempts_per_second ") != std::string::npos,
+            "tcp: attempts");
+      size_t body = response.find("\r\n\r\n");
+      size_t length = response.find("Content-Length: ");
+      check(body != std::string::npos && length != std::string::npos
+         && strtoul(response.c_str() + length + 16, nullptr, 10) == response.size() - body - 4,
+            "tcp: Content-Length");
+      check(fetch_tcp(server.port(), "/other").compare(0, 12, "HTTP/1.0 404") == 0, "tcp: 404");
+      check(server.requests == 2, "tcp: requests counted");
+    }
+    
+    // The endpoint, on a Unix socket.
+    {
+      std::string path = "/tmp/metrics-test-" + std::to_string(getpid()) + ".sock";
+      {
+        MetricsServer server(metrics, "unix:" + path);
+        std::string response = fetch_unix(path, "/metrics");
+        check(response.compare(0, 15, "HTTP/1.0 200 OK") == 0
+           && response.find("glitch_attempts_total") != std::string::npos, "unix: metrics");
+      }
+      check(access(path.c_str(), F_OK) != 0, "unix: socket removed");
+    }
+    
+    bool thrown = false;
+    try
+    {
+      MetricsServer server(metrics, "not-a-port");
+    }
+    catch (const std::runtime_error &)
+    {
+      thrown = true;
+    }
+    check(thrown, "bad address refused");
+  }
+  catch (const std::exception & e)
+  {
+    printf("FAIL: %s\n", e.what());
+    ++failures;
+  }
+  
+  printf("%u failures\n", failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,350 @@
+#include <algorithm>
+#include <arpa/inet.h>
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdexcept>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "metrics.hpp"
+
+// Buckets: the values below 2^SUB_BUCKET_BITS one by one, then half as 
+// many sub-buckets for every further power of two up to 2^63.
+static const size_t LINEAR = (size_t) 1 << 7;
+static const size_t HALF = LINEAR / 2;
+static const size_t BUCKETS = LINEAR + (63 - 6) * HALF;
+
+HdrHistogram::HdrHistogram()
+  : counts(BUCKETS)
+{
+  static_assert(LINEAR == (size_t) 1 << SUB_BUCKET_BITS, "bucket layout");
+}
+
+size_t HdrHistogram::index(uint64_t value)
+{
+  if (value < LINEAR)
+    return value;
+  unsigned shift = 63 - __builtin_clzll(value) - (SUB_BUCKET_BITS - 1);
+  return LINEAR + (shift - 1) * HALF + ((value >> shift) - HALF);
+}
+
+uint64_t HdrHistogram::highest_equivalent(size_t index)
+{
+  if (index < LINEAR)
+    return index;
+  unsigned shift = (index - LINEAR) / HALF + 1;
+  uint64_t sub = (index - LINEAR) % HALF + HALF;
+  return ((sub + 1) << shift) - 1;
+}
+
+void HdrHistogram::record(uint64_t value)
+{
+  ++counts[index(value)];
+  ++total;
+  lowest = std::min(lowest, value);
+  highest = std::max(highest, value);
+  summed += value;
+}
+
+void HdrHistogram::add(const HdrHistogram & other)
+{
+  for (size_t i = 0; i < BUCKETS; ++i)
+    counts[i] += other.counts[i];
+  total += other.total;
+  lowest = std::min(lowest, other.lowest);
+  highest = std::max(highest, other.highest);
+  summed += other.summed;
+}
+
+uint64_t HdrHistogram::percentile(double percent) const
+{
+  if (!total)
+    return 0;
+  uint64_t wanted = std::max<uint64_t>(1, ceil(percent / 100 * total));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < BUCKETS; ++i)
+  {
+    seen += counts[i];
+    if (seen >= wanted)
+      return std::min(highest_equivalent(i), highest);
+  }
+  return highest;
+}
+
+
+
+Metrics::Metrics()
+  : start(Clock::now())
+{
+}
+
+void Metrics::record(const std::string & phase, Clock::duration duration)
+{
+  int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+  std::lock_guard<std::mutex> lock(mutex);
+  histograms[phase].record(ns > 0 ? ns : 0);
+}
+
+void Metrics::count_attempt(char outcome)
+{
+  int64_t second = std::chrono::duration_cast<std::chrono::seconds>(
+    Clock::now() - start).count();
+  std::lock_guard<std::mutex> lock(mutex);
+  ++outcomes[outcome];
+  unsigned slot = second % RATE_SECONDS;
+  if (rate_second[slot] != second)
+  {
+    rate_second[slot] = second;
+    rate_count[slot] = 0;
+  }
+  ++rate_count[slot];
+}
+
+HdrHistogram Metrics::phase(const std::string & phase)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = histograms.find(phase);
+  return it == histograms.end() ? HdrHistogram() : it->second;
+}
+
+std::vector<std::string> Metrics::phases()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  std::vector<std::string> names;
+  for (auto & h : histograms)
+    names.push_back(h.first);
+  return names;
+}
+
+uint64_t Metrics::attempts()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  uint64_t sum = 0;
+  for (auto & o : outcomes)
+    sum += o.second;
+  return sum;
+}
+
+double Metrics::attempts_per_second()
+{
+  double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+  int64_t now = (int64_t) elapsed;
+  std::lock_guard<std::mutex> lock(mutex);
+  // The current second is not over yet: count it, and the seconds 
+  // before it.
+  uint64_t sum = 0;
+  for (unsigned slot = 0; slot < RATE_SECONDS; ++slot)
+    if (now - rate_second[slot] < RATE_SECONDS && rate_second[slot] <= now)
+      sum += rate_count[slot];
+  double window = std::min<double>(elapsed, RATE_SECONDS);
+  return window > 0 ? sum / window : 0;
+}
+
+std::string Metrics::command_phase(const std::string & command)
+{
+  static const std::string catch_start = "if {[catch {";
+  std::string inner = command;
+  if (inner.compare(0, catch_start.size(), catch_start) == 0)
+    inner = inner.substr(catch_start.size(), inner.find('}') - catch_start.size());
+  size_t space = inner.find(' ');
+  std::string name = inner.substr(0, space);
+  if (name == "reset" && space != std::string::npos)
+    name += "_" + inner.substr(space + 1, inner.find(' ', space + 1) - space - 1);
+  for (char & c : name)
+    if (!isalnum((unsigned char) c))
+      c = '_';
+  return name;
+}
+
+static const char * outcome_name(char outcome)
+{
+  switch (outcome)
+  {
+    case '.': return "no_effect";
+    case '!': return "hit";
+    case 'r': return "reset";
+    case '0': return "restart";
+  }
+  return "unknown";
+}
+
+std::string Metrics::prometheus()
+{
+  double rate = attempts_per_second();
+  std::lock_guard<std::mutex> lock(mutex);
+  std::string out;
+  char line[256];
+  
+  out += "# HELP glitch_phase_seconds Time per phase of the glitch attempts.\n";
+  out += "# TYPE glitch_phase_seconds summary\n";
+  for (auto & h : histograms)
+  {
+    for (double q : {0.5, 0.9, 0.99, 0.999})
+    {
+      snprintf(line, sizeof line, "glitch_phase_seconds{phase=\"%s\",quantile=\"%g\"} %.9f\n",
+               h.first.c_str(), q, h.second.percentile(100 * q) / 1e9);
+      out += line;
+    }
+    snprintf(line, sizeof line, "glitch_phase_seconds_sum{phase=\"%s\"} %.9f\n"
+                                "glitch_phase_seconds_count{phase=\"%s\"} %llu\n",
+             h.first.c_str(), h.second.sum() / 1e9,
+             h.first.c_str(), (unsigned long long) h.second.count());
+    out += line;
+  }
+  
+  out += "# HELP glitch_attempts_total Glitch attempts by outcome.\n";
+  out += "# TYPE glitch_attempts_total counter\n";
+  std::map<std::string, uint64_t> by_name;
+  for (auto & o : outcomes)
+    by_name[outcome_name(o.first)] += o.second;
+  for (auto & o : by_name)
+  {
+    snprintf(line, sizeof line, "glitch_attempts_total{outcome=\"%s\"} %llu\n",
+             o.first.c_str(), (unsigned long long) o.second);
+    out += line;
+  }
+  
+  out += "# HELP glitch_attempts_per_second Glitch attempts per second, over the last 10 s.\n";
+  out += "# TYPE glitch_attempts_per_second gauge\n";
+  snprintf(line, sizeof line, "glitch_attempts_per_second %.3f\n", rate);
+  out += line;
+  return out;
+}
+
+void Metrics::print_summary(FILE * out)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  auto attempt = histograms.find("attempt");
+  double attempt_ns = attempt == histograms.end() ? 0 : attempt->second.sum();
+  
+  fprintf(out, "%-16s %9s %10s %10s %10s %10s %10s %10s %6s\n", "phase", "count",
+          "mean ms", "p50 ms", "p90 ms", "p99 ms", "p99.9 ms", "max ms", "share");
+  std::vector<std::pair<std::string, const HdrHistogram *>> sorted;
+  for (auto & h : histograms)
+    sorted.push_back({h.first, &h.second});
+  std::sort(sorted.begin(), sorted.end(), [](const std::pair<std::string, const HdrHistogram *> & a,
+                                             const std::pair<std::string, const HdrHistogram *> & b)
+  {
+    return a.second->sum() > b.second->sum();
+  });
+  for (auto & h : sorted)
+  {
+    const HdrHistogram & s = *h.second;
+    fprintf(out, "%-16s %9llu %10.3f %10.3f %10.3f %10.3f %10.3f %10.3f %5.1f%%\n",
+            h.first.c_str(), (unsigned long long) s.count(), s.mean() / 1e6,
+            s.percentile(50) / 1e6, s.percentile(90) / 1e6, s.percentile(99) / 1e6,
+            s.percentile(99.9) / 1e6, s.max() / 1e6,
+            attempt_ns > 0 ? 100 * s.sum() / attempt_ns : 0.0);
+  }
+}
+
+
+
+MetricsServer::MetricsServer(Metrics & metrics, const std::string & address)
+  : metrics(metrics)
+{
+  if (address.compare(0, 5, "unix:") == 0)
+  {
+    unix_path = address.substr(5);
+    sockaddr_un un = {};
+    un.sun_family = AF_UNIX;
+    if (unix_path.empty() || unix_path.size() >= sizeof un.sun_path)
+      throw std::runtime_error("metrics: bad socket path " + unix_path);
+    strcpy(un.sun_path, unix_path.c_str());
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    unlink(unix_path.c_str());
+    if (listen_fd < 0 || bind(listen_fd, (sockaddr *) &un, sizeof un) < 0
+     || listen(listen_fd, 4) < 0)
+      throw std::runtime_error("metrics: " + unix_path + ": " + strerror(errno));
+  }
+  else
+  {
+    char * end;
+    unsigned long port = strtoul(address.c_str(), &end, 0);
+    if (address.empty() || *end || port > 0xFFFF)
+      throw std::runtime_error("metrics: bad address " + address);
+    listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int one = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+    sockaddr_in in = {};
+    in.sin_family = AF_INET;
+    in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    in.sin_port = htons(port);
+    socklen_t length = sizeof in;
+    if (bind(listen_fd, (sockaddr *) &in, sizeof in) < 0
+     || listen(listen_fd, 4) < 0
+     || getsockname(listen_fd, (sockaddr *) &in, &length) < 0)
+      throw std::runtime_error(std::string("metrics: ") + strerror(errno));
+    listen_port = ntohs(in.sin_port);
+  }
+  thread = std::thread(&MetricsServer::serve, this);
+}
+
+MetricsServer::~MetricsServer()
+{
+  stop = true;
+  thread.join();
+  close(listen_fd);
+  if (!unix_path.empty())
+    unlink(unix_path.c_str());
+}
+
+void MetricsServer::serve()
+{
+  while (!stop)
+  {
+    pollfd p = {listen_fd, POLLIN, 0};
+    if (poll(&p, 1, 50) <= 0)
+      continue;
+    int client = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (client < 0)
+      continue;
+    serve_client(client);
+    close(client);
+  }
+}
+
+void MetricsServer::serve_client(int client)
+{
+  // Just the request line and the headers; nobody sends a body to GET.
+  std::string request;
+  while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192)
+  {
+    pollfd p = {client, POLLIN, 0};
+    if (poll(&p, 1, 1000) <= 0)
+      return;
+    char chunk[1024];
+    ssize_t n = recv(client, chunk, sizeof chunk, 0);
+    if (n <= 0)
+      return;
+    request.append(chunk, n);
+  }
+  ++requests;
+  
+  std::string status = "200 OK";
+  std::string body;
+  if (request.compare(0, 13, "GET /metrics ") == 0 || request.compare(0, 6, "GET / ") == 0)
+    body = metrics.prometheus();
+  else
+  {
+    status = "404 Not Found";
+    body = "GET /metrics\n";
+  }
+  std::string out = "HTTP/1.0 " + status + "\r\n"
+                    "Content-Type: text/plain; version=0.0.4\r\n"
+                    "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                    "Connection: close\r\n\r\n" + body;
+  for (size_t done = 0; done < out.size(); )
+  {
+    ssize_t n = send(client, out.data() + done, out.size() - done, MSG_NOSIGNAL);
+    if (n <= 0)
+      return;
+    done += n;
+  }
+}
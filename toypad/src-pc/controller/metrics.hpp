@@ -0,0 +1,146 @@
+#ifndef _METRICS_HPP_
+#define _METRICS_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Histogram of durations (or any positive integer) in the manner of 
+// HdrHistogram: 64 linear sub-buckets per power of two, so every value 
+// is kept to within 1/64 (1.6%), from 1 ns to centuries, in a fixed 
+// 30 kB. Not thread safe by itself.
+class HdrHistogram
+{
+  public:
+    HdrHistogram();
+    
+    void record(uint64_t value);
+    void add(const HdrHistogram & other);
+    
+    uint64_t count() const { return total; }
+    uint64_t min() const { return total ? lowest : 0; }
+    uint64_t max() const { return highest; }
+    uint64_t sum() const { return summed; }
+    double mean() const { return total ? (double) summed / total : 0; }
+    
+    // The value that percent of the values are at or below (to within 
+    // the precision of the histogram).
+    uint64_t percentile(double percent) const;
+    
+  private:
+    static const unsigned SUB_BUCKET_BITS = 7;
+    static size_t index(uint64_t value);
+    static uint64_t highest_equivalent(size_t index);
+    
+    std::vector<uint64_t> counts;
+    uint64_t total = 0;
+    uint64_t lowest = UINT64_MAX;
+    uint64_t highest = 0;
+    uint64_t summed = 0;
+};
+
+// Where the time of the glitch attempts goes: one histogram (in ns) per 
+// phase, and the attempts by outcome. Thread safe; the host side fills 
+// it in with record() (TclRpc, GlitcherLink and Campaign have a metrics 
+// pointer for it).
+// 
+// The phases:
+// 
+//   attempt          a whole Campaign::attempt()
+//   glitch           a whole glitch command of the glitcher
+//   check            the openocd batch after the glitch (and the setup 
+//                    of the next attempt)
+//   setup            the setup of find-length on its own
+//   serial_write     writing a command to the glitcher
+//   glitcher_echo    from then up to the first line of the echo
+//   glitcher_done    from the echo up to "DONE" (the glitch itself)
+//   glitcher_ready   from "DONE" up to the "READY" of the main loop
+//   resync           getting back in sync with the glitcher
+//   openocd_send     writing a batch to openocd
+//   reset_run, halt, set_reg, resume, get_reg, ...
+//                    the commands of a batch: from the reply before 
+//                    (or the send) up to its reply, which is the time 
+//                    openocd took, as it runs them one after another
+class Metrics
+{
+  public:
+    typedef std::chrono::steady_clock Clock;
+    
+    Metrics();
+    
+    void record(const std::string & phase, Clock::duration duration);
+    void record(const std::string & phase, Clock::time_point start)
+    {
+      record(phase, Clock::now() - start);
+    }
+    void count_attempt(char outcome);
+    
+    // The histogram of a phase (a copy), and all phases.
+    HdrHistogram phase(const std::string & phase);
+    std::vector<std::string> phases();
+    
+    uint64_t attempts();
+    // Over the last RATE_SECONDS.
+    double attempts_per_second();
+    
+    // All of it, in the text format of Prometheus.
+    std::string prometheus();
+    
+    // Table of the phases: count, mean, percentiles, max, and their 
+    // share of the time of the attempts.
+    void print_summary(FILE * out);
+    
+    // Name of a phase for an openocd command: the first word, and the 
+    // mode of a reset ("reset run" is reset_run); the command inside 
+    // TclRpc::catch_error().
+    static std::string command_phase(const std::string & command);
+    
+    static const unsigned RATE_SECONDS = 10;
+    
+  private:
+    std::mutex mutex;
+    std::map<std::string, HdrHistogram> histograms;
+    std::map<char, uint64_t> outcomes;
+    Clock::time_point start;
+    
+    // Attempts per second of the last RATE_SECONDS seconds.
+    int64_t rate_second[RATE_SECONDS] = {};
+    uint64_t rate_count[RATE_SECONDS] = {};
+};
+
+// Serves Metrics::prometheus() over HTTP ("GET /metrics"), in its own 
+// thread, on a Unix socket ("unix:<path>") or on a TCP port of 
+// localhost ("<port>", 0 for any free port, see port()).
+// 
+// Throws std::runtime_error if it cannot listen.
+class MetricsServer
+{
+  public:
+    MetricsServer(Metrics & metrics, const std::string & address);
+    ~MetricsServer();
+    MetricsServer(const MetricsServer &) = delete;
+    MetricsServer & operator=(const MetricsServer &) = delete;
+    
+    uint16_t port() const { return listen_port; }
+    
+    std::atomic<unsigned> requests{0};
+    
+  private:
+    void serve();
+    void serve_client(int client);
+    
+    Metrics & metrics;
+    std::string unix_path;
+    int listen_fd = -1;
+    uint16_t listen_port = 0;
+    std::atomic<bool> stop{false};
+    std::thread thread;
+};
+
+#endif /* _METRICS_HPP_ */
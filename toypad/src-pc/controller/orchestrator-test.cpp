@@ -0,0 +1,184 @@
+// Runs the orchestrator (orchestrator.cpp) on simulated rigs (a fake 
+// target, openocd and glitcher each): every attempt is done exactly 
+// once and logged, rigs steal work, flaky and dead rigs are 
+// quarantined, and the throughput grows with the number of rigs.
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+#include "attempt-log.hpp"
+#include "fake-glitcher.hpp"
+#include "fake-openocd.hpp"
+#include "fake-target.hpp"
+#include "orchestrator.hpp"
+#include "test-check.hpp"
+
+struct SimulatedRig
+{
+  SimulatedRig(const FakeTarget::Config & config, unsigned latency_us)
+    : target(config), ocd(target), glitcher(target)
+  {
+    glitcher.reply_latency_us = latency_us;
+  }
+  
+  RigConfig config() const
+  {
+    RigConfig rig;
+    rig.serial = glitcher.path();
+    rig.ocd_host = "127.0.0.1";
+    rig.ocd_port = ocd.port();
+    return rig;
+  }
+  
+  FakeTarget target;
+  FakeOpenocd ocd;
+  FakeGlitcher glitcher;
+};
+
+struct Result
+{
+  bool done;
+  // The longest time a rig spent glitching.
+  double seconds = 0;
+  std::vector<Orchestrator::RigStats> stats;
+  // Attempts per (delay, width) in the log, and whether their outcomes 
+  // were right.
+  std::map<std::pair<unsigned, unsigned>, unsigned> cells;
+  unsigned wrong = 0;
+};
+
+static Orchestrator::Options options()
+{
+  Orchestrator::Options o;
+  o.delays = {995, 1010};
+  o.widths = {10, 40};
+  o.quarantine_window = 50;
+  return o;
+}
+
+// latencies: one simulated rig per latency; flaky: the last rig browns 
+// out after that many glitches; dead: add a rig that does not exist.
+static Result run(const std::vector<unsigned> & latencies, unsigned flaky = 0, bool dead = false)
+{
+  char path[] = "/tmp/orchestrator-test-XXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0)
+    throw std::runtime_error("mkstemp");
+  close(fd);
+  unlink(path);
+  
+  std::vector<std::unique_ptr<SimulatedRig>> simulated;
+  std::vector<RigConfig> rigs;
+  for (size_t i = 0; i < latencies.size(); ++i)
+  {
+    FakeTarget::Config config;
+    if (i == latencies.size() - 1)
+      config.brown_out_after = flaky;
+    simulated.emplace_back(new SimulatedRig(config, latencies[i]));
+    rigs.push_back(simulated.back()->config());
+  }
+  if (dead)
+    rigs.insert(rigs.begin(), RigConfig{"/dev/no-such-glitcher", "127.0.0.1", 1});
+  
+  Result result;
+  {
+    AttemptLogWriter log(path);
+    Orchestrator orchestrator(rigs, options(), &log);
+    result.done = orchestrator.run();
+    result.stats = orchestrator.stats();
+    for (const Orchestrator::RigStats & s : result.stats)
+      result.seconds = std::max(result.seconds, s.seconds);
+  }
+  
+  FakeTarget reference{FakeTarget::Config()};
+  AttemptLogReader log(path, true);
+  for (const attempt_log::Columns & b : log.blocks())
+    for (size_t i = 0; i < b.count; ++i)
+    {
+      ++result.cells[{b.delay[i], b.width[i]}];
+      bool flaky_rig = flaky && b.rig[i] == rigs.size() - 1;
+      char expected = reference.expected(b.delay[i], b.width[i], 1);
+      result.wrong += !flaky_rig && b.outcome[i] != expected;
+    }
+  unlink(path);
+  return result;
+}
+
+static bool every_cell_once(const Result & result)
+{
+  Orchestrator::Options o = options();
+  if (result.cells.size() != o.delays.size() * o.widths.size())
+    return false;
+  for (auto & cell : result.cells)
+    if (cell.second != 1)
+      return false;
+  return true;
+}
+
+int main()
+{
+  try
+  {
+    RigConfig rig;
+    check(parse_rig("/dev/ttyUSB1,localhost:6667", rig) && rig.serial == "/dev/ttyUSB1"
+       && rig.ocd_host == "localhost" && rig.ocd_port == 6667, "parse --rig");
+    check(parse_rig("/dev/ttyUSB0", rig) && rig.ocd_port == 6666, "parse --rig without openocd");
+    check(!parse_rig("/dev/ttyUSB0,localhost", rig) && !parse_rig(",x:1", rig),
+          "parse bad --rig");
+    
+    // Throughput.
+    const unsigned LATENCY_US = 1000;
+    Result one = run({LATENCY_US});
+    check(one.done && every_cell_once(one) && !one.wrong, "1 rig: every attempt once, right");
+    Result four = run({LATENCY_US, LATENCY_US, LATENCY_US, LATENCY_US});
+    check(four.done && every_cell_once(four) && !four.wrong, "4 rigs: every attempt once, right");
+    bool all_worked = true;
+    for (const Orchestrator::RigStats & s : four.stats)
+      all_worked = all_worked && s.attempts > 0 && !s.quarantined;
+    check(all_worked, "4 rigs: all rigs worked");
+    printf("      1 rig: %.2f s, 4 rigs: %.2f s (%.1f times the throughput)\n",
+           one.seconds, four.seconds, one.seconds / four.seconds);
+    check(one.seconds / four.seconds > 3, "4 rigs: more than 3 times the throughput");
+    
+    // A slow rig: the others steal its shards.
+    Result slow = run({LATENCY_US, LATENCY_US, LATENCY_US, 8 * LATENCY_US});
+    unsigned stolen = 0;
+    for (const Orchestrator::RigStats & s : slow.stats)
+      stolen += s.stolen;
+    check(slow.done && every_cell_once(slow), "slow rig: every attempt once");
+    check(stolen > 0 && slow.stats[3].attempts < slow.stats[0].attempts,
+          "slow rig: shards stolen from it");
+    
+    // A flaky rig: browns out on every glitch after 40.
+    Result flaky = run({LATENCY_US, LATENCY_US, LATENCY_US, LATENCY_US}, 40);
+    check(flaky.done && every_cell_once(flaky) && !flaky.wrong, "flaky rig: every attempt once");
+    check(flaky.stats[3].quarantined && flaky.stats[3].why == "reset rate spiked",
+          "flaky rig: quarantined");
+    check(!flaky.stats[0].quarantined && !flaky.stats[1].quarantined
+       && !flaky.stats[2].quarantined, "flaky rig: the others are not");
+    
+    // A rig that does not work at all.
+    Result dead = run({LATENCY_US, LATENCY_US}, 0, true);
+    check(dead.done && every_cell_once(dead) && !dead.wrong, "dead rig: every attempt once");
+    check(dead.stats[0].quarantined && dead.stats[0].attempts == 0, "dead rig: quarantined");
+    
+    // No working rig at all.
+    Result none = run({}, 0, true);
+    check(!none.done && none.cells.empty(), "no working rig: not done");
+  }
+  catch (const std::exception & e)
+  {
+    printf("FAIL: %s\n", e.what());
+    ++failures;
+  }
+  
+  printf("%u failures\n", failures);
+  return failures ? 1 : 0;
+}
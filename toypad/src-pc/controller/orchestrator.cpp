@@ -0,0 +1,275 @@
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <utility>
+
+#include "glitcher-link.hpp"
+#include "orchestrator.hpp"
+#include "serial-port.hpp"
+#include "tcl-rpc.hpp"
+
+bool parse_rig(const std::string & text, RigConfig & rig)
+{
+  rig = RigConfig();
+  size_t comma = text.find(',');
+  rig.serial = text.substr(0, comma);
+  if (rig.serial.empty())
+    return false;
+  if (comma == std::string::npos)
+    return true;
+  std::string ocd = text.substr(comma + 1);
+  size_t colon = ocd.rfind(':');
+  if (colon == std::string::npos || colon == 0)
+    return false;
+  char * end;
+  unsigned long port = strtoul(ocd.c_str() + colon + 1, &end, 0);
+  if (*end || !port || port > 0xFFFF)
+    return false;
+  rig.ocd_host = ocd.substr(0, colon);
+  rig.ocd_port = port;
+  return true;
+}
+
+Orchestrator::Orchestrator(const std::vector<RigConfig> & rigs, const Options & options,
+                           AttemptLogWriter * log)
+  : rigs(rigs), options(options), log(log), shards(rigs.size()), rig_stats(rigs.size()),
+    width_attempts(rigs.size(), std::vector<uint32_t>(options.widths.size())),
+    width_resets(rigs.size(), std::vector<uint32_t>(options.widths.size()))
+{
+  if (rigs.empty() || rigs.size() > 0x100)
+    throw std::runtime_error("1 to 256 rigs");
+  if (!options.shard_delays || !options.quarantine_window)
+    throw std::runtime_error("shards and the quarantine window cannot be empty");
+}
+
+bool Orchestrator::run()
+{
+  std::vector<unsigned> live;
+  for (unsigned rig = 0; rig < rigs.size(); ++rig)
+    if (!rig_stats[rig].quarantined)
+      live.push_back(rig);
+  if (live.empty())
+    return false;
+  
+  unsigned n = 0;
+  for (unsigned d = options.delays.first; d <= options.delays.last; d += options.shard_delays)
+  {
+    unsigned last = std::min(d + options.shard_delays - 1, options.delays.last);
+    shards[live[n++ % live.size()]].push_back({d, last, 0});
+  }
+  
+  working = live.size();
+  std::vector<std::thread> threads;
+  for (unsigned rig : live)
+    threads.emplace_back(&Orchestrator::run_rig, this, rig);
+  for (std::thread & thread : threads)
+    thread.join();
+  
+  for (const std::deque<Shard> & left : shards)
+    if (!left.empty())
+      return false;
+  return true;
+}
+
+bool Orchestrator::next_shard(unsigned rig, Shard & shard)
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  --working;
+  for (;;)
+  {
+    if (!shards[rig].empty())
+    {
+      shard = shards[rig].front();
+      shards[rig].pop_front();
+      break;
+    }
+    // Steal from the rig with the most shards left.
+    unsigned victim = rig;
+    for (unsigned other = 0; other < shards.size(); ++other)
+      if (shards[other].size() > shards[victim].size())
+        victim = other;
+    if (victim != rig)
+    {
+      shard = shards[victim].back();
+      shards[victim].pop_back();
+      ++rig_stats[rig].stolen;
+      break;
+    }
+    // Nothing left, unless a rig fails and gives its shard back.
+    if (!working)
+    {
+      changed.notify_all();
+      return false;
+    }
+    changed.wait(lock);
+  }
+  ++working;
+  ++rig_stats[rig].shards;
+  return true;
+}
+
+void Orchestrator::give_back(unsigned rig, const Shard & shard)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  // To the live rig with the fewest shards, or else for the next run().
+  unsigned to = rig;
+  for (unsigned other = 0; other < shards.size(); ++other)
+    if (other != rig && !rig_stats[other].quarantined
+     && (to == rig || shards[other].size() < shards[to].size()))
+      to = other;
+  shards[to].push_front(shard);
+  changed.notify_all();
+}
+
+bool Orchestrator::spiking(unsigned rig, const std::deque<std::pair<uint16_t, char>> & window)
+{
+  if (window.size() < options.quarantine_window)
+    return false;
+  
+  std::lock_guard<std::mutex> lock(mutex);
+  // The reset rate of the other rigs, per width, and over all widths for 
+  // widths they did not try yet.
+  const unsigned widths = options.widths.size();
+  std::vector<uint32_t> attempts(widths), resets(widths);
+  uint64_t total_attempts = 0, total_resets = 0;
+  for (unsigned other = 0; other < rigs.size(); ++other)
+  {
+    if (other == rig)
+      continue;
+    for (unsigned w = 0; w < widths; ++w)
+    {
+      attempts[w] += width_attempts[other][w];
+      resets[w] += width_resets[other][w];
+    }
+    total_attempts += rig_stats[other].attempts;
+    total_resets += rig_stats[other].resets;
+  }
+  if (total_attempts < options.quarantine_window)
+    return false;
+  
+  double expected = 0;
+  unsigned observed = 0;
+  for (const std::pair<uint16_t, char> & attempt : window)
+  {
+    unsigned w = attempt.first - options.widths.first;
+    expected += attempts[w] ? (double) resets[w] / attempts[w]
+                            : (double) total_resets / total_attempts;
+    observed += attempt.second == 'r';
+  }
+  return (observed - expected) / window.size() > options.quarantine_margin;
+}
+
+void Orchestrator::quarantine(unsigned rig, const std::string & why)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  rig_stats[rig].quarantined = true;
+  rig_stats[rig].why = why;
+  --working;
+  changed.notify_all();
+  fprintf(stderr, "rig %u (%s) quarantined: %s\n", rig, rigs[rig].serial.c_str(), why.c_str());
+}
+
+void Orchestrator::log_attempt(unsigned rig, uint16_t delay, uint16_t width,
+                               char outcome, uint32_t pc)
+{
+  if (!log)
+    return;
+  Attempt attempt;
+  attempt.time_us = std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::system_clock::now().time_since_epoch()).count();
+  attempt.rig = rig;
+  attempt.target = (uint8_t) options.mode;
+  attempt.delay = delay;
+  attempt.width = width;
+  attempt.outcome = outcome;
+  attempt.pc = pc;
+  std::lock_guard<std::mutex> lock(log_mutex);
+  log->append(attempt);
+}
+
+void Orchestrator::run_rig(unsigned rig)
+{
+  const RigConfig & config = rigs[rig];
+  bool have_shard = false;
+  Shard shard;
+  try
+  {
+    SerialPort port(config.serial, options.baud);
+    GlitcherLink glitcher(port);
+    glitcher.metrics = options.metrics;
+    if (glitcher.set_resolution(options.resolution) != options.resolution)
+      throw std::runtime_error("glitcher cannot do the resolution");
+    glitcher.set_swd_oracle(options.swd_oracle);
+    std::unique_ptr<TclRpc> ocd;
+    if (!(options.mode == Mode::FINAL && options.swd_oracle))
+    {
+      ocd.reset(new TclRpc(config.ocd_host, config.ocd_port));
+      ocd->metrics = options.metrics;
+    }
+    Campaign campaign(options.mode, glitcher, ocd.get(), options.swd_oracle);
+    campaign.metrics = options.metrics;
+    
+    std::deque<std::pair<uint16_t, char>> window;
+    std::string row;
+    const unsigned widths = options.widths.size();
+    while ((have_shard = next_shard(rig, shard)))
+    {
+      uint64_t total = (uint64_t) (shard.delay_last - shard.delay_first + 1) * widths;
+      for (; shard.done < total; ++shard.done)
+      {
+        uint16_t delay = shard.delay_first + shard.done / widths;
+        uint16_t width = options.widths.first + shard.done % widths;
+        unsigned errors = campaign.link_errors;
+        auto begin = std::chrono::steady_clock::now();
+        char outcome = campaign.attempt(delay, width);
+        log_attempt(rig, delay, width, outcome, campaign.last_pc);
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          RigStats & stats = rig_stats[rig];
+          stats.seconds += std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - begin).count();
+          ++stats.attempts;
+          stats.hits += outcome == '!';
+          stats.resets += outcome == 'r';
+          stats.link_errors += campaign.link_errors - errors;
+          ++width_attempts[rig][width - options.widths.first];
+          width_resets[rig][width - options.widths.first] += outcome == 'r';
+        }
+        
+        if (options.verbose)
+        {
+          row += outcome;
+          if (width == options.widths.last)
+          {
+            printf("rig %2u post-reset delay %4u: %s\n", rig, delay, row.c_str());
+            fflush(stdout);
+            row.clear();
+          }
+        }
+        
+        window.push_back({width, outcome});
+        if (window.size() > options.quarantine_window)
+          window.pop_front();
+        if (spiking(rig, window))
+        {
+          if (++shard.done < total)
+            give_back(rig, shard);
+          have_shard = false;
+          quarantine(rig, "reset rate spiked");
+          return;
+        }
+      }
+    }
+  }
+  catch (const std::exception & e)
+  {
+    // The attempt that failed (if any) is not done.
+    if (have_shard)
+      give_back(rig, shard);
+    quarantine(rig, e.what());
+  }
+}
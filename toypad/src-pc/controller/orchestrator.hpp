@@ -0,0 +1,122 @@
+#ifndef _ORCHESTRATOR_HPP_
+#define _ORCHESTRATOR_HPP_
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "attempt-log.hpp"
+#include "campaign.hpp"
+#include "metrics.hpp"
+#include "scheduler.hpp"
+
+// One glitcher+target pair: the serial port of its glitcher, and the 
+// Tcl RPC port of the openocd of its debug probe.
+struct RigConfig
+{
+  std::string serial;
+  std::string ocd_host = "localhost";
+  uint16_t ocd_port = 6666;
+};
+
+// Parse "<serial>[,<host>:<port>]".
+bool parse_rig(const std::string & text, RigConfig & rig);
+
+// A campaign on several rigs at once. The delays are cut into shards of 
+// shard_delays delays (every width of them), dealt out to the rigs in 
+// turn. Every rig runs in its own thread and works off its own shards; 
+// a rig without shards left steals the last shard of the rig with the 
+// most shards left.
+// 
+// A rig whose reset rate spikes is quarantined: over its last 
+// quarantine_window attempts, it reset quarantine_margin (as a 
+// fraction) more often than the other rigs did at the same widths 
+// (once they did at least quarantine_window attempts), so widths that 
+// reset on any rig do not count against it. A rig that fails (serial 
+// link, openocd) is 
+// quarantined too. The rest of its current shard goes back to the 
+// others, and so do its shards left (by stealing).
+// 
+// All attempts go to one log, if any, with the rig's number (its index 
+// in rigs).
+class Orchestrator
+{
+  public:
+    struct Options
+    {
+      Mode mode = Mode::FIND_LENGTH;
+      Range delays = {9900, 9908};
+      Range widths = {135, 264};
+      unsigned resolution = 1;
+      bool swd_oracle = false;
+      unsigned baud = 115200;
+      unsigned shard_delays = 1;
+      unsigned quarantine_window = 200;
+      double quarantine_margin = 0.25;
+      
+      // Print a line per delay.
+      bool verbose = false;
+      
+      // If set: the phases of the attempts of all rigs.
+      Metrics * metrics = nullptr;
+    };
+    
+    Orchestrator(const std::vector<RigConfig> & rigs, const Options & options,
+                 AttemptLogWriter * log = nullptr);
+    
+    // One round over all delays and widths. Returns false if every rig 
+    // got quarantined before the round was done.
+    bool run();
+    
+    struct RigStats
+    {
+      unsigned attempts = 0;
+      unsigned hits = 0;
+      unsigned resets = 0;
+      unsigned shards = 0;
+      unsigned stolen = 0;
+      unsigned link_errors = 0;
+      // Time spent glitching, without starting up or waiting for work.
+      double seconds = 0;
+      bool quarantined = false;
+      std::string why;
+    };
+    const std::vector<RigStats> & stats() const { return rig_stats; }
+    
+  private:
+    struct Shard
+    {
+      unsigned delay_first;
+      unsigned delay_last;
+      // Attempts of the shard already done.
+      uint64_t done;
+    };
+    
+    void run_rig(unsigned rig);
+    bool next_shard(unsigned rig, Shard & shard);
+    void give_back(unsigned rig, const Shard & shard);
+    bool spiking(unsigned rig, const std::deque<std::pair<uint16_t, char>> & window);
+    void quarantine(unsigned rig, const std::string & why);
+    void log_attempt(unsigned rig, uint16_t delay, uint16_t width, char outcome, uint32_t pc);
+    
+    std::vector<RigConfig> rigs;
+    Options options;
+    AttemptLogWriter * log;
+    
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<std::deque<Shard>> shards;
+    // Rigs working on a shard (or starting up): they may give work back.
+    unsigned working = 0;
+    std::vector<RigStats> rig_stats;
+    // Attempts and resets per rig and width.
+    std::vector<std::vector<uint32_t>> width_attempts;
+    std::vector<std::vector<uint32_t>> width_resets;
+    std::mutex log_mutex;
+};
+
+#endif /* _ORCHESTRATOR_HPP_ */
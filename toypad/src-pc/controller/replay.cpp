@@ -0,0 +1,92 @@
+#include <algorithm>
+
+#include "replay.hpp"
+
+// A gap between two attempts longer than this is a pause of the 
+// campaign, not the duration of an attempt.
+#define PAUSE_SECONDS	10.0
+
+void OutcomeModel::add(const AttemptLogReader & log, int rig, int target)
+{
+  for (const attempt_log::Columns & b : log.blocks())
+    for (size_t i = 0; i < b.count; ++i)
+      if ((rig < 0 || b.rig[i] == rig) && (target < 0 || b.target[i] == target))
+        add({b.time_us[i], b.rig[i], b.target[i], b.delay[i], b.width[i],
+             (char) b.outcome[i], b.pc[i]});
+}
+
+void OutcomeModel::add(const Attempt & attempt)
+{
+  Counts & c = cells[(uint32_t) attempt.delay << 16 | attempt.width];
+  ++c.total;
+  c.hits += attempt.outcome == '!';
+  c.resets += attempt.outcome == 'r';
+  c.others += attempt.outcome != '!' && attempt.outcome != 'r' && attempt.outcome != '.';
+  ++attempts;
+  hits += attempt.outcome == '!';
+  
+  delay_low = std::min<unsigned>(delay_low, attempt.delay);
+  delay_high = std::max<unsigned>(delay_high, attempt.delay);
+  width_low = std::min<unsigned>(width_low, attempt.width);
+  width_high = std::max<unsigned>(width_high, attempt.width);
+  
+  // The attempts of a rig follow each other, and are logged when done: 
+  // the time since the one before is the time this one took.
+  auto last = last_time_us.find(attempt.rig);
+  if (last != last_time_us.end() && attempt.time_us > last->second)
+  {
+    double seconds = (attempt.time_us - last->second) / 1e6;
+    if (seconds < PAUSE_SECONDS)
+    {
+      recorded_seconds += seconds;
+      if (attempt.outcome == 'r')
+        seconds_reset += (seconds - seconds_reset) / ++timed_reset;
+      else
+        seconds_plain += (seconds - seconds_plain) / ++timed_plain;
+    }
+  }
+  last_time_us[attempt.rig] = attempt.time_us;
+  
+  // Without timing, every attempt takes the same time.
+  if (!timed_plain)
+    seconds_plain = timed_reset ? seconds_reset : 1;
+  if (!timed_reset)
+    seconds_reset = seconds_plain;
+}
+
+char OutcomeModel::outcome(const Point & point, std::mt19937_64 & random) const
+{
+  auto it = cells.find((uint32_t) point.delay << 16 | point.width);
+  if (it == cells.end())
+    return '.';
+  const Counts & c = it->second;
+  uint32_t n = std::uniform_int_distribution<uint32_t>(0, c.total - 1)(random);
+  if (n < c.hits)
+    return '!';
+  n -= c.hits;
+  if (n < c.resets)
+    return 'r';
+  n -= c.resets;
+  return n < c.others ? '?' : '.';
+}
+
+ReplayResult replay(Scheduler & scheduler, const OutcomeModel & model,
+                    double seconds, unsigned batch, uint64_t seed)
+{
+  std::mt19937_64 random(seed);
+  ReplayResult result;
+  while (result.seconds < seconds)
+  {
+    for (const Point & point : scheduler.next_batch(batch))
+    {
+      char outcome = model.outcome(point, random);
+      double took = model.seconds(outcome);
+      scheduler.record(point, outcome, took);
+      ++result.attempts;
+      result.hits += outcome == '!';
+      result.resets += outcome == 'r';
+      result.seconds += took;
+    }
+  }
+  return result;
+}
@@ -0,0 +1,72 @@
+#ifndef _REPLAY_HPP_
+#define _REPLAY_HPP_
+
+#include <map>
+#include <random>
+#include <stdint.h>
+
+#include "attempt-log.hpp"
+#include "scheduler.hpp"
+
+// What recorded attempts say about a rig: per cell (delay, width) how 
+// often each outcome happened, and how long an attempt takes with and 
+// without a reset. Replaying a campaign against it tells how many hits a 
+// scheduler would have had in the same time.
+class OutcomeModel
+{
+  public:
+    // All attempts of the log of one rig and mode (-1: any).
+    void add(const AttemptLogReader & log, int rig = -1, int target = -1);
+    void add(const Attempt & attempt);
+    
+    // Draw the outcome of a glitch at point. Cells without recorded 
+    // attempts have no effect.
+    char outcome(const Point & point, std::mt19937_64 & random) const;
+    double seconds(char outcome) const
+    {
+      return outcome == 'r' ? seconds_reset : seconds_plain;
+    }
+    
+    // Smallest ranges around all recorded attempts.
+    Range delays() const { return {delay_low, delay_high}; }
+    Range widths() const { return {width_low, width_high}; }
+    
+    uint64_t attempts = 0;
+    uint64_t hits = 0;
+    // Recorded time, without the pauses.
+    double recorded_seconds = 0;
+    
+  private:
+    struct Counts
+    {
+      uint32_t total = 0;
+      uint32_t hits = 0;
+      uint32_t resets = 0;
+      uint32_t others = 0;
+    };
+    std::map<uint32_t, Counts> cells;
+    
+    unsigned delay_low = 0xFFFF, delay_high = 0, width_low = 0xFFFF, width_high = 0;
+    
+    double seconds_plain = 0;
+    double seconds_reset = 0;
+    uint64_t timed_plain = 0;
+    uint64_t timed_reset = 0;
+    std::map<int, uint64_t> last_time_us;
+};
+
+struct ReplayResult
+{
+  uint64_t attempts = 0;
+  uint64_t hits = 0;
+  uint64_t resets = 0;
+  double seconds = 0;
+  
+  double hits_per_hour() const { return seconds > 0 ? hits * 3600 / seconds : 0; }
+};
+
+// Let scheduler run for seconds against the model, batch by batch.
+ReplayResult replay(Scheduler & scheduler, const OutcomeModel & model,
+                    double seconds, unsigned batch, uint64_t seed = 1);
+
+#endif /* _REPLAY_HPP_ */
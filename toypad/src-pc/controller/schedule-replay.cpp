@@ -0,0 +1,130 @@
+// How many hits per hour the adaptive scheduler (ThompsonScheduler, see 
+// scheduler.hpp) would have had on a rig, compared with the sweep of 
+// run-glitch.py: replays both against the outcomes and timing recorded 
+// in attempt logs (glitch-controller --log), over the same delays and 
+// widths.
+// 
+// Usage: schedule-replay [options] <log>...
+// 
+//   --rig <n>            only attempts of rig n
+//   --target <mode>      only attempts of mode find-length, find-delay 
+//                        or final
+//   --hours <h>          replay this long (the recorded time)
+//   --batch <n>          glitches per batch (64)
+//   --explore <rate>     fraction of random glitches (0.05)
+//   --runs <n>           average over n seeds (5)
+
+#include <getopt.h>
+#include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "attempt-log.hpp"
+#include "campaign.hpp"
+#include "replay.hpp"
+#include "scheduler.hpp"
+
+static void usage(const char * program)
+{
+  fprintf(stderr,
+    "Usage: %s [--rig <n>] [--target <mode>] [--hours <h>] [--batch <n>]\n"
+    "       [--explore <rate>] [--runs <n>] <log>...\n", program);
+  exit(2);
+}
+
+static void print(const char * name, const ReplayResult & r, unsigned runs)
+{
+  printf("%-9s %10.0f attempts  %8.1f hits  %5.1f%% resets  %10.1f hits/hour\n", name,
+         (double) r.attempts / runs, (double) r.hits / runs,
+         r.attempts ? 100.0 * r.resets / r.attempts : 0.0, r.hits_per_hour());
+}
+
+int main(int argc, char ** argv)
+{
+  int rig = -1;
+  int target = -1;
+  double hours = 0;
+  unsigned batch = 64;
+  double explore = 0.05;
+  unsigned runs = 5;
+  
+  static const option options[] = {
+    {"rig",     required_argument, nullptr, 'r'},
+    {"target",  required_argument, nullptr, 't'},
+    {"hours",   required_argument, nullptr, 'h'},
+    {"batch",   required_argument, nullptr, 'b'},
+    {"explore", required_argument, nullptr, 'e'},
+    {"runs",    required_argument, nullptr, 'n'},
+    {nullptr,   0,                 nullptr, 0},
+  };
+  int option;
+  while ((option = getopt_long(argc, argv, "", options, nullptr)) != -1)
+  {
+    switch (option)
+    {
+      case 'r': rig = strtoul(optarg, nullptr, 0); break;
+      case 't':
+      {
+        Mode mode;
+        if (!parse_mode(optarg, mode))
+          usage(argv[0]);
+        target = (int) mode;
+        break;
+      }
+      case 'h': hours = strtod(optarg, nullptr); break;
+      case 'b': batch = strtoul(optarg, nullptr, 0); break;
+      case 'e': explore = strtod(optarg, nullptr); break;
+      case 'n': runs = strtoul(optarg, nullptr, 0); break;
+      default: usage(argv[0]);
+    }
+  }
+  if (optind == argc || !batch || !runs)
+    usage(argv[0]);
+  
+  try
+  {
+    OutcomeModel model;
+    for (int i = optind; i < argc; ++i)
+      model.add(AttemptLogReader(argv[i]), rig, target);
+    if (!model.attempts)
+      throw std::runtime_error("no attempts");
+    double seconds = hours > 0 ? hours * 3600 : model.recorded_seconds;
+    if (seconds <= 0)
+      throw std::runtime_error("no timing recorded, use --hours");
+    
+    Range delays = model.delays();
+    Range widths = model.widths();
+    printf("%llu recorded attempts, %llu hits, delays %u..%u, widths %u..%u\n",
+           (unsigned long long) model.attempts, (unsigned long long) model.hits,
+           delays.first, delays.last, widths.first, widths.last);
+    printf("%.2f ms per attempt, %.2f ms per reset; replaying %.2f hours, %u runs\n\n",
+           model.seconds('.') * 1e3, model.seconds('r') * 1e3, seconds / 3600, runs);
+    
+    ReplayResult sweep_total, adaptive_total;
+    for (unsigned run = 0; run < runs; ++run)
+    {
+      SweepScheduler sweep(delays, widths);
+      ThompsonScheduler adaptive(delays, widths, explore, run + 1);
+      for (auto p : {std::make_pair(static_cast<Scheduler *>(&sweep), &sweep_total),
+                     std::make_pair(static_cast<Scheduler *>(&adaptive), &adaptive_total)})
+      {
+        ReplayResult r = replay(*p.first, model, seconds, batch, run + 1);
+        p.second->attempts += r.attempts;
+        p.second->hits += r.hits;
+        p.second->resets += r.resets;
+        p.second->seconds += r.seconds;
+      }
+    }
+    print("sweep", sweep_total, runs);
+    print("adaptive", adaptive_total, runs);
+    if (sweep_total.hits)
+      printf("\nadaptive: %.2f times the hits per hour of the sweep\n",
+             adaptive_total.hits_per_hour() / sweep_total.hits_per_hour());
+  }
+  catch (const std::exception & e)
+  {
+    fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,147 @@
+// Checks the schedulers (scheduler.cpp) against a made up rig, replayed 
+// with replay.cpp: the sweep is the loop of run-glitch.py, and the 
+// adaptive scheduler has many more hits per hour, without giving up on 
+// exploring.
+
+#include <random>
+#include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "attempt-log.hpp"
+#include "replay.hpp"
+#include "scheduler.hpp"
+#include "test-check.hpp"
+
+static const Range DELAYS = {9900, 9919};
+static const Range WIDTHS = {135, 164};
+
+// The made up rig: hits (one in five) in a small window, mostly resets 
+// from width 155 on. A reset takes 5 s, any other attempt 1 s.
+static char made_up_outcome(const Point & p, std::mt19937_64 & random)
+{
+  std::uniform_real_distribution<double> coin(0, 1);
+  if (p.width >= 155)
+    return coin(random) < 0.9 ? 'r' : '.';
+  if (9910 <= p.delay && p.delay <= 9911 && 147 <= p.width && p.width <= 149)
+    return coin(random) < 0.2 ? '!' : '.';
+  return '.';
+}
+
+// The made up rig, as recorded by glitch-controller: 20 sweeps.
+static OutcomeModel record(const std::string & path)
+{
+  std::mt19937_64 random(42);
+  uint64_t time_us = 1700000000000000ull;
+  {
+    AttemptLogWriter writer(path);
+    for (unsigned round = 0; round < 20; ++round)
+      for (unsigned d = DELAYS.first; d <= DELAYS.last; ++d)
+        for (unsigned w = WIDTHS.first; w <= WIDTHS.last; ++w)
+        {
+          Point p = {(uint16_t) d, (uint16_t) w};
+          char outcome = made_up_outcome(p, random);
+          time_us += outcome == 'r' ? 5000000 : 1000000;
+          writer.append({time_us, 0, 0, p.delay, p.width, outcome, 0});
+        }
+    // A pause, and one more attempt: not part of the timing.
+    writer.append({time_us + 3600000000ull, 0, 0, 9900, 135, '.', 0});
+  }
+  OutcomeModel model;
+  model.add(AttemptLogReader(path));
+  return model;
+}
+
+int main()
+{
+  try
+  {
+    // The sweep.
+    {
+      SweepScheduler sweep(DELAYS, WIDTHS);
+      std::vector<Point> first = sweep.next_batch(WIDTHS.size() + 1);
+      std::vector<Point> rest = sweep.next_batch(DELAYS.size() * WIDTHS.size() - first.size());
+      bool ok = first[0].delay == 9900 && first[0].width == 135
+             && first[WIDTHS.size() - 1].delay == 9900 && first[WIDTHS.size() - 1].width == 164
+             && first[WIDTHS.size()].delay == 9901 && first[WIDTHS.size()].width == 135
+             && rest.back().delay == 9919 && rest.back().width == 164
+             && sweep.next_batch(1)[0].delay == 9900;
+      check(ok, "sweep goes like run-glitch.py");
+    }
+    
+    // The model of the recorded attempts.
+    char path[] = "/tmp/scheduler-test-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0)
+      throw std::runtime_error("mkstemp");
+    close(fd);
+    unlink(path);
+    OutcomeModel model = record(path);
+    unlink(path);
+    check(model.attempts == 20 * DELAYS.size() * WIDTHS.size() + 1, "model: attempts");
+    check(model.delays().first == DELAYS.first && model.delays().last == DELAYS.last
+       && model.widths().first == WIDTHS.first && model.widths().last == WIDTHS.last,
+          "model: delays and widths");
+    check(model.seconds('.') == 1 && model.seconds('r') == 5, "model: timing");
+    check(model.hits > 0 && model.hits < 20 * 6, "model: hits");
+    
+    // Sweep against adaptive, for the recorded time.
+    double hours = model.recorded_seconds / 3600;
+    SweepScheduler sweep(DELAYS, WIDTHS);
+    ReplayResult swept = replay(sweep, model, model.recorded_seconds, 64, 7);
+    ThompsonScheduler adaptive(DELAYS, WIDTHS, 0.05, 7);
+    ReplayResult adapted = replay(adaptive, model, model.recorded_seconds, 64, 7);
+    printf("      %.1f hours: sweep %llu hits (%.1f/hour, %.0f%% resets), "
+           "adaptive %llu hits (%.1f/hour, %.0f%% resets)\n", hours,
+           (unsigned long long) swept.hits, swept.hits_per_hour(),
+           100.0 * swept.resets / swept.attempts,
+           (unsigned long long) adapted.hits, adapted.hits_per_hour(),
+           100.0 * adapted.resets / adapted.attempts);
+    check(swept.hits_per_hour() > 0.5 * model.hits / hours
+       && swept.hits_per_hour() < 1.5 * model.hits / hours,
+          "sweep replays as recorded");
+    check(adapted.hits_per_hour() > 5 * swept.hits_per_hour(),
+          "adaptive: at least 5 times the hits per hour");
+    check(adapted.resets * swept.attempts < swept.resets * adapted.attempts / 2,
+          "adaptive: less than half the resets");
+    
+    // The minimum exploration rate.
+    double explored = (double) adaptive.explored / adaptive.chosen;
+    check(0.04 < explored && explored < 0.06, "adaptive: explores 5% of the glitches");
+    unsigned untried = 0;
+    for (unsigned d = DELAYS.first; d <= DELAYS.last; ++d)
+      for (unsigned w = WIDTHS.first; w <= WIDTHS.last; ++w)
+        untried += adaptive.cell({(uint16_t) d, (uint16_t) w}).attempts == 0;
+    check(untried < DELAYS.size() * WIDTHS.size() / 10, "adaptive: tries (nearly) every cell");
+    
+    // Same seed, same glitches.
+    ThompsonScheduler a(DELAYS, WIDTHS, 0.05, 3), b(DELAYS, WIDTHS, 0.05, 3);
+    bool same = true;
+    for (const Point & p : a.next_batch(100))
+    {
+      Point q = b.next_batch(1)[0];
+      same = same && p.delay == q.delay && p.width == q.width;
+    }
+    check(same, "adaptive: reproducible");
+    
+    bool thrown = false;
+    try
+    {
+      ThompsonScheduler(DELAYS, WIDTHS, 0);
+    }
+    catch (const std::runtime_error &)
+    {
+      thrown = true;
+    }
+    check(thrown, "adaptive: exploration rate 0 is refused");
+  }
+  catch (const std::exception & e)
+  {
+    printf("FAIL: %s\n", e.what());
+    ++failures;
+  }
+  
+  printf("%u failures\n", failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,104 @@
+#include <math.h>
+#include <stdexcept>
+#include <stdlib.h>
+
+#include "scheduler.hpp"
+
+bool parse_range(const char * text, Range & range)
+{
+  char * end;
+  range.first = strtoul(text, &end, 0);
+  if (*end != ':')
+    return false;
+  range.last = strtoul(end + 1, &end, 0);
+  return !*end && range.first <= range.last && range.last <= 0xFFFF;
+}
+
+std::vector<Point> SweepScheduler::next_batch(unsigned size)
+{
+  std::vector<Point> batch;
+  for (unsigned i = 0; i < size; ++i, ++next)
+  {
+    uint64_t n = next % ((uint64_t) delays.size() * widths.size());
+    batch.push_back({(uint16_t) (delays.first + n / widths.size()),
+                     (uint16_t) (widths.first + n % widths.size())});
+  }
+  return batch;
+}
+
+ThompsonScheduler::ThompsonScheduler(const Range & delays, const Range & widths,
+                                     double explore, uint64_t seed)
+  : Scheduler(delays, widths), explore(explore), random(seed),
+    cells((size_t) delays.size() * widths.size())
+{
+  if (explore <= 0 || explore > 1)
+    throw std::runtime_error("exploration rate must be in (0, 1]");
+}
+
+double ThompsonScheduler::beta(uint32_t a, uint32_t b)
+{
+  // Cells without hits (most of them): Beta(1, b) has the closed form 
+  // inverse CDF 1 - (1 - u)^(1/b).
+  if (a == 1)
+    return 1 - pow(std::uniform_real_distribution<double>(0, 1)(random), 1.0 / b);
+  // Beta(a, b) = X / (X + Y) with X ~ Gamma(a), Y ~ Gamma(b).
+  double x = std::gamma_distribution<double>(a)(random);
+  double y = std::gamma_distribution<double>(b)(random);
+  return x / (x + y);
+}
+
+std::vector<Point> ThompsonScheduler::next_batch(unsigned size)
+{
+  std::uniform_real_distribution<double> coin(0, 1);
+  std::uniform_int_distribution<size_t> any(0, cells.size() - 1);
+  std::vector<Point> batch;
+  while (batch.size() < size)
+  {
+    size_t best = 0;
+    if (coin(random) < explore)
+    {
+      best = any(random);
+      ++explored;
+    }
+    else
+    {
+      double best_rate = -1;
+      for (size_t i = 0; i < cells.size(); ++i)
+      {
+        const Cell & c = cells[i];
+        double hit = beta(c.hits + 1, c.attempts - c.hits + 1);
+        // The reset rate only sets the cost, its mean will do.
+        double reset = (c.resets + 1.0) / (c.attempts + 2.0);
+        double rate = hit / (reset * seconds_reset + (1 - reset) * seconds_plain);
+        if (rate > best_rate)
+        {
+          best_rate = rate;
+          best = i;
+        }
+      }
+    }
+    ++chosen;
+    batch.push_back({(uint16_t) (delays.first + best / widths.size()),
+                     (uint16_t) (widths.first + best % widths.size())});
+  }
+  return batch;
+}
+
+void ThompsonScheduler::record(const Point & point, char outcome, double seconds)
+{
+  if (point.delay < delays.first || point.delay > delays.last
+   || point.width < widths.first || point.width > widths.last)
+    return;
+  Cell & c = cells[index(point)];
+  ++c.attempts;
+  c.hits += outcome == '!';
+  c.resets += outcome == 'r';
+  if (seconds > 0)
+  {
+    // Running means.
+    if (outcome == 'r')
+      seconds_reset += (seconds - seconds_reset) / ++timed_reset;
+    else
+      seconds_plain += (seconds - seconds_plain) / ++timed_plain;
+  }
+}
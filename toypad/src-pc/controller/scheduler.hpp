@@ -0,0 +1,107 @@
+#ifndef _SCHEDULER_HPP_
+#define _SCHEDULER_HPP_
+
+#include <random>
+#include <stdint.h>
+#include <vector>
+
+// Inclusive range of post-reset delays or glitch widths, in steps.
+struct Range
+{
+  unsigned first;
+  unsigned last;
+  
+  unsigned size() const { return last - first + 1; }
+};
+
+// Parse "<first>:<last>".
+bool parse_range(const char * text, Range & range);
+
+// One glitch to try.
+struct Point
+{
+  uint16_t delay;
+  uint16_t width;
+};
+
+// Chooses the glitches of a campaign, a batch at a time, and learns from 
+// their outcomes (the characters of campaign.hpp) and how long they took.
+class Scheduler
+{
+  public:
+    Scheduler(const Range & delays, const Range & widths)
+      : delays(delays), widths(widths) {}
+    virtual ~Scheduler() {}
+    
+    virtual std::vector<Point> next_batch(unsigned size) = 0;
+    virtual void record(const Point & point, char outcome, double seconds = 0) = 0;
+    
+    const Range delays;
+    const Range widths;
+};
+
+// The loop of run-glitch.py: every width of a delay, then the next 
+// delay, and so on, over and over.
+class SweepScheduler : public Scheduler
+{
+  public:
+    using Scheduler::Scheduler;
+    
+    std::vector<Point> next_batch(unsigned size) override;
+    void record(const Point &, char, double) override {}
+    
+  private:
+    uint64_t next = 0;
+};
+
+// Thompson sampling over the cells (delay, width) of the grid. Per cell 
+// the hit rate has a Beta(hits + 1, misses + 1) posterior. For every 
+// glitch of a batch, every cell draws a hit rate from its posterior, and 
+// the cell with the most hits per second wins: resets cost more time 
+// (the target has to boot again) than glitches without effect, so the 
+// time per attempt of a cell follows from its reset rate, and what a 
+// reset costs is learned from the durations passed to record().
+// 
+// A cell that only ever resets quickly loses, but never for good: a 
+// fraction explore of the glitches goes to a cell picked uniformly at 
+// random.
+class ThompsonScheduler : public Scheduler
+{
+  public:
+    ThompsonScheduler(const Range & delays, const Range & widths,
+                      double explore = 0.05, uint64_t seed = 1);
+    
+    std::vector<Point> next_batch(unsigned size) override;
+    void record(const Point & point, char outcome, double seconds = 0) override;
+    
+    struct Cell
+    {
+      uint32_t attempts = 0;
+      uint32_t hits = 0;
+      uint32_t resets = 0;
+    };
+    const Cell & cell(const Point & point) const { return cells[index(point)]; }
+    
+    // Glitches chosen at random (exploring) so far, and in total.
+    uint64_t explored = 0;
+    uint64_t chosen = 0;
+    
+  private:
+    size_t index(const Point & point) const
+    {
+      return (size_t) (point.delay - delays.first) * widths.size() + (point.width - widths.first);
+    }
+    double beta(uint32_t a, uint32_t b);
+    
+    double explore;
+    std::mt19937_64 random;
+    std::vector<Cell> cells;
+    
+    // Mean seconds per attempt without a reset, and with a reset.
+    double seconds_plain = 1;
+    double seconds_reset = 1;
+    uint64_t timed_plain = 0;
+    uint64_t timed_reset = 0;
+};
+
+#endif /* _SCHEDULER_HPP_ */
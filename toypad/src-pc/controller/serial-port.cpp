@@ -0,0 +1,190 @@
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/serial.h>
+#include <stdexcept>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "serial-port.hpp"
+
+static speed_t termios_speed(unsigned baud)
+{
+  switch (baud)
+  {
+    case   9600: return B9600;
+    case  19200: return B19200;
+    case  38400: return B38400;
+    case  57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    case 500000: return B500000;
+    case 1000000: return B1000000;
+  }
+  throw std::runtime_error("unsupported baud rate " + std::to_string(baud));
+}
+
+SerialPort::SerialPort(const std::string & path, unsigned baud)
+  : path(path)
+{
+  fd = open(path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+  if (fd < 0)
+    throw std::runtime_error(path + ": " + strerror(errno));
+  
+  termios tio;
+  if (tcgetattr(fd, &tio) < 0)
+  {
+    close(fd);
+    throw std::runtime_error(path + ": not a tty");
+  }
+  cfmakeraw(&tio);
+  tio.c_cflag |= CLOCAL | CREAD;
+  tio.c_cflag &= ~(CSTOPB | CRTSCTS);
+  tio.c_cc[VMIN] = 0;
+  tio.c_cc[VTIME] = 0;
+  cfsetspeed(&tio, termios_speed(baud));
+  if (tcsetattr(fd, TCSANOW, &tio) < 0)
+  {
+    close(fd);
+    throw std::runtime_error(path + ": " + strerror(errno));
+  }
+  tcflush(fd, TCIOFLUSH);
+  set_low_latency();
+  
+  epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  epoll_event event = {};
+  event.events = EPOLLIN;
+  event.data.fd = fd;
+  if (epoll_fd < 0 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0)
+  {
+    close(fd);
+    throw std::runtime_error(path + ": epoll: " + strerror(errno));
+  }
+}
+
+SerialPort::~SerialPort()
+{
+  if (epoll_fd >= 0)
+    close(epoll_fd);
+  if (fd >= 0)
+    close(fd);
+}
+
+void SerialPort::set_low_latency()
+{
+  serial_struct serial;
+  if (ioctl(fd, TIOCGSERIAL, &serial) == 0)
+  {
+    serial.flags |= ASYNC_LOW_LATENCY;
+    if (ioctl(fd, TIOCSSERIAL, &serial) == 0)
+      has_low_latency = true;
+  }
+  
+  // Older ftdi_sio ignore the flag; the latency timer itself is in 
+  // /sys/bus/usb-serial/devices/ttyUSBx/latency_timer (root only, or a 
+  // udev rule).
+  char real[PATH_MAX];
+  if (!realpath(path.c_str(), real))
+    return;
+  const char * name = strrchr(real, '/');
+  std::string sysfs = std::string("/sys/bus/usb-serial/devices") + name + "/latency_timer";
+  int latency_fd = open(sysfs.c_str(), O_WRONLY | O_CLOEXEC);
+  if (latency_fd < 0)
+    return;
+  if (::write(latency_fd, "1", 1) == 1)
+    has_low_latency = true;
+  close(latency_fd);
+}
+
+void SerialPort::write(const std::string & data)
+{
+  for (size_t done = 0; done < data.size(); )
+  {
+    ssize_t n = ::write(fd, data.data() + done, data.size() - done);
+    if (n < 0 && (errno == EAGAIN || errno == EINTR))
+    {
+      usleep(100);
+      continue;
+    }
+    if (n < 0)
+      throw std::runtime_error(path + ": " + strerror(errno));
+    done += n;
+  }
+}
+
+void SerialPort::set_baud(unsigned baud)
+{
+  termios tio;
+  if (tcgetattr(fd, &tio) < 0)
+    throw std::runtime_error(path + ": " + strerror(errno));
+  cfsetspeed(&tio, termios_speed(baud));
+  if (tcsetattr(fd, TCSADRAIN, &tio) < 0)
+    throw std::runtime_error(path + ": " + strerror(errno));
+}
+
+bool SerialPort::read_line(std::string & line, int timeout_ms)
+{
+  auto deadline = std::chrono::steady_clock::now()
+                + std::chrono::milliseconds(timeout_ms);
+  while (1)
+  {
+    size_t end = buffer.find('\n');
+    if (end != std::string::npos)
+    {
+      line.clear();
+      line_garbled = false;
+      for (size_t i = 0; i < end; ++i)
+      {
+        char c = buffer[i];
+        if (c == '\r')
+          continue;
+        if (c < ' ' || c > '~')
+        {
+          line_garbled = true;
+          ++garbage_bytes;
+          continue;
+        }
+        line += c;
+      }
+      buffer.erase(0, end + 1);
+      return true;
+    }
+    
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+      deadline - std::chrono::steady_clock::now()).count();
+    if (left < 0)
+      return false;
+    epoll_event event;
+    int ready = epoll_wait(epoll_fd, &event, 1, left);
+    if (ready < 0 && errno == EINTR)
+      continue;
+    if (ready < 0)
+      throw std::runtime_error(path + ": " + strerror(errno));
+    if (ready == 0)
+      continue;
+    
+    char chunk[256];
+    ssize_t n = ::read(fd, chunk, sizeof chunk);
+    if (n < 0 && (errno == EAGAIN || errno == EINTR))
+      continue;
+    if (n < 0)
+      throw std::runtime_error(path + ": " + strerror(errno));
+    if (n == 0 && (event.events & EPOLLHUP))
+      throw std::runtime_error(path + ": hung up");
+    buffer.append(chunk, n);
+  }
+}
+
+void SerialPort::discard_input()
+{
+  tcflush(fd, TCIFLUSH);
+  char chunk[256];
+  while (::read(fd, chunk, sizeof chunk) > 0)
+    ;
+  buffer.clear();
+}
@@ -0,0 +1,59 @@
+#ifndef _SERIAL_PORT_HPP_
+#define _SERIAL_PORT_HPP_
+
+#include <string>
+
+// The serial port to the glitcher, in raw mode (no echo, no line 
+// editing, no CR/LF translation), 8N1, no flow control.
+// 
+// Every attempt waits for a few short replies, so what counts is 
+// latency, not throughput. A USB serial converter holds back received 
+// bytes for up to its latency timer (16 ms for an FTDI) before it sends 
+// them to the host. So:
+// 
+//   - ASYNC_LOW_LATENCY is set on the port (for ftdi_sio: a latency 
+//     timer of 1 ms), and the latency timer in sysfs is set to 1 ms if 
+//     we may. low_latency() tells whether either worked; not on a pty.
+//   - Reads are driven by epoll, and return as soon as a line is 
+//     complete.
+// 
+// Throws std::runtime_error on errors of the port itself.
+class SerialPort
+{
+  public:
+    SerialPort(const std::string & path, unsigned baud);
+    ~SerialPort();
+    SerialPort(const SerialPort &) = delete;
+    SerialPort & operator=(const SerialPort &) = delete;
+    
+    void write(const std::string & data);
+    
+    // Wait until everything written is on the wire, then switch both 
+    // directions to the new rate.
+    void set_baud(unsigned baud);
+    
+    // Read up to and including the next '\n', and return it without the 
+    // "\r\n". Returns false if no complete line arrived within 
+    // timeout_ms. Bytes that are not printable ASCII are dropped from 
+    // the line, and make garbled() true for it.
+    bool read_line(std::string & line, int timeout_ms);
+    bool garbled() const { return line_garbled; }
+    
+    // Forget everything received so far, by the driver and by us.
+    void discard_input();
+    
+    bool low_latency() const { return has_low_latency; }
+    unsigned garbage_bytes = 0;
+    
+  private:
+    void set_low_latency();
+    
+    int fd = -1;
+    int epoll_fd = -1;
+    std::string path;
+    std::string buffer;
+    bool line_garbled = false;
+    bool has_low_latency = false;
+};
+
+#endif /* _SERIAL_PORT_HPP_ */
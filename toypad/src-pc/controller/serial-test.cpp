@@ -0,0 +1,146 @@
+// Runs the serial layer (serial-port.cpp, glitcher-link.cpp) against the 
+// fake glitcher: every command of the firmware, spoiled replies and 
+// resynchronization, and the round trip time.
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+#include "campaign.hpp"
+#include "fake-glitcher.hpp"
+#include "fake-openocd.hpp"
+#include "fake-target.hpp"
+#include "glitcher-link.hpp"
+#include "serial-port.hpp"
+#include "tcl-rpc.hpp"
+#include "test-check.hpp"
+
+static bool has_line(const std::vector<std::string> & lines, const std::string & start)
+{
+  for (const std::string & line : lines)
+    if (line.compare(0, start.size(), start) == 0)
+      return true;
+  return false;
+}
+
+// Returns the kind of GlitcherError of the command, or -1 if it went 
+// well.
+static int error_kind(GlitcherLink & link, const std::string & command)
+{
+  try
+  {
+    link.command(command, 200);
+  }
+  catch (const GlitcherError & e)
+  {
+    return e.kind;
+  }
+  return -1;
+}
+
+int main()
+{
+  // With CRP3, so the SWD oracle tells hits from misses.
+  FakeTarget::Config config;
+  config.crp3 = true;
+  FakeTarget target(config);
+  FakeGlitcher fake(target);
+  SerialPort port(fake.path(), 115200);
+  GlitcherLink link(port);
+  
+  printf("low latency: %s (never on a pty)\n", port.low_latency() ? "yes" : "no");
+  
+  try
+  {
+    // The command set.
+    check(link.set_resolution(2) == 2 && !link.dead_time, "R2");
+    check(link.set_resolution(1) == 1, "R1");
+    link.set_swd_oracle(true);
+    check(has_line(link.lines, "SWD ORACLE ON"), "S1");
+    check(link.glitch(1001, 21) == '!', "G hit");
+    check(link.glitch(1001, 25) == '.', "G miss");
+    check(link.glitch(1001, 40) == '?', "G reset");
+    link.set_swd_oracle(false);
+    check(link.glitch(1001, 21) == 0, "G without oracle");
+    
+    // 1001 steps = 64 + 3 * 312 + 1: timer 1 312 + 3 - 17 ticks, 
+    // timer 4 65 ticks, as src-pc/timing.py computes them.
+    unsigned before = target.glitches;
+    link.set_swd_oracle(true);
+    check(link.timed_glitch(0x10000 - 298, 1024 - 65, 24, 0, 0x01) == '.', "T miss");
+    check(link.timed_glitch(0x10000 - 298, 1024 - 65, 20, 0, 0x01) == '!', "T hit");
+    check(target.glitches == before + 2, "T glitches");
+    check(error_kind(link, "T0,0,0,0,0\n") == GlitcherError::FAILED, "T bad registers");
+    check(error_kind(link, "T65238,959,20,0,3\n") == GlitcherError::FAILED, "T divider 4");
+    check(error_kind(link, "T65238,959,20,0,129\n") == GlitcherError::FAILED, "T PWM4X");
+    check(error_kind(link, "T65238,959,20,0,257\n") == GlitcherError::FAILED, "T TCCR4B over a byte");
+    check(error_kind(link, "T65238,959,20,256,66\n") == GlitcherError::FAILED, "T DT4 over a byte");
+    check(error_kind(link, "T65238,959,20,16,1\n") == GlitcherError::FAILED, "T DT4 without PSR4");
+    check(link.timed_glitch(0x10000 - 298, 1024 - 65, 10, 0x10, 0x42) == '.', "T dead time");
+    link.set_swd_oracle(false);
+    // At 96 MHz timer 4 counts 6 * 17 ticks after the end of the glitch.
+    link.set_resolution(2);
+    check(error_kind(link, "T65238,959,922,0,1\n") == GlitcherError::FAILED, "T second glitch at 96 MHz");
+    check(link.timed_glitch(0x10000 - 298, 1024 - 65, 921, 0, 0x01) == 0, "T longest glitch at 96 MHz");
+    link.set_resolution(1);
+    
+    const std::vector<std::string> & calibration = link.command("C3\n");
+    check(has_line(calibration, "C 0002 06A6 09EE"), "C");
+    check(has_line(link.command("L1600,21,1000\n"), "FAULT "), "L fault");
+    check(has_line(link.command("L1600,25,1000\n"), "NO FAULT"), "L no fault");
+    check(error_kind(link, "L100,21,1000\n") == GlitcherError::FAILED, "L period too short");
+    check(error_kind(link, "X") == GlitcherError::FAILED, "unknown command");
+    
+    // Spoiled replies, each followed by a good command.
+    fake.inject(FakeGlitcher::GARBAGE);
+    check(error_kind(link, "G1001,21\n") == GlitcherError::GARBAGE, "garbage");
+    check(link.glitch(1001, 21) == 0 && link.lines.back() == "DONE", "resync after garbage");
+    fake.inject(FakeGlitcher::RESET);
+    check(error_kind(link, "G1001,21\n") == GlitcherError::RESET, "reset");
+    check(link.glitch(1001, 21) == 0, "after reset");
+    fake.inject(FakeGlitcher::SILENCE);
+    auto start = std::chrono::steady_clock::now();
+    check(error_kind(link, "G1001,21\n") == GlitcherError::TIMEOUT, "silence");
+    double waited = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    check(waited > 0.15 && waited < 0.5, "timeout of the frame");
+    check(link.glitch(1001, 21) == 0, "resync after silence");
+    
+    // A campaign does not notice, apart from the count.
+    FakeOpenocd fake_ocd(target);
+    TclRpc ocd("127.0.0.1", fake_ocd.port());
+    Campaign campaign(Mode::FIND_LENGTH, link, &ocd, false);
+    unsigned wrong = 0;
+    static const FakeGlitcher::Fault faults[] = {
+      FakeGlitcher::GARBAGE, FakeGlitcher::RESET, FakeGlitcher::SILENCE,
+    };
+    for (unsigned n = 0; n < 60; ++n)
+    {
+      if (n % 20 == 7)
+        fake.inject(faults[n / 20]);
+      wrong += campaign.attempt(1001, 21) != '!';
+    }
+    check(wrong == 0 && campaign.link_errors == 3, "campaign through spoiled replies");
+    
+    // Round trips of an attempt, with and without the latency of a 
+    // USB serial converter.
+    for (unsigned latency : {0, 1000, 16000})
+    {
+      fake.reply_latency_us = latency;
+      auto start = std::chrono::steady_clock::now();
+      for (unsigned n = 0; n < 50; ++n)
+        link.glitch(1001, 25);
+      double us = std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now() - start).count() / 50;
+      printf("      latency %5u us: %7.0f us per G\n", latency, us);
+    }
+  }
+  catch (const std::exception & e)
+  {
+    printf("FAIL: %s\n", e.what());
+    ++failures;
+  }
+  
+  printf("%u failures, %u resyncs, %u garbage bytes\n", failures, link.resyncs, port.garbage_bytes);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,157 @@
+#include <chrono>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdexcept>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "tcl-rpc.hpp"
+
+static std::runtime_error socket_error(const char * what)
+{
+  return std::runtime_error(std::string("openocd: ") + what + ": " + strerror(errno));
+}
+
+TclRpc::TclRpc(const std::string & host, uint16_t port, int timeout_ms)
+  : timeout_ms(timeout_ms)
+{
+  addrinfo hints = {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo * addresses;
+  std::string service = std::to_string(port);
+  int error = getaddrinfo(host.c_str(), service.c_str(), &hints, &addresses);
+  if (error)
+    throw std::runtime_error("openocd: " + host + ": " + gai_strerror(error));
+  
+  for (addrinfo * a = addresses; a; a = a->ai_next)
+  {
+    fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+    if (fd < 0)
+      continue;
+    if (connect(fd, a->ai_addr, a->ai_addrlen) == 0)
+      break;
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(addresses);
+  if (fd < 0)
+    throw socket_error("connect");
+  
+  // Our commands are tiny and we wait for every reply: don't let Nagle 
+  // hold them back.
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+}
+
+TclRpc::~TclRpc()
+{
+  if (fd >= 0)
+    close(fd);
+}
+
+std::string TclRpc::command(const std::string & command)
+{
+  return batch({command})[0];
+}
+
+std::vector<std::string> TclRpc::batch(const std::vector<std::string> & commands)
+{
+  if (fd < 0)
+    throw std::runtime_error("openocd: not connected (after a timeout)");
+  
+  std::string out;
+  for (const std::string & command : commands)
+  {
+    out += command;
+    out += TERMINATOR;
+  }
+  
+  auto start = Metrics::Clock::now();
+  for (size_t done = 0; done < out.size(); )
+  {
+    ssize_t n = ::send(fd, out.data() + done, out.size() - done, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0)
+      throw socket_error("send");
+    done += n;
+  }
+  if (metrics)
+  {
+    metrics->record("openocd_send", start);
+    start = Metrics::Clock::now();
+  }
+  
+  // openocd runs the commands one after another, and replies to each 
+  // when done: the time between two replies is the time of a command.
+  std::vector<std::string> replies;
+  for (size_t i = 0; i < commands.size(); ++i)
+  {
+    replies.push_back(read_reply());
+    if (metrics)
+    {
+      auto now = Metrics::Clock::now();
+      metrics->record(Metrics::command_phase(commands[i]), now - start);
+      start = now;
+    }
+  }
+  ++round_trips;
+  return replies;
+}
+
+std::string TclRpc::read_reply()
+{
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+  while (1)
+  {
+    size_t end = buffer.find(TERMINATOR);
+    if (end != std::string::npos)
+    {
+      std::string reply = buffer.substr(0, end);
+      buffer.erase(0, end + 1);
+      return reply;
+    }
+    
+    // A hung openocd must not hang the controller.
+    int left = std::chrono::duration_cast<std::chrono::milliseconds>(
+      deadline - std::chrono::steady_clock::now()).count();
+    pollfd p = {fd, POLLIN, 0};
+    int ready = left > 0 ? poll(&p, 1, left) : 0;
+    if (ready < 0 && errno == EINTR)
+      continue;
+    if (ready < 0)
+      throw socket_error("poll");
+    if (ready == 0)
+    {
+      close(fd);
+      fd = -1;
+      buffer.clear();
+      throw std::runtime_error("openocd: no reply within " + std::to_string(timeout_ms) + " ms");
+    }
+    
+    char chunk[4096];
+    ssize_t n = ::recv(fd, chunk, sizeof chunk, 0);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0)
+      throw socket_error("recv");
+    if (n == 0)
+      throw std::runtime_error("openocd: connection closed");
+    buffer.append(chunk, n);
+  }
+}
+
+std::string TclRpc::catch_error(const std::string & command)
+{
+  return "if {[catch {" + command + "} r]} {set r \"ERROR $r\"} else {set r}";
+}
+
+bool TclRpc::is_error(const std::string & reply)
+{
+  return reply.compare(0, 6, "ERROR ") == 0;
+}
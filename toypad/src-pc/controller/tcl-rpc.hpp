@@ -0,0 +1,54 @@
+#ifndef _TCL_RPC_HPP_
+#define _TCL_RPC_HPP_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "metrics.hpp"
+
+// Client for the Tcl RPC server of openocd (port 6666 by default). Every 
+// command and every reply ends with 0x1a. No gdb, no "monitor", no 
+// remote serial protocol in between.
+// 
+// batch() pipelines: it sends all commands in one write and only then 
+// reads the replies, so a whole batch costs a single round trip.
+// 
+// Throws std::runtime_error if openocd cannot be reached, hangs up, or 
+// does not reply within timeout_ms. After a timeout the replies are out 
+// of step, so the connection is closed and every later command throws 
+// as well.
+class TclRpc
+{
+  public:
+    static const char TERMINATOR = 0x1a;
+    
+    TclRpc(const std::string & host, uint16_t port, int timeout_ms = 5000);
+    ~TclRpc();
+    TclRpc(const TclRpc &) = delete;
+    TclRpc & operator=(const TclRpc &) = delete;
+    
+    std::string command(const std::string & command);
+    std::vector<std::string> batch(const std::vector<std::string> & commands);
+    
+    // openocd replies with the bare error message if a command fails. 
+    // Wrap a command with catch_error() to get "ERROR <message>" 
+    // instead, and test the reply with is_error().
+    static std::string catch_error(const std::string & command);
+    static bool is_error(const std::string & reply);
+    
+    unsigned round_trips = 0;
+    
+    // If set: the time of the send, and of every command (see 
+    // Metrics).
+    Metrics * metrics = nullptr;
+    
+  private:
+    std::string read_reply();
+    
+    int fd = -1;
+    int timeout_ms;
+    std::string buffer;
+};
+
+#endif /* _TCL_RPC_HPP_ */
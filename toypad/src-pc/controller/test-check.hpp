@@ -0,0 +1,19 @@
+#ifndef _TEST_CHECK_HPP_
+#define _TEST_CHECK_HPP_
+
+#include <stdio.h>
+
+// The verdicts of the *-test programs of src-pc: one line per check, and 
+// main() ends with
+// 
+//   printf("%u failures\n", failures);
+//   return failures ? 1 : 0;
+inline unsigned failures = 0;
+
+inline void check(bool ok, const char * what)
+{
+  printf("%s: %s\n", ok ? "ok  " : "FAIL", what);
+  failures += !ok;
+}
+
+#endif /* _TEST_CHECK_HPP_ */
@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+# Read the records of src-lpc/crp-replica from the UART of the LPC11U35:
+# every iteration of the replicated CRP check that got past it, and a
+# status record every 65536 iterations. Stop with Ctrl-C to get the
+# summary.
+#
+# A bypass stored either the word at 0x2fc as it is (the "CRP disabled"
+# branch was taken, 'branch') or anything else (a load was glitched,
+# 'corrupt').
+#
+# Usage: ./crp_replica.py [serial port]
+
+import collections
+import sys
+
+RECORD_BYPASS = 0xFB
+RECORD_STATUS = 0xFC
+PAYLOAD_SIZES = {RECORD_BYPASS: 8, RECORD_STATUS: 9}
+
+CRP2 = 0x87654321
+REPLICA_CRP3 = 0x43218766
+
+Bypass = collections.namedtuple('Bypass', ('iteration', 'crp_register'))
+Status = collections.namedtuple('Status', ('iterations', 'bypasses', 'dropped'))
+
+def checksum(payload):
+	value = 0
+	for b in payload:
+		value ^= b
+	return value
+
+def encode(record):
+	'''The bytes the firmware sends for the record.'''
+	if isinstance(record, Bypass):
+		payload = record.iteration.to_bytes(4, 'little') \
+			+ record.crp_register.to_bytes(4, 'little')
+		sync = RECORD_BYPASS
+	else:
+		payload = record.iterations.to_bytes(4, 'little') \
+			+ record.bypasses.to_bytes(4, 'little') + bytes((record.dropped,))
+		sync = RECORD_STATUS
+	return bytes((sync,)) + payload + bytes((checksum(payload),))
+
+def classify(bypass):
+	if bypass.crp_register == REPLICA_CRP3:
+		return 'branch'
+	return 'corrupt'
+
+class Parser:
+	'''Split a byte stream into records, resync after garbage.'''
+
+	def __init__(self):
+		self.buffer = bytearray()
+		self.skipped = 0
+
+	def feed(self, data):
+		self.buffer += data
+		records = []
+		while self.buffer:
+			size = PAYLOAD_SIZES.get(self.buffer[0])
+			if size is None:
+				self.skipped += 1
+				del self.buffer[:1]
+				continue
+			if len(self.buffer) < size + 2:
+				break
+			payload = bytes(self.buffer[1:size + 1])
+			if checksum(payload) != self.buffer[size + 1]:
+				self.skipped += 1
+				del self.buffer[:1]
+				continue
+			if self.buffer[0] == RECORD_BYPASS:
+				records.append(Bypass(int.from_bytes(payload[0:4], 'little'),
+					int.from_bytes(payload[4:8], 'little')))
+			else:
+				records.append(Status(int.from_bytes(payload[0:4], 'little'),
+					int.from_bytes(payload[4:8], 'little'), payload[8]))
+			del self.buffer[:size + 2]
+		return records
+
+def main():
+	import serial
+	port = sys.argv[1] if len(sys.argv) > 1 else '/dev/ttyACM0'
+	lpc = serial.Serial(port, 115200, timeout = 0.1)
+	parser = Parser()
+	kinds = collections.Counter()
+	status = None
+	try:
+		while True:
+			for record in parser.feed(lpc.read(4096)):
+				if isinstance(record, Status):
+					status = record
+					print('%10d iterations, %d bypasses, %d dropped' % record)
+				else:
+					kinds[classify(record)] += 1
+					print('%10d %-7s 0x%08x' % (record.iteration,
+						classify(record), record.crp_register))
+	except KeyboardInterrupt:
+		pass
+	if status and status.iterations:
+		print('bypass rate: %.3g (%d branch, %d corrupt)' %
+			(status.bypasses / status.iterations, kinds['branch'], kinds['corrupt']))
+
+if __name__ == '__main__':
+	main()
@@ -0,0 +1,177 @@
+#!/usr/bin/env python3
+# Collect and classify the fault records of src-lpc/voltage-glitch-loop
+# (built with make CHARACTERIZE=1), read from the UART of the LPC11U35.
+# Let the glitcher pulse (e.g. loop-glitch.py, command 'L'; it counts the
+# faults as reboots then), stop with Ctrl-C to get the summary.
+#
+# See send_fault_record() in voltage-glitch-loop.c for the format. The
+# classes:
+#
+#   boot       The target (re)booted.
+#   skip       All magics intact: the compare or the branch itself was
+#              glitched.
+#   reference  magic0, the value all others are compared to, corrupted.
+#   register   One or more of the other magics corrupted.
+#
+# Usage: ./fault_records.py [serial port]
+
+import collections
+import sys
+
+SYNC = 0xFA
+MAGIC = 0x015ac37f
+NUM_MAGICS = 7
+HEADER_SIZE = 5
+
+Record = collections.namedtuple('Record',
+	('sequence', 'compare', 'dropped', 'values'))
+Record.__doc__ = '''values: {magic index: corrupted value}.'''
+
+def encode(record):
+	'''The bytes send_fault_record() sends for the record.'''
+	corrupted = 0
+	for i in record.values:
+		corrupted |= 1 << i
+	body = bytes((record.sequence, record.compare, corrupted, record.dropped))
+	for i in sorted(record.values):
+		body += record.values[i].to_bytes(4, 'little')
+	checksum = 0
+	for b in body:
+		checksum ^= b
+	return bytes((SYNC,)) + body + bytes((checksum,))
+
+def classify(record):
+	if record.compare == 0:
+		return 'boot'
+	if not record.values:
+		return 'skip'
+	if 0 in record.values:
+		return 'reference'
+	return 'register'
+
+class Parser:
+	'''Split a byte stream into records. Skips (and counts) whatever is
+	not a record, e.g. the "E" and "?" of the command handler, or bytes
+	lost to a reset.'''
+
+	def __init__(self):
+		self.buffer = bytearray()
+		self.skipped = 0
+		self.bad_checksums = 0
+
+	def feed(self, data):
+		'''List of the records completed by data.'''
+		self.buffer += data
+		records = []
+		while True:
+			start = self.buffer.find(SYNC)
+			if start < 0:
+				self.skipped += len(self.buffer)
+				self.buffer.clear()
+				break
+			self.skipped += start
+			del self.buffer[:start]
+			if len(self.buffer) < HEADER_SIZE:
+				break
+			corrupted = self.buffer[3]
+			size = HEADER_SIZE + 4 * bin(corrupted).count('1') + 1
+			if len(self.buffer) < size:
+				break
+			checksum = 0
+			for b in self.buffer[1:size]:
+				checksum ^= b
+			if checksum != 0 or corrupted >> NUM_MAGICS \
+					or self.buffer[2] > NUM_MAGICS - 1:
+				# Not a record after all: resync on the next sync.
+				self.bad_checksums += 1
+				self.skipped += 1
+				del self.buffer[:1]
+				continue
+			values = {}
+			offset = HEADER_SIZE
+			for i in range(NUM_MAGICS):
+				if corrupted & (1 << i):
+					values[i] = int.from_bytes(
+						self.buffer[offset:offset + 4], 'little')
+					offset += 4
+			records.append(Record(self.buffer[1], self.buffer[2],
+				self.buffer[4], values))
+			del self.buffer[:size]
+		return records
+
+class Summary:
+	def __init__(self):
+		self.classes = collections.Counter()
+		self.compares = collections.Counter()
+		self.registers = collections.Counter()
+		# Bit position -> number of times it flipped to 0 (to 1).
+		self.to_zero = collections.Counter()
+		self.to_one = collections.Counter()
+		self.faults = 0
+		self.dropped = 0
+		self.missing = 0
+		self.expected_sequence = None
+
+	def add(self, record):
+		kind = classify(record)
+		self.classes[kind] += 1
+		self.dropped += record.dropped
+		if kind == 'boot':
+			self.expected_sequence = 1
+			return
+		if self.expected_sequence is not None:
+			self.missing += (record.sequence - self.expected_sequence) & 0xFF
+		self.expected_sequence = (record.sequence + 1) & 0xFF
+		self.faults += 1
+		self.compares[record.compare] += 1
+		for i, value in record.values.items():
+			self.registers[i] += 1
+			for bit in range(32):
+				if (value ^ MAGIC) & (1 << bit):
+					if MAGIC & (1 << bit):
+						self.to_zero[bit] += 1
+					else:
+						self.to_one[bit] += 1
+
+	def print(self, out = sys.stdout):
+		out.write('faults: %d, boots: %d, dropped: %d, missing: %d\n' %
+			(self.faults, self.classes['boot'], self.dropped, self.missing))
+		for kind in ('skip', 'reference', 'register'):
+			out.write('  %-9s  %6d\n' % (kind, self.classes[kind]))
+		out.write('compare  faults\n')
+		for compare in sorted(self.compares):
+			out.write('%7d  %6d\n' % (compare, self.compares[compare]))
+		out.write('magic  corrupted\n')
+		for i in sorted(self.registers):
+			out.write('%5d  %9d\n' % (i, self.registers[i]))
+		out.write('bit  to 0  to 1\n')
+		for bit in range(32):
+			if self.to_zero[bit] or self.to_one[bit]:
+				out.write('%3d  %4d  %4d\n' %
+					(bit, self.to_zero[bit], self.to_one[bit]))
+
+def describe(record):
+	values = ' '.join('magic%d=0x%08x' % (i, v)
+		for i, v in sorted(record.values.items()))
+	return '%3d %-9s compare %d %s' % (record.sequence, classify(record),
+		record.compare, values)
+
+def main():
+	import serial
+	port = sys.argv[1] if len(sys.argv) > 1 else '/dev/ttyACM0'
+	lpc = serial.Serial(port, 115200, timeout = 0.1)
+	parser = Parser()
+	summary = Summary()
+	try:
+		while True:
+			for record in parser.feed(lpc.read(4096)):
+				print(describe(record))
+				summary.add(record)
+	except KeyboardInterrupt:
+		pass
+	summary.print()
+	if parser.bad_checksums:
+		print('bad checksums: %d' % parser.bad_checksums)
+
+if __name__ == '__main__':
+	main()
@@ -0,0 +1,160 @@
+#!/usr/bin/env python3
+# Host side of src-lpc/flash-dumper: ask for all blocks of the flash,
+# check their CRC32, ask again for the ones that were damaged or lost,
+# and check the vector table checksum of the result the way the boot ROM
+# does (see src-lpc/voltage-glitch-loop/cm3_checksum.py).
+#
+# Usage: ./flash_dump.py <output file> [serial port] [baud]
+
+import struct
+import sys
+import time
+import zlib
+
+SYNC = 0xD5
+HELLO_SIZE = 1 + 4 + 2
+CRC_SIZE = 4
+
+# Give up on a block after this many requests.
+MAX_REQUESTS = 5
+
+# The dumper reads commands only between blocks, into the 16 byte receive
+# FIFO of its UART; what does not fit is lost, and the 3 byte 'B' commands
+# after it go out of step. So at most 5 requests are sent before their
+# blocks have come back.
+MAX_IN_FLIGHT = 16 // 3
+
+def encode_frame(kind, payload):
+	'''A frame as the firmware sends it.'''
+	body = kind + payload
+	return bytes((SYNC,)) + body + struct.pack('<I', zlib.crc32(body))
+
+def encode_hello(flash_size, block_size):
+	return encode_frame(b'H', struct.pack('<IH', flash_size, block_size))
+
+def encode_block(index, data):
+	return encode_frame(b'D', struct.pack('<H', index) + data)
+
+def vector_checksum_ok(image):
+	'''Entries 0 to 7 of the vector table add up to 0.'''
+	return sum(struct.unpack('<8I', image[:32])) & 0xFFFFFFFF == 0
+
+class Parser:
+	'''Frames out of the byte stream: ('H', flash size, block size) and
+	('D', block, data). Frames with a bad CRC are counted and dropped.'''
+
+	def __init__(self, block_size = 256):
+		self.block_size = block_size
+		self.buffer = bytearray()
+		self.bad_frames = 0
+
+	def frame_size(self, kind):
+		if kind == ord('H'):
+			return 1 + HELLO_SIZE + CRC_SIZE
+		if kind == ord('D'):
+			return 1 + 1 + 2 + self.block_size + CRC_SIZE
+		return None
+
+	def feed(self, data):
+		self.buffer += data
+		frames = []
+		while True:
+			start = self.buffer.find(SYNC)
+			if start < 0:
+				self.buffer.clear()
+				break
+			del self.buffer[:start]
+			if len(self.buffer) < 2:
+				break
+			size = self.frame_size(self.buffer[1])
+			if size is None:
+				del self.buffer[:1]
+				continue
+			if len(self.buffer) < size:
+				break
+			body = bytes(self.buffer[1:size - CRC_SIZE])
+			crc, = struct.unpack('<I', self.buffer[size - CRC_SIZE:size])
+			if zlib.crc32(body) != crc:
+				# Resync on the next sync byte.
+				self.bad_frames += 1
+				del self.buffer[:1]
+				continue
+			del self.buffer[:size]
+			if body[0] == ord('H'):
+				flash_size, self.block_size = struct.unpack('<IH', body[1:])
+				frames.append(('H', flash_size, self.block_size))
+			else:
+				index, = struct.unpack('<H', body[1:3])
+				frames.append(('D', index, body[3:]))
+		return frames
+
+def dump(link, timeout = 1.0, log = lambda *args: None):
+	'''Read the flash through link (read(n) returning what arrived within
+	its timeout, and write(bytes)). Returns the image, raises RuntimeError
+	if blocks stay missing.'''
+	parser = Parser()
+	hello = None
+	link.write(b'H')
+	deadline = time.monotonic() + timeout
+	while hello is None and time.monotonic() < deadline:
+		for frame in parser.feed(link.read(64)):
+			if frame[0] == 'H':
+				hello = frame
+	if hello is None:
+		raise RuntimeError('no hello from the flash dumper')
+	flash_size, block_size = hello[1], hello[2]
+	num_blocks = flash_size // block_size
+	log('%d bytes in %d blocks' % (flash_size, num_blocks))
+
+	blocks = {}
+	requests = {}
+	def collect(wanted):
+		idle = time.monotonic() + timeout
+		while any(b not in blocks for b in wanted) and time.monotonic() < idle:
+			data = link.read(4096)
+			if data:
+				idle = time.monotonic() + timeout
+			for frame in parser.feed(data):
+				if frame[0] == 'D' and frame[1] < num_blocks:
+					blocks[frame[1]] = frame[2]
+
+	link.write(b'A')
+	collect(range(num_blocks))
+	while len(blocks) < num_blocks:
+		missing = [b for b in range(num_blocks) if b not in blocks]
+		if any(requests.get(b, 0) >= MAX_REQUESTS for b in missing):
+			raise RuntimeError('blocks %s missing' % missing)
+		log('asking again for blocks %s' % missing)
+		for start in range(0, len(missing), MAX_IN_FLIGHT):
+			batch = missing[start:start + MAX_IN_FLIGHT]
+			for b in batch:
+				requests[b] = requests.get(b, 0) + 1
+				link.write(b'B' + struct.pack('<H', b))
+			collect(batch)
+	log('%d bad frames' % parser.bad_frames)
+	return b''.join(blocks[b] for b in range(num_blocks))
+
+def main():
+	if len(sys.argv) < 2:
+		print('Usage: %s <output file> [serial port] [baud]' % sys.argv[0])
+		sys.exit(2)
+	import serial
+	port = sys.argv[2] if len(sys.argv) > 2 else '/dev/ttyACM0'
+	baud = int(sys.argv[3]) if len(sys.argv) > 3 else 1000000
+	link = serial.Serial(port, baud, timeout = 0.05)
+	start = time.monotonic()
+	try:
+		image = dump(link, log = print)
+	except RuntimeError as err:
+		print(err)
+		sys.exit(1)
+	with open(sys.argv[1], 'wb') as f:
+		f.write(image)
+	print('%d bytes in %.1f s' % (len(image), time.monotonic() - start))
+	if not vector_checksum_ok(image):
+		print('Vector table checksum is wrong: not a valid image.')
+		sys.exit(1)
+	print('Vector table checksum OK.')
+
+if __name__ == '__main__':
+	main()
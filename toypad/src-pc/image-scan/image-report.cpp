@@ -0,0 +1,193 @@
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+#include "crc32.hpp"
+#include "image-report.hpp"
+
+static uint32_t word_at(const uint8_t * data, size_t offset)
+{
+  return data[offset] | data[offset + 1] << 8 | data[offset + 2] << 16 | (uint32_t) data[offset + 3] << 24;
+}
+
+const char * ImageReport::crp_level() const
+{
+  switch (crp)
+  {
+    case 0x12345678: return "CRP1";
+    case 0x87654321: return "CRP2";
+    case 0x43218765: return "CRP3";
+    case 0x4e697370: return "NO_ISP";
+    default: return "none";
+  }
+}
+
+static std::vector<uint8_t> swap_words(std::vector<uint8_t> bytes)
+{
+  for (size_t i = 0; i + 4 <= bytes.size(); i += 4)
+  {
+    std::swap(bytes[i], bytes[i + 3]);
+    std::swap(bytes[i + 1], bytes[i + 2]);
+  }
+  return bytes;
+}
+
+void add_builtin_patterns(MultiSearch & search)
+{
+  // legodimensions.py
+  search.add("copyright", std::string("(c) Copyright LEGO 2014"));
+  const std::vector<uint8_t> randomness = {
+    0xb7, 0xd5, 0xd7, 0xe6, 0xe7, 0xba, 0x3c, 0xa8,
+    0xd8, 0x75, 0x47, 0x68, 0xcf, 0x23, 0xe9, 0xfe,
+  };
+  search.add("static_randomness", randomness);
+  search.add("static_randomness_swapped", swap_words(randomness));
+  // command_0xB3_replayed.py
+  const std::vector<uint8_t> tea_key = {
+    0x55, 0xfe, 0xf6, 0x30, 0x62, 0xbf, 0x0b, 0xc1,
+    0xc9, 0xb3, 0x7c, 0x34, 0x97, 0x3e, 0x29, 0xfb,
+  };
+  search.add("tea_key", tea_key);
+  search.add("tea_key_swapped", swap_words(tea_key));
+  search.add("f1ea5eed_le", std::vector<uint8_t>{0xed, 0x5e, 0xea, 0xf1});
+  search.add("f1ea5eed_be", std::vector<uint8_t>{0xf1, 0xea, 0x5e, 0xed});
+}
+
+static void add_section(ImageReport & report, const std::string & name, size_t offset, size_t size,
+                        const uint8_t * data, const uint8_t * base, size_t base_size)
+{
+  if (offset >= report.size)
+    return;
+  if (size > report.size - offset)
+    size = report.size - offset;
+  ImageSection section;
+  section.name = name;
+  section.offset = offset;
+  section.size = size;
+  section.crc = crc32(data + offset, size);
+  if (base)
+  {
+    size_t common = offset < base_size ? std::min(size, base_size - offset) : 0;
+    // Most sections are the same: let memcmp() say so.
+    if (common && memcmp(data + offset, base + offset, common))
+      for (size_t i = offset; i < offset + common; ++i)
+        if (data[i] != base[i])
+        {
+          if (!section.differing++)
+            section.first_difference = i;
+        }
+    if (common < size && !section.differing)
+      section.first_difference = offset + common;
+    section.differing += size - common;
+  }
+  report.sections.push_back(section);
+}
+
+ImageReport analyze_image(const std::string & path, const uint8_t * data, size_t size,
+                          const MultiSearch & search, const uint8_t * base, size_t base_size)
+{
+  auto start = std::chrono::steady_clock::now();
+  ImageReport report;
+  report.path = path;
+  report.size = size;
+  report.used = size;
+  while (report.used && data[report.used - 1] == 0xff)
+    --report.used;
+  report.crc = crc32(data, size);
+  
+  if (size >= 32)
+  {
+    uint32_t sum = 0;
+    for (unsigned n = 0; n < 7; ++n)
+      sum += word_at(data, 4 * n);
+    report.has_vectors = true;
+    report.vector_expected = -sum;
+    report.vector_checksum = word_at(data, 28);
+  }
+  if (size >= CRP_ADDRESS + 4)
+  {
+    report.has_crp = true;
+    report.crp = word_at(data, CRP_ADDRESS);
+  }
+  
+  report.matches = search.find(data, size);
+  
+  report.compared = base != nullptr;
+  add_section(report, "vectors", 0, VECTOR_TABLE_SIZE, data, base, base_size);
+  add_section(report, "crp", CRP_ADDRESS, 4, data, base, base_size);
+  for (size_t offset = 0; offset < size; offset += SECTOR_SIZE)
+    add_section(report, "sector " + std::to_string(offset / SECTOR_SIZE), offset, SECTOR_SIZE,
+                data, base, base_size);
+  
+  report.elapsed_ms = std::chrono::duration<double, std::milli>(
+    std::chrono::steady_clock::now() - start).count();
+  return report;
+}
+
+static std::string quoted(const std::string & text)
+{
+  std::string json = "\"";
+  for (unsigned char c : text)
+  {
+    if (c == '"' || c == '\\')
+      json += '\\';
+    if (c < 0x20)
+    {
+      char escape[8];
+      snprintf(escape, sizeof escape, "\\u%04x", c);
+      json += escape;
+    }
+    else
+      json += c;
+  }
+  return json + "\"";
+}
+
+static std::string hex(uint32_t value)
+{
+  char text[16];
+  snprintf(text, sizeof text, "\"0x%08x\"", value);
+  return text;
+}
+
+std::string ImageReport::json(const MultiSearch & search) const
+{
+  std::string json = "{\"path\":" + quoted(path)
+                   + ",\"size\":" + std::to_string(size)
+                   + ",\"used\":" + std::to_string(used)
+                   + ",\"crc32\":" + hex(crc);
+  if (has_vectors)
+    json += ",\"vector_checksum\":{\"stored\":" + hex(vector_checksum)
+          + ",\"expected\":" + hex(vector_expected)
+          + ",\"ok\":" + (vector_checksum_ok() ? "true" : "false") + "}";
+  if (has_crp)
+    json += ",\"crp\":{\"word\":" + hex(crp) + ",\"level\":" + quoted(crp_level()) + "}";
+  
+  json += ",\"matches\":[";
+  for (size_t n = 0; n < matches.size(); ++n)
+    json += std::string(n ? "," : "") + "{\"pattern\":" + quoted(search.names[matches[n].pattern])
+          + ",\"offset\":" + std::to_string(matches[n].offset) + "}";
+  
+  json += "],\"sections\":[";
+  for (size_t n = 0; n < sections.size(); ++n)
+  {
+    const ImageSection & section = sections[n];
+    json += std::string(n ? "," : "") + "{\"name\":" + quoted(section.name)
+          + ",\"offset\":" + std::to_string(section.offset)
+          + ",\"size\":" + std::to_string(section.size)
+          + ",\"crc32\":" + hex(section.crc);
+    if (compared)
+    {
+      json += ",\"same\":" + std::string(section.differing ? "false" : "true");
+      json += ",\"differing_bytes\":" + std::to_string(section.differing);
+      if (section.differing)
+        json += ",\"first_difference\":" + std::to_string(section.first_difference);
+    }
+    json += "}";
+  }
+  
+  char elapsed[32];
+  snprintf(elapsed, sizeof elapsed, "%.3f", elapsed_ms);
+  return json + "],\"elapsed_ms\":" + elapsed + "}";
+}
@@ -0,0 +1,77 @@
+#ifndef _IMAGE_REPORT_HPP_
+#define _IMAGE_REPORT_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "multi-search.hpp"
+
+// What we know of a flash dump of the LPC11U35 of the toypad (see 
+// flash_dump.py and src-lpc/flash-dumper), in one pass or two:
+// 
+//   - its size, how much of it is not erased (0xff), and its CRC-32;
+//   - the checksum of the vector table, as the boot ROM checks it (and 
+//     src-lpc/voltage-glitch-loop/cm3_checksum.py writes it): entry 7 is 
+//     the 2's complement of the sum of entries 0 to 6;
+//   - the code read protection word at 0x2fc;
+//   - where the constants of python/legodimensions.py and 
+//     command_0xB3_replayed.py are: the copyright string, the static 
+//     randomness of the password, the TEA key and 0xf1ea5eed, also with 
+//     the bytes of every 32 bit word swapped (the firmware may keep them 
+//     as words in the other order);
+//   - per section (the vector table, the CRP word, every 4 kB sector) a 
+//     CRC-32 and, against a base image, how many bytes differ.
+// 
+// The report is one line of JSON.
+
+#define VECTOR_TABLE_SIZE	0xc0	// 48 vectors.
+#define CRP_ADDRESS		0x2fc
+#define SECTOR_SIZE		4096
+
+struct ImageSection
+{
+  std::string name;
+  size_t offset;
+  size_t size;
+  uint32_t crc;
+  // Against the base, if any. Bytes the base does not have differ.
+  size_t differing = 0;
+  size_t first_difference = 0;	// Offset, if differing.
+};
+
+struct ImageReport
+{
+  std::string path;
+  size_t size = 0;
+  size_t used = 0;		// Up to the last byte that is not 0xff.
+  uint32_t crc = 0;
+  
+  bool has_vectors = false;	// At least 8 entries.
+  uint32_t vector_checksum = 0;	// Entry 7.
+  uint32_t vector_expected = 0;
+  
+  bool has_crp = false;
+  uint32_t crp = 0;
+  
+  std::vector<MultiSearch::Match> matches;
+  std::vector<ImageSection> sections;
+  bool compared = false;
+  double elapsed_ms = 0;
+  
+  bool vector_checksum_ok() const { return has_vectors && vector_checksum == vector_expected; }
+  // "CRP1", "CRP2", "CRP3", "NO_ISP" or "none".
+  const char * crp_level() const;
+  std::string json(const MultiSearch & search) const;
+};
+
+// The constants above, as patterns.
+void add_builtin_patterns(MultiSearch & search);
+
+// base: nullptr for no comparison.
+ImageReport analyze_image(const std::string & path, const uint8_t * data, size_t size,
+                          const MultiSearch & search,
+                          const uint8_t * base = nullptr, size_t base_size = 0);
+
+#endif /* _IMAGE_REPORT_HPP_ */
@@ -0,0 +1,156 @@
+// Checks the image analyzer: the SSE2 filter of MultiSearch finds what 
+// the Aho-Corasick automaton finds, on random data with planted 
+// patterns; analyze_image() on a made up flash image (vector checksum, 
+// CRP, the constants, a diff); MappedFile on a file of it. Also times 
+// both searches on a 32 kB image.
+
+#include <chrono>
+#include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+#include "../controller/test-check.hpp"
+#include "image-report.hpp"
+#include "mapped-file.hpp"
+#include "multi-search.hpp"
+
+static void put_word(std::vector<uint8_t> & image, size_t offset, uint32_t value)
+{
+  for (unsigned i = 0; i < 4; ++i)
+    image[offset + i] = value >> (8 * i);
+}
+
+static size_t count(const ImageReport & report, const MultiSearch & search, const char * name)
+{
+  size_t n = 0;
+  for (const MultiSearch::Match & match : report.matches)
+    n += search.names[match.pattern] == name;
+  return n;
+}
+
+int main()
+{
+  try
+  {
+    // A few bytes, so the patterns show up by chance too, and overlap.
+    srand(1);
+    MultiSearch search;
+    search.add("abab", std::string("abab"));
+    search.add("ba", std::string("ba"));
+    search.add("bab", std::string("bab"));
+    search.add("cab", std::string("cab"));
+    search.add("long", std::string("abcabcabcabcabcabcab"));
+    std::vector<uint8_t> data(100000);
+    for (uint8_t & byte : data)
+      byte = "abcd"[rand() % 4];
+    memcpy(&data[data.size() - 20], "abcabcabcabcabcabcab", 20);
+    bool same = true;
+    for (size_t size : {0, 1, 2, 15, 16, 17, 18, 33, 1000, 100000})
+      same = same && search.find(data.data(), size) == search.find_automaton(data.data(), size);
+    std::vector<MultiSearch::Match> all = search.find(data.data(), data.size());
+    check(same && all.size() > 5000, "filter finds what the automaton finds");
+    bool at_end = false;
+    for (const MultiSearch::Match & match : all)
+      at_end = at_end || (match.pattern == 4 && match.offset == data.size() - 20);
+    check(at_end, "pattern at the end");
+    
+    MultiSearch one_byte;
+    one_byte.add("a", std::string("a"));
+    one_byte.add("ab", std::string("ab"));
+    check(one_byte.find(data.data(), 1000) == one_byte.find_automaton(data.data(), 1000),
+          "pattern of one byte: the automaton");
+    
+    // A made up image of 32 kB.
+    std::vector<uint8_t> image(32 * 1024, 0xff);
+    for (size_t i = 0; i < 0x1000; ++i)
+      image[0xc0 + i] = i * 7;
+    static const uint32_t vectors[7] = {0x10001ff0, 0x000000d5, 0x000000dd, 0x000000df, 0, 0, 0};
+    uint32_t sum = 0;
+    for (unsigned n = 0; n < 7; ++n)
+    {
+      put_word(image, 4 * n, vectors[n]);
+      sum += vectors[n];
+    }
+    put_word(image, 28, -sum);
+    put_word(image, CRP_ADDRESS, 0x43218765);
+    memcpy(&image[0x2000], "(c) Copyright LEGO 2014", 23);
+    static const uint8_t key_words[16] = {
+      0x30, 0xf6, 0xfe, 0x55, 0xc1, 0x0b, 0xbf, 0x62,
+      0x34, 0x7c, 0xb3, 0xc9, 0xfb, 0x29, 0x3e, 0x97,
+    };
+    memcpy(&image[0x2100], key_words, 16);
+    put_word(image, 0x2200, 0xf1ea5eed);
+    image[0x7000] = 0;
+    
+    MultiSearch builtin;
+    add_builtin_patterns(builtin);
+    ImageReport report = analyze_image("made-up", image.data(), image.size(), builtin);
+    check(report.vector_checksum_ok(), "vector checksum");
+    check(report.used == 0x7001, "used");
+    check(!strcmp(report.crp_level(), "CRP3"), "CRP3");
+    check(count(report, builtin, "copyright") == 1 && count(report, builtin, "tea_key_swapped") == 1
+       && count(report, builtin, "f1ea5eed_le") == 1 && count(report, builtin, "tea_key") == 0,
+          "constants found");
+    check(report.sections.size() == 2 + 8 && !report.compared, "sections");
+    
+    std::vector<uint8_t> changed = image;
+    put_word(changed, CRP_ADDRESS, 0xffffffff);
+    changed[0x3456] ^= 1;
+    changed[0x3457] ^= 1;
+    changed.resize(image.size() - 100);
+    report = analyze_image("changed", changed.data(), changed.size(), builtin, image.data(), image.size());
+    check(report.vector_checksum_ok() && !strcmp(report.crp_level(), "none"), "no CRP");
+    bool diff = report.compared;
+    for (const ImageSection & section : report.sections)
+    {
+      size_t expected = section.name == "crp" || section.name == "sector 0" ? 4
+                      : section.name == "sector 3" ? 2 : 0;
+      diff = diff && section.differing == expected;
+    }
+    report = analyze_image("image", image.data(), image.size(), builtin, changed.data(), changed.size());
+    diff = diff && report.sections.back().differing == 100
+        && report.sections.back().first_difference == changed.size();
+    check(diff, "diff");
+    
+    char path[] = "/tmp/image-scan-test-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0 || write(fd, image.data(), image.size()) != (ssize_t) image.size())
+      throw std::runtime_error("cannot write a temporary file");
+    close(fd);
+    {
+      MappedFile file(path);
+      check(file.size == image.size() && !memcmp(file.data, image.data(), image.size()), "mmap");
+      std::string json = analyze_image(path, file.data, file.size, builtin).json(builtin);
+      check(json.find("\"level\":\"CRP3\"") != std::string::npos
+         && json.find("{\"pattern\":\"copyright\",\"offset\":8192}") != std::string::npos,
+            "JSON");
+    }
+    unlink(path);
+    
+    const unsigned rounds = 1000;
+    auto time = [&](bool filter)
+    {
+      auto start = std::chrono::steady_clock::now();
+      size_t found = 0;
+      for (unsigned n = 0; n < rounds; ++n)
+        found += (filter ? builtin.find(image.data(), image.size())
+                         : builtin.find_automaton(image.data(), image.size())).size();
+      double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      printf("      %s: %.1f MB/s (%zu)\n", filter ? "filter   " : "automaton",
+             rounds * image.size() / seconds / 1e6, found);
+    };
+    time(true);
+    time(false);
+  }
+  catch (const std::exception & e)
+  {
+    printf("FAIL: %s\n", e.what());
+    ++failures;
+  }
+  
+  printf("%u failures\n", failures);
+  return failures ? 1 : 0;
+}
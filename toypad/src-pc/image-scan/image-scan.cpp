@@ -0,0 +1,169 @@
+// Analyzes flash dumps of the LPC11U35 (see image-report.hpp): prints a 
+// line of JSON per image, in the order of the arguments, with the 
+// checksum of the vector table, the CRP word, where the known constants 
+// are, and per section a CRC-32 (and the bytes that differ from --diff).
+// The images are mmap()ed and spread over threads.
+// 
+// Usage: image-scan [options] <image>...
+// 
+//   --diff <image>          compare every section with this one
+//   --pattern <name>=<hex>  also look for these bytes (e.g.
+//                           delta=b979379e)
+//   --string <name>=<text>  also look for this text
+//   --no-builtin            only the patterns of the options
+//   --threads <n>           (0: one per core)
+// 
+// Exits with 1 if an image cannot be read.
+
+#include <atomic>
+#include <ctype.h>
+#include <getopt.h>
+#include <memory>
+#include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "image-report.hpp"
+#include "mapped-file.hpp"
+#include "multi-search.hpp"
+
+static void usage(const char * program)
+{
+  fprintf(stderr,
+    "Usage: %s [--diff <image>] [--pattern <name>=<hex>] [--string <name>=<text>]\n"
+    "       [--no-builtin] [--threads <n>] <image>...\n", program);
+  exit(2);
+}
+
+static std::vector<uint8_t> parse_hex(const std::string & text)
+{
+  std::vector<uint8_t> bytes;
+  std::string digits;
+  for (char c : text)
+    if (isxdigit((unsigned char) c))
+      digits += c;
+    else if (c != ' ' && c != ':')
+      throw std::runtime_error("not hex: " + text);
+  if (digits.size() % 2)
+    throw std::runtime_error("odd number of hex digits: " + text);
+  for (size_t i = 0; i < digits.size(); i += 2)
+    bytes.push_back(strtoul(digits.substr(i, 2).c_str(), nullptr, 16));
+  return bytes;
+}
+
+// name=value
+static void split(const char * argument, std::string & name, std::string & value)
+{
+  std::string text = argument;
+  size_t equals = text.find('=');
+  if (equals == std::string::npos || equals == 0)
+    throw std::runtime_error(text + ": expected <name>=<value>");
+  name = text.substr(0, equals);
+  value = text.substr(equals + 1);
+}
+
+int main(int argc, char ** argv)
+{
+  std::string diff;
+  std::vector<std::pair<std::string, std::vector<uint8_t>>> extra;
+  bool builtin = true;
+  unsigned threads = 0;
+  
+  static const option options[] = {
+    {"diff",       required_argument, nullptr, 'd'},
+    {"pattern",    required_argument, nullptr, 'p'},
+    {"string",     required_argument, nullptr, 's'},
+    {"no-builtin", no_argument,       nullptr, 'n'},
+    {"threads",    required_argument, nullptr, 'j'},
+    {nullptr,      0,                 nullptr, 0},
+  };
+  try
+  {
+    int option;
+    std::string name, value;
+    while ((option = getopt_long(argc, argv, "", options, nullptr)) != -1)
+    {
+      switch (option)
+      {
+        case 'd': diff = optarg; break;
+        case 'p':
+          split(optarg, name, value);
+          extra.push_back({name, parse_hex(value)});
+          break;
+        case 's':
+          split(optarg, name, value);
+          extra.push_back({name, std::vector<uint8_t>(value.begin(), value.end())});
+          break;
+        case 'n': builtin = false; break;
+        case 'j': threads = strtoul(optarg, nullptr, 0); break;
+        default: usage(argv[0]);
+      }
+    }
+    if (optind == argc)
+      usage(argv[0]);
+    if (!threads)
+      threads = std::thread::hardware_concurrency();
+    if (!threads)
+      threads = 1;
+    
+    MultiSearch search;
+    if (builtin)
+      add_builtin_patterns(search);
+    for (const auto & pattern : extra)
+      search.add(pattern.first, pattern.second);
+    
+    std::unique_ptr<MappedFile> base;
+    if (!diff.empty())
+      base.reset(new MappedFile(diff));
+    
+    std::vector<std::string> paths(argv + optind, argv + argc);
+    std::vector<std::string> lines(paths.size());
+    std::vector<std::string> errors(paths.size());
+    std::atomic<size_t> next(0);
+    auto work = [&]()
+    {
+      size_t n;
+      while ((n = next++) < paths.size())
+      {
+        try
+        {
+          MappedFile image(paths[n]);
+          ImageReport report = analyze_image(paths[n], image.data, image.size, search,
+                                             base ? base->data : nullptr, base ? base->size : 0);
+          lines[n] = report.json(search);
+        }
+        catch (const std::exception & e)
+        {
+          errors[n] = e.what();
+        }
+      }
+    };
+    std::vector<std::thread> workers;
+    for (unsigned n = 1; n < threads && n < paths.size(); ++n)
+      workers.emplace_back(work);
+    work();
+    for (std::thread & worker : workers)
+      worker.join();
+    
+    int status = 0;
+    for (size_t n = 0; n < paths.size(); ++n)
+    {
+      if (errors[n].empty())
+        printf("%s\n", lines[n].c_str());
+      else
+      {
+        fprintf(stderr, "%s\n", errors[n].c_str());
+        status = 1;
+      }
+    }
+    return status;
+  }
+  catch (const std::exception & e)
+  {
+    fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+}
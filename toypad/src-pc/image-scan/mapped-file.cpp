@@ -0,0 +1,46 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mapped-file.hpp"
+
+static std::runtime_error file_error(const std::string & path, const char * what)
+{
+  return std::runtime_error(path + ": " + what + ": " + strerror(errno));
+}
+
+MappedFile::MappedFile(const std::string & path)
+  : path(path)
+{
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    throw file_error(path, "open");
+  struct stat st;
+  if (fstat(fd, &st) < 0)
+  {
+    close(fd);
+    throw file_error(path, "stat");
+  }
+  size = st.st_size;
+  if (size == 0)
+  {
+    close(fd);
+    return;
+  }
+  void * map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    throw file_error(path, "mmap");
+  data = (const uint8_t *) map;
+  madvise(map, size, MADV_SEQUENTIAL);
+}
+
+MappedFile::~MappedFile()
+{
+  if (data)
+    munmap((void *) data, size);
+}
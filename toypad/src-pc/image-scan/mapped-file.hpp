@@ -0,0 +1,23 @@
+#ifndef _MAPPED_FILE_HPP_
+#define _MAPPED_FILE_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+// A file mmap()ed read only, for as long as the object lives. An empty 
+// file has data nullptr and size 0.
+class MappedFile
+{
+  public:
+    explicit MappedFile(const std::string & path);
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile & operator=(const MappedFile &) = delete;
+    
+    const std::string path;
+    const uint8_t * data = nullptr;
+    size_t size = 0;
+};
+
+#endif /* _MAPPED_FILE_HPP_ */
@@ -0,0 +1,177 @@
+#include <algorithm>
+#include <deque>
+#include <stdexcept>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "multi-search.hpp"
+
+unsigned MultiSearch::add(const std::string & name, const std::vector<uint8_t> & bytes)
+{
+  if (bytes.empty())
+    throw std::runtime_error("pattern " + name + " is empty");
+  names.push_back(name);
+  patterns.push_back(bytes);
+  build();
+  return patterns.size() - 1;
+}
+
+unsigned MultiSearch::add(const std::string & name, const std::string & text)
+{
+  return add(name, std::vector<uint8_t>(text.begin(), text.end()));
+}
+
+void MultiSearch::build()
+{
+  // The trie, with 0 for no edge (the root is never a child).
+  next.assign(256, 0);
+  out.assign(1, {});
+  for (unsigned p = 0; p < patterns.size(); ++p)
+  {
+    uint32_t state = 0;
+    for (uint8_t byte : patterns[p])
+    {
+      if (!next[256 * state + byte])
+      {
+        next[256 * state + byte] = out.size();
+        next.resize(next.size() + 256, 0);
+        out.emplace_back();
+      }
+      state = next[256 * state + byte];
+    }
+    out[state].push_back(p);
+  }
+  
+  // Breadth first: the missing edges of a state are those of its 
+  // failure state, which is nearer to the root.
+  std::vector<uint32_t> fail(out.size(), 0);
+  std::deque<uint32_t> queue;
+  for (unsigned byte = 0; byte < 256; ++byte)
+    if (next[byte])
+      queue.push_back(next[byte]);
+  while (!queue.empty())
+  {
+    uint32_t state = queue.front();
+    queue.pop_front();
+    const std::vector<unsigned> & inherited = out[fail[state]];
+    out[state].insert(out[state].end(), inherited.begin(), inherited.end());
+    for (unsigned byte = 0; byte < 256; ++byte)
+    {
+      uint32_t & child = next[256 * state + byte];
+      uint32_t failed = next[256 * fail[state] + byte];
+      if (child)
+      {
+        fail[child] = failed;
+        queue.push_back(child);
+      }
+      else
+        child = failed;
+    }
+  }
+  
+  anchors.clear();
+  filter = true;
+  for (unsigned p = 0; p < patterns.size(); ++p)
+  {
+    const std::vector<uint8_t> & pattern = patterns[p];
+    if (pattern.size() < 2)
+    {
+      filter = false;
+      break;
+    }
+    auto same = [&pattern](const Anchor & anchor)
+    {
+      return anchor.first == pattern[0] && anchor.second == pattern[1];
+    };
+    auto anchor = std::find_if(anchors.begin(), anchors.end(), same);
+    if (anchor == anchors.end())
+    {
+      anchors.push_back({pattern[0], pattern[1], {}});
+      anchor = anchors.end() - 1;
+    }
+    anchor->patterns.push_back(p);
+  }
+  if (anchors.size() > MAX_ANCHORS)
+    filter = false;
+#ifndef __SSE2__
+  filter = false;
+#endif
+}
+
+static bool by_offset(const MultiSearch::Match & a, const MultiSearch::Match & b)
+{
+  return a.offset != b.offset ? a.offset < b.offset : a.pattern < b.pattern;
+}
+
+std::vector<MultiSearch::Match> MultiSearch::find_automaton(const uint8_t * data, size_t size) const
+{
+  std::vector<Match> matches;
+  uint32_t state = 0;
+  for (size_t i = 0; i < size; ++i)
+  {
+    state = next[256 * state + data[i]];
+    for (unsigned p : out[state])
+      matches.push_back({p, i + 1 - patterns[p].size()});
+  }
+  std::sort(matches.begin(), matches.end(), by_offset);
+  return matches;
+}
+
+std::vector<MultiSearch::Match> MultiSearch::find(const uint8_t * data, size_t size) const
+{
+  if (!filter)
+    return find_automaton(data, size);
+  
+  std::vector<Match> matches;
+  auto check = [&](size_t offset, const Anchor & anchor)
+  {
+    for (unsigned p : anchor.patterns)
+    {
+      const std::vector<uint8_t> & pattern = patterns[p];
+      if (pattern.size() <= size - offset && !memcmp(data + offset, pattern.data(), pattern.size()))
+        matches.push_back({p, offset});
+    }
+  };
+  
+  size_t i = 0;
+#ifdef __SSE2__
+  __m128i firsts[MAX_ANCHORS], seconds[MAX_ANCHORS];
+  for (size_t a = 0; a < anchors.size(); ++a)
+  {
+    firsts[a] = _mm_set1_epi8((char) anchors[a].first);
+    seconds[a] = _mm_set1_epi8((char) anchors[a].second);
+  }
+  // The second bytes of the 16 positions are 1 further: up to i + 16.
+  for (; i + 17 <= size; i += 16)
+  {
+    __m128i here = _mm_loadu_si128((const __m128i *) (data + i));
+    __m128i after = _mm_loadu_si128((const __m128i *) (data + i + 1));
+    unsigned hits[MAX_ANCHORS];
+    unsigned any = 0;
+    for (size_t a = 0; a < anchors.size(); ++a)
+    {
+      hits[a] = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(here, firsts[a]),
+                                                _mm_cmpeq_epi8(after, seconds[a])));
+      any |= hits[a];
+    }
+    while (any)
+    {
+      unsigned bit = __builtin_ctz(any);
+      any &= any - 1;
+      for (size_t a = 0; a < anchors.size(); ++a)
+        if (hits[a] & (1u << bit))
+          check(i + bit, anchors[a]);
+    }
+  }
+#endif
+  for (; i + 1 < size; ++i)
+    for (const Anchor & anchor : anchors)
+      if (data[i] == anchor.first && data[i + 1] == anchor.second)
+        check(i, anchor);
+  // Patterns with the same two first bytes were checked in the order of 
+  // their anchor.
+  std::sort(matches.begin(), matches.end(), by_offset);
+  return matches;
+}
@@ -0,0 +1,68 @@
+#ifndef _MULTI_SEARCH_HPP_
+#define _MULTI_SEARCH_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Finds every occurrence of a set of byte strings in one pass over the 
+// data, overlapping ones included.
+// 
+// The patterns we look for in a flash dump (see image-report.hpp) are a 
+// handful, and a dump is mostly 0xff, code and tables in which their 
+// first two bytes are rare. So find() is a filter in the manner of 
+// Teddy (of the Hyperscan and Rust regex crates), with plain SSE2: it 
+// compares 16 positions at a time with the first and the second byte of 
+// every pattern, and only checks the whole pattern where both match.
+// 
+// With a pattern of one byte, more than MAX_ANCHORS different first two 
+// bytes, or without SSE2, find() runs the Aho-Corasick automaton 
+// (find_automaton()), a table of 256 next states per state.
+class MultiSearch
+{
+  public:
+    struct Match
+    {
+      unsigned pattern;	// Index, in the order of add().
+      size_t offset;
+      
+      bool operator==(const Match & other) const
+      {
+        return pattern == other.pattern && offset == other.offset;
+      }
+    };
+    
+    static const unsigned MAX_ANCHORS = 16;
+    
+    // Returns the index of the pattern. Empty patterns are an error.
+    unsigned add(const std::string & name, const std::vector<uint8_t> & bytes);
+    unsigned add(const std::string & name, const std::string & text);
+    
+    // In the order of their offsets, then of their patterns.
+    std::vector<Match> find(const uint8_t * data, size_t size) const;
+    std::vector<Match> find_automaton(const uint8_t * data, size_t size) const;
+    
+    std::vector<std::string> names;
+    std::vector<std::vector<uint8_t>> patterns;
+  
+  private:
+    void build();
+    
+    // Aho-Corasick: next[256 * state + byte]; out[state] are the patterns 
+    // that end in state, also those of its suffixes.
+    std::vector<uint32_t> next;
+    std::vector<std::vector<unsigned>> out;
+    
+    // The filter: the first two bytes, and the patterns that start with 
+    // them.
+    struct Anchor
+    {
+      uint8_t first, second;
+      std::vector<unsigned> patterns;
+    };
+    std::vector<Anchor> anchors;
+    bool filter = false;
+};
+
+#endif /* _MULTI_SEARCH_HPP_ */
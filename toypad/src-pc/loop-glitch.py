@@ -0,0 +1,72 @@
+#!/usr/bin/env python3
+# Width characterization with the closed loop mode (command 'L') of the
+# glitcher, against src-lpc/voltage-glitch-loop. For every pulse width,
+# let the glitcher pulse until the target faults, a number of times, and
+# print how many pulses it took. Build the target without CHARACTERIZE:
+# with it, the target keeps on looping after a fault, and 'L' never sees
+# one.
+#
+# Usage: ./loop-glitch.py [first width] [last width] [serial port]
+
+import serial
+import sys
+
+# Time between pulses, in CPU cycles of the glitcher (16 MHz). 1600 is
+# 10 kHz.
+period = 1600
+
+# Give up on a width after this many pulses (at most 65535).
+max_pulses = 50000
+
+# Number of faults to collect per width.
+runs = 10
+
+do_trace = True
+do_trace = False
+if do_trace:
+	trace = print
+else:
+	trace = lambda *args: None
+
+def loop(avr, width):
+	'''Pulse until fault. Return (pulses, resets, faulted).'''
+	avr.write(b'L%d,%d,%d\n' % (period, width, max_pulses))
+	pulses = 0
+	resets = 0
+	faulted = False
+	for line in avr:
+		trace(b'avr: ' + line)
+		if line.startswith(b'FAIL'):
+			print('Glitcher: %s' % line.decode(errors='replace').strip())
+			sys.exit(1)
+		if line.startswith(b'PULSES '):
+			pulses = int(line.split()[1], 16)
+		if line.startswith(b'RESETS '):
+			resets = int(line.split()[1], 16)
+		if line.startswith(b'FAULT '):
+			faulted = True
+		if b'DONE' in line:
+			break
+	return pulses, resets, faulted
+
+def main():
+	first = int(sys.argv[1]) if len(sys.argv) > 1 else 2
+	last = int(sys.argv[2]) if len(sys.argv) > 2 else 100
+	port = sys.argv[3] if len(sys.argv) > 3 else '/dev/ttyUSB0'
+	avr = serial.Serial(port, 115200)
+
+	print('width  faults  resets  pulses/fault')
+	for width in range(first, last + 1):
+		faults = 0
+		resets = 0
+		pulses = 0
+		for run in range(runs):
+			p, r, f = loop(avr, width)
+			pulses += p
+			resets += r
+			faults += f
+		per_fault = '%12.1f' % (pulses / faults) if faults else '           -'
+		print('%5d  %6d  %6d  %s' % (width, faults, resets, per_fault))
+
+if __name__ == '__main__':
+	main()
@@ -0,0 +1,165 @@
+// Microbenchmarks of tag-crypto.hpp (Google Benchmark): every function 
+// over batches of 1 to 4096 random UIDs, keys or blocks, in items per 
+// second; and of tag-batch.hpp, which takes a whole batch at once.
+// 
+// Usage: crypto-bench [--benchmark_filter=<regex>] [--benchmark_format=json] ...
+
+#include <benchmark/benchmark.h>
+#include <random>
+#include <vector>
+
+#include "tag-batch.hpp"
+#include "tag-crypto.hpp"
+
+struct Batch
+{
+  explicit Batch(size_t size)
+    : uids(size), keys(size), blocks(size), states(size)
+  {
+    std::mt19937 random(size);
+    for (size_t n = 0; n < size; ++n)
+    {
+      for (uint8_t & byte : uids[n].bytes)
+        byte = random();
+      for (uint32_t & word : keys[n].words)
+        word = random();
+      for (uint32_t & word : blocks[n].words)
+        word = random();
+      for (uint32_t & word : states[n].words)
+        word = random();
+    }
+  }
+  
+  struct Uid { uint8_t bytes[UID_SIZE]; };
+  struct Key { uint32_t words[4]; };
+  struct Block { uint32_t words[2]; };
+  std::vector<Uid> uids;
+  std::vector<Key> keys;
+  std::vector<Block> blocks;
+  std::vector<Key> states;
+};
+
+#define BATCHES		RangeMultiplier(8)->Range(1, 4096)
+
+static void run(benchmark::State & state, void (* function)(Batch & batch, size_t n))
+{
+  Batch batch(state.range(0));
+  for (auto _ : state)
+    for (size_t n = 0; n < batch.uids.size(); ++n)
+      function(batch, n);
+  state.SetItemsProcessed(state.iterations() * batch.uids.size());
+}
+
+static void BM_tea_encrypt(benchmark::State & state)
+{
+  run(state, [](Batch & batch, size_t n)
+  {
+    tea_encrypt(batch.blocks[n].words, batch.keys[n].words);
+    benchmark::DoNotOptimize(batch.blocks[n]);
+  });
+}
+BENCHMARK(BM_tea_encrypt)->BATCHES;
+
+static void BM_tea_decrypt(benchmark::State & state)
+{
+  run(state, [](Batch & batch, size_t n)
+  {
+    tea_decrypt(batch.blocks[n].words, batch.keys[n].words);
+    benchmark::DoNotOptimize(batch.blocks[n]);
+  });
+}
+BENCHMARK(BM_tea_decrypt)->BATCHES;
+
+static void BM_tag_password(benchmark::State & state)
+{
+  run(state, [](Batch & batch, size_t n)
+  {
+    benchmark::DoNotOptimize(tag_password(batch.uids[n].bytes));
+  });
+}
+BENCHMARK(BM_tag_password)->BATCHES;
+
+static void BM_tag_scramble(benchmark::State & state)
+{
+  run(state, [](Batch & batch, size_t n)
+  {
+    benchmark::DoNotOptimize(tag_scramble(batch.uids[n].bytes, 6));
+  });
+}
+BENCHMARK(BM_tag_scramble)->BATCHES;
+
+static void BM_tag_tea_key(benchmark::State & state)
+{
+  run(state, [](Batch & batch, size_t n)
+  {
+    tag_tea_key(batch.uids[n].bytes, batch.keys[n].words);
+    benchmark::DoNotOptimize(batch.keys[n]);
+  });
+}
+BENCHMARK(BM_tag_tea_key)->BATCHES;
+
+static void BM_encrypt_character(benchmark::State & state)
+{
+  run(state, [](Batch & batch, size_t n)
+  {
+    uint8_t pages[8];
+    encrypt_character(batch.uids[n].bytes, n % 1000, pages);
+    benchmark::DoNotOptimize(pages);
+  });
+}
+BENCHMARK(BM_encrypt_character)->BATCHES;
+
+static void BM_toypad_shuffle(benchmark::State & state)
+{
+  run(state, [](Batch & batch, size_t n)
+  {
+    toypad_shuffle(batch.states[n].words);
+    benchmark::DoNotOptimize(batch.states[n]);
+  });
+}
+BENCHMARK(BM_toypad_shuffle)->BATCHES;
+
+static void BM_toypad_scramble(benchmark::State & state)
+{
+  run(state, [](Batch & batch, size_t n)
+  {
+    toypad_scramble(batch.blocks[n].words[0], batch.states[n].words);
+    benchmark::DoNotOptimize(batch.states[n]);
+  });
+}
+BENCHMARK(BM_toypad_scramble)->BATCHES;
+
+// The whole batch in one call.
+static void BM_tag_keys_batch(benchmark::State & state)
+{
+  Batch batch(state.range(0));
+  std::vector<TagKeys> keys(batch.uids.size());
+  for (auto _ : state)
+  {
+    tag_keys(&batch.uids[0].bytes, batch.uids.size(), keys.data());
+    benchmark::DoNotOptimize(keys.data());
+  }
+  state.SetItemsProcessed(state.iterations() * batch.uids.size());
+}
+BENCHMARK(BM_tag_keys_batch)->BATCHES;
+
+static void BM_encode_tags(benchmark::State & state)
+{
+  Batch batch(state.range(0));
+  std::vector<TagKeys> keys(batch.uids.size());
+  std::vector<uint32_t> ids(batch.uids.size());
+  for (size_t n = 0; n < ids.size(); ++n)
+    ids[n] = n % 1000;
+  tag_keys(&batch.uids[0].bytes, batch.uids.size(), keys.data());
+  std::vector<uint8_t> memories(batch.uids.size() * TAG_MEMORY_SIZE);
+  for (auto _ : state)
+  {
+    encode_tags(&batch.uids[0].bytes, ids.data(), keys.data(), ids.size(),
+                (uint8_t (*)[TAG_MEMORY_SIZE]) memories.data());
+    benchmark::DoNotOptimize(memories.data());
+  }
+  state.SetItemsProcessed(state.iterations() * batch.uids.size());
+}
+BENCHMARK(BM_encode_tags)->BATCHES;
+
+BENCHMARK_MAIN();
@@ -0,0 +1,201 @@
+// The tag arithmetic of tag-crypto.hpp, one operation per line of 
+// standard input, for python/differential_crypto.py: it runs the same 
+// lines through the Python, C and JavaScript implementations and 
+// compares the answers. Every argument and answer is hex, the bytes as 
+// the Python code has them (words little endian):
+// 
+//   password <uid>              -> 4 bytes 
+//   scramble <uid> <rounds>     -> 4 bytes 
+//   tea_key <uid>               -> 16 bytes 
+//   encrypt <key> <block>       -> 8 bytes 
+//   decrypt <key> <block>       -> 8 bytes 
+//   character <uid> <id>        -> pages 0x24 and 0x25 (8 bytes) 
+//   shuffle <16 bytes>          -> 16 bytes (toypad_shuffle()) 
+//   toypad_scramble <4 bytes>   -> 16 bytes
+// 
+// All lines are read before the first is computed; after the answers, 
+// one line per operation: "# <operation> <count> <seconds>", the time of 
+// the computing only (after a first pass, the lines of an operation are 
+// computed as many times as fit in 20 ms, REPEATS times; the fastest 
+// of these counts).
+// 
+// Usage: crypto-vectors < lines
+
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include "tag-crypto.hpp"
+
+#define MIN_SECONDS	0.02	// Per operation and repeat.
+#define REPEATS		5
+
+typedef std::vector<uint8_t> Bytes;
+
+static Bytes from_hex(const std::string & text, size_t size)
+{
+  if (text.size() != 2 * size)
+    throw std::runtime_error("expected " + std::to_string(size) + " bytes: " + text);
+  Bytes bytes(size);
+  for (size_t i = 0; i < size; ++i)
+    bytes[i] = strtoul(text.substr(2 * i, 2).c_str(), nullptr, 16);
+  return bytes;
+}
+
+static void words(const Bytes & bytes, uint32_t * words)
+{
+  for (size_t i = 0; i < bytes.size() / 4; ++i)
+    words[i] = get_le32(&bytes[4 * i]);
+}
+
+struct Line
+{
+  std::string op;
+  Bytes a, b;
+  unsigned number = 0;
+  uint8_t answer[16];
+  size_t answer_size = 0;
+};
+
+static void compute(Line & line)
+{
+  uint32_t v[4], key[4];
+  const std::string & op = line.op;
+  if (op == "password" || op == "scramble")
+  {
+    put_le32(line.answer, op == "password" ? tag_password(line.a.data())
+                                           : tag_scramble(line.a.data(), line.number));
+    line.answer_size = 4;
+  }
+  else if (op == "tea_key")
+  {
+    tag_tea_key(line.a.data(), key);
+    for (unsigned n = 0; n < 4; ++n)
+      put_le32(line.answer + 4 * n, key[n]);
+    line.answer_size = 16;
+  }
+  else if (op == "encrypt" || op == "decrypt")
+  {
+    words(line.a, key);
+    words(line.b, v);
+    if (op == "encrypt")
+      tea_encrypt(v, key);
+    else
+      tea_decrypt(v, key);
+    put_le32(line.answer, v[0]);
+    put_le32(line.answer + 4, v[1]);
+    line.answer_size = 8;
+  }
+  else if (op == "character")
+  {
+    encrypt_character(line.a.data(), line.number, line.answer);
+    line.answer_size = 8;
+  }
+  else if (op == "shuffle" || op == "toypad_scramble")
+  {
+    words(line.a, v);
+    if (op == "shuffle")
+      toypad_shuffle(v);
+    else
+      toypad_scramble(v[0], v);
+    for (unsigned n = 0; n < 4; ++n)
+      put_le32(line.answer + 4 * n, v[n]);
+    line.answer_size = 16;
+  }
+}
+
+int main()
+{
+  try
+  {
+    std::vector<Line> lines;
+    std::string op, a, b;
+    while (std::cin >> op)
+    {
+      Line line;
+      line.op = op;
+      if (op == "password" || op == "tea_key")
+      {
+        std::cin >> a;
+        line.a = from_hex(a, UID_SIZE);
+      }
+      else if (op == "scramble" || op == "character")
+      {
+        std::cin >> a >> line.number;
+        line.a = from_hex(a, UID_SIZE);
+      }
+      else if (op == "encrypt" || op == "decrypt")
+      {
+        std::cin >> a >> b;
+        line.a = from_hex(a, 16);
+        line.b = from_hex(b, 8);
+      }
+      else if (op == "shuffle")
+      {
+        std::cin >> a;
+        line.a = from_hex(a, 16);
+      }
+      else if (op == "toypad_scramble")
+      {
+        std::cin >> a;
+        line.a = from_hex(a, 4);
+      }
+      else
+        throw std::runtime_error("unknown operation: " + op);
+      lines.push_back(line);
+    }
+    
+    // Per operation: how many, and how long.
+    std::map<std::string, std::pair<size_t, double>> times;
+    for (size_t first = 0; first < lines.size(); )
+    {
+      size_t last = first;
+      while (last < lines.size() && lines[last].op == lines[first].op)
+        ++last;
+      // The first pass warms the caches up; then again and again, for 
+      // MIN_SECONDS: a few hundred lines take microseconds. The fastest 
+      // repeat is the one that was disturbed least.
+      for (size_t n = first; n < last; ++n)
+        compute(lines[n]);
+      auto & time = times[lines[first].op];
+      for (unsigned repeat = 0; repeat < REPEATS; ++repeat)
+      {
+        auto start = std::chrono::steady_clock::now();
+        double seconds;
+        size_t passes = 0;
+        do
+        {
+          for (size_t n = first; n < last; ++n)
+            compute(lines[n]);
+          ++passes;
+          seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        while (seconds < MIN_SECONDS);
+        size_t count = passes * (last - first);
+        if (!time.first || count / seconds > time.first / time.second)
+          time = std::make_pair(count, seconds);
+      }
+      first = last;
+    }
+    
+    for (const Line & line : lines)
+    {
+      for (size_t i = 0; i < line.answer_size; ++i)
+        printf("%02x", line.answer[i]);
+      printf("\n");
+    }
+    for (const auto & time : times)
+      printf("# %s %zu %.9f\n", time.first.c_str(), time.second.first, time.second.second);
+  }
+  catch (const std::exception & e)
+  {
+    fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+  return 0;
+}
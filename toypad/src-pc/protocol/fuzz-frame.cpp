@@ -0,0 +1,63 @@
+#include <string.h>
+
+#include "fuzz.hpp"
+#include "toypad-frame.hpp"
+
+using namespace toypad;
+
+const char * const FUZZ_TARGET = "frame";
+
+// Reads every byte, so the sanitizers see a read beyond the packet.
+static unsigned touch(const uint8_t * bytes, size_t size)
+{
+  unsigned sum = 0;
+  for (size_t i = 0; i < size; ++i)
+    sum += bytes[i];
+  return sum;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t * data, size_t size)
+{
+  if (size < 1)
+    return 0;
+  bool xbox = data[0] & 1;
+  const uint8_t * packet = data + 1;
+  size -= 1;
+  
+  Frame frame;
+  if (parse_frame(packet, size, xbox, frame) != OK)
+    return 0;
+  size_t prefix = xbox ? 2 : 0;
+  FUZZ_CHECK(frame.body + frame.length < packet + size);
+  FUZZ_CHECK(frame.available == size - prefix - 2);
+  
+  // The frame again, from what was parsed.
+  uint8_t again[PACKET_SIZE];
+  if (encode_frame(frame.start, frame.body, frame.length, xbox, again))
+    FUZZ_CHECK(!memcmp(again, packet, prefix + 2 + frame.length + 1));
+  
+  CommandFrame command;
+  if (parse_command(frame, command) == OK)
+  {
+    FUZZ_CHECK(command.payload_size <= command.available);
+    touch(command.payload, command.available);
+    if (encode_command(command.command, command.message_id, command.payload, command.payload_size,
+                       xbox, again))
+      FUZZ_CHECK(!memcmp(again, packet, prefix + 2 + frame.length + 1));
+  }
+  ReplyFrame reply;
+  if (parse_reply(frame, reply) == OK)
+    touch(reply.payload, reply.payload_size);
+  Event event;
+  if (parse_event(frame, event) == OK)
+  {
+    encode_event(event, xbox, again);
+    Frame other;
+    Event same;
+    FUZZ_CHECK(parse_frame(again, PACKET_SIZE, xbox, other) == OK);
+    FUZZ_CHECK(parse_event(other, same) == OK);
+    FUZZ_CHECK(same.pad == event.pad && same.index == event.index && same.removed == event.removed
+            && !memcmp(same.uid, event.uid, sizeof event.uid));
+  }
+  return 0;
+}
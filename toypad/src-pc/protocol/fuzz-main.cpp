@@ -0,0 +1,297 @@
+// The main() of a fuzz harness without libFuzzer (see fuzz.hpp).
+// 
+// Built with afl-clang-fast++, it is the persistent mode loop of AFL++:
+// 
+//   afl-fuzz -i corpus/frame -o findings -- ./fuzz-frame
+// 
+// Otherwise it runs the seeds and the files given, then mutates them 
+// (bit flips, random and interesting bytes, inserts, erases, splices) 
+// for as long as it is told, in the same process:
+// 
+// Usage: fuzz-<target> [options] [file or directory]...
+// 
+//   --runs <n>          mutated inputs (0: until --seconds)
+//   --seconds <n>       (10)
+//   --seed <n>          of the random generator (1)
+//   --max-size <n>      of a mutated input (256)
+//   --write-seeds <dir> write the seeds as files, for libFuzzer or AFL++, 
+//                       and stop
+// 
+// A failed FUZZ_CHECK() or a sanitizer error aborts, and writes the 
+// input to crash-<target>.
+
+#include <algorithm>
+#include <chrono>
+#include <dirent.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+#ifdef __SANITIZE_ADDRESS__
+#include <sanitizer/common_interface_defs.h>
+#endif
+
+#include "fuzz.hpp"
+
+typedef std::vector<uint8_t> Bytes;
+
+#ifdef __AFL_FUZZ_TESTCASE_LEN
+
+__AFL_FUZZ_INIT();
+
+int main()
+{
+  __AFL_INIT();
+  const uint8_t * buffer = __AFL_FUZZ_TESTCASE_BUF;
+  while (__AFL_LOOP(100000))
+  {
+    // A copy of its own size, for the sanitizers.
+    Bytes input(buffer, buffer + __AFL_FUZZ_TESTCASE_LEN);
+    LLVMFuzzerTestOneInput(input.data(), input.size());
+  }
+  return 0;
+}
+
+#else
+
+static void usage(const char * program)
+{
+  fprintf(stderr,
+    "Usage: %s [--runs <n>] [--seconds <n>] [--seed <n>] [--max-size <n>]\n"
+    "       [--write-seeds <dir>] [file or directory]...\n", program);
+  exit(2);
+}
+
+static Bytes read_file(const std::string & path)
+{
+  FILE * file = fopen(path.c_str(), "rb");
+  if (!file)
+    throw std::runtime_error(path + ": cannot read");
+  Bytes data;
+  uint8_t buffer[4096];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof buffer, file)) > 0)
+    data.insert(data.end(), buffer, buffer + n);
+  fclose(file);
+  return data;
+}
+
+static void write_file(const std::string & path, const Bytes & data)
+{
+  FILE * file = fopen(path.c_str(), "wb");
+  if (!file || fwrite(data.data(), 1, data.size(), file) != data.size())
+    throw std::runtime_error(path + ": cannot write");
+  fclose(file);
+}
+
+// A file, or the files of a directory.
+static void add_inputs(const std::string & path, std::vector<Bytes> & corpus)
+{
+  DIR * dir = opendir(path.c_str());
+  if (!dir)
+  {
+    corpus.push_back(read_file(path));
+    return;
+  }
+  while (dirent * entry = readdir(dir))
+    if (entry->d_name[0] != '.')
+      corpus.push_back(read_file(path + "/" + entry->d_name));
+  closedir(dir);
+}
+
+// The input that runs, written to crash_path when it fails.
+static const Bytes * current = nullptr;
+static std::string crash_path;
+
+static void save_current()
+{
+  if (!current)
+    return;
+  int fd = open(crash_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    return;
+  if (write(fd, current->data(), current->size()) < 0)
+    perror(crash_path.c_str());
+  close(fd);
+  fprintf(stderr, "input written to %s\n", crash_path.c_str());
+}
+
+// A failed FUZZ_CHECK().
+static void on_abort(int)
+{
+  save_current();
+  signal(SIGABRT, SIG_DFL);
+  raise(SIGABRT);
+}
+
+// xorshift64
+static uint64_t state;
+
+static uint32_t random_below(uint32_t n)
+{
+  state ^= state << 13;
+  state ^= state >> 7;
+  state ^= state << 17;
+  return (state >> 32) % n;
+}
+
+static void mutate(Bytes & input, const std::vector<Bytes> & corpus, size_t max_size)
+{
+  static const uint8_t interesting[] = {0x00, 0x01, 0x02, 0x0b, 0x16, 0x1f, 0x20, 0x21, 0x24, 0x2c,
+                                        0x55, 0x56, 0x7f, 0x80, 0xb0, 0xb1, 0xb3, 0xc0, 0xc8, 0xd2,
+                                        0xf0, 0xf8, 0xfe, 0xff};
+  for (unsigned n = 1 + random_below(4); n; --n)
+  {
+    size_t size = input.size();
+    switch (random_below(7))
+    {
+      case 0:
+        if (size)
+          input[random_below(size)] ^= 1 << random_below(8);
+        break;
+      case 1:
+        if (size)
+          input[random_below(size)] = random_below(256);
+        break;
+      case 2:
+        if (size)
+          input[random_below(size)] = interesting[random_below(sizeof interesting)];
+        break;
+      case 3:
+        if (size < max_size)
+          input.insert(input.begin() + random_below(size + 1), random_below(256));
+        break;
+      case 4:
+        if (size)
+        {
+          size_t at = random_below(size);
+          input.erase(input.begin() + at, input.begin() + at + 1 + random_below(std::min<size_t>(8, size - at)));
+        }
+        break;
+      case 5:
+      {
+        // The start of this one, the rest of another.
+        const Bytes & other = corpus[random_below(corpus.size())];
+        size_t at = random_below(size + 1);
+        input.resize(at);
+        if (!other.empty())
+        {
+          size_t from = random_below(other.size());
+          input.insert(input.end(), other.begin() + from, other.end());
+        }
+        break;
+      }
+      default:
+        // A byte that a checksum would need: the sum so far.
+        if (size > 1)
+        {
+          size_t at = 1 + random_below(size - 1);
+          uint8_t sum = 0;
+          for (size_t i = 1; i < at; ++i)
+            sum += input[i];
+          input[at] = sum;
+        }
+    }
+    if (input.size() > max_size)
+      input.resize(max_size);
+  }
+}
+
+int main(int argc, char ** argv)
+{
+  uint64_t runs = 0;
+  double seconds = 10;
+  uint64_t seed = 1;
+  size_t max_size = 256;
+  std::string seeds_dir;
+  
+  static const option options[] = {
+    {"runs",        required_argument, nullptr, 'r'},
+    {"seconds",     required_argument, nullptr, 't'},
+    {"seed",        required_argument, nullptr, 's'},
+    {"max-size",    required_argument, nullptr, 'm'},
+    {"write-seeds", required_argument, nullptr, 'w'},
+    {nullptr,       0,                 nullptr, 0},
+  };
+  int option;
+  while ((option = getopt_long(argc, argv, "", options, nullptr)) != -1)
+  {
+    switch (option)
+    {
+      case 'r': runs = strtoull(optarg, nullptr, 0); break;
+      case 't': seconds = strtod(optarg, nullptr); break;
+      case 's': seed = strtoull(optarg, nullptr, 0); break;
+      case 'm': max_size = strtoul(optarg, nullptr, 0); break;
+      case 'w': seeds_dir = optarg; break;
+      default: usage(argv[0]);
+    }
+  }
+  
+  try
+  {
+    std::vector<Bytes> corpus = fuzz_seeds(FUZZ_TARGET);
+    if (!seeds_dir.empty())
+    {
+      mkdir(seeds_dir.c_str(), 0755);
+      for (size_t n = 0; n < corpus.size(); ++n)
+        write_file(seeds_dir + "/seed-" + std::to_string(n), corpus[n]);
+      printf("%zu seeds in %s\n", corpus.size(), seeds_dir.c_str());
+      return 0;
+    }
+    for (int n = optind; n < argc; ++n)
+      add_inputs(argv[n], corpus);
+    if (corpus.empty())
+      corpus.push_back(Bytes());
+    
+    crash_path = std::string("crash-") + FUZZ_TARGET;
+    signal(SIGABRT, on_abort);
+#ifdef __SANITIZE_ADDRESS__
+    __sanitizer_set_death_callback(save_current);
+#endif
+    for (const Bytes & input : corpus)
+    {
+      Bytes copy = input;
+      current = &copy;
+      LLVMFuzzerTestOneInput(copy.data(), copy.size());
+    }
+    
+    state = seed * 0x9e3779b97f4a7c15ull | 1;
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed = [&start]()
+    {
+      return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+    uint64_t executions = 0;
+    Bytes input;
+    current = &input;
+    for (;;)
+    {
+      // The clock only now and then.
+      if (runs ? executions >= runs : executions % 1024 == 0 && elapsed() >= seconds)
+        break;
+      input = corpus[random_below(corpus.size())];
+      mutate(input, corpus, max_size);
+      LLVMFuzzerTestOneInput(input.data(), input.size());
+      ++executions;
+    }
+    current = nullptr;
+    double time = elapsed();
+    printf("%s: %zu seeds, %llu executions in %.2f s (%.0f per second)\n", FUZZ_TARGET,
+           corpus.size(), (unsigned long long) executions, time, executions / time);
+  }
+  catch (const std::exception & e)
+  {
+    fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+  return 0;
+}
+
+#endif
@@ -0,0 +1,122 @@
+#include <string.h>
+
+#include "fuzz.hpp"
+#include "tag-pages.hpp"
+#include "toypad-frame.hpp"
+
+using namespace toypad;
+
+typedef std::vector<uint8_t> Bytes;
+
+static Bytes hex(const char * text)
+{
+  Bytes bytes;
+  for (const char * p = text; *p; )
+  {
+    if (*p == ' ' || *p == ':')
+    {
+      ++p;
+      continue;
+    }
+    bytes.push_back(strtoul(std::string(p, 2).c_str(), nullptr, 16));
+    p += 2;
+  }
+  return bytes;
+}
+
+static Bytes command(uint8_t command, uint8_t message_id, const Bytes & payload, bool xbox = false)
+{
+  uint8_t packet[PACKET_SIZE];
+  encode_command(command, message_id, payload.data(), payload.size(), xbox, packet);
+  return Bytes(packet, packet + PACKET_SIZE);
+}
+
+static Bytes padded(Bytes packet)
+{
+  packet.resize(PACKET_SIZE, 0);
+  return packet;
+}
+
+// The UIDs of python/unittest_legodimensions.py: Wyldstyle, BMO, 
+// Supergirl.
+static const char * const UIDS[] = {"04 13 bb 1a 99 40 80", "04 d9 c8 da a2 40 80", "04 58 e4 52 25 20 91"};
+
+// The packets of toypad-dump-endpoint-0x81.py and 
+// command_0xB3_replayed.py.
+static std::vector<Bytes> packets(bool xbox)
+{
+  std::vector<Bytes> packets = {
+    command(START, 0x01, hex("28 63 29 20 4c 45 47 4f 20 32 30 31 34"), xbox),
+    command(CHANGE_COLOR, 0x01, hex("00 08 08 08"), xbox),
+    command(CHANGE_COLOR, 0x42, hex("02 40 00 80"), xbox),
+    command(CHANGE_COLORS, 0x43, hex("01 ff 00 00  00 00 00 00  01 00 80 40"), xbox),
+    command(READ_PAGE, 0x77, hex("00 24"), xbox),
+    command(SEED, 0x02, hex("de ad be ef ca fe b0 0b"), xbox),
+  };
+  if (!xbox)
+  {
+    // As captured: the challenge with length 2, and the two replies.
+    packets.push_back(padded(hex("55 02 b3 03 0d")));
+    packets.push_back(padded(hex("55 09 03 55 0e b8 f6 64 71 fc 5d a0")));
+    packets.push_back(padded(hex("55 09 03 e1 0d 9c 20 c1 6f 1f 91 eb")));
+  }
+  Event event = {1, 0, 0, false, {}};
+  memcpy(event.uid, hex(UIDS[0]).data(), UID_SIZE);
+  uint8_t packet[PACKET_SIZE];
+  encode_event(event, xbox, packet);
+  packets.push_back(Bytes(packet, packet + PACKET_SIZE));
+  return packets;
+}
+
+std::vector<Bytes> fuzz_seeds(const std::string & target)
+{
+  std::vector<Bytes> seeds;
+  if (target == "frame")
+  {
+    for (bool xbox : {false, true})
+      for (Bytes packet : packets(xbox))
+      {
+        packet.insert(packet.begin(), xbox);
+        seeds.push_back(packet);
+      }
+    seeds.push_back(Bytes(1 + PACKET_SIZE, 0));
+  }
+  else if (target == "toypad")
+  {
+    for (bool xbox : {false, true})
+    {
+      // Two tags on the pads; every packet; a third tag, one off.
+      Bytes seed = {(uint8_t) (xbox | 2 << 1)};
+      for (const Bytes & packet : packets(xbox))
+      {
+        seed.push_back(packet.size());
+        seed.insert(seed.end(), packet.begin(), packet.end());
+      }
+      seed.push_back(0xf0);
+      seed.push_back(3);
+      Bytes uid = hex(UIDS[2]);
+      seed.insert(seed.end(), uid.begin(), uid.end());
+      seed.push_back(0xf8);
+      seeds.push_back(seed);
+    }
+  }
+  else if (target == "pages")
+  {
+    // tagreaderwriter.py: Wyldstyle (ID 3), BMO (1173), Supergirl (46), 
+    // and an empty tag.
+    static const char * const pages[] = {
+      "01 39 ed 60  e4 be 30 7c  00 00 00 00  00 00 00 00",
+      "95 04 00 00  00 00 00 00  00 01 00 00  00 00 00 00",
+      "4b 63 b1 08  8f 63 8a 8d  00 00 00 00  00 00 00 00",
+      "00 00 00 00  00 00 00 00  00 00 00 00  00 00 00 00",
+    };
+    for (unsigned n = 0; n < 4; ++n)
+    {
+      Bytes seed = hex(UIDS[n % 3]);
+      Bytes page = hex(pages[n]);
+      seed.insert(seed.end(), page.begin(), page.end());
+      seeds.push_back(seed);
+    }
+  }
+  return seeds;
+}
@@ -0,0 +1,69 @@
+#include <algorithm>
+#include <vector>
+
+#include "fuzz.hpp"
+#include "toypad-emulator.hpp"
+
+using namespace toypad;
+
+const char * const FUZZ_TARGET = "toypad";
+
+// Everything the toypad sends must parse, as a reply or an event.
+static void check_outbox(ToypadEmulator & toypad)
+{
+  FUZZ_CHECK(toypad.outbox.size() <= 1 + ToypadEmulator::MAX_TAGS);
+  for (const ToypadEmulator::Packet & packet : toypad.outbox)
+  {
+    Frame frame;
+    FUZZ_CHECK(parse_frame(packet.data(), packet.size(), toypad.xbox, frame) == OK);
+    ReplyFrame reply;
+    Event event;
+    FUZZ_CHECK(parse_reply(frame, reply) == OK || parse_event(frame, event) == OK);
+  }
+  toypad.outbox.clear();
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t * data, size_t size)
+{
+  if (size < 1)
+    return 0;
+  ToypadEmulator toypad(data[0] & 1);
+  static const uint8_t uids[3][UID_SIZE] = {
+    {0x04, 0x13, 0xbb, 0x1a, 0x99, 0x40, 0x80},
+    {0x04, 0xd9, 0xc8, 0xda, 0xa2, 0x40, 0x80},
+    {0x04, 0x58, 0xe4, 0x52, 0x25, 0x20, 0x91},
+  };
+  static const uint32_t ids[3] = {3, 1173, 46};
+  for (unsigned n = 0; n < ((data[0] >> 1) & 3u) && n < 3; ++n)
+    toypad.place(1 + n, uids[n], ids[n]);
+  
+  size_t i = 1;
+  while (i < size)
+  {
+    uint8_t op = data[i++];
+    if (op < 0xf0)
+    {
+      // A packet of its own size, for the sanitizers.
+      size_t length = std::min<size_t>(op % (PACKET_SIZE + 1), size - i);
+      std::vector<uint8_t> packet(data + i, data + i + length);
+      i += length;
+      unsigned rejected = toypad.rejected;
+      Error error = toypad.receive(packet.data(), packet.size());
+      FUZZ_CHECK((error == OK) == (toypad.rejected == rejected));
+    }
+    else if (op < 0xf8)
+    {
+      if (size - i < 1 + UID_SIZE)
+        break;
+      uint8_t memory[TAG_MEMORY_SIZE];
+      encode_tag(data + i + 1, data[i + 1], memory);
+      int index = toypad.place(data[i] % 4, memory);
+      FUZZ_CHECK(index < (int) ToypadEmulator::MAX_TAGS);
+      i += 1 + UID_SIZE;
+    }
+    else
+      toypad.remove(op - 0xf8);
+    check_outbox(toypad);
+  }
+  return 0;
+}
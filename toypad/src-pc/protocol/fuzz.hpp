@@ -0,0 +1,48 @@
+#ifndef _FUZZ_HPP_
+#define _FUZZ_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+// The fuzz harnesses of the protocol code: every fuzz-<target>.cpp has 
+// the entry point of libFuzzer, LLVMFuzzerTestOneInput(), and checks 
+// what must hold for any input with FUZZ_CHECK(). Linked with -fsanitize= 
+// fuzzer it is a libFuzzer binary; otherwise fuzz-main.cpp gives it a 
+// main(): the persistent mode loop of AFL++ (with afl-clang-fast++), or 
+// a small mutating fuzzer of its own (see the Makefile).
+// 
+// The targets:
+// 
+//   frame   A flags byte (bit 0: Xbox 360), then a packet for the parsers 
+//           of toypad-frame.hpp. What parses is encoded again and must 
+//           come out the same.
+//   toypad  A flags byte (bit 0: Xbox 360; bits 1 and 2: the number of 
+//           tags on the pads), then operations for ToypadEmulator: a 
+//           byte below 0xf0 is a packet of that many bytes (modulo 33), 
+//           0xf0 to 0xf7 puts a tag (pad, UID) on a pad, 0xf8 to 0xff 
+//           takes tag 0 to 7 off. Every packet it sends must parse.
+//   pages   A UID (7 bytes) and pages 0x24 to 0x27 (16 bytes; the rest is 
+//           ignored) for decode_pages(). A character or vehicle it 
+//           decodes encodes to the same pages.
+// 
+// The seeds are the captures of the Python scripts (fuzz-seeds.cpp).
+
+extern const char * const FUZZ_TARGET;
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t * data, size_t size);
+
+std::vector<std::vector<uint8_t>> fuzz_seeds(const std::string & target);
+
+[[noreturn]] static inline void fuzz_failed(const char * what, const char * file, int line)
+{
+  fprintf(stderr, "%s:%d: FUZZ_CHECK(%s) failed\n", file, line, what);
+  abort();
+}
+
+#define FUZZ_CHECK(condition)	do { if (!(condition)) fuzz_failed(#condition, __FILE__, __LINE__); } while (0)
+
+#endif /* _FUZZ_HPP_ */
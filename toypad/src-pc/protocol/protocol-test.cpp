@@ -0,0 +1,167 @@
+// Checks the protocol code against what the Python scripts know: the 
+// passwords, TEA keys and pages of the tags of 
+// python/unittest_legodimensions.py (one by one and in batches), the 
+// seed and the challenge replies of command_0xB3_replayed.py (with the 
+// toypad emulator), and the frames of toypad-dump-endpoint-0x81.py.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../controller/test-check.hpp"
+#include "tag-batch.hpp"
+#include "tag-crypto.hpp"
+#include "tag-pages.hpp"
+#include "toypad-emulator.hpp"
+#include "toypad-frame.hpp"
+
+using namespace toypad;
+
+struct KnownTag
+{
+  const char * name;
+  uint8_t uid[UID_SIZE];
+  uint32_t id;
+  uint8_t pages[8];	// 0x24, 0x25.
+  uint32_t password;
+  uint32_t key[4];
+};
+
+static const KnownTag TAGS[] = {
+  {"Wyldstyle", {0x04, 0x13, 0xbb, 0x1a, 0x99, 0x40, 0x80}, 3,
+   {0x01, 0x39, 0xed, 0x60, 0xe4, 0xbe, 0x30, 0x7c}, 0x2136ef4b,
+   {0x33ef8223, 0x3a56082f, 0x78f06c7c, 0x246c3710}},
+  {"BMO", {0x04, 0xd9, 0xc8, 0xda, 0xa2, 0x40, 0x80}, 1173,
+   {0x95, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, 0xd0019151,
+   {0x663af2fc, 0x640f96cb, 0xd3089a58, 0x4d817d6d}},
+  {"Supergirl", {0x04, 0x58, 0xe4, 0x52, 0x25, 0x20, 0x91}, 46,
+   {0x4b, 0x63, 0xb1, 0x08, 0x8f, 0x63, 0x8a, 0x8d}, 0x9b208d85,
+   {0xa1f10040, 0x546f1929, 0xa9e65ed3, 0x043badce}},
+};
+
+// The payload of the only reply in the outbox.
+static bool only_reply(ToypadEmulator & toypad, const uint8_t * payload, size_t size)
+{
+  Frame frame;
+  ReplyFrame reply;
+  bool ok = toypad.outbox.size() == 1
+         && parse_frame(toypad.outbox[0].data(), PACKET_SIZE, toypad.xbox, frame) == OK
+         && parse_reply(frame, reply) == OK
+         && reply.payload_size == size && (!size || !memcmp(reply.payload, payload, size));
+  toypad.outbox.clear();
+  return ok;
+}
+
+int main()
+{
+  bool passwords = true, keys = true, pages = true;
+  for (const KnownTag & tag : TAGS)
+  {
+    passwords = passwords && tag_password(tag.uid) == tag.password;
+    uint32_t key[4];
+    tag_tea_key(tag.uid, key);
+    keys = keys && !memcmp(key, tag.key, sizeof key);
+    uint8_t encoded[ID_PAGES_SIZE];
+    encode_pages(tag.uid, tag.id, encoded);
+    TagContents contents = decode_pages(tag.uid, encoded);
+    pages = pages && !memcmp(encoded, tag.pages, 8) && contents.id == tag.id && contents.consistent
+         && contents.kind == (tag.id < 1000 ? TagContents::CHARACTER : TagContents::VEHICLE);
+  }
+  check(passwords, "passwords");
+  check(keys, "TEA keys");
+  check(pages, "pages 0x24 to 0x26");
+  
+  // Supergirl's pages on Wyldstyle's UID.
+  uint8_t moved[ID_PAGES_SIZE] = {};
+  memcpy(moved, TAGS[2].pages, 8);
+  check(!decode_pages(TAGS[0].uid, moved).consistent, "pages of another UID");
+  moved[10] = 1;
+  check(decode_pages(TAGS[0].uid, moved).kind == TagContents::UNKNOWN, "unknown type");
+  
+  uint8_t memory[TAG_MEMORY_SIZE];
+  encode_tag(TAGS[0].uid, 3, memory);
+  check(memory[3] == (0x88 ^ 0x04 ^ 0x13 ^ 0xbb) && get_le32(memory + 4 * PASSWORD_PAGE) == 0x2136ef4b,
+        "tag memory");
+  
+  // tag-batch.cpp, on the known tags and on more random UIDs than a 
+  // multiple of BATCH_WIDTH, against the functions above.
+  uint8_t uids[3 * BATCH_WIDTH + 1][UID_SIZE];
+  uint32_t ids[3 * BATCH_WIDTH + 1];
+  uint32_t random = 12345;
+  for (unsigned n = 0; n < 3 * BATCH_WIDTH + 1; ++n)
+  {
+    for (unsigned i = 0; i < UID_SIZE; ++i)
+      uids[n][i] = (random = random * 1103515245 + 12345) >> 16;
+    ids[n] = ((random = random * 1103515245 + 12345) >> 16) % 1500;
+  }
+  for (unsigned n = 0; n < 3; ++n)
+  {
+    memcpy(uids[n], TAGS[n].uid, UID_SIZE);
+    ids[n] = TAGS[n].id;
+  }
+  TagKeys batch_keys[3 * BATCH_WIDTH + 1];
+  uint8_t memories[3 * BATCH_WIDTH + 1][TAG_MEMORY_SIZE];
+  bool same_keys = true, same_memories = true;
+  for (unsigned count : {1u, 3u, 3u * BATCH_WIDTH + 1})
+  {
+    tag_keys(uids, count, batch_keys);
+    encode_tags(uids, ids, batch_keys, count, memories);
+    for (unsigned n = 0; n < count; ++n)
+    {
+      uint32_t key[4];
+      tag_tea_key(uids[n], key);
+      same_keys = same_keys && batch_keys[n].password == tag_password(uids[n])
+               && !memcmp(batch_keys[n].key, key, sizeof key);
+      uint8_t one[TAG_MEMORY_SIZE];
+      encode_tag(uids[n], ids[n], one);
+      same_memories = same_memories && !memcmp(memories[n], one, TAG_MEMORY_SIZE);
+    }
+  }
+  check(same_keys && batch_keys[0].password == TAGS[0].password, "batch: keys");
+  check(same_memories && !memcmp(memories[2] + 4 * FIRST_ID_PAGE, TAGS[2].pages, 8), "batch: tags");
+  
+  // command_0xB3_replayed.py: the challenge as captured (length 2), its 
+  // reply with seed 0, the seed of de ad be ef ca fe b0 0b and the reply 
+  // with that one.
+  ToypadEmulator toypad;
+  uint8_t challenge[PACKET_SIZE] = {0x55, 0x02, 0xb3, 0x03, 0x0d};
+  static const uint8_t reply0[8] = {0x55, 0x0e, 0xb8, 0xf6, 0x64, 0x71, 0xfc, 0x5d};
+  check(toypad.receive(challenge, sizeof challenge) == OK && only_reply(toypad, reply0, 8)
+     && toypad.outbox.empty(), "challenge, seed 0");
+  uint8_t packet[PACKET_SIZE];
+  static const uint8_t seed[8] = {0xde, 0xad, 0xbe, 0xef, 0xca, 0xfe, 0xb0, 0x0b};
+  encode_command(SEED, 0x02, seed, 8, false, packet);
+  toypad.receive(packet, sizeof packet);
+  toypad.outbox.clear();
+  static const uint32_t seeded[4] = {0x291dea0f, 0xb284da7e, 0x7bb5b229, 0xc9ab3935};
+  check(!memcmp(toypad.seed, seeded, sizeof seeded), "seed");
+  static const uint8_t reply1[8] = {0xe1, 0x0d, 0x9c, 0x20, 0xc1, 0x6f, 0x1f, 0x91};
+  toypad.receive(challenge, sizeof challenge);
+  check(only_reply(toypad, reply1, 8), "challenge, seeded");
+  
+  // toypad-dump-endpoint-0x81.py: start, a tag, read page 0x24.
+  ToypadEmulator xbox(true);
+  encode_command(START, 0x01, (const uint8_t *) "(c) LEGO 2014", 13, true, packet);
+  check(packet[0] == 0x0b && packet[1] == 0x16 && packet[2] == 0x55 && packet[3] == 0x0f,
+        "start command");
+  xbox.receive(packet, sizeof packet);
+  check(only_reply(xbox, nullptr, 0), "start: reply");
+  int index = xbox.place(2, TAGS[0].uid, 3);
+  Frame frame;
+  Event event;
+  check(xbox.outbox.size() == 1 && parse_frame(xbox.outbox[0].data(), PACKET_SIZE, true, frame) == OK
+     && parse_event(frame, event) == OK && event.pad == 2 && event.index == index && !event.removed
+     && !memcmp(event.uid, TAGS[0].uid, UID_SIZE), "tag event");
+  xbox.outbox.clear();
+  uint8_t read[2] = {(uint8_t) index, FIRST_ID_PAGE};
+  encode_command(READ_PAGE, 0x77, read, 2, true, packet);
+  xbox.receive(packet, sizeof packet);
+  uint8_t expected[17] = {0};
+  memcpy(expected + 1, memory + 4 * FIRST_ID_PAGE, 16);
+  check(only_reply(xbox, expected, 17), "read page 0x24");
+  packet[3] = 0x0c;
+  check(xbox.receive(packet, sizeof packet) == BAD_CHECKSUM && xbox.rejected == 1, "bad checksum");
+  check(xbox.receive(packet, 3) == BAD_LENGTH, "short packet");
+  
+  printf("%u failures\n", failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,188 @@
+#include <string.h>
+#include <vector>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "tag-batch.hpp"
+
+#define TEA_DELTA	0x9e3779b9
+#define TEA_ROUNDS	32
+
+#ifdef __SSE2__
+static inline __m128i rotate_left(__m128i x, int n)
+{
+  return _mm_or_si128(_mm_slli_epi32(x, n), _mm_srli_epi32(x, 32 - n));
+}
+
+// One round of derive() of tag-crypto.cpp.
+static inline __m128i derive_step(__m128i password, __m128i word)
+{
+  __m128i sum = _mm_add_epi32(word, rotate_left(password, 7));
+  sum = _mm_add_epi32(sum, rotate_left(password, 22));
+  return _mm_sub_epi32(sum, password);
+}
+
+// Word n of every lane: words[n][lane].
+static inline __m128i load(const uint32_t (* words)[BATCH_WIDTH], unsigned n)
+{
+  return _mm_loadu_si128((const __m128i *) words[n]);
+}
+
+// BATCH_WIDTH UIDs.
+static void tag_keys_sse2(const uint8_t (* uids)[UID_SIZE], TagKeys * keys)
+{
+  // The password: the UID, the copyright, 0xaa 0xaa. The key: the UID 
+  // and the static randomness; round r ends with 0xaa in byte 4 r - 1 
+  // (the tail) instead of the static randomness.
+  uint32_t password_words[8][BATCH_WIDTH], key_words[6][BATCH_WIDTH], tails[6][BATCH_WIDTH];
+  for (unsigned lane = 0; lane < BATCH_WIDTH; ++lane)
+  {
+    uint8_t base[32];
+    memcpy(base, uids[lane], UID_SIZE);
+    memcpy(base + UID_SIZE, "(c) Copyright LEGO 2014", 23);
+    base[30] = base[31] = 0xaa;
+    for (unsigned n = 0; n < 8; ++n)
+      password_words[n][lane] = get_le32(base + 4 * n);
+    memcpy(base + UID_SIZE, STATIC_RANDOMNESS, sizeof STATIC_RANDOMNESS);
+    for (unsigned n = 0; n < 6; ++n)
+    {
+      key_words[n][lane] = get_le32(base + 4 * n);
+      tails[n][lane] = (key_words[n][lane] & 0x00ffffff) | 0xaa000000;
+    }
+  }
+  
+  __m128i password = _mm_setzero_si128();
+  for (unsigned n = 0; n < 8; ++n)
+    password = derive_step(password, load(password_words, n));
+  
+  // Rounds 3 to 6 share all but their last word: the key word of round 
+  // r is the tail after the first r - 1 words.
+  uint32_t out[5][BATCH_WIDTH];
+  _mm_storeu_si128((__m128i *) out[0], password);
+  __m128i scrambled = _mm_setzero_si128();
+  for (unsigned n = 0; n < 6; ++n)
+  {
+    if (n >= 2)
+      _mm_storeu_si128((__m128i *) out[n - 1], derive_step(scrambled, load(tails, n)));
+    scrambled = derive_step(scrambled, load(key_words, n));
+  }
+  for (unsigned lane = 0; lane < BATCH_WIDTH; ++lane)
+  {
+    keys[lane].password = out[0][lane];
+    for (unsigned n = 0; n < 4; ++n)
+      keys[lane].key[n] = out[1 + n][lane];
+  }
+}
+
+static void tea_encrypt_sse2(uint32_t (* blocks)[2], const TagKeys * keys)
+{
+  uint32_t v[2][BATCH_WIDTH], k[4][BATCH_WIDTH];
+  for (unsigned lane = 0; lane < BATCH_WIDTH; ++lane)
+  {
+    v[0][lane] = blocks[lane][0];
+    v[1][lane] = blocks[lane][1];
+    for (unsigned n = 0; n < 4; ++n)
+      k[n][lane] = keys[lane].key[n];
+  }
+  __m128i v0 = load(v, 0), v1 = load(v, 1);
+  __m128i k0 = load(k, 0), k1 = load(k, 1), k2 = load(k, 2), k3 = load(k, 3);
+  __m128i sum = _mm_setzero_si128();
+  const __m128i delta = _mm_set1_epi32((int) TEA_DELTA);
+  for (unsigned n = 0; n < TEA_ROUNDS; ++n)
+  {
+    sum = _mm_add_epi32(sum, delta);
+    v0 = _mm_add_epi32(v0, _mm_xor_si128(_mm_xor_si128(
+           _mm_add_epi32(_mm_slli_epi32(v1, 4), k0), _mm_add_epi32(v1, sum)),
+           _mm_add_epi32(_mm_srli_epi32(v1, 5), k1)));
+    v1 = _mm_add_epi32(v1, _mm_xor_si128(_mm_xor_si128(
+           _mm_add_epi32(_mm_slli_epi32(v0, 4), k2), _mm_add_epi32(v0, sum)),
+           _mm_add_epi32(_mm_srli_epi32(v0, 5), k3)));
+  }
+  _mm_storeu_si128((__m128i *) v[0], v0);
+  _mm_storeu_si128((__m128i *) v[1], v1);
+  for (unsigned lane = 0; lane < BATCH_WIDTH; ++lane)
+  {
+    blocks[lane][0] = v[0][lane];
+    blocks[lane][1] = v[1][lane];
+  }
+}
+#endif
+
+void tag_keys(const uint8_t (* uids)[UID_SIZE], size_t count, TagKeys * keys)
+{
+  size_t n = 0;
+#ifdef __SSE2__
+  for (; n + BATCH_WIDTH <= count; n += BATCH_WIDTH)
+    tag_keys_sse2(uids + n, keys + n);
+  if (n < count)
+  {
+    uint8_t padded[BATCH_WIDTH][UID_SIZE] = {};
+    TagKeys out[BATCH_WIDTH];
+    memcpy(padded, uids + n, (count - n) * UID_SIZE);
+    tag_keys_sse2(padded, out);
+    memcpy(keys + n, out, (count - n) * sizeof out[0]);
+  }
+#else
+  for (; n < count; ++n)
+  {
+    keys[n].password = tag_password(uids[n]);
+    tag_tea_key(uids[n], keys[n].key);
+  }
+#endif
+}
+
+void tea_encrypt_batch(uint32_t (* blocks)[2], const TagKeys * keys, size_t count)
+{
+  size_t n = 0;
+#ifdef __SSE2__
+  for (; n + BATCH_WIDTH <= count; n += BATCH_WIDTH)
+    tea_encrypt_sse2(blocks + n, keys + n);
+  if (n < count)
+  {
+    uint32_t padded[BATCH_WIDTH][2] = {};
+    TagKeys padded_keys[BATCH_WIDTH] = {};
+    memcpy(padded, blocks + n, (count - n) * sizeof padded[0]);
+    memcpy(padded_keys, keys + n, (count - n) * sizeof padded_keys[0]);
+    tea_encrypt_sse2(padded, padded_keys);
+    memcpy(blocks + n, padded, (count - n) * sizeof padded[0]);
+  }
+#else
+  for (; n < count; ++n)
+    tea_encrypt(blocks[n], keys[n].key);
+#endif
+}
+
+void encode_tags(const uint8_t (* uids)[UID_SIZE], const uint32_t * ids, const TagKeys * keys,
+                 size_t count, uint8_t (* memories)[TAG_MEMORY_SIZE])
+{
+  // The characters together, for tea_encrypt_batch().
+  std::vector<size_t> characters;
+  std::vector<TagKeys> character_keys;
+  std::vector<uint32_t> blocks;
+  for (size_t n = 0; n < count; ++n)
+    if (ids[n] < FIRST_VEHICLE_ID)
+    {
+      characters.push_back(n);
+      character_keys.push_back(keys[n]);
+      blocks.push_back(ids[n]);
+      blocks.push_back(ids[n]);
+    }
+  tea_encrypt_batch((uint32_t (*)[2]) blocks.data(), character_keys.data(), characters.size());
+  
+  size_t character = 0;
+  for (size_t n = 0; n < count; ++n)
+  {
+    uint8_t pages[ID_PAGES_SIZE];
+    if (character < characters.size() && characters[character] == n)
+    {
+      memset(pages, 0, sizeof pages);
+      put_le32(pages, blocks[2 * character]);
+      put_le32(pages + 4, blocks[2 * character + 1]);
+      ++character;
+    }
+    else
+      encode_pages(uids[n], ids[n], pages);
+    fill_tag(uids[n], pages, keys[n].password, memories[n]);
+  }
+}
@@ -0,0 +1,36 @@
+#ifndef _TAG_BATCH_HPP_
+#define _TAG_BATCH_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tag-crypto.hpp"
+#include "tag-pages.hpp"
+
+// The arithmetic of tag-crypto.cpp on many tags at once: BATCH_WIDTH 
+// UIDs side by side in the 32 bit lanes of an SSE2 register (without 
+// SSE2: one after another). The derivation of the password and the TEA 
+// key, and TEA itself, are adds, xors and shifts only, the same for 
+// every UID.
+// 
+// Any count will do; the last BATCH_WIDTH - 1 or fewer UIDs are padded.
+
+#define BATCH_WIDTH	4
+
+// What a tag needs besides its ID: tag_password() and tag_tea_key().
+struct TagKeys
+{
+  uint32_t password;
+  uint32_t key[4];
+};
+
+void tag_keys(const uint8_t (* uids)[UID_SIZE], size_t count, TagKeys * keys);
+
+// tea_encrypt() of blocks[n] with keys[n].key.
+void tea_encrypt_batch(uint32_t (* blocks)[2], const TagKeys * keys, size_t count);
+
+// encode_tag() of every UID and ID, with their keys.
+void encode_tags(const uint8_t (* uids)[UID_SIZE], const uint32_t * ids, const TagKeys * keys,
+                 size_t count, uint8_t (* memories)[TAG_MEMORY_SIZE]);
+
+#endif /* _TAG_BATCH_HPP_ */
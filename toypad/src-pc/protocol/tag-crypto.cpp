@@ -0,0 +1,117 @@
+#include <string.h>
+
+#include "tag-crypto.hpp"
+
+#define TEA_DELTA	0x9e3779b9
+#define TEA_ROUNDS	32
+
+const uint8_t STATIC_RANDOMNESS[16] = {
+  0xb7, 0xd5, 0xd7, 0xe6, 0xe7, 0xba, 0x3c, 0xa8,
+  0xd8, 0x75, 0x47, 0x68, 0xcf, 0x23, 0xe9, 0xfe,
+};
+
+// 55 fe f6 30  62 bf 0b c1  c9 b3 7c 34  97 3e 29 fb
+const uint32_t TOYPAD_TEA_KEY[4] = {0x30f6fe55, 0xc10bbf62, 0x347cb3c9, 0xfb293e97};
+
+static inline uint32_t rotate_left(uint32_t x, unsigned n)
+{
+  return x << n | x >> (32 - n);
+}
+
+// _shuffle_bits_and_derive_4byte_password() of legodimensions.py, on 
+// 4 * rounds bytes.
+static uint32_t derive(const uint8_t * base, unsigned rounds)
+{
+  uint32_t password = 0;
+  for (unsigned n = 0; n < rounds; ++n)
+    password = get_le32(base + 4 * n) + rotate_left(password, 7) + rotate_left(password, 22) - password;
+  return password;
+}
+
+uint32_t tag_password(const uint8_t uid[UID_SIZE])
+{
+  // The UID, the copyright (without its terminating 0), 0xaa 0xaa.
+  uint8_t base[32];
+  memcpy(base, uid, UID_SIZE);
+  memcpy(base + UID_SIZE, "(c) Copyright LEGO 2014", 23);
+  base[30] = base[31] = 0xaa;
+  return derive(base, 8);
+}
+
+uint32_t tag_scramble(const uint8_t uid[UID_SIZE], unsigned rounds)
+{
+  // The UID, 4 * (rounds - 2) bytes of the static randomness, 0xaa.
+  uint8_t base[4 * 6];
+  memcpy(base, uid, UID_SIZE);
+  memcpy(base + UID_SIZE, STATIC_RANDOMNESS, 4 * (rounds - 2));
+  base[4 * rounds - 1] = 0xaa;
+  return derive(base, rounds);
+}
+
+void tag_tea_key(const uint8_t uid[UID_SIZE], uint32_t key[4])
+{
+  for (unsigned n = 0; n < 4; ++n)
+    key[n] = tag_scramble(uid, 3 + n);
+}
+
+void tea_encrypt(uint32_t v[2], const uint32_t key[4])
+{
+  uint32_t v0 = v[0], v1 = v[1], sum = 0;
+  for (unsigned n = 0; n < TEA_ROUNDS; ++n)
+  {
+    sum += TEA_DELTA;
+    v0 += ((v1 << 4) + key[0]) ^ (v1 + sum) ^ ((v1 >> 5) + key[1]);
+    v1 += ((v0 << 4) + key[2]) ^ (v0 + sum) ^ ((v0 >> 5) + key[3]);
+  }
+  v[0] = v0;
+  v[1] = v1;
+}
+
+void tea_decrypt(uint32_t v[2], const uint32_t key[4])
+{
+  uint32_t v0 = v[0], v1 = v[1], sum = TEA_DELTA * TEA_ROUNDS;
+  for (unsigned n = 0; n < TEA_ROUNDS; ++n)
+  {
+    v1 -= ((v0 << 4) + key[2]) ^ (v0 + sum) ^ ((v0 >> 5) + key[3]);
+    v0 -= ((v1 << 4) + key[0]) ^ (v1 + sum) ^ ((v1 >> 5) + key[1]);
+    sum -= TEA_DELTA;
+  }
+  v[0] = v0;
+  v[1] = v1;
+}
+
+void encrypt_character(const uint8_t uid[UID_SIZE], uint32_t id, uint8_t pages[8])
+{
+  uint32_t key[4];
+  tag_tea_key(uid, key);
+  uint32_t v[2] = {id, id};
+  tea_encrypt(v, key);
+  put_le32(pages, v[0]);
+  put_le32(pages + 4, v[1]);
+}
+
+void decrypt_character(const uint8_t uid[UID_SIZE], const uint8_t pages[8], uint32_t ids[2])
+{
+  uint32_t key[4];
+  tag_tea_key(uid, key);
+  ids[0] = get_le32(pages);
+  ids[1] = get_le32(pages + 4);
+  tea_decrypt(ids, key);
+}
+
+void toypad_shuffle(uint32_t words[4])
+{
+  uint32_t temp = words[0] - rotate_left(words[1], 21);
+  words[0] = rotate_left(words[2], 19) ^ words[1];
+  words[1] = rotate_left(words[3], 6) + words[2];
+  words[2] = words[3] + temp;
+  words[3] = words[0] + temp;
+}
+
+void toypad_scramble(uint32_t value, uint32_t words[4])
+{
+  words[0] = 0xf1ea5eed;
+  words[1] = words[2] = words[3] = value;
+  for (unsigned n = 0; n < 42; ++n)
+    toypad_shuffle(words);
+}
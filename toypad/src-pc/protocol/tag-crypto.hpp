@@ -0,0 +1,62 @@
+#ifndef _TAG_CRYPTO_HPP_
+#define _TAG_CRYPTO_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The arithmetic of LEGO Dimensions, as python/legodimensions.py, 
+// python/tea.py and python/command_0xB3_replayed.py have it, on 32 bit 
+// words: a byte string of the Python code is a sequence of little 
+// endian words here.
+// 
+//   tag_password()   The NTAG213 password of a tag (PWD, page 0x2b), 
+//                    from its 7 byte UID.
+//   tag_scramble()   The shuffle of the UID and the static randomness 
+//                    of the firmware; rounds 3 to 6 are the TEA key of 
+//                    the tag (tag_tea_key()).
+//   tea_encrypt()    TEA with 32 rounds (c/tea_tester.c): a character 
+//   tea_decrypt()    ID twice, encrypted with the TEA key of the tag, 
+//                    is in pages 0x24 and 0x25.
+//   toypad_shuffle() The pseudo random generator of the toypad 
+//   toypad_scramble() firmware, and its seed from a 32 bit value 
+//                    (command 0xb1).
+
+#define UID_SIZE	7
+
+// In the firmware (legodimensions.py).
+extern const uint8_t STATIC_RANDOMNESS[16];
+// For the challenges of command 0xb3 (command_0xB3_replayed.py).
+extern const uint32_t TOYPAD_TEA_KEY[4];
+
+uint32_t tag_password(const uint8_t uid[UID_SIZE]);
+// rounds: 3 to 6.
+uint32_t tag_scramble(const uint8_t uid[UID_SIZE], unsigned rounds);
+void tag_tea_key(const uint8_t uid[UID_SIZE], uint32_t key[4]);
+
+void tea_encrypt(uint32_t v[2], const uint32_t key[4]);
+void tea_decrypt(uint32_t v[2], const uint32_t key[4]);
+
+// Pages 0x24 and 0x25 of a character: its ID twice, encrypted.
+void encrypt_character(const uint8_t uid[UID_SIZE], uint32_t id, uint8_t pages[8]);
+// The two IDs of pages 0x24 and 0x25. The same for a genuine character.
+void decrypt_character(const uint8_t uid[UID_SIZE], const uint8_t pages[8], uint32_t ids[2]);
+
+void toypad_shuffle(uint32_t words[4]);
+// 0xf1ea5eed and value three times, shuffled 42 times.
+void toypad_scramble(uint32_t value, uint32_t words[4]);
+
+// Little endian.
+static inline uint32_t get_le32(const uint8_t * bytes)
+{
+  return bytes[0] | bytes[1] << 8 | bytes[2] << 16 | (uint32_t) bytes[3] << 24;
+}
+
+static inline void put_le32(uint8_t * bytes, uint32_t value)
+{
+  bytes[0] = value;
+  bytes[1] = value >> 8;
+  bytes[2] = value >> 16;
+  bytes[3] = value >> 24;
+}
+
+#endif /* _TAG_CRYPTO_HPP_ */
@@ -0,0 +1,75 @@
+#include <string.h>
+
+#include "tag-pages.hpp"
+
+static const uint8_t VEHICLE_TYPE[4] = {0x00, 0x01, 0x00, 0x00};
+
+const char * kind_name(TagContents::Kind kind)
+{
+  static const char * const names[] = {"empty", "character", "vehicle", "unknown"};
+  return names[kind];
+}
+
+TagContents decode_pages(const uint8_t uid[UID_SIZE], const uint8_t pages[ID_PAGES_SIZE])
+{
+  TagContents contents;
+  static const uint8_t zeros[ID_PAGES_SIZE] = {};
+  const uint8_t * type = pages + 8;
+  if (!memcmp(pages, zeros, ID_PAGES_SIZE))
+    contents.kind = TagContents::EMPTY;
+  else if (!memcmp(type, VEHICLE_TYPE, 4))
+  {
+    contents.kind = TagContents::VEHICLE;
+    contents.id = pages[0] | pages[1] << 8;
+  }
+  else if (!memcmp(type, zeros, 4))
+  {
+    contents.kind = TagContents::CHARACTER;
+    uint32_t ids[2];
+    decrypt_character(uid, pages, ids);
+    contents.id = ids[0];
+    contents.consistent = ids[0] == ids[1];
+  }
+  else
+    contents.kind = TagContents::UNKNOWN;
+  return contents;
+}
+
+void encode_pages(const uint8_t uid[UID_SIZE], uint32_t id, uint8_t pages[ID_PAGES_SIZE])
+{
+  memset(pages, 0, ID_PAGES_SIZE);
+  if (id < FIRST_VEHICLE_ID)
+    encrypt_character(uid, id, pages);
+  else
+  {
+    put_le32(pages, id);
+    memcpy(pages + 8, VEHICLE_TYPE, 4);
+  }
+}
+
+void encode_tag(const uint8_t uid[UID_SIZE], uint32_t id, uint8_t memory[TAG_MEMORY_SIZE])
+{
+  uint8_t pages[ID_PAGES_SIZE];
+  encode_pages(uid, id, pages);
+  fill_tag(uid, pages, tag_password(uid), memory);
+}
+
+void fill_tag(const uint8_t uid[UID_SIZE], const uint8_t pages[ID_PAGES_SIZE], uint32_t password,
+              uint8_t memory[TAG_MEMORY_SIZE])
+{
+  memset(memory, 0, TAG_MEMORY_SIZE);
+  // The cascade tag 0x88 is part of BCC0.
+  memcpy(memory, uid, 3);
+  memory[3] = 0x88 ^ uid[0] ^ uid[1] ^ uid[2];
+  memcpy(memory + 4, uid + 3, 4);
+  memory[8] = uid[3] ^ uid[4] ^ uid[5] ^ uid[6];
+  memory[9] = 0x48;
+  static const uint8_t capabilities[4] = {0xe1, 0x10, 0x12, 0x00};
+  memcpy(memory + 4 * 3, capabilities, 4);
+  memcpy(memory + 4 * FIRST_ID_PAGE, pages, ID_PAGES_SIZE);
+  static const uint8_t config[8] = {0x04, 0x00, 0x00, 0xff, 0x00, 0x05, 0x00, 0x00};
+  memcpy(memory + 4 * 0x29, config, sizeof config);
+  put_le32(memory + 4 * PASSWORD_PAGE, password);
+  memory[4 * 0x2c] = 0xaa;
+  memory[4 * 0x2c + 1] = 0x55;
+}
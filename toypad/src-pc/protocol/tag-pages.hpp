@@ -0,0 +1,61 @@
+#ifndef _TAG_PAGES_HPP_
+#define _TAG_PAGES_HPP_
+
+#include <stdint.h>
+
+#include "tag-crypto.hpp"
+
+// What pages 0x24 to 0x27 of an NTAG213 say, as python/tagreaderwriter.py 
+// reads them:
+// 
+//   0x24, 0x25  character: the ID twice, TEA encrypted with the key of 
+//               the UID; vehicle or token: the ID (16 bits), zeros 
+//   0x26        0 for a character, 00 01 00 00 for a vehicle or token 
+//   0x27        (not used)
+// 
+// All zeros is an empty tag.
+
+#define FIRST_ID_PAGE	0x24
+#define ID_PAGES_SIZE	16	// 0x24 to 0x27.
+#define TAG_PAGES	45	// Of an NTAG213.
+#define TAG_MEMORY_SIZE	(4 * TAG_PAGES)
+#define PASSWORD_PAGE	0x2b
+#define FIRST_VEHICLE_ID	1000	// Below: a character.
+
+struct TagContents
+{
+  enum Kind
+  {
+    EMPTY,
+    CHARACTER,
+    VEHICLE,		// Or token.
+    UNKNOWN,		// Page 0x26 is neither.
+  };
+  
+  Kind kind = EMPTY;
+  uint32_t id = 0;
+  // A character: both IDs of the pages are the same. A tag that was 
+  // written for another UID decrypts to two different ones.
+  bool consistent = true;
+};
+
+const char * kind_name(TagContents::Kind kind);
+
+TagContents decode_pages(const uint8_t uid[UID_SIZE], const uint8_t pages[ID_PAGES_SIZE]);
+
+// Pages 0x24 to 0x27 of a character or vehicle (ID below 1000: a 
+// character, see tagreaderwriter.py).
+void encode_pages(const uint8_t uid[UID_SIZE], uint32_t id, uint8_t pages[ID_PAGES_SIZE]);
+
+// The whole memory of an NTAG213 written as tagreaderwriter.py writes 
+// one: the UID and its check bytes (pages 0 to 2), the capability 
+// container (page 3), pages 0x24 to 0x27, the configuration as it comes 
+// from the factory (0x29, 0x2a), the password (0x2b) and its 
+// acknowledge 0xaa 0x55 (0x2c).
+void encode_tag(const uint8_t uid[UID_SIZE], uint32_t id, uint8_t memory[TAG_MEMORY_SIZE]);
+// The same, with pages 0x24 to 0x27 and the password already worked out 
+// (see tag-batch.hpp).
+void fill_tag(const uint8_t uid[UID_SIZE], const uint8_t pages[ID_PAGES_SIZE], uint32_t password,
+              uint8_t memory[TAG_MEMORY_SIZE]);
+
+#endif /* _TAG_PAGES_HPP_ */
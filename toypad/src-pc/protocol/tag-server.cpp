@@ -0,0 +1,99 @@
+// Serves the pages of tags (see tag-service.hpp) on a Unix socket until 
+// SIGINT or SIGTERM, then prints the latencies and batches it had.
+// 
+// Usage: tag-server [options]
+// 
+//   --socket <path>     (/tmp/tag-service.socket)
+//   --cache <n>         UIDs to keep the keys of (4096, 0: none)
+//   --max-batch <n>     tags per batch (64)
+//   --linger-us <n>     wait for more requests to fill a batch (0)
+//   --stats             ask the server at --socket for its metrics (in 
+//                       the text format of Prometheus) instead
+
+#include <chrono>
+#include <getopt.h>
+#include <signal.h>
+#include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+
+#include "tag-service.hpp"
+
+static volatile sig_atomic_t stop = 0;
+
+static void on_signal(int)
+{
+  stop = 1;
+}
+
+static void usage(const char * program)
+{
+  fprintf(stderr,
+    "Usage: %s [--socket <path>] [--cache <n>] [--max-batch <n>] [--linger-us <n>]\n"
+    "       %s [--socket <path>] --stats\n", program, program);
+  exit(2);
+}
+
+int main(int argc, char ** argv)
+{
+  std::string path = "/tmp/tag-service.socket";
+  size_t cache_size = 4096;
+  size_t max_batch = 64;
+  unsigned linger_us = 0;
+  bool stats = false;
+  
+  static const option options[] = {
+    {"socket",    required_argument, nullptr, 's'},
+    {"cache",     required_argument, nullptr, 'c'},
+    {"max-batch", required_argument, nullptr, 'b'},
+    {"linger-us", required_argument, nullptr, 'l'},
+    {"stats",     no_argument,       nullptr, 'S'},
+    {nullptr,     0,                 nullptr, 0},
+  };
+  int option;
+  while ((option = getopt_long(argc, argv, "", options, nullptr)) != -1)
+  {
+    switch (option)
+    {
+      case 's': path = optarg; break;
+      case 'c': cache_size = strtoul(optarg, nullptr, 0); break;
+      case 'b': max_batch = strtoul(optarg, nullptr, 0); break;
+      case 'l': linger_us = strtoul(optarg, nullptr, 0); break;
+      case 'S': stats = true; break;
+      default: usage(argv[0]);
+    }
+  }
+  if (optind < argc)
+    usage(argv[0]);
+  
+  try
+  {
+    if (stats)
+    {
+      TagClient client(path);
+      printf("%s", client.stats().c_str());
+      return 0;
+    }
+    TagService service(cache_size, max_batch, std::chrono::microseconds(linger_us));
+    {
+      TagServer server(service, path);
+      printf("serving on %s: cache %zu, batches of up to %zu tags, linger %u us\n",
+             path.c_str(), cache_size, max_batch, linger_us);
+      fflush(stdout);
+      
+      signal(SIGINT, on_signal);
+      signal(SIGTERM, on_signal);
+      while (!stop)
+        pause();
+    }
+    service.print_summary(stdout);
+  }
+  catch (const std::exception & e)
+  {
+    fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,186 @@
+// Checks the tag service (tag-service.cpp) over a Unix socket: the pages 
+// of the tags of python/unittest_legodimensions.py, batches against 
+// encode_tag(), clients at the same time, the cache, a bad request and 
+// the metrics; and prints the round trip of a request for one tag.
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "../controller/test-check.hpp"
+#include "tag-service.hpp"
+
+#define SOCKET_PATH	"/tmp/tag-service-test.socket"
+#define CLIENTS		8
+#define CLIENT_REQUESTS	200
+
+static uint32_t random_state = 12345;
+
+static uint32_t next_random()
+{
+  random_state = random_state * 1103515245 + 12345;
+  return random_state >> 16;
+}
+
+static void random_tags(size_t count, std::vector<uint8_t> & uids, std::vector<uint32_t> & ids)
+{
+  uids.resize(count * UID_SIZE);
+  ids.resize(count);
+  for (size_t n = 0; n < count; ++n)
+  {
+    for (unsigned i = 0; i < UID_SIZE; ++i)
+      uids[n * UID_SIZE + i] = next_random();
+    ids[n] = next_random() % 1500;
+  }
+}
+
+// encode_tag() of every tag, as the reply of TAGS.
+static bool same_tags(const std::vector<uint8_t> & uids, const std::vector<uint32_t> & ids,
+                      const std::vector<uint8_t> & reply)
+{
+  if (reply.size() != ids.size() * TAG_MEMORY_SIZE)
+    return false;
+  for (size_t n = 0; n < ids.size(); ++n)
+  {
+    uint8_t memory[TAG_MEMORY_SIZE];
+    encode_tag(&uids[n * UID_SIZE], ids[n], memory);
+    if (memcmp(memory, &reply[n * TAG_MEMORY_SIZE], TAG_MEMORY_SIZE))
+      return false;
+  }
+  return true;
+}
+
+static const uint8_t (* as_uids(const std::vector<uint8_t> & uids))[UID_SIZE]
+{
+  return (const uint8_t (*)[UID_SIZE]) uids.data();
+}
+
+int main()
+{
+  try
+  {
+    KeyCache cache(2);
+    const uint8_t a[UID_SIZE] = {1}, b[UID_SIZE] = {2}, c[UID_SIZE] = {3};
+    TagKeys keys = {};
+    cache.put(a, keys);
+    cache.put(b, keys);
+    cache.get(a, keys);
+    cache.put(c, keys);
+    check(cache.size() == 2 && cache.get(a, keys) && !cache.get(b, keys) && cache.get(c, keys),
+          "cache: least recently used out");
+    
+    TagService service(4096, 64);
+    TagServer server(service, SOCKET_PATH);
+    TagClient client(SOCKET_PATH);
+    
+    // Wyldstyle, BMO (a vehicle), Supergirl.
+    const uint8_t known_uids[3][UID_SIZE] = {
+      {0x04, 0x13, 0xbb, 0x1a, 0x99, 0x40, 0x80},
+      {0x04, 0xd9, 0xc8, 0xda, 0xa2, 0x40, 0x80},
+      {0x04, 0x58, 0xe4, 0x52, 0x25, 0x20, 0x91},
+    };
+    const uint32_t known_ids[3] = {3, 1173, 46};
+    const uint8_t known_pages[3][8] = {
+      {0x01, 0x39, 0xed, 0x60, 0xe4, 0xbe, 0x30, 0x7c},
+      {0x95, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+      {0x4b, 0x63, 0xb1, 0x08, 0x8f, 0x63, 0x8a, 0x8d},
+    };
+    const uint32_t known_passwords[3] = {0x2136ef4b, 0xd0019151, 0x9b208d85};
+    std::vector<uint8_t> pages = client.pages(known_uids, known_ids, 3);
+    bool known = pages.size() == 3 * PAGES_REPLY_SIZE;
+    for (unsigned n = 0; known && n < 3; ++n)
+      known = !memcmp(&pages[n * PAGES_REPLY_SIZE], known_pages[n], 8)
+           && get_le32(&pages[n * PAGES_REPLY_SIZE + ID_PAGES_SIZE]) == known_passwords[n];
+    check(known, "pages and passwords of the known tags");
+    std::vector<uint8_t> tag = client.tags(known_uids, known_ids, 1);
+    check(tag.size() == TAG_MEMORY_SIZE && !memcmp(&tag[4 * FIRST_ID_PAGE], known_pages[0], 8)
+          && get_le32(&tag[4 * PASSWORD_PAGE]) == known_passwords[0], "whole tag");
+    
+    std::vector<uint8_t> uids;
+    std::vector<uint32_t> ids;
+    random_tags(1001, uids, ids);
+    check(same_tags(uids, ids, client.tags(as_uids(uids), ids.data(), ids.size())),
+          "a batch of 1001 tags");
+    TagService::Stats before = service.stats();
+    check(same_tags(uids, ids, client.tags(as_uids(uids), ids.data(), ids.size())),
+          "the same batch again");
+    TagService::Stats after = service.stats();
+    check(after.cache_hits - before.cache_hits == 1001, "again: all from the cache");
+    
+    // Every client its own tags, one per request.
+    std::atomic<bool> all_same(true);
+    std::vector<std::thread> threads;
+    std::vector<std::vector<uint8_t>> client_uids(CLIENTS);
+    std::vector<std::vector<uint32_t>> client_ids(CLIENTS);
+    for (unsigned n = 0; n < CLIENTS; ++n)
+      random_tags(CLIENT_REQUESTS, client_uids[n], client_ids[n]);
+    before = service.stats();
+    for (unsigned n = 0; n < CLIENTS; ++n)
+      threads.emplace_back([&, n]
+      {
+        TagClient own(SOCKET_PATH);
+        std::vector<uint8_t> replies;
+        for (unsigned r = 0; r < CLIENT_REQUESTS; ++r)
+        {
+          std::vector<uint8_t> reply = own.tags(as_uids(client_uids[n]) + r, &client_ids[n][r], 1);
+          replies.insert(replies.end(), reply.begin(), reply.end());
+        }
+        if (!same_tags(client_uids[n], client_ids[n], replies))
+          all_same = false;
+      });
+    for (std::thread & thread : threads)
+      thread.join();
+    after = service.stats();
+    check(all_same, "clients at the same time");
+    check(after.requests - before.requests == CLIENTS * CLIENT_REQUESTS
+          && after.batches - before.batches <= CLIENTS * CLIENT_REQUESTS, "requests and batches");
+    printf("      %u requests in %llu batches\n", CLIENTS * CLIENT_REQUESTS,
+           (unsigned long long) (after.batches - before.batches));
+    
+    // An unknown op: BAD_REQUEST, then the server hangs up.
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un un = {};
+    un.sun_family = AF_UNIX;
+    strcpy(un.sun_path, SOCKET_PATH);
+    uint8_t bad[4] = {9, 0, 0, 0}, reply[8] = {};
+    bool rejected = connect(fd, (sockaddr *) &un, sizeof un) == 0
+                 && send(fd, bad, sizeof bad, 0) == sizeof bad
+                 && recv(fd, reply, sizeof reply, MSG_WAITALL) == sizeof reply
+                 && reply[0] == tag_service::BAD_REQUEST && recv(fd, reply, 1, 0) == 0;
+    close(fd);
+    check(rejected, "bad request");
+    
+    std::string stats = client.stats();
+    check(stats.find("tag_service_request_seconds{quantile=\"0.99\"}") != std::string::npos
+          && stats.find("tag_service_cache_hits_total ") != std::string::npos, "metrics");
+    
+    // The round trip of one tag, from the client.
+    HdrHistogram round_trips;
+    for (unsigned r = 0; r < 1000; ++r)
+    {
+      auto start = std::chrono::steady_clock::now();
+      client.tags(as_uids(uids) + r, &ids[r], 1);
+      round_trips.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count());
+    }
+    printf("      round trip of one tag: p50 %.3f ms, p99 %.3f ms\n",
+           round_trips.percentile(50) / 1e6, round_trips.percentile(99) / 1e6);
+    service.print_summary(stdout);
+  }
+  catch (const std::exception & e)
+  {
+    printf("FAIL: %s\n", e.what());
+    ++failures;
+  }
+  
+  printf("%u failures\n", failures);
+  return failures ? 1 : 0;
+}
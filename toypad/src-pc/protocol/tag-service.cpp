@@ -0,0 +1,484 @@
+#include <errno.h>
+#include <poll.h>
+#include <stdexcept>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "tag-service.hpp"
+
+#define REQUEST_HEADER_SIZE	4
+#define REPLY_HEADER_SIZE	8
+
+uint64_t KeyCache::key_of(const uint8_t uid[UID_SIZE])
+{
+  uint64_t key = 0;
+  for (unsigned n = 0; n < UID_SIZE; ++n)
+    key |= (uint64_t) uid[n] << (8 * n);
+  return key;
+}
+
+bool KeyCache::get(const uint8_t uid[UID_SIZE], TagKeys & keys)
+{
+  auto found = index.find(key_of(uid));
+  if (found == index.end())
+    return false;
+  entries.splice(entries.begin(), entries, found->second);
+  keys = found->second->second;
+  return true;
+}
+
+void KeyCache::put(const uint8_t uid[UID_SIZE], const TagKeys & keys)
+{
+  if (!capacity)
+    return;
+  uint64_t key = key_of(uid);
+  auto found = index.find(key);
+  if (found != index.end())
+  {
+    entries.splice(entries.begin(), entries, found->second);
+    found->second->second = keys;
+    return;
+  }
+  if (entries.size() == capacity)
+  {
+    index.erase(entries.back().first);
+    entries.pop_back();
+  }
+  entries.emplace_front(key, keys);
+  index[key] = entries.begin();
+}
+
+TagService::TagService(size_t cache_size, size_t max_batch, Clock::duration linger)
+  : max_batch(max_batch ? max_batch : 1), linger(linger), cache(cache_size)
+{
+  worker = std::thread(&TagService::work, this);
+}
+
+TagService::~TagService()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = true;
+  }
+  queued_cv.notify_one();
+  worker.join();
+}
+
+void TagService::personalize(const uint8_t (* uids)[UID_SIZE], const uint32_t * ids, size_t count,
+                             uint8_t (* memories)[TAG_MEMORY_SIZE])
+{
+  if (!count)
+    return;
+  Request request;
+  request.uids = uids;
+  request.ids = ids;
+  request.count = count;
+  request.memories = memories;
+  request.start = Clock::now();
+  
+  std::unique_lock<std::mutex> lock(mutex);
+  queue.push_back(&request);
+  queued_tags += count;
+  queued_cv.notify_one();
+  done_cv.wait(lock, [&request] { return request.done; });
+  counters.latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+    Clock::now() - request.start).count());
+}
+
+void TagService::work()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true)
+  {
+    queued_cv.wait(lock, [this] { return stop || !queue.empty(); });
+    // After a stop: the requests that are still waiting, then out.
+    if (queue.empty())
+      return;
+    if (linger > Clock::duration::zero())
+      queued_cv.wait_until(lock, queue.front()->start + linger,
+                           [this] { return stop || queued_tags >= max_batch; });
+    
+    std::vector<Request *> batch;
+    size_t tags = 0;
+    while (!queue.empty() && (batch.empty() || tags + queue.front()->count <= max_batch))
+    {
+      batch.push_back(queue.front());
+      tags += queue.front()->count;
+      queued_tags -= queue.front()->count;
+      queue.pop_front();
+    }
+    Clock::time_point taken = Clock::now();
+    lock.unlock();
+    
+    size_t hits = compute(batch);
+    Clock::time_point end = Clock::now();
+    
+    lock.lock();
+    for (Request * request : batch)
+    {
+      counters.queued.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        taken - request->start).count());
+      request->done = true;
+    }
+    ++counters.batches;
+    counters.requests += batch.size();
+    counters.tags += tags;
+    counters.batch_time.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+      end - taken).count());
+    counters.batch_tags.record(tags);
+    counters.cache_hits += hits;
+    counters.cache_misses += tags - hits;
+    done_cv.notify_all();
+  }
+}
+
+size_t TagService::compute(const std::vector<Request *> & batch)
+{
+  size_t count = 0;
+  for (const Request * request : batch)
+    count += request->count;
+  std::vector<uint8_t> uids(count * UID_SIZE);
+  std::vector<uint32_t> ids(count);
+  std::vector<TagKeys> keys(count);
+  size_t n = 0;
+  for (const Request * request : batch)
+  {
+    memcpy(&uids[n * UID_SIZE], request->uids, request->count * UID_SIZE);
+    memcpy(&ids[n], request->ids, request->count * sizeof ids[0]);
+    n += request->count;
+  }
+  const uint8_t (* all_uids)[UID_SIZE] = (const uint8_t (*)[UID_SIZE]) uids.data();
+  
+  // Only the UIDs that are not in the cache through tag_keys().
+  std::vector<size_t> misses;
+  std::vector<uint8_t> miss_uids;
+  for (n = 0; n < count; ++n)
+    if (!cache.get(all_uids[n], keys[n]))
+    {
+      misses.push_back(n);
+      miss_uids.insert(miss_uids.end(), all_uids[n], all_uids[n] + UID_SIZE);
+    }
+  std::vector<TagKeys> miss_keys(misses.size());
+  tag_keys((const uint8_t (*)[UID_SIZE]) miss_uids.data(), misses.size(), miss_keys.data());
+  for (size_t miss = 0; miss < misses.size(); ++miss)
+  {
+    keys[misses[miss]] = miss_keys[miss];
+    cache.put(all_uids[misses[miss]], miss_keys[miss]);
+  }
+  
+  std::vector<uint8_t> memories(count * TAG_MEMORY_SIZE);
+  encode_tags(all_uids, ids.data(), keys.data(), count, (uint8_t (*)[TAG_MEMORY_SIZE]) memories.data());
+  n = 0;
+  for (const Request * request : batch)
+  {
+    memcpy(request->memories, &memories[n * TAG_MEMORY_SIZE], request->count * TAG_MEMORY_SIZE);
+    n += request->count;
+  }
+  return count - misses.size();
+}
+
+TagService::Stats TagService::stats()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return counters;
+}
+
+// A summary of Prometheus, of a histogram of ns (scale 1e-9) or of 
+// anything else (scale 1).
+static void summary(std::string & out, const char * name, const char * help,
+                    const HdrHistogram & histogram, double scale)
+{
+  char line[256];
+  snprintf(line, sizeof line, "# HELP %s %s\n# TYPE %s summary\n", name, help, name);
+  out += line;
+  for (double q : {0.5, 0.9, 0.99, 0.999})
+  {
+    snprintf(line, sizeof line, "%s{quantile=\"%g\"} %.9g\n", name, q,
+             histogram.percentile(100 * q) * scale);
+    out += line;
+  }
+  snprintf(line, sizeof line, "%s_sum %.9g\n%s_count %llu\n", name, histogram.sum() * scale,
+           name, (unsigned long long) histogram.count());
+  out += line;
+}
+
+static void counter(std::string & out, const char * name, const char * help, uint64_t value)
+{
+  char line[256];
+  snprintf(line, sizeof line, "# HELP %s %s\n# TYPE %s counter\n%s %llu\n", name, help, name, name,
+           (unsigned long long) value);
+  out += line;
+}
+
+std::string TagService::prometheus()
+{
+  Stats s = stats();
+  std::string out;
+  summary(out, "tag_service_request_seconds", "Time per request, until its tags are done.",
+          s.latency, 1e-9);
+  summary(out, "tag_service_queued_seconds", "Time per request, until the worker took it.",
+          s.queued, 1e-9);
+  summary(out, "tag_service_batch_seconds", "Time per batch, computing.", s.batch_time, 1e-9);
+  summary(out, "tag_service_batch_tags", "Tags per batch.", s.batch_tags, 1);
+  counter(out, "tag_service_requests_total", "Requests.", s.requests);
+  counter(out, "tag_service_tags_total", "Tags.", s.tags);
+  counter(out, "tag_service_batches_total", "Batches.", s.batches);
+  counter(out, "tag_service_cache_hits_total", "Tags with the keys of their UID in the cache.",
+          s.cache_hits);
+  counter(out, "tag_service_cache_misses_total", "Tags without.", s.cache_misses);
+  return out;
+}
+
+void TagService::print_summary(FILE * out)
+{
+  Stats s = stats();
+  fprintf(out, "%-8s %9s %10s %10s %10s %10s %10s %10s\n", "", "count", "mean ms", "p50 ms",
+          "p90 ms", "p99 ms", "p99.9 ms", "max ms");
+  const std::pair<const char *, const HdrHistogram *> rows[] = {
+    {"request", &s.latency},
+    {"queued", &s.queued},
+    {"batch", &s.batch_time},
+  };
+  for (auto & row : rows)
+  {
+    const HdrHistogram & h = *row.second;
+    fprintf(out, "%-8s %9llu %10.3f %10.3f %10.3f %10.3f %10.3f %10.3f\n", row.first,
+            (unsigned long long) h.count(), h.mean() / 1e6, h.percentile(50) / 1e6,
+            h.percentile(90) / 1e6, h.percentile(99) / 1e6, h.percentile(99.9) / 1e6,
+            h.max() / 1e6);
+  }
+  fprintf(out, "%llu requests, %llu tags in %llu batches (%.1f tags per batch), "
+               "%llu cache hits, %llu misses\n",
+          (unsigned long long) s.requests, (unsigned long long) s.tags,
+          (unsigned long long) s.batches, s.batch_tags.mean(),
+          (unsigned long long) s.cache_hits, (unsigned long long) s.cache_misses);
+}
+
+static bool send_all(int fd, const void * data, size_t size)
+{
+  for (size_t done = 0; done < size; )
+  {
+    ssize_t n = send(fd, (const uint8_t *) data + done, size - done, MSG_NOSIGNAL);
+    if (n <= 0)
+      return false;
+    done += n;
+  }
+  return true;
+}
+
+static void reply_header(uint8_t header[REPLY_HEADER_SIZE], uint8_t status, size_t count, size_t size)
+{
+  header[0] = status;
+  header[1] = 0;
+  header[2] = count;
+  header[3] = count >> 8;
+  put_le32(header + 4, size);
+}
+
+static sockaddr_un unix_address(const std::string & path)
+{
+  sockaddr_un un = {};
+  un.sun_family = AF_UNIX;
+  if (path.empty() || path.size() >= sizeof un.sun_path)
+    throw std::runtime_error("tag service: bad socket path " + path);
+  strcpy(un.sun_path, path.c_str());
+  return un;
+}
+
+TagServer::TagServer(TagService & service, const std::string & path)
+  : service(service), path(path)
+{
+  sockaddr_un un = unix_address(path);
+  listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  unlink(path.c_str());
+  if (listen_fd < 0 || bind(listen_fd, (sockaddr *) &un, sizeof un) < 0
+   || listen(listen_fd, 16) < 0)
+  {
+    std::string error = strerror(errno);
+    if (listen_fd >= 0)
+      close(listen_fd);
+    throw std::runtime_error("tag service: " + path + ": " + error);
+  }
+  thread = std::thread(&TagServer::serve, this);
+}
+
+TagServer::~TagServer()
+{
+  stop = true;
+  thread.join();
+  for (ClientThread & client : client_threads)
+    client.thread.join();
+  close(listen_fd);
+  unlink(path.c_str());
+}
+
+void TagServer::serve()
+{
+  while (!stop)
+  {
+    pollfd p = {listen_fd, POLLIN, 0};
+    if (poll(&p, 1, 50) <= 0)
+      continue;
+    int client = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (client < 0)
+      continue;
+    ++clients;
+    for (auto c = client_threads.begin(); c != client_threads.end(); )
+      if (c->finished)
+      {
+        c->thread.join();
+        c = client_threads.erase(c);
+      }
+      else
+        ++c;
+    client_threads.emplace_back();
+    ClientThread & slot = client_threads.back();
+    slot.thread = std::thread([this, client, &slot]
+    {
+      serve_client(client);
+      close(client);
+      slot.finished = true;
+    });
+  }
+}
+
+bool TagServer::receive(int client, void * data, size_t size)
+{
+  for (size_t done = 0; done < size; )
+  {
+    pollfd p = {client, POLLIN, 0};
+    if (stop)
+      return false;
+    if (poll(&p, 1, 50) <= 0)
+      continue;
+    ssize_t n = recv(client, (uint8_t *) data + done, size - done, 0);
+    if (n <= 0)
+      return false;
+    done += n;
+  }
+  return true;
+}
+
+void TagServer::serve_client(int client)
+{
+  uint8_t header[REQUEST_HEADER_SIZE];
+  std::vector<uint8_t> request, reply;
+  std::vector<uint8_t> uids;
+  std::vector<uint32_t> ids;
+  std::vector<uint8_t> memories;
+  while (receive(client, header, sizeof header))
+  {
+    uint8_t op = header[0];
+    size_t count = header[2] | header[3] << 8;
+    if ((op != tag_service::TAGS && op != tag_service::PAGES && op != tag_service::STATS)
+     || count > MAX_REQUEST_TAGS || (op == tag_service::STATS && count))
+    {
+      uint8_t bad[REPLY_HEADER_SIZE];
+      reply_header(bad, tag_service::BAD_REQUEST, 0, 0);
+      send_all(client, bad, sizeof bad);
+      return;
+    }
+    request.resize(count * REQUEST_TAG_SIZE);
+    if (!receive(client, request.data(), request.size()))
+      return;
+    uids.resize(count * UID_SIZE);
+    ids.resize(count);
+    for (size_t n = 0; n < count; ++n)
+    {
+      memcpy(&uids[n * UID_SIZE], &request[n * REQUEST_TAG_SIZE], UID_SIZE);
+      ids[n] = get_le32(&request[n * REQUEST_TAG_SIZE + UID_SIZE]);
+    }
+    const uint8_t (* request_uids)[UID_SIZE] = (const uint8_t (*)[UID_SIZE]) uids.data();
+    
+    if (op == tag_service::TAGS)
+    {
+      // Straight into the reply.
+      reply.resize(REPLY_HEADER_SIZE + count * TAG_MEMORY_SIZE);
+      service.personalize(request_uids, ids.data(), count,
+                          (uint8_t (*)[TAG_MEMORY_SIZE]) (reply.data() + REPLY_HEADER_SIZE));
+    }
+    else if (op == tag_service::PAGES)
+    {
+      memories.resize(count * TAG_MEMORY_SIZE);
+      service.personalize(request_uids, ids.data(), count, (uint8_t (*)[TAG_MEMORY_SIZE]) memories.data());
+      reply.resize(REPLY_HEADER_SIZE + count * PAGES_REPLY_SIZE);
+      for (size_t n = 0; n < count; ++n)
+      {
+        const uint8_t * memory = &memories[n * TAG_MEMORY_SIZE];
+        uint8_t * pages = &reply[REPLY_HEADER_SIZE + n * PAGES_REPLY_SIZE];
+        memcpy(pages, memory + 4 * FIRST_ID_PAGE, ID_PAGES_SIZE);
+        memcpy(pages + ID_PAGES_SIZE, memory + 4 * PASSWORD_PAGE, 4);
+      }
+    }
+    else
+    {
+      std::string text = service.prometheus();
+      reply.resize(REPLY_HEADER_SIZE);
+      reply.insert(reply.end(), text.begin(), text.end());
+    }
+    reply_header(reply.data(), tag_service::OK, count, reply.size() - REPLY_HEADER_SIZE);
+    if (!send_all(client, reply.data(), reply.size()))
+      return;
+  }
+}
+
+TagClient::TagClient(const std::string & path)
+{
+  sockaddr_un un = unix_address(path);
+  fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0 || connect(fd, (sockaddr *) &un, sizeof un) < 0)
+  {
+    std::string error = strerror(errno);
+    if (fd >= 0)
+      close(fd);
+    throw std::runtime_error("tag service: " + path + ": " + error);
+  }
+}
+
+TagClient::~TagClient()
+{
+  close(fd);
+}
+
+std::vector<uint8_t> TagClient::tags(const uint8_t (* uids)[UID_SIZE], const uint32_t * ids, size_t count)
+{
+  return call(tag_service::TAGS, uids, ids, count);
+}
+
+std::vector<uint8_t> TagClient::pages(const uint8_t (* uids)[UID_SIZE], const uint32_t * ids, size_t count)
+{
+  return call(tag_service::PAGES, uids, ids, count);
+}
+
+std::string TagClient::stats()
+{
+  std::vector<uint8_t> text = call(tag_service::STATS, nullptr, nullptr, 0);
+  return std::string(text.begin(), text.end());
+}
+
+std::vector<uint8_t> TagClient::call(uint8_t op, const uint8_t (* uids)[UID_SIZE], const uint32_t * ids,
+                                     size_t count)
+{
+  std::vector<uint8_t> request(REQUEST_HEADER_SIZE + count * REQUEST_TAG_SIZE);
+  request[0] = op;
+  request[2] = count;
+  request[3] = count >> 8;
+  for (size_t n = 0; n < count; ++n)
+  {
+    uint8_t * tag = &request[REQUEST_HEADER_SIZE + n * REQUEST_TAG_SIZE];
+    memcpy(tag, uids[n], UID_SIZE);
+    put_le32(tag + UID_SIZE, ids[n]);
+  }
+  uint8_t header[REPLY_HEADER_SIZE];
+  if (!send_all(fd, request.data(), request.size())
+   || recv(fd, header, sizeof header, MSG_WAITALL) != sizeof header)
+    throw std::runtime_error("tag service: hung up");
+  if (header[0] != tag_service::OK)
+    throw std::runtime_error("tag service: bad request");
+  std::vector<uint8_t> reply(get_le32(header + 4));
+  if (!reply.empty() && recv(fd, reply.data(), reply.size(), MSG_WAITALL) != (ssize_t) reply.size())
+    throw std::runtime_error("tag service: hung up");
+  return reply;
+}
@@ -0,0 +1,205 @@
+#ifndef _TAG_SERVICE_HPP_
+#define _TAG_SERVICE_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "metrics.hpp"
+#include "tag-batch.hpp"
+
+// The pages of tags for UIDs and IDs, as a long-running service, so the 
+// stations do not each work out passwords and keys in Python (with 
+// numpy, and the catalog JSON) over and over again.
+// 
+// TagService computes. Every personalize() is a request; one worker 
+// thread takes all requests that are waiting (up to max_batch tags), 
+// computes their tags together with tag_keys() and encode_tags() in 
+// lanes of BATCH_WIDTH, and wakes the requests up. With linger, the 
+// worker waits up to that long after the first request for more to 
+// fill a batch. The keys of the last cache_size UIDs are kept.
+// 
+// TagServer serves a TagService on a Unix socket, a thread per client; 
+// TagClient (and python/tag_service.py) talks to it. The requests and 
+// replies, all numbers little endian:
+// 
+//   request  op (1), 0 (1), count (2), count times a UID (7) and an ID (4) 
+//   reply    status (1), 0 (1), count (2), size (4), size bytes
+// 
+//   op TAGS   the whole memory of every tag (encode_tag()): count times 
+//             TAG_MEMORY_SIZE bytes 
+//   op PAGES  pages 0x24 to 0x27 and the password (page 0x2b) of every 
+//             tag: count times PAGES_REPLY_SIZE bytes 
+//   op STATS  no tags (count 0); TagService::prometheus(), text
+// 
+// A request for more than MAX_REQUEST_TAGS tags, or with an unknown op, 
+// gets status BAD_REQUEST (and nothing else) and the connection is 
+// closed.
+
+#define MAX_REQUEST_TAGS	4096
+#define REQUEST_TAG_SIZE	(UID_SIZE + 4)
+#define PAGES_REPLY_SIZE	(ID_PAGES_SIZE + 4)
+
+namespace tag_service
+{
+  enum Op
+  {
+    TAGS = 1,
+    PAGES = 2,
+    STATS = 3,
+  };
+  
+  enum Status
+  {
+    OK = 0,
+    BAD_REQUEST = 1,
+  };
+}
+
+// The keys of the most recently used UIDs. Not thread safe.
+class KeyCache
+{
+  public:
+    explicit KeyCache(size_t capacity) : capacity(capacity) {}
+    
+    bool get(const uint8_t uid[UID_SIZE], TagKeys & keys);
+    void put(const uint8_t uid[UID_SIZE], const TagKeys & keys);
+    size_t size() const { return entries.size(); }
+  
+  private:
+    static uint64_t key_of(const uint8_t uid[UID_SIZE]);
+    
+    size_t capacity;
+    // Most recently used first.
+    std::list<std::pair<uint64_t, TagKeys>> entries;
+    std::unordered_map<uint64_t, std::list<std::pair<uint64_t, TagKeys>>::iterator> index;
+};
+
+class TagService
+{
+  public:
+    typedef std::chrono::steady_clock Clock;
+    
+    TagService(size_t cache_size = 4096, size_t max_batch = 64,
+               Clock::duration linger = Clock::duration::zero());
+    ~TagService();
+    TagService(const TagService &) = delete;
+    TagService & operator=(const TagService &) = delete;
+    
+    // encode_tag() of every UID and ID. Thread safe; blocks until the 
+    // batch it is in is done.
+    void personalize(const uint8_t (* uids)[UID_SIZE], const uint32_t * ids, size_t count,
+                     uint8_t (* memories)[TAG_MEMORY_SIZE]);
+    
+    struct Stats
+    {
+      uint64_t requests = 0;
+      uint64_t tags = 0;
+      uint64_t batches = 0;
+      uint64_t cache_hits = 0;
+      uint64_t cache_misses = 0;
+      HdrHistogram latency;	// Per request, ns: from personalize() until done.
+      HdrHistogram queued;	// Per request, ns: until the worker took it.
+      HdrHistogram batch_time;	// Per batch, ns: the computing.
+      HdrHistogram batch_tags;	// Per batch: tags.
+    };
+    Stats stats();
+    
+    // stats() in the text format of Prometheus.
+    std::string prometheus();
+    // Table of stats(), in ms.
+    void print_summary(FILE * out);
+  
+  private:
+    struct Request
+    {
+      const uint8_t (* uids)[UID_SIZE];
+      const uint32_t * ids;
+      size_t count;
+      uint8_t (* memories)[TAG_MEMORY_SIZE];
+      Clock::time_point start;
+      bool done = false;
+    };
+    
+    void work();
+    // The requests, together, without the lock. Returns the cache hits.
+    size_t compute(const std::vector<Request *> & batch);
+    
+    size_t max_batch;
+    Clock::duration linger;
+    KeyCache cache;		// Of the worker only.
+    
+    std::mutex mutex;
+    std::condition_variable queued_cv;
+    std::condition_variable done_cv;
+    std::deque<Request *> queue;
+    size_t queued_tags = 0;
+    bool stop = false;
+    Stats counters;
+    std::thread worker;
+};
+
+// Throws std::runtime_error if it cannot listen.
+class TagServer
+{
+  public:
+    TagServer(TagService & service, const std::string & path);
+    ~TagServer();
+    TagServer(const TagServer &) = delete;
+    TagServer & operator=(const TagServer &) = delete;
+    
+    std::atomic<unsigned> clients{0};
+  
+  private:
+    void serve();
+    void serve_client(int client);
+    // A whole request (false: hung up, or stopping).
+    bool receive(int client, void * data, size_t size);
+    
+    TagService & service;
+    std::string path;
+    int listen_fd = -1;
+    std::atomic<bool> stop{false};
+    std::thread thread;
+    struct ClientThread
+    {
+      std::thread thread;
+      std::atomic<bool> finished{false};
+    };
+    // Of serve() only; it joins the finished ones as it goes.
+    std::list<ClientThread> client_threads;
+};
+
+// Throws std::runtime_error if the service cannot be reached, hangs up, 
+// or says BAD_REQUEST.
+class TagClient
+{
+  public:
+    explicit TagClient(const std::string & path);
+    ~TagClient();
+    TagClient(const TagClient &) = delete;
+    TagClient & operator=(const TagClient &) = delete;
+    
+    // count times TAG_MEMORY_SIZE bytes.
+    std::vector<uint8_t> tags(const uint8_t (* uids)[UID_SIZE], const uint32_t * ids, size_t count);
+    // count times PAGES_REPLY_SIZE bytes.
+    std::vector<uint8_t> pages(const uint8_t (* uids)[UID_SIZE], const uint32_t * ids, size_t count);
+    std::string stats();
+  
+  private:
+    std::vector<uint8_t> call(uint8_t op, const uint8_t (* uids)[UID_SIZE], const uint32_t * ids,
+                              size_t count);
+    
+    int fd = -1;
+};
+
+#endif /* _TAG_SERVICE_HPP_ */
@@ -0,0 +1,179 @@
+#include <string.h>
+
+#include "toypad-emulator.hpp"
+
+using namespace toypad;
+
+#define READ_OK		0x00
+#define READ_FAILED	0x01
+
+ToypadEmulator::ToypadEmulator(bool xbox)
+  : xbox(xbox)
+{
+}
+
+int ToypadEmulator::place(uint8_t pad, const uint8_t memory[TAG_MEMORY_SIZE])
+{
+  for (unsigned index = 0; index < MAX_TAGS; ++index)
+  {
+    Tag & tag = tags[index];
+    if (tag.present)
+      continue;
+    tag.present = true;
+    tag.pad = pad;
+    memcpy(tag.memory, memory, TAG_MEMORY_SIZE);
+    // Pages 0 and 1, without the check byte BCC0.
+    memcpy(tag.uid, memory, 3);
+    memcpy(tag.uid + 3, memory + 4, 4);
+    if (started)
+      event(index, false);
+    return index;
+  }
+  return -1;
+}
+
+int ToypadEmulator::place(uint8_t pad, const uint8_t uid[UID_SIZE], uint32_t id)
+{
+  uint8_t memory[TAG_MEMORY_SIZE];
+  encode_tag(uid, id, memory);
+  return place(pad, memory);
+}
+
+bool ToypadEmulator::remove(unsigned index)
+{
+  if (index >= MAX_TAGS || !tags[index].present)
+    return false;
+  tags[index].present = false;
+  if (started)
+    event(index, true);
+  return true;
+}
+
+void ToypadEmulator::reply(uint8_t message_id, const uint8_t * payload, size_t size)
+{
+  Packet packet;
+  encode_reply(message_id, payload, size, xbox, packet.data());
+  outbox.push_back(packet);
+}
+
+void ToypadEmulator::event(unsigned index, bool removed)
+{
+  Event event;
+  event.pad = tags[index].pad;
+  event.status = 0;
+  event.index = index;
+  event.removed = removed;
+  memcpy(event.uid, tags[index].uid, UID_SIZE);
+  Packet packet;
+  encode_event(event, xbox, packet.data());
+  outbox.push_back(packet);
+}
+
+toypad::Error ToypadEmulator::receive(const uint8_t * packet, size_t size)
+{
+  Frame frame;
+  CommandFrame command;
+  Error error = parse_frame(packet, size, xbox, frame);
+  if (error == OK)
+    error = parse_command(frame, command);
+  if (error == OK && !execute(command))
+    error = BAD_LENGTH;
+  if (error != OK)
+    ++rejected;
+  return error;
+}
+
+// false: an unknown command, or a payload of the wrong size.
+bool ToypadEmulator::execute(const CommandFrame & command)
+{
+  const uint8_t * payload = command.payload;
+  const size_t size = command.payload_size;
+  uint8_t out[17];
+  switch (command.command)
+  {
+    case START:
+    {
+      static const char copyright[] = "(c) LEGO 2014";
+      if (size != sizeof copyright - 1 || memcmp(payload, copyright, size))
+        return false;
+      reply(command.message_id, nullptr, 0);
+      if (!started)
+      {
+        started = true;
+        for (unsigned index = 0; index < MAX_TAGS; ++index)
+          if (tags[index].present)
+            event(index, false);
+      }
+      return true;
+    }
+    case SEED:
+    {
+      if (size != 8)
+        return false;
+      uint32_t v[2] = {get_le32(payload), get_le32(payload + 4)};
+      tea_decrypt(v, TOYPAD_TEA_KEY);
+      toypad_scramble(v[0], seed);
+      v[0] = seed[1];
+      v[1] = 0;
+      tea_encrypt(v, TOYPAD_TEA_KEY);
+      put_le32(out, v[0]);
+      put_le32(out + 4, v[1]);
+      reply(command.message_id, out, 8);
+      return true;
+    }
+    case CHALLENGE:
+    {
+      // The toypad reads 8 bytes, whatever the length says: the 
+      // capture of command_0xB3_replayed.py has length 2, so its 
+      // challenge is the checksum and the padding.
+      if (command.available < 8)
+        return false;
+      uint32_t challenge[2] = {get_le32(payload), get_le32(payload + 4)};
+      tea_decrypt(challenge, TOYPAD_TEA_KEY);
+      uint32_t shuffled[4];
+      memcpy(shuffled, seed, sizeof shuffled);
+      toypad_shuffle(shuffled);
+      uint32_t v[2] = {shuffled[3], challenge[0]};
+      tea_encrypt(v, TOYPAD_TEA_KEY);
+      put_le32(out, v[0]);
+      put_le32(out + 4, v[1]);
+      reply(command.message_id, out, 8);
+      return true;
+    }
+    case CHANGE_COLOR:
+      if (size != 4 || payload[0] > PADS)
+        return false;
+      for (unsigned pad = 1; pad <= PADS; ++pad)
+        if (payload[0] == 0 || payload[0] == pad)
+          memcpy(colors[pad - 1], payload + 1, 3);
+      reply(command.message_id, nullptr, 0);
+      return true;
+    case CHANGE_COLORS:
+      if (size != 4 * PADS)
+        return false;
+      for (unsigned pad = 0; pad < PADS; ++pad)
+        if (payload[4 * pad])
+          memcpy(colors[pad], payload + 4 * pad + 1, 3);
+      reply(command.message_id, nullptr, 0);
+      return true;
+    case READ_PAGE:
+    {
+      if (size != 2)
+        return false;
+      unsigned index = payload[0], page = payload[1];
+      if (index >= MAX_TAGS || !tags[index].present || page >= TAG_PAGES)
+      {
+        out[0] = READ_FAILED;
+        reply(command.message_id, out, 1);
+        return true;
+      }
+      out[0] = READ_OK;
+      for (unsigned n = 0; n < 4; ++n)
+        memcpy(out + 1 + 4 * n, tags[index].memory + 4 * ((page + n) % TAG_PAGES), 4);
+      reply(command.message_id, out, 17);
+      return true;
+    }
+    default:
+      return false;
+  }
+}
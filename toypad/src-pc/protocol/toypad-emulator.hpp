@@ -0,0 +1,75 @@
+#ifndef _TOYPAD_EMULATOR_HPP_
+#define _TOYPAD_EMULATOR_HPP_
+
+#include <array>
+#include <deque>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tag-pages.hpp"
+#include "toypad-frame.hpp"
+
+// The toypad as the host sees it over USB: it takes command packets and 
+// queues the reply packets and the events of tags put on and taken off 
+// its pads. The commands (see toypad-frame.hpp):
+// 
+//   START          "(c) LEGO 2014": an empty reply, then an event for 
+//                  every tag that is on a pad.
+//   SEED           8 bytes, TEA encrypted with TOYPAD_TEA_KEY: the first 
+//                  word scrambled (toypad_scramble()) is the new seed.
+//                  The reply is word 1 of the seed and 0, encrypted.
+//   CHALLENGE      8 bytes, encrypted: the reply is word 3 of the 
+//                  shuffled seed and the first word of the challenge, 
+//                  encrypted. As in command_0xB3_replayed.py, which 
+//                  matches two captures, the seed stays as it is. The 
+//                  8 bytes follow the message ID whatever the length 
+//                  of the frame is.
+//   CHANGE_COLOR   pad (0 for all), red, green, blue: an empty reply.
+//   CHANGE_COLORS  enable, red, green, blue for the 3 pads.
+//   READ_PAGE      tag index, page: status 0 and 4 pages (16 bytes), 
+//                  wrapping around after the last one. Status 1 for a 
+//                  tag that is not there or a page beyond the last one.
+// 
+// Anything else (a bad frame, an unknown command, a payload of the wrong 
+// size) gets no reply and is counted in rejected.
+class ToypadEmulator
+{
+  public:
+    typedef std::array<uint8_t, toypad::PACKET_SIZE> Packet;
+    static const unsigned MAX_TAGS = 7;
+    static const unsigned PADS = 3;
+    
+    struct Tag
+    {
+      bool present = false;
+      uint8_t pad = 0;
+      uint8_t uid[UID_SIZE];
+      uint8_t memory[TAG_MEMORY_SIZE];
+    };
+    
+    explicit ToypadEmulator(bool xbox = false);
+    
+    // Returns the index of the tag, -1 if every index is taken.
+    int place(uint8_t pad, const uint8_t memory[TAG_MEMORY_SIZE]);
+    // A tag as encode_tag() writes it.
+    int place(uint8_t pad, const uint8_t uid[UID_SIZE], uint32_t id);
+    bool remove(unsigned index);
+    
+    // A packet from the host, up to PACKET_SIZE bytes.
+    toypad::Error receive(const uint8_t * packet, size_t size);
+    
+    std::deque<Packet> outbox;
+    const bool xbox;
+    bool started = false;
+    uint32_t seed[4] = {};
+    uint8_t colors[PADS][3] = {};
+    Tag tags[MAX_TAGS];
+    unsigned rejected = 0;
+  
+  private:
+    void reply(uint8_t message_id, const uint8_t * payload, size_t size);
+    void event(unsigned index, bool removed);
+    bool execute(const toypad::CommandFrame & command);
+};
+
+#endif /* _TOYPAD_EMULATOR_HPP_ */
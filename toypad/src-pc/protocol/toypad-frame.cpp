@@ -0,0 +1,140 @@
+#include <string.h>
+
+#include "toypad-frame.hpp"
+
+using namespace toypad;
+
+const char * toypad::error_name(Error error)
+{
+  static const char * const names[] = {
+    "ok", "empty", "bad prefix", "bad start", "bad length", "bad checksum",
+  };
+  return names[error];
+}
+
+static uint8_t checksum(const uint8_t * bytes, size_t size)
+{
+  uint8_t sum = 0;
+  for (size_t i = 0; i < size; ++i)
+    sum += bytes[i];
+  return sum;
+}
+
+Error toypad::parse_frame(const uint8_t * packet, size_t size, bool xbox, Frame & frame)
+{
+  // The toypad sometimes sends an empty packet.
+  bool zeros = true;
+  for (size_t i = 0; i < size && zeros; ++i)
+    zeros = packet[i] == 0;
+  if (zeros)
+    return EMPTY;
+  if (xbox)
+  {
+    if (size < 2 || packet[0] != XBOX_PREFIX[0] || packet[1] != XBOX_PREFIX[1])
+      return BAD_PREFIX;
+    packet += 2;
+    size -= 2;
+  }
+  if (size < 1 || (packet[0] != FRAME_START && packet[0] != EVENT_START))
+    return BAD_START;
+  // The start, the length, the body, the checksum.
+  if (size < 3 || packet[1] > size - 3)
+    return BAD_LENGTH;
+  frame.start = packet[0];
+  frame.length = packet[1];
+  frame.body = packet + 2;
+  frame.available = size - 2;
+  if (checksum(packet, 2 + frame.length) != packet[2 + frame.length])
+    return BAD_CHECKSUM;
+  return OK;
+}
+
+Error toypad::parse_command(const Frame & frame, CommandFrame & command)
+{
+  if (frame.start != FRAME_START)
+    return BAD_START;
+  if (frame.length < 2)
+    return BAD_LENGTH;
+  command.command = frame.body[0];
+  command.message_id = frame.body[1];
+  command.payload = frame.body + 2;
+  command.payload_size = frame.length - 2;
+  command.available = frame.available - 2;
+  return OK;
+}
+
+Error toypad::parse_reply(const Frame & frame, ReplyFrame & reply)
+{
+  if (frame.start != FRAME_START)
+    return BAD_START;
+  if (frame.length < 1)
+    return BAD_LENGTH;
+  reply.message_id = frame.body[0];
+  reply.payload = frame.body + 1;
+  reply.payload_size = frame.length - 1;
+  return OK;
+}
+
+Error toypad::parse_event(const Frame & frame, Event & event)
+{
+  if (frame.start != EVENT_START)
+    return BAD_START;
+  if (frame.length != EVENT_LENGTH)
+    return BAD_LENGTH;
+  event.pad = frame.body[0];
+  event.status = frame.body[1];
+  event.index = frame.body[2];
+  event.removed = frame.body[3] != 0;
+  memcpy(event.uid, frame.body + 4, sizeof event.uid);
+  return OK;
+}
+
+bool toypad::encode_frame(uint8_t start, const uint8_t * body, size_t length, bool xbox,
+                          uint8_t packet[PACKET_SIZE])
+{
+  size_t prefix = xbox ? 2 : 0;
+  if (prefix + 2 + length + 1 > PACKET_SIZE)
+    return false;
+  memset(packet, 0, PACKET_SIZE);
+  memcpy(packet, XBOX_PREFIX, prefix);
+  uint8_t * frame = packet + prefix;
+  frame[0] = start;
+  frame[1] = length;
+  if (length)
+    memcpy(frame + 2, body, length);
+  frame[2 + length] = checksum(frame, 2 + length);
+  return true;
+}
+
+bool toypad::encode_command(uint8_t command, uint8_t message_id, const uint8_t * payload, size_t size,
+                            bool xbox, uint8_t packet[PACKET_SIZE])
+{
+  uint8_t body[PACKET_SIZE];
+  if (2 + size > sizeof body)
+    return false;
+  body[0] = command;
+  body[1] = message_id;
+  if (size)
+    memcpy(body + 2, payload, size);
+  return encode_frame(FRAME_START, body, 2 + size, xbox, packet);
+}
+
+bool toypad::encode_reply(uint8_t message_id, const uint8_t * payload, size_t size, bool xbox,
+                          uint8_t packet[PACKET_SIZE])
+{
+  uint8_t body[PACKET_SIZE];
+  if (1 + size > sizeof body)
+    return false;
+  body[0] = message_id;
+  // memcpy() does not take nullptr, even for 0 bytes.
+  if (size)
+    memcpy(body + 1, payload, size);
+  return encode_frame(FRAME_START, body, 1 + size, xbox, packet);
+}
+
+void toypad::encode_event(const Event & event, bool xbox, uint8_t packet[PACKET_SIZE])
+{
+  uint8_t body[EVENT_LENGTH] = {event.pad, event.status, event.index, event.removed};
+  memcpy(body + 4, event.uid, sizeof event.uid);
+  encode_frame(EVENT_START, body, sizeof body, xbox, packet);
+}
@@ -0,0 +1,103 @@
+#ifndef _TOYPAD_FRAME_HPP_
+#define _TOYPAD_FRAME_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The frames of the USB protocol of the toypad, as 
+// python/toypad-dump-endpoint-0x81.py sends and reads them. Every 
+// frame is a packet of 32 bytes on endpoint 0x01 (to the toypad) or 
+// 0x81 (from it), padded with zeros:
+// 
+//   command  0x55 length command message_id payload... checksum 
+//   reply    0x55 length message_id payload... checksum 
+//   event    0x56 0x0b pad status index removed uid[7] checksum
+// 
+// length counts the bytes between itself and the checksum; the checksum 
+// is the sum of the bytes before it, modulo 256. The Xbox 360 toypad 
+// puts 0x0b 0x16 in front of every frame.
+// 
+// The parsers check every length against the packet, so any 32 bytes 
+// (or fewer) are safe to pass (see fuzz/).
+
+namespace toypad
+{
+  static const size_t PACKET_SIZE = 32;
+  static const uint8_t FRAME_START = 0x55;
+  static const uint8_t EVENT_START = 0x56;
+  static const uint8_t EVENT_LENGTH = 0x0b;
+  static const uint8_t XBOX_PREFIX[2] = {0x0b, 0x16};
+  
+  enum Command
+  {
+    START = 0xb0,
+    SEED = 0xb1,
+    CHALLENGE = 0xb3,
+    CHANGE_COLOR = 0xc0,
+    CHANGE_COLORS = 0xc8,
+    READ_PAGE = 0xd2,
+  };
+  
+  enum Error
+  {
+    OK,
+    EMPTY,		// Nothing, or only zeros.
+    BAD_PREFIX,		// Xbox 360: not 0x0b 0x16.
+    BAD_START,		// Neither 0x55 nor 0x56.
+    BAD_LENGTH,		// Beyond the packet, or too short for the kind.
+    BAD_CHECKSUM,
+  };
+  
+  const char * error_name(Error error);
+  
+  // A frame in a packet: body points into the packet.
+  struct Frame
+  {
+    uint8_t start;
+    uint8_t length;
+    const uint8_t * body;
+    size_t available;	// From body to the end of the packet.
+  };
+  
+  struct CommandFrame
+  {
+    uint8_t command;
+    uint8_t message_id;
+    const uint8_t * payload;
+    size_t payload_size;
+    size_t available;	// From payload to the end of the packet.
+  };
+  
+  struct ReplyFrame
+  {
+    uint8_t message_id;
+    const uint8_t * payload;
+    size_t payload_size;
+  };
+  
+  struct Event
+  {
+    uint8_t pad;		// 1: center, 2: left, 3: right.
+    uint8_t status;		// 0: accepted.
+    uint8_t index;		// For READ_PAGE.
+    bool removed;
+    uint8_t uid[7];
+  };
+  
+  Error parse_frame(const uint8_t * packet, size_t size, bool xbox, Frame & frame);
+  Error parse_command(const Frame & frame, CommandFrame & command);
+  Error parse_reply(const Frame & frame, ReplyFrame & reply);
+  Error parse_event(const Frame & frame, Event & event);
+  
+  // A whole packet (zero padded). Returns false if the body does not 
+  // fit.
+  bool encode_frame(uint8_t start, const uint8_t * body, size_t length, bool xbox,
+                    uint8_t packet[PACKET_SIZE]);
+  bool encode_command(uint8_t command, uint8_t message_id, const uint8_t * payload, size_t size,
+                      bool xbox, uint8_t packet[PACKET_SIZE]);
+  bool encode_reply(uint8_t message_id, const uint8_t * payload, size_t size, bool xbox,
+                    uint8_t packet[PACKET_SIZE]);
+  void encode_event(const Event & event, bool xbox, uint8_t packet[PACKET_SIZE]);
+}
+
+#endif /* _TOYPAD_FRAME_HPP_ */
@@ -3,11 +3,16 @@
 # gdb-multiarch --command run-glitch.py
 
 import gdb
+import json
+import os
 import time
 import serial
 import sys
 import subprocess
 
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import timing
+
 # Glitch mode must be one of these constants. This determines how a glitch is
 # checked.
 GLITCH_MODE_FIND_LENGTH = 'find-length'
@@ -16,6 +21,27 @@ GLITCH_MODE_FINAL = 'final'
 
 mode = GLITCH_MODE_FIND_LENGTH
 
+# Number of glitcher steps per 48 MHz tick: 1 (48 MHz) or 2 (96 MHz). The
+# glitcher falls back to 1 if its timer cannot keep up with 96 MHz.
+resolution = 1
+
+# Let the glitcher check SWD itself after every glitch (command 'S'). The
+# debug probe is then only attached after a hit; needed for a real toypad,
+# which has CRP3 and therefore no SWD to prepare the attempts with.
+swd_oracle = False
+
+# Per-board timing profile (see timing.py), e.g. 'profiles/default.json'.
+# If set, the host computes the timer registers and sends command 'T';
+# otherwise the glitcher does the arithmetic itself (command 'G'). The
+# resolution then comes from the profile.
+timing_profile = None
+
+# Printed for an attempt without a STATUS line from the SWD oracle, e.g.
+# because the glitcher said FAIL. Not one of the status bytes of the
+# oracle ('!', '.' and '?'), so these are counted apart.
+NO_STATUS = 'x'
+no_status = 0
+
 do_trace = True
 do_trace = False
 if do_trace:
@@ -56,11 +82,57 @@ def start_ocd():
 
 def init():
 	global avr
+	global resolution
+	global profile
 	start_ocd()
 	avr = serial.Serial('/dev/ttyUSB0', 115200)
+	profile = None
+	if timing_profile:
+		profile = timing.load_profile(timing_profile)
+		resolution = timing.STEPS_PER_TICK[profile['resolution']]
+	actual = set_resolution(resolution)
+	if profile and (actual != resolution or dead_time !=
+			(profile['resolution'] == timing.RESOLUTION_96MHZ_DEAD_TIME)):
+		print('Glitcher cannot do the resolution of %s.' % timing_profile)
+		sys.exit(1)
+	resolution = actual
+	set_swd_oracle(swd_oracle)
 	gdb.set_parameter(name='pagination', value='off')
 	gdb.execute('file ../src-lpc/test-lpc.elf')
-	gdb.execute('target extended-remote :3333')
+	if not swd_oracle:
+		gdb.execute('target extended-remote :3333')
+
+def set_swd_oracle(enable):
+	'''Let the AVR check SWD after every glitch, or not.'''
+	avr.write(b'S%d\n' % enable)
+	for line in avr:
+		if b'DONE' in line:
+			break
+		trace(b'avr: ' + line)
+
+def attach_probe():
+	'''Attach the debug probe, after the SWD oracle saw a hit.'''
+	start_ocd()
+	try:
+		gdb.execute('target extended-remote :3333')
+	except gdb.error as err:
+		print('GDB error ', err)
+
+def set_resolution(steps_per_tick):
+	'''Ask the AVR for a resolution, return the one it actually uses.'''
+	global dead_time
+	avr.write(b'R%d\n' % steps_per_tick)
+	actual = 1
+	for line in avr:
+		if line.startswith(b'FALLBACK'):
+			print('Glitcher cannot do resolution %d, falling back.' % steps_per_tick)
+		if line.startswith(b'RESOLUTION '):
+			actual = int(line.split()[1].rstrip(b':'))
+			dead_time = b'DEAD TIME' in line
+		if b'DONE' in line:
+			break
+		trace(b'avr: ' + line)
+	return actual
 
 def pre_glitch_setup():
 	try:
@@ -73,18 +145,32 @@ def pre_glitch_setup():
 		sys.exit(42)
 
 def glitch(post_reset_delay, glitch_duration):
-	'''Attempt a glitch through the AVR.'''
+	'''Attempt a glitch through the AVR. Returns the attempt status byte
+	of the SWD oracle, or None if the oracle is off (or the profile
+	cannot do this glitch: like a FAIL of the glitcher).'''
 	global avr
 	trace('start glitch attempt')
+	status = None
 	if True:
-		command = b'G%d,%d\n' % (post_reset_delay, glitch_duration)
+		if profile:
+			try:
+				command = timing.compile_steps(post_reset_delay,
+					glitch_duration, profile).command()
+			except ValueError as err:
+				trace('timing: %s' % err)
+				return None
+		else:
+			command = b'G%d,%d\n' % (post_reset_delay, glitch_duration)
 		avr.write(command)
 		#print('avr write: %s' % command)
 		for line in avr:
-			if b'DONE' in line:
+			if line.startswith(b'STATUS '):
+				status = chr(line[7])
+			if b'DONE' in line or b'FAIL' in line:
 				break
 			trace(b'avr: ' + line)
 	trace('glitch attempt done')
+	return status
 
 def check_glitch():
 	gdb.execute('monitor halt 0', to_string=True)
@@ -115,19 +201,41 @@ def check_glitch():
 	return '?'
 
 def main_iteration(post_reset_delay, glitch_duration):
+	global no_status
+	if swd_oracle:
+		status = glitch(post_reset_delay, glitch_duration)
+		if status is None:
+			no_status += 1
+			return NO_STATUS
+		if status == '!':
+			attach_probe()
+		return status
 	pre_glitch_setup()
 	glitch(post_reset_delay, glitch_duration)
 	return check_glitch()
 
+def post_reset_delays():
+	'''Post-reset delays to sweep, in 48 MHz ticks. Measured by
+	calibrate-boot.py if available.'''
+	try:
+		with open('boot-timing.json') as f:
+			timing = json.load(f)
+		return range(timing['sweep_start'], timing['sweep_end'] + 1)
+	except FileNotFoundError:
+		return range(9900, 9909)
+
 def main():
 	init()
+	delays = post_reset_delays()
 	while True:
-		for post_reset_delay in range(9900, 9909):
+		for post_reset_delay in range(delays.start * resolution, delays.stop * resolution):
 			sys.stdout.write('post-reset delay %4d: ' % post_reset_delay)
-			for glitch_duration in range(135, 265):
+			for glitch_duration in range(135 * resolution, 265 * resolution):
 				status = main_iteration(post_reset_delay, glitch_duration)
 				sys.stdout.write(status)
 				sys.stdout.flush()
+			if no_status:
+				sys.stdout.write(' (%d without status so far)' % no_status)
 			print()
 
 if __name__ == '__main__':
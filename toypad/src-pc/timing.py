@@ -0,0 +1,188 @@
+#!/usr/bin/env python3
+# Timing compiler for the glitcher. Turns a glitch (offset from the end
+# of the reset pulse, and width, both in ns) into the raw timer registers
+# for the glitcher's T command:
+#
+#   T<TCNT1>,<TCNT4>,<OCR4B>,<DT4>,<TCCR4B>
+#
+# This is the same arithmetic command G does on the AVR (see
+# command_glitch() in src-avr/glitcher.cpp), but every constant comes
+# from a per-board profile (profiles/*.json), so a rig can be calibrated
+# without reflashing the glitcher:
+#
+#   resolution                        "48mhz", "96mhz" or
+#                                     "96mhz-dead-time" (see command R).
+#   cpu_hz                            Clock of the ATmega32U4.
+#   timer1_start_cpu_cycles           CPU cycles between releasing the
+#                                     reset and starting timer 1.
+#   timer1_interrupt_cpu_cycles       CPU cycles between the overflow of
+#                                     timer 1 and starting timer 4.
+#   min_timer4_ticks_before_overflow  Timer 4 ticks the interrupt of
+#                                     timer 4 gets to stop the timer.
+#   timer4_interrupt_cpu_cycles       CPU cycles between the end of the
+#                                     glitch and stopping timer 4. The
+#                                     glitch must end this long before
+#                                     timer 4 wraps around, or it gives
+#                                     a second glitch.
+#   offset_correction_ns              Measured error of the offset
+#                                     (achieved - requested), e.g. with
+#                                     the oscilloscope or
+#                                     src-avr/sim/glitcher-bench.
+#   width_correction_ns               Same for the width (e.g. the rise
+#                                     and fall time of the MOSFETs).
+#
+# The defaults (profiles/default.json) give exactly the registers of
+# command G.
+#
+# Usage: ./timing.py <profile> <offset ns> <width ns>
+
+import json
+import sys
+
+RESOLUTION_48MHZ = '48mhz'
+RESOLUTION_96MHZ_DEAD_TIME = '96mhz-dead-time'
+RESOLUTION_96MHZ = '96mhz'
+
+# Steps per 48 MHz tick, as in the R command of the glitcher.
+STEPS_PER_TICK = {
+	RESOLUTION_48MHZ: 1,
+	RESOLUTION_96MHZ_DEAD_TIME: 2,
+	RESOLUTION_96MHZ: 2,
+}
+
+# TCCR4B: CS4 bits, plus PSR4 to reset the prescaler in dead-time mode
+# (so the first tick of the divided clock is deterministic).
+TCCR4B_DIVIDER_1 = 0x01
+TCCR4B_DIVIDER_2_PSR4 = 0x42
+
+TIMER4_TOP = 1 << 10
+
+DEFAULT_PROFILE = {
+	'name': 'default',
+	'resolution': RESOLUTION_48MHZ,
+	'cpu_hz': 16000000,
+	'timer1_start_cpu_cycles': 3,
+	'timer1_interrupt_cpu_cycles': 17,
+	'min_timer4_ticks_before_overflow': 64,
+	'timer4_interrupt_cpu_cycles': 17,
+	'offset_correction_ns': 0.0,
+	'width_correction_ns': 0.0,
+}
+
+def load_profile(path):
+	'''Read a profile, missing keys get the default value.'''
+	profile = dict(DEFAULT_PROFILE)
+	with open(path) as f:
+		profile.update(json.load(f))
+	if profile['resolution'] not in STEPS_PER_TICK:
+		raise ValueError('Unknown resolution "%s" in %s' % (profile['resolution'], path))
+	return profile
+
+def step_hz(profile):
+	'''Frequency of one step (the unit of offset and width).'''
+	return 48000000 * STEPS_PER_TICK[profile['resolution']]
+
+class Registers:
+	'''Timer registers for command T, and the glitch they give.'''
+	def __init__(self, tcnt1, tcnt4, ocr4b, dt4, tccr4b, offset_ns, width_ns):
+		self.tcnt1 = tcnt1
+		self.tcnt4 = tcnt4
+		self.ocr4b = ocr4b
+		self.dt4 = dt4
+		self.tccr4b = tccr4b
+		self.offset_ns = offset_ns
+		self.width_ns = width_ns
+
+	def command(self):
+		return b'T%d,%d,%d,%d,%d\n' % (self.tcnt1, self.tcnt4,
+			self.ocr4b, self.dt4, self.tccr4b)
+
+	def __repr__(self):
+		return ('Registers(TCNT1=%d, TCNT4=%d, OCR4B=%d, DT4=0x%02x, TCCR4B=0x%02x, offset=%.1f ns, width=%.1f ns)' %
+			(self.tcnt1, self.tcnt4, self.ocr4b, self.dt4,
+			self.tccr4b, self.offset_ns, self.width_ns))
+
+def compile_steps(post_reset_steps, glitch_steps, profile = DEFAULT_PROFILE):
+	'''Registers for a glitch in steps of the profile's resolution, as
+	command G would compute them. Raises ValueError if the glitcher
+	cannot do it.'''
+	resolution = profile['resolution']
+	timer4_hz = 96000000 if resolution == RESOLUTION_96MHZ else 48000000
+	ticks_per_cpu_cycle = timer4_hz // profile['cpu_hz']
+	min_ticks = profile['min_timer4_ticks_before_overflow']
+
+	if resolution == RESOLUTION_96MHZ_DEAD_TIME:
+		# Timer 4 counts 48 MHz ticks, the dead time generator delays
+		# the rising edge by the odd half tick. The end of the glitch
+		# stays on a 48 MHz tick, so round it up.
+		dead = post_reset_steps & 1
+		post_reset_ticks = post_reset_steps >> 1
+		glitch_ticks = ((post_reset_steps + glitch_steps + 1) >> 1) - post_reset_ticks
+		achieved_glitch_steps = 2 * glitch_ticks - dead
+		tccr4b = TCCR4B_DIVIDER_2_PSR4
+	else:
+		dead = 0
+		post_reset_ticks = post_reset_steps
+		glitch_ticks = glitch_steps
+		achieved_glitch_steps = glitch_steps
+		tccr4b = TCCR4B_DIVIDER_1
+
+	# As command G: OCR4B is at least 1.
+	if glitch_steps <= 1 or glitch_ticks <= 1:
+		raise ValueError('Glitch too short: %d steps' % glitch_steps)
+	if post_reset_ticks <= min_ticks:
+		raise ValueError('Post reset delay too short: %d steps' % post_reset_steps)
+
+	post_reset_ticks -= min_ticks
+	timer1_ticks = post_reset_ticks // ticks_per_cpu_cycle
+	timer4_ticks = post_reset_ticks % ticks_per_cpu_cycle + min_ticks
+
+	timer1_ticks += profile['timer1_start_cpu_cycles']
+	if timer1_ticks <= profile['timer1_interrupt_cpu_cycles']:
+		raise ValueError('Post reset delay too short: %d steps' % post_reset_steps)
+	timer1_ticks -= profile['timer1_interrupt_cpu_cycles']
+	if timer1_ticks > 0xFFFF:
+		raise ValueError('Post reset delay too long: %d steps' % post_reset_steps)
+
+	tcnt4 = TIMER4_TOP - timer4_ticks
+	ocr4b = glitch_ticks - 1
+	if ocr4b + profile['timer4_interrupt_cpu_cycles'] * ticks_per_cpu_cycle >= TIMER4_TOP:
+		# Timer 4 counts on until the interrupt stops it, and would
+		# wrap around to a second glitch (see MAX_GLITCH_TICKS_48MHZ in
+		# src-avr/glitcher.hpp).
+		raise ValueError('Glitch too long: %d steps' % glitch_steps)
+
+	ns_per_step = 1e9 / step_hz(profile)
+	return Registers(
+		tcnt1 = (0x10000 - timer1_ticks) & 0xFFFF,
+		tcnt4 = tcnt4,
+		ocr4b = ocr4b,
+		dt4 = dead << 4,
+		tccr4b = tccr4b,
+		offset_ns = post_reset_steps * ns_per_step + profile['offset_correction_ns'],
+		width_ns = achieved_glitch_steps * ns_per_step + profile['width_correction_ns'],
+	)
+
+def compile(offset_ns, width_ns, profile = DEFAULT_PROFILE):
+	'''Registers for the glitch closest to offset_ns (from the end of the
+	reset pulse) and width_ns, corrected with the profile.'''
+	ns_per_step = 1e9 / step_hz(profile)
+	post_reset_steps = round((offset_ns - profile['offset_correction_ns']) / ns_per_step)
+	glitch_steps = round((width_ns - profile['width_correction_ns']) / ns_per_step)
+	return compile_steps(post_reset_steps, glitch_steps, profile)
+
+def main():
+	if len(sys.argv) != 4:
+		print('Usage: %s <profile> <offset ns> <width ns>' % sys.argv[0])
+		sys.exit(1)
+	profile = load_profile(sys.argv[1])
+	try:
+		registers = compile(float(sys.argv[2]), float(sys.argv[3]), profile)
+	except ValueError as err:
+		print(err)
+		sys.exit(1)
+	print(registers)
+	sys.stdout.write(registers.command().decode())
+
+if __name__ == '__main__':
+	main()
@@ -0,0 +1,41 @@
+#!/usr/bin/env python3
+
+import crp_replica
+import unittest
+
+from crp_replica import Bypass, Status
+
+
+
+class TestCrpReplica(unittest.TestCase):
+	def test_encode(self):
+		self.assertEqual(crp_replica.encode(Bypass(0x102, 0x43218766)),
+			bytes((0xFB, 0x02, 0x01, 0, 0, 0x66, 0x87, 0x21, 0x43,
+				0x02 ^ 0x01 ^ 0x66 ^ 0x87 ^ 0x21 ^ 0x43)))
+		self.assertEqual(len(crp_replica.encode(Status(0, 0, 0))), 11)
+
+	def test_round_trip(self):
+		records = [Status(0, 0, 0), Bypass(17, 0x43218766),
+			Bypass(20, 0), Status(65536, 2, 1)]
+		data = b''.join(crp_replica.encode(r) for r in records)
+		parser = crp_replica.Parser()
+		parsed = []
+		for b in data:
+			parsed += parser.feed(bytes((b,)))
+		self.assertEqual(parsed, records)
+		self.assertEqual(parser.skipped, 0)
+
+	def test_resync(self):
+		good = crp_replica.encode(Bypass(5, 1))
+		corrupt = bytearray(good)
+		corrupt[3] ^= 0x40
+		parser = crp_replica.Parser()
+		self.assertEqual(parser.feed(b'\x00' + bytes(corrupt) + good), [Bypass(5, 1)])
+		self.assertEqual(parser.skipped, 1 + len(corrupt))
+
+	def test_classify(self):
+		self.assertEqual(crp_replica.classify(Bypass(1, crp_replica.REPLICA_CRP3)), 'branch')
+		self.assertEqual(crp_replica.classify(Bypass(1, 0x87654320)), 'corrupt')
+
+if __name__ == '__main__':
+	unittest.main()
@@ -0,0 +1,73 @@
+#!/usr/bin/env python3
+
+import fault_records
+import io
+import unittest
+
+from fault_records import MAGIC, Record
+
+
+
+BOOT = Record(0, 0, 0, {})
+
+class TestFaultRecords(unittest.TestCase):
+	def test_encode(self):
+		# Exactly what send_fault_record() builds.
+		record = Record(5, 3, 0, {3: 0x015ac37e})
+		self.assertEqual(fault_records.encode(record),
+			bytes((0xFA, 5, 3, 0x08, 0, 0x7e, 0xc3, 0x5a, 0x01,
+				5 ^ 3 ^ 0x08 ^ 0x7e ^ 0xc3 ^ 0x5a ^ 0x01)))
+		self.assertEqual(len(fault_records.encode(BOOT)), 6)
+
+	def test_round_trip(self):
+		records = [BOOT, Record(1, 6, 0, {}),
+			Record(2, 1, 3, {0: 0, 6: 0xffffffff}),
+			Record(3, 2, 0, {i: i for i in range(7)})]
+		data = b''.join(fault_records.encode(r) for r in records)
+		parser = fault_records.Parser()
+		# Byte by byte: records split over reads.
+		parsed = []
+		for b in data:
+			parsed += parser.feed(bytes((b,)))
+		self.assertEqual(parsed, records)
+		self.assertEqual(parser.skipped, 0)
+
+	def test_resync(self):
+		record = Record(7, 4, 0, {4: MAGIC ^ 0x10})
+		good = fault_records.encode(record)
+		corrupt = bytearray(good)
+		corrupt[6] ^= 1
+		parser = fault_records.Parser()
+		parsed = parser.feed(b'E?' + bytes(corrupt) + b'\xfa' + good)
+		self.assertEqual(parsed, [record])
+		# The stray sync as well.
+		self.assertEqual(parser.bad_checksums, 2)
+		self.assertEqual(parser.skipped, 2 + len(corrupt) + 1)
+
+	def test_classify(self):
+		self.assertEqual(fault_records.classify(BOOT), 'boot')
+		self.assertEqual(fault_records.classify(Record(1, 6, 0, {})), 'skip')
+		self.assertEqual(fault_records.classify(Record(1, 1, 0, {0: 0, 1: 0})), 'reference')
+		self.assertEqual(fault_records.classify(Record(1, 1, 0, {1: 0})), 'register')
+
+	def test_summary(self):
+		summary = fault_records.Summary()
+		for record in (BOOT, Record(1, 2, 0, {2: MAGIC & ~1}),
+				Record(2, 6, 0, {}), Record(5, 6, 4, {6: MAGIC | 0x80000000}),
+				BOOT, Record(1, 6, 0, {})):
+			summary.add(record)
+		self.assertEqual(summary.faults, 4)
+		self.assertEqual(summary.classes['boot'], 2)
+		self.assertEqual(summary.classes['register'], 2)
+		self.assertEqual(summary.classes['skip'], 2)
+		self.assertEqual(summary.missing, 2)
+		self.assertEqual(summary.dropped, 4)
+		self.assertEqual(summary.compares[6], 3)
+		self.assertEqual(summary.to_zero[0], 1)
+		self.assertEqual(summary.to_one[31], 1)
+		out = io.StringIO()
+		summary.print(out)
+		self.assertIn('faults: 4, boots: 2', out.getvalue())
+
+if __name__ == '__main__':
+	unittest.main()
@@ -0,0 +1,122 @@
+#!/usr/bin/env python3
+
+import flash_dump
+import struct
+import unittest
+
+
+
+def make_image(size = 4096):
+	'''Vector table with a valid checksum, then a pattern.'''
+	vectors = [0x10000ffc, 0x401, 0, 0, 0, 0, 0]
+	vectors.append(-sum(vectors) & 0xFFFFFFFF)
+	image = struct.pack('<8I', *vectors)
+	return image + bytes(i * 7 & 0xFF for i in range(size - len(image)))
+
+class FakeDumper:
+	'''The protocol of src-lpc/flash-dumper, with a lossy line: the
+	first answer for every block in damage is damaged. Like the firmware
+	it reads commands only while it sends nothing, through a receive FIFO
+	of 16 bytes; the bytes that do not fit are lost (and counted).'''
+
+	FIFO_SIZE = 16
+
+	def __init__(self, image, block_size = 256, damage = ()):
+		self.image = image
+		self.block_size = block_size
+		self.damage = set(damage)
+		self.out = bytearray()
+		self.fifo = bytearray()
+		self.overruns = 0
+		self.requests = []
+
+	def block(self, index):
+		data = self.image[index * self.block_size:(index + 1) * self.block_size]
+		frame = bytearray(flash_dump.encode_block(index, data))
+		if index in self.damage:
+			self.damage.discard(index)
+			frame[100] ^= 0x01
+		self.out += frame
+
+	def serve(self):
+		'''Take commands out of the FIFO until there is something to send.'''
+		while self.fifo and not self.out:
+			command = self.fifo[0]
+			if command == ord('H'):
+				self.out += flash_dump.encode_hello(len(self.image), self.block_size)
+				del self.fifo[:1]
+			elif command == ord('A'):
+				for index in range(len(self.image) // self.block_size):
+					self.block(index)
+				del self.fifo[:1]
+			elif command == ord('B'):
+				if len(self.fifo) < 3:
+					break
+				index, = struct.unpack('<H', self.fifo[1:3])
+				self.requests.append(index)
+				if index < len(self.image) // self.block_size:
+					self.block(index)
+				del self.fifo[:3]
+			else:
+				del self.fifo[:1]
+
+	def write(self, data):
+		for byte in data:
+			self.serve()
+			if len(self.fifo) < self.FIFO_SIZE:
+				self.fifo.append(byte)
+			else:
+				self.overruns += 1
+		self.serve()
+
+	def read(self, n):
+		data = bytes(self.out[:n])
+		del self.out[:n]
+		self.serve()
+		return data
+
+class TestFlashDump(unittest.TestCase):
+	def test_clean(self):
+		image = make_image()
+		dumper = FakeDumper(image)
+		self.assertEqual(flash_dump.dump(dumper, timeout = 0.05), image)
+		self.assertEqual(dumper.requests, [])
+		self.assertTrue(flash_dump.vector_checksum_ok(image))
+
+	def test_requests_damaged_blocks(self):
+		image = make_image()
+		dumper = FakeDumper(image, damage = (0, 3, 15))
+		self.assertEqual(flash_dump.dump(dumper, timeout = 0.05), image)
+		self.assertEqual(sorted(dumper.requests), [0, 3, 15])
+
+	def test_requests_many_blocks(self):
+		# More requests than the receive FIFO of the dumper holds.
+		image = make_image(64 * 256)
+		damage = range(2, 64, 3)
+		dumper = FakeDumper(image, damage = damage)
+		self.assertEqual(flash_dump.dump(dumper, timeout = 0.05), image)
+		self.assertEqual(sorted(dumper.requests), list(damage))
+		self.assertEqual(dumper.overruns, 0)
+
+	def test_gives_up(self):
+		class Broken(FakeDumper):
+			def block(self, index):
+				if index != 2:
+					FakeDumper.block(self, index)
+		dumper = Broken(make_image())
+		self.assertRaises(RuntimeError, flash_dump.dump, dumper, 0.01)
+		self.assertEqual(dumper.requests, [2] * flash_dump.MAX_REQUESTS)
+
+	def test_resync(self):
+		parser = flash_dump.Parser()
+		hello = flash_dump.encode_hello(32768, 256)
+		frames = parser.feed(b'garbage\xd5' + hello)
+		self.assertEqual(frames, [('H', 32768, 256)])
+
+	def test_vector_checksum(self):
+		image = bytearray(make_image())
+		image[4] ^= 0x10
+		self.assertFalse(flash_dump.vector_checksum_ok(bytes(image)))
+
+if __name__ == '__main__':
+	unittest.main()
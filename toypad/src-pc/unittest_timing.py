@@ -0,0 +1,117 @@
+#!/usr/bin/env python3
+
+import os
+import timing
+import unittest
+
+
+
+PROFILES = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'profiles')
+
+def firmware_glitch(post_reset_delay, glitch_duration, resolution):
+	'''The arithmetic of command G in src-avr/glitcher.cpp, step by step.
+	None if G says the glitch is too short.'''
+	if resolution == timing.RESOLUTION_96MHZ_DEAD_TIME:
+		dead = post_reset_delay & 1
+		post_ticks = post_reset_delay >> 1
+		glitch_ticks = ((post_reset_delay + glitch_duration + 1) >> 1) - post_ticks
+		ratio = 3
+		cs4 = 0x42
+	else:
+		dead = 0
+		post_ticks = post_reset_delay
+		glitch_ticks = glitch_duration
+		ratio = 6 if resolution == timing.RESOLUTION_96MHZ else 3
+		cs4 = 0x01
+	if glitch_duration <= 1 or glitch_ticks <= 1:
+		return None
+	post_ticks -= 64
+	timer1_ticks = post_ticks // ratio + 3 - 17
+	timer4_ticks = post_ticks % ratio + 64
+	return ((0x10000 - timer1_ticks) & 0xFFFF, 1024 - timer4_ticks,
+		glitch_ticks - 1, dead << 4, cs4)
+
+def as_tuple(registers):
+	return (registers.tcnt1, registers.tcnt4, registers.ocr4b,
+		registers.dt4, registers.tccr4b)
+
+class TestTiming(unittest.TestCase):
+	def test_default_profile_file(self):
+		profile = timing.load_profile(os.path.join(PROFILES, 'default.json'))
+		for key, value in timing.DEFAULT_PROFILE.items():
+			if key != 'name':
+				self.assertEqual(profile[key], value)
+
+	def test_all_profiles_load(self):
+		for name in os.listdir(PROFILES):
+			profile = timing.load_profile(os.path.join(PROFILES, name))
+			self.assertIn(profile['resolution'], timing.STEPS_PER_TICK)
+
+	def test_known_glitch(self):
+		# 57 us after reset, 200 ticks wide (see the README).
+		registers = timing.compile(57000, 200 / 48e-3)
+		self.assertEqual(as_tuple(registers), (64660, 958, 199, 0, 0x01))
+		self.assertEqual(registers.command(), b'T64660,958,199,0,1\n')
+		self.assertAlmostEqual(registers.offset_ns, 57000)
+
+	def test_same_as_firmware(self):
+		for resolution in timing.STEPS_PER_TICK:
+			profile = dict(timing.DEFAULT_PROFILE, resolution = resolution)
+			for post_reset_delay in range(400, 20000, 37):
+				for glitch_duration in (1, 2, 3, 135, 264, 501):
+					expected = firmware_glitch(post_reset_delay, glitch_duration, resolution)
+					if expected is None:
+						self.assertRaises(ValueError, timing.compile_steps,
+							post_reset_delay, glitch_duration, profile)
+						continue
+					registers = timing.compile_steps(post_reset_delay, glitch_duration, profile)
+					self.assertEqual(as_tuple(registers), expected)
+
+	def test_dead_time_odd_offset(self):
+		profile = dict(timing.DEFAULT_PROFILE, resolution = timing.RESOLUTION_96MHZ_DEAD_TIME)
+		even = timing.compile_steps(2000, 100, profile)
+		odd = timing.compile_steps(2001, 100, profile)
+		self.assertEqual(even.dt4, 0x00)
+		self.assertEqual(odd.dt4, 0x10)
+		self.assertEqual(even.tcnt1, odd.tcnt1)
+		self.assertEqual(even.tcnt4, odd.tcnt4)
+		# The end stays on a 48 MHz tick: rounded up to 2102 steps.
+		self.assertAlmostEqual(odd.width_ns, 101 / 96e-3)
+
+	def test_corrections(self):
+		profile = dict(timing.DEFAULT_PROFILE,
+			offset_correction_ns = 100.0, width_correction_ns = -50.0)
+		registers = timing.compile(57100, 200 / 48e-3 - 50, profile)
+		self.assertEqual(as_tuple(registers), (64660, 958, 199, 0, 0x01))
+		self.assertAlmostEqual(registers.offset_ns, 57100)
+		self.assertAlmostEqual(registers.width_ns, 200 / 48e-3 - 50)
+
+	def test_too_short(self):
+		self.assertRaises(ValueError, timing.compile_steps, 64, 10)
+		self.assertRaises(ValueError, timing.compile_steps, 100, 10)
+		self.assertRaises(ValueError, timing.compile_steps, 10000, 0)
+		# Command G rejects a glitch of 1 step too.
+		for resolution in timing.STEPS_PER_TICK:
+			profile = dict(timing.DEFAULT_PROFILE, resolution = resolution)
+			self.assertRaises(ValueError, timing.compile_steps, 10000, 1, profile)
+			timing.compile_steps(10000, 3, profile)
+
+	def test_too_long(self):
+		# At 48 MHz timer 4 counts 3 * 17 ticks after the end of the
+		# glitch: MAX_GLITCH_TICKS_48MHZ (973) in src-avr/glitcher.hpp.
+		self.assertRaises(ValueError, timing.compile_steps, 10000, 1024 - 51 + 1)
+		self.assertRaises(ValueError, timing.compile_steps, 3 * 0x10000 + 200, 100)
+		self.assertEqual(timing.compile_steps(10000, 1024 - 51).ocr4b, 1024 - 51 - 1)
+
+	def test_second_glitch(self):
+		# At 96 MHz timer 4 counts 6 * 17 ticks after the end of the
+		# glitch before it is stopped: OCR4B + 102 must stay below 1024.
+		profile = dict(timing.DEFAULT_PROFILE, resolution = timing.RESOLUTION_96MHZ)
+		registers = timing.compile_steps(10000, 1024 - 102, profile)
+		self.assertEqual(registers.ocr4b, 1024 - 102 - 1)
+		self.assertRaises(ValueError, timing.compile_steps, 10000, 1024 - 101, profile)
+		profile = dict(profile, resolution = timing.RESOLUTION_96MHZ_DEAD_TIME)
+		timing.compile_steps(10000, 2 * 900, profile)
+
+if __name__ == '__main__':
+	unittest.main()